@@ -1398,6 +1398,8 @@ bool OBSBasic::InitBasicConfigDefaults()
 	config_set_default_string(basicConfig, "Video", "ColorSpace", "709");
 	config_set_default_string(basicConfig, "Video", "ColorRange",
 				  "Partial");
+	config_set_default_uint(basicConfig, "Video", "ReadbackDelay", 1);
+	config_set_default_uint(basicConfig, "Video", "ZeroCopySurfaces", 1);
 
 	config_set_default_string(basicConfig, "Audio", "MonitoringDeviceId",
 				  "default");
@@ -3945,6 +3947,15 @@ int OBSBasic::ResetVideo()
 	ovi.gpu_conversion = true;
 	ovi.scale_type = GetScaleType(basicConfig);
 
+	uint32_t readbackDelay =
+		config_get_uint(basicConfig, "Video", "ReadbackDelay");
+	obs_set_video_readback_delay(readbackDelay);
+
+	/* 1 staging surface (the default) disables zero-copy */
+	uint32_t zeroCopySurfaces =
+		config_get_uint(basicConfig, "Video", "ZeroCopySurfaces");
+	obs_set_video_zero_copy(zeroCopySurfaces > 1, zeroCopySurfaces);
+
 	if (ovi.base_width < 8 || ovi.base_height < 8) {
 		ovi.base_width = 1920;
 		ovi.base_height = 1080;
@@ -542,6 +542,8 @@ OBSBasicSettings::OBSBasicSettings(QWidget *parent)
 	HookWidget(ui->colorFormat,          COMBO_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->colorSpace,           COMBO_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->colorRange,           COMBO_CHANGED,  ADV_CHANGED);
+	HookWidget(ui->readbackDelay,        SCROLL_CHANGED, ADV_CHANGED);
+	HookWidget(ui->zeroCopySurfaces,     SCROLL_CHANGED, ADV_CHANGED);
 	HookWidget(ui->disableOSXVSync,      CHECK_CHANGED,  ADV_CHANGED);
 	HookWidget(ui->resetOSXVSync,        CHECK_CHANGED,  ADV_CHANGED);
 #if defined(_WIN32) || defined(__APPLE__) || HAVE_PULSEAUDIO
@@ -2416,6 +2418,10 @@ void OBSBasicSettings::LoadAdvancedSettings()
 		config_get_string(main->Config(), "Video", "ColorSpace");
 	const char *videoColorRange =
 		config_get_string(main->Config(), "Video", "ColorRange");
+	int readbackDelay =
+		config_get_int(main->Config(), "Video", "ReadbackDelay");
+	int zeroCopySurfaces =
+		config_get_int(main->Config(), "Video", "ZeroCopySurfaces");
 #if defined(_WIN32) || defined(__APPLE__) || HAVE_PULSEAUDIO
 	const char *monDevName = config_get_string(main->Config(), "Audio",
 						   "MonitoringDeviceName");
@@ -2480,6 +2486,8 @@ void OBSBasicSettings::LoadAdvancedSettings()
 	SetComboByName(ui->colorFormat, videoColorFormat);
 	SetComboByName(ui->colorSpace, videoColorSpace);
 	SetComboByValue(ui->colorRange, videoColorRange);
+	ui->readbackDelay->setValue(readbackDelay);
+	ui->zeroCopySurfaces->setValue(zeroCopySurfaces);
 
 	if (!SetComboByValue(ui->bindToIP, bindIP))
 		SetInvalidValue(ui->bindToIP, bindIP, bindIP);
@@ -3166,6 +3174,8 @@ void OBSBasicSettings::SaveAdvancedSettings()
 	SaveCombo(ui->colorFormat, "Video", "ColorFormat");
 	SaveCombo(ui->colorSpace, "Video", "ColorSpace");
 	SaveComboData(ui->colorRange, "Video", "ColorRange");
+	SaveSpinBox(ui->readbackDelay, "Video", "ReadbackDelay");
+	SaveSpinBox(ui->zeroCopySurfaces, "Video", "ZeroCopySurfaces");
 #if defined(_WIN32) || defined(__APPLE__) || HAVE_PULSEAUDIO
 	SaveCombo(ui->monitoringDevice, "Audio", "MonitoringDeviceName");
 	SaveComboData(ui->monitoringDevice, "Audio", "MonitoringDeviceId");
@@ -555,6 +555,8 @@ struct gs_stage_surface {
 	GLint gl_internal_format;
 	GLenum gl_type;
 	GLuint pack_buffer;
+	/* signaled once the last copy to pack_buffer completed */
+	GLsync fence;
 };
 
 struct gs_zstencil_buffer {
@@ -766,6 +766,9 @@ EXPORT bool gs_stagesurface_map(gs_stagesurf_t *stagesurf, uint8_t **data,
 				uint32_t *linesize);
 EXPORT void gs_stagesurface_unmap(gs_stagesurf_t *stagesurf);
 
+/** returns true if mapping would not wait for the last staged copy */
+EXPORT bool gs_stagesurface_ready(gs_stagesurf_t *stagesurf);
+
 EXPORT void gs_zstencil_destroy(gs_zstencil_t *zstencil);
 
 EXPORT void gs_samplerstate_destroy(gs_samplerstate_t *samplerstate);
@@ -33,11 +33,38 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 
 #define MAX_CONVERT_BUFFERS 3
 #define MAX_CACHE_SIZE 16
+#define DEFAULT_INPUT_QUEUE_SIZE 2
+#define MAX_INPUT_QUEUE_SIZE 8
+#define ZERO_COPY_BACKOFF_FRAMES 60
 
 struct cached_frame_info {
 	struct video_data frame;
 	int skipped;
 	int count;
+
+	/* queued to inputs that are not done with it yet, reusable at 0 once
+	 * no longer queued for the video thread */
+	volatile long refs;
+	bool queued;
+
+	/* video_output_push_frame: planes used instead of those of |frame|,
+	 * released with the last of |shared_refs|. The video thread holds one
+	 * until the frame is queued, each input it is shared with one until
+	 * done reading it. Lagging inputs get a copy in |frame| instead. */
+	uint8_t *shared_data[MAX_AV_PLANES];
+	uint32_t shared_linesize[MAX_AV_PLANES];
+	volatile long shared_refs;
+	bool copied;
+	void (*release)(void *param);
+	void *release_param;
+};
+
+/* Frame queued to an input, output |count| times */
+struct input_frame {
+	struct cached_frame_info *cfi;
+	struct video_data frame;
+	volatile long count;
+	bool shared;
 };
 
 struct video_input {
@@ -48,14 +75,30 @@ struct video_input {
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
-};
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
+	/* Worker thread of the input, fed by the video thread through a
+	 * single producer single consumer queue. A lagging input repeats its
+	 * last queued frame, the others are not held back by it. */
+	struct video_output *video;
+	pthread_t thread;
+	bool thread_initialized;
+	os_sem_t *semaphore;
+	volatile bool stop;
+	volatile bool exited;
+	volatile bool busy;
+
+	struct input_frame queue[MAX_INPUT_QUEUE_SIZE];
+	size_t queue_size;
+	volatile long queue_head; /* worker */
+	volatile long queue_tail; /* video thread */
+
+	volatile long skipped_frames;
+	volatile long total_frames;
+
+	/* video thread: zero-copy frames still copied since it last lagged */
+	long copy_frames;
+	long copied_frames;
+};
 
 struct video_output {
 	struct video_output_info info;
@@ -72,11 +115,19 @@ struct video_output {
 	bool initialized;
 
 	pthread_mutex_t input_mutex;
-	DARRAY(struct video_input) inputs;
-
-	size_t available_frames;
-	size_t first_added;
-	size_t last_added;
+	DARRAY(struct video_input *) inputs;
+	/* disconnected from their own callback, joined once their worker
+	 * exited (or by video_output_close) */
+	DARRAY(struct video_input *) stopped_inputs;
+
+	/* cache entries: free ones, and the ones queued for the video thread
+	 * in output order. Inputs release theirs in any order. */
+	size_t free_frames[MAX_CACHE_SIZE];
+	size_t num_free;
+	size_t queued_frames[MAX_CACHE_SIZE];
+	size_t first_queued;
+	size_t num_queued;
+	size_t locked_frame;
 	struct cached_frame_info cache[MAX_CACHE_SIZE];
 
 	volatile bool raw_active;
@@ -116,17 +167,146 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
-static inline bool video_output_cur_frame(struct video_output *video)
+static inline struct cached_frame_info *
+last_queued_frame(struct video_output *video)
+{
+	size_t idx = (video->first_queued + video->num_queued - 1) %
+		     MAX_CACHE_SIZE;
+	return &video->cache[video->queued_frames[idx]];
+}
+
+static void release_frame(struct video_output *video,
+			  struct cached_frame_info *cfi)
+{
+	pthread_mutex_lock(&video->data_mutex);
+	if (os_atomic_dec_long(&cfi->refs) == 0 && !cfi->queued)
+		video->free_frames[video->num_free++] =
+			(size_t)(cfi - video->cache);
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
+/* the planes of video_output_push_frame are released with the last reader,
+ * before the cache entry itself */
+static inline void release_shared(struct cached_frame_info *cfi)
+{
+	if (os_atomic_dec_long(&cfi->shared_refs) == 0)
+		cfi->release(cfi->release_param);
+}
+
+/* video thread: whether |input| reads the zero-copy planes of |cfi|. An
+ * input still busy with earlier frames would hold them (and the stage
+ * surfaces behind them) for longer than a frame, so it gets a copy instead,
+ * and keeps getting copies for a while after that. */
+static bool share_planes(struct video_input *input,
+			 struct cached_frame_info *cfi, bool idle)
+{
+	if (!idle)
+		input->copy_frames = ZERO_COPY_BACKOFF_FRAMES;
+	else if (input->copy_frames > 0)
+		input->copy_frames--;
+
+	if (!input->copy_frames)
+		return true;
+
+	if (!cfi->copied) {
+		struct video_output *video = input->video;
+		struct video_frame src;
+
+		memcpy(src.data, cfi->shared_data, sizeof(src.data));
+		memcpy(src.linesize, cfi->shared_linesize,
+		       sizeof(src.linesize));
+		video_frame_copy((struct video_frame *)&cfi->frame, &src,
+				 video->info.format, video->info.height);
+		cfi->copied = true;
+	}
+
+	input->copied_frames++;
+	return false;
+}
+
+/* video thread, call with input_mutex held. Queues |cfi| once, to be output
+ * |count| times. Returns false if the input lagged, its last queued frame is
+ * then repeated |count| more times instead. */
+static bool queue_input_frame(struct video_input *input,
+			      struct cached_frame_info *cfi, long count)
+{
+	long head = os_atomic_load_long(&input->queue_head);
+	long tail = input->queue_tail;
+
+	for (long i = 0; i < count; i++)
+		os_atomic_inc_long(&input->total_frames);
+
+	if ((size_t)(tail - head) >= input->queue_size) {
+		/* lagging, repeat the last frame queued unless the worker
+		 * took it meanwhile (count 0), its slot is free then */
+		struct input_frame *last =
+			&input->queue[(tail - 1) % MAX_INPUT_QUEUE_SIZE];
+		long last_count;
+		do {
+			last_count = os_atomic_load_long(&last->count);
+		} while (last_count &&
+			 !os_atomic_compare_swap_long(&last->count, last_count,
+						      last_count + count));
+
+		if (last_count) {
+			for (long i = 0; i < count; i++)
+				os_atomic_inc_long(&input->skipped_frames);
+			return false;
+		}
+	}
+
+	bool idle = tail == head && !os_atomic_load_bool(&input->busy);
+
+	struct input_frame *item = &input->queue[tail % MAX_INPUT_QUEUE_SIZE];
+	item->cfi = cfi;
+	item->frame = cfi->frame;
+	item->shared = cfi->release && share_planes(input, cfi, idle);
+	if (item->shared) {
+		memcpy(item->frame.data, cfi->shared_data,
+		       sizeof(item->frame.data));
+		memcpy(item->frame.linesize, cfi->shared_linesize,
+		       sizeof(item->frame.linesize));
+		os_atomic_inc_long(&cfi->shared_refs);
+	}
+	os_atomic_set_long(&item->count, count);
+	os_atomic_inc_long(&cfi->refs);
+
+	os_atomic_set_long(&input->queue_tail, tail + 1);
+	os_sem_post(input->semaphore);
+	return true;
+}
+
+/* video thread: hands the next queued frame to the inputs, once, with its
+ * repeat count */
+static inline void video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
-	bool complete;
-	bool skipped;
+	bool shared;
+	long count;
+	long skipped;
+	long lagged = 0;
 
 	/* -------------------------------- */
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	frame_info = &video->cache[video->first_added];
+	if (!video->num_queued) {
+		pthread_mutex_unlock(&video->data_mutex);
+		return;
+	}
+
+	/* dequeued now, so its count no longer changes; held by the video
+	 * thread until it was queued to the inputs */
+	frame_info = &video->cache[video->queued_frames[video->first_queued]];
+	video->first_queued = (video->first_queued + 1) % MAX_CACHE_SIZE;
+	video->num_queued--;
+	frame_info->queued = false;
+	os_atomic_inc_long(&frame_info->refs);
+
+	shared = frame_info->release != NULL;
+	count = frame_info->count;
+	skipped = frame_info->skipped < count ? frame_info->skipped
+					      : count - 1;
 
 	pthread_mutex_unlock(&video->data_mutex);
 
@@ -135,39 +315,28 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
-		struct video_data frame = frame_info->frame;
-
-		if (scale_video_output(input, &frame))
-			input->callback(input->param, &frame);
+		if (!queue_input_frame(video->inputs.array[i], frame_info,
+				       count))
+			lagged = count;
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
 
 	/* -------------------------------- */
 
-	pthread_mutex_lock(&video->data_mutex);
-
-	frame_info->frame.timestamp += video->frame_time;
-	complete = --frame_info->count == 0;
-	skipped = frame_info->skipped > 0;
+	if (shared)
+		release_shared(frame_info);
+	release_frame(video, frame_info);
 
-	if (complete) {
-		if (++video->first_added == video->info.cache_size)
-			video->first_added = 0;
+	/* the lag of the inputs is not summed: a frame counts as skipped
+	 * once, however many inputs repeat it */
+	if (lagged > skipped)
+		skipped = lagged;
 
-		if (++video->available_frames == video->info.cache_size)
-			video->last_added = video->first_added;
-	} else if (skipped) {
-		--frame_info->skipped;
+	for (long i = 0; i < count; i++)
+		os_atomic_inc_long(&video->total_frames);
+	for (long i = 0; i < skipped; i++)
 		os_atomic_inc_long(&video->skipped_frames);
-	}
-
-	pthread_mutex_unlock(&video->data_mutex);
-
-	/* -------------------------------- */
-
-	return complete;
 }
 
 static void *video_thread(void *param)
@@ -185,19 +354,138 @@ static void *video_thread(void *param)
 			break;
 
 		profile_start(video_thread_name);
-		while (!video->stop && !video_output_cur_frame(video)) {
-			os_atomic_inc_long(&video->total_frames);
+		video_output_cur_frame(video);
+		profile_end(video_thread_name);
+
+		profile_reenable_thread();
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void video_input_free(struct video_input *input)
+{
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
+		video_frame_free(&input->frame[i]);
+	video_scaler_destroy(input->scaler);
+	os_sem_destroy(input->semaphore);
+	bfree(input);
+}
+
+static void *input_thread(void *param)
+{
+	struct video_input *input = param;
+	struct video_output *video = input->video;
+
+	os_set_thread_name("video-io: input thread");
+
+	const char *input_thread_name =
+		profile_store_name(obs_get_profiler_name_store(),
+				   "video_input_thread(%s)", video->info.name);
+
+	while (os_sem_wait(input->semaphore) == 0) {
+		if (os_atomic_load_bool(&input->stop))
+			break;
+
+		long head = input->queue_head;
+		struct input_frame *item =
+			&input->queue[head % MAX_INPUT_QUEUE_SIZE];
+		struct cached_frame_info *cfi = item->cfi;
+		struct video_data frame = item->frame;
+		bool shared = item->shared;
+
+		/* taken: the video thread no longer repeats it, and can
+		 * reuse its slot */
+		os_atomic_set_bool(&input->busy, true);
+		long count = os_atomic_set_long(&item->count, 0);
+		os_atomic_set_long(&input->queue_head, head + 1);
+
+		profile_start(input_thread_name);
+		bool success = scale_video_output(input, &frame);
+
+		/* scaled frames no longer read the shared planes */
+		if (shared && input->scaler) {
+			release_shared(cfi);
+			shared = false;
 		}
 
-		os_atomic_inc_long(&video->total_frames);
-		profile_end(video_thread_name);
+		if (success) {
+			for (long i = 0;
+			     i < count && !os_atomic_load_bool(&input->stop);
+			     i++) {
+				input->callback(input->param, &frame);
+				frame.timestamp += video->frame_time;
+			}
+		}
+		profile_end(input_thread_name);
+
+		if (shared)
+			release_shared(cfi);
+		release_frame(video, cfi);
+		os_atomic_set_bool(&input->busy, false);
 
 		profile_reenable_thread();
 	}
 
+	/* frames it did not get to, no more are queued once stopped */
+	long head = input->queue_head;
+	long tail = os_atomic_load_long(&input->queue_tail);
+	for (long i = head; i < tail; i++) {
+		struct input_frame *item =
+			&input->queue[i % MAX_INPUT_QUEUE_SIZE];
+		if (item->shared)
+			release_shared(item->cfi);
+		release_frame(video, item->cfi);
+	}
+
+	/* |video| is not used past this point */
+	os_atomic_set_bool(&input->exited, true);
 	return NULL;
 }
 
+/* call once the input is no longer connected, its callback is not called
+ * anymore when this returns (unless called from it) */
+static void video_input_stop(struct video_input *input)
+{
+	if (!input->thread_initialized) {
+		video_input_free(input);
+		return;
+	}
+
+	os_atomic_set_bool(&input->stop, true);
+	os_sem_post(input->semaphore);
+
+	if (pthread_equal(pthread_self(), input->thread)) {
+		/* disconnected from its own callback, joined later */
+		struct video_output *video = input->video;
+
+		pthread_mutex_lock(&video->input_mutex);
+		da_push_back(video->stopped_inputs, &input);
+		pthread_mutex_unlock(&video->input_mutex);
+		return;
+	}
+
+	pthread_join(input->thread, NULL);
+	video_input_free(input);
+}
+
+/* call with input_mutex held, frees the inputs stopped from their own
+ * callback whose worker has exited */
+static void reap_stopped_inputs(struct video_output *video)
+{
+	for (size_t i = video->stopped_inputs.num; i > 0; i--) {
+		struct video_input *input = video->stopped_inputs.array[i - 1];
+		if (!os_atomic_load_bool(&input->exited))
+			continue;
+
+		pthread_join(input->thread, NULL);
+		video_input_free(input);
+		da_erase(video->stopped_inputs, i - 1);
+	}
+}
+
 /* ------------------------------------------------------------------------- */
 
 static inline bool valid_video_params(const struct video_output_info *info)
@@ -217,9 +505,10 @@ static inline void init_cache(struct video_output *video)
 
 		video_frame_init(frame, video->info.format, video->info.width,
 				 video->info.height);
+		video->free_frames[i] = video->info.cache_size - 1 - i;
 	}
 
-	video->available_frames = video->info.cache_size;
+	video->num_free = video->info.cache_size;
 }
 
 int video_output_open(video_t **video, struct video_output_info *info)
@@ -235,6 +524,12 @@ int video_output_open(video_t **video, struct video_output_info *info)
 		goto fail;
 
 	memcpy(&out->info, info, sizeof(struct video_output_info));
+	if (!out->info.input_queue_size)
+		out->info.input_queue_size = DEFAULT_INPUT_QUEUE_SIZE;
+	else if (out->info.input_queue_size < 2)
+		out->info.input_queue_size = 2;
+	else if (out->info.input_queue_size > MAX_INPUT_QUEUE_SIZE)
+		out->info.input_queue_size = MAX_INPUT_QUEUE_SIZE;
 	out->frame_time =
 		util_mul_div64(1000000000ULL, info->fps_den, info->fps_num);
 	out->initialized = false;
@@ -254,6 +549,13 @@ int video_output_open(video_t **video, struct video_output_info *info)
 
 	init_cache(out);
 
+	/* a lagging input holds its queue and the frame in its callback, at
+	 * least one entry is left for the others */
+	size_t max_queue_size =
+		out->info.cache_size > 3 ? out->info.cache_size - 2 : 1;
+	if (out->info.input_queue_size > max_queue_size)
+		out->info.input_queue_size = max_queue_size;
+
 	out->initialized = true;
 	*video = out;
 	return VIDEO_OUTPUT_SUCCESS;
@@ -271,9 +573,24 @@ void video_output_close(video_t *video)
 	video_output_stop(video);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_stop(video->inputs.array[i]);
 	da_free(video->inputs);
 
+	/* wait for the workers still in the callback they disconnected from,
+	 * they release their frames to |video| when they exit */
+	DARRAY(struct video_input *) stopped;
+	da_init(stopped);
+
+	pthread_mutex_lock(&video->input_mutex);
+	da_move(stopped, video->stopped_inputs);
+	pthread_mutex_unlock(&video->input_mutex);
+
+	for (size_t i = 0; i < stopped.num; i++) {
+		pthread_join(stopped.array[i]->thread, NULL);
+		video_input_free(stopped.array[i]);
+	}
+	da_free(stopped);
+
 	for (size_t i = 0; i < video->info.cache_size; i++)
 		video_frame_free((struct video_frame *)&video->cache[i]);
 
@@ -289,7 +606,7 @@ static size_t video_get_input_idx(const video_t *video,
 				  void *param)
 {
 	for (size_t i = 0; i < video->inputs.num; i++) {
-		struct video_input *input = video->inputs.array + i;
+		struct video_input *input = video->inputs.array[i];
 		if (input->callback == callback && input->param == param)
 			return i;
 	}
@@ -351,28 +668,35 @@ bool video_output_connect(
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	reap_stopped_inputs(video);
+
 	if (video_get_input_idx(video, callback, param) == DARRAY_INVALID) {
-		struct video_input input;
-		memset(&input, 0, sizeof(input));
+		struct video_input *input = bzalloc(sizeof(*input));
 
-		input.callback = callback;
-		input.param = param;
+		input->callback = callback;
+		input->param = param;
+		input->video = video;
+		input->queue_size = video->info.input_queue_size;
 
 		if (conversion) {
-			input.conversion = *conversion;
+			input->conversion = *conversion;
 		} else {
-			input.conversion.format = video->info.format;
-			input.conversion.width = video->info.width;
-			input.conversion.height = video->info.height;
+			input->conversion.format = video->info.format;
+			input->conversion.width = video->info.width;
+			input->conversion.height = video->info.height;
 		}
 
-		if (input.conversion.width == 0)
-			input.conversion.width = video->info.width;
-		if (input.conversion.height == 0)
-			input.conversion.height = video->info.height;
+		if (input->conversion.width == 0)
+			input->conversion.width = video->info.width;
+		if (input->conversion.height == 0)
+			input->conversion.height = video->info.height;
 
-		success = video_input_init(&input, video);
+		success = video_input_init(input, video) &&
+			  os_sem_init(&input->semaphore, 0) == 0 &&
+			  pthread_create(&input->thread, NULL, input_thread,
+					 input) == 0;
 		if (success) {
+			input->thread_initialized = true;
 			if (video->inputs.num == 0) {
 				if (!os_atomic_load_long(&video->gpu_refs)) {
 					reset_frames(video);
@@ -380,6 +704,8 @@ bool video_output_connect(
 				os_atomic_set_bool(&video->raw_active, true);
 			}
 			da_push_back(video->inputs, &input);
+		} else {
+			video_input_free(input);
 		}
 	}
 
@@ -415,9 +741,12 @@ void video_output_disconnect(video_t *video,
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	reap_stopped_inputs(video);
+
+	struct video_input *input = NULL;
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		input = video->inputs.array[idx];
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -429,6 +758,38 @@ void video_output_disconnect(video_t *video,
 	}
 
 	pthread_mutex_unlock(&video->input_mutex);
+
+	/* not queued to anymore, stopped outside of the lock so that the
+	 * video thread keeps feeding the other inputs meanwhile */
+	if (input) {
+		if (input->copied_frames)
+			blog(LOG_INFO,
+			     "video-io: %ld zero-copy frames copied for a "
+			     "lagging input",
+			     input->copied_frames);
+		video_input_stop(input);
+	}
+}
+
+uint32_t video_output_get_input_skipped_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param)
+{
+	uint32_t skipped = 0;
+
+	if (!video || !callback)
+		return 0;
+
+	pthread_mutex_lock(&video->input_mutex);
+
+	size_t idx = video_get_input_idx(video, callback, param);
+	if (idx != DARRAY_INVALID)
+		skipped = (uint32_t)os_atomic_load_long(
+			&video->inputs.array[idx]->skipped_frames);
+
+	pthread_mutex_unlock(&video->input_mutex);
+
+	return skipped;
 }
 
 bool video_output_active(const video_t *video)
@@ -443,54 +804,129 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+/* call with data_mutex held */
+static struct cached_frame_info *lock_cache_entry(video_t *video, int count,
+						 uint64_t timestamp)
+{
+	struct cached_frame_info *cfi;
+
+	if (video->num_free == 0) {
+		if (video->num_queued) {
+			cfi = last_queued_frame(video);
+			cfi->count += count;
+			cfi->skipped += count;
+		} else {
+			/* all held by lagging inputs, counted here as no
+			 * queued entry will */
+			for (int i = 0; i < count; i++) {
+				os_atomic_inc_long(&video->total_frames);
+				os_atomic_inc_long(&video->skipped_frames);
+			}
+		}
+		return NULL;
+	}
+
+	video->locked_frame = video->free_frames[--video->num_free];
+
+	cfi = &video->cache[video->locked_frame];
+	cfi->frame.timestamp = timestamp;
+	cfi->count = count;
+	cfi->skipped = 0;
+	cfi->release = NULL;
+	return cfi;
+}
+
+/* call with data_mutex held */
+static void queue_locked_entry(video_t *video)
+{
+	size_t idx = (video->first_queued + video->num_queued) %
+		     MAX_CACHE_SIZE;
+
+	video->cache[video->locked_frame].queued = true;
+	video->queued_frames[idx] = video->locked_frame;
+	video->num_queued++;
+	os_sem_post(video->update_semaphore);
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 			     int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
 
 	if (!video)
 		return false;
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		video->cache[video->last_added].skipped += count;
-		locked = false;
+	cfi = lock_cache_entry(video, count, timestamp);
+	if (cfi)
+		memcpy(frame, &cfi->frame, sizeof(*frame));
 
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
-		}
+	pthread_mutex_unlock(&video->data_mutex);
 
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-		cfi->skipped = 0;
+	return cfi != NULL;
+}
 
-		memcpy(frame, &cfi->frame, sizeof(*frame));
+void video_output_unlock_frame(video_t *video)
+{
+	if (!video)
+		return;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	queue_locked_entry(video);
+
+	pthread_mutex_unlock(&video->data_mutex);
+}
+
+bool video_output_push_frame(video_t *video, const struct video_data *frame,
+			     int count, void (*release)(void *param),
+			     void *param)
+{
+	struct cached_frame_info *cfi;
 
-		locked = true;
+	if (!video || !frame || !release)
+		return false;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	cfi = lock_cache_entry(video, count, frame->timestamp);
+	if (cfi) {
+		memcpy(cfi->shared_data, frame->data, sizeof(frame->data));
+		memcpy(cfi->shared_linesize, frame->linesize,
+		       sizeof(frame->linesize));
+		cfi->release = release;
+		cfi->release_param = param;
+		cfi->shared_refs = 1;
+		cfi->copied = false;
+
+		queue_locked_entry(video);
 	}
 
 	pthread_mutex_unlock(&video->data_mutex);
 
-	return locked;
+	return cfi != NULL;
 }
 
-void video_output_unlock_frame(video_t *video)
+bool video_output_skip_frame(video_t *video, int count)
 {
+	bool queued;
+
 	if (!video)
-		return;
+		return false;
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	video->available_frames--;
-	os_sem_post(video->update_semaphore);
+	queued = video->num_queued > 0;
+	if (queued) {
+		struct cached_frame_info *cfi = last_queued_frame(video);
+		cfi->count += count;
+		cfi->skipped += count;
+	}
 
 	pthread_mutex_unlock(&video->data_mutex);
+
+	return queued;
 }
 
 uint64_t video_output_get_frame_time(const video_t *video)
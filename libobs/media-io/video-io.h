@@ -101,6 +101,11 @@ struct video_output_info {
 
 	enum video_colorspace colorspace;
 	enum video_range_type range;
+
+	/* frames an input can fall behind before it repeats frames (2 to 8,
+	 * 0 for 2, at most cache_size - 2), each input runs on its own
+	 * thread */
+	size_t input_queue_size;
 };
 
 static inline bool format_is_yuv(enum video_format format)
@@ -249,6 +254,19 @@ video_output_get_info(const video_t *video);
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 				    int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/* Zero-copy alternative to lock/unlock: the inputs get the planes of |frame|
+ * as-is, and |release| is called (from the video thread or an input thread)
+ * once all of them are done reading it. Inputs lagging behind get a copy
+ * instead, so |release| waits for one callback at most. False if the frame
+ * was skipped (cache full), |release| is not called then. Frames still
+ * queued when the output stops are not released. */
+EXPORT bool video_output_push_frame(video_t *video,
+				    const struct video_data *frame, int count,
+				    void (*release)(void *param), void *param);
+/* Frame that could not be output: the last queued one is repeated in its
+ * place, as for a full cache. False if no frame is queued. */
+EXPORT bool video_output_skip_frame(video_t *video, int count);
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
@@ -259,6 +277,10 @@ EXPORT uint32_t video_output_get_height(const video_t *video);
 EXPORT double video_output_get_frame_rate(const video_t *video);
 
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
+/* Frames repeated for a single input (callback, param) because it lagged */
+EXPORT uint32_t video_output_get_input_skipped_frames(
+	video_t *video, void (*callback)(void *param, struct video_data *frame),
+	void *param);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
 extern void video_output_inc_texture_encoders(video_t *video);
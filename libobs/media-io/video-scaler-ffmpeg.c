@@ -17,11 +17,13 @@
 
 #include "../util/bmem.h"
 #include "video-scaler.h"
+#include "video-scaler-simd.h"
 
 #include <libavutil/imgutils.h>
 #include <libswscale/swscale.h>
 
 struct video_scaler {
+	struct simd_scaler *simd;
 	struct SwsContext *swscale;
 	int src_height;
 	int dst_heights[4];
@@ -136,6 +138,13 @@ int video_scaler_create(video_scaler_t **scaler_out,
 	scaler = bzalloc(sizeof(struct video_scaler));
 	scaler->src_height = src->height;
 
+	/* plain resizes of the usual formats, straight to the output */
+	scaler->simd = simd_scaler_create(dst, src, type);
+	if (scaler->simd) {
+		*scaler_out = scaler;
+		return VIDEO_SCALER_SUCCESS;
+	}
+
 	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format_dst);
 	bool has_plane[4] = {0};
 	for (size_t i = 0; i < 4; i++)
@@ -187,6 +196,7 @@ fail:
 void video_scaler_destroy(video_scaler_t *scaler)
 {
 	if (scaler) {
+		simd_scaler_destroy(scaler->simd);
 		sws_freeContext(scaler->swscale);
 
 		if (scaler->dst_pointers[0])
@@ -204,6 +214,12 @@ bool video_scaler_scale(video_scaler_t *scaler, uint8_t *output[],
 	if (!scaler)
 		return false;
 
+	if (scaler->simd) {
+		simd_scaler_scale(scaler->simd, output, out_linesize, input,
+				  in_linesize);
+		return true;
+	}
+
 	int ret = sws_scale(scaler->swscale, input, (const int *)in_linesize, 0,
 			    scaler->src_height, scaler->dst_pointers,
 			    scaler->dst_linesizes);
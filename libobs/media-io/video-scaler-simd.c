@@ -0,0 +1,596 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include "../util/bmem.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "../util/sse-intrin.h"
+#include "video-scaler-simd.h"
+
+/* coefficients are 2.14 fixed point, the vertical pass keeps 6 fractional
+ * bits for the horizontal one (bicubic overshoots stay within int16) */
+#define FILTER_BITS 14
+#define INTER_BITS 6
+#define MAX_TAPS 16
+
+#define MAX_SLICES 4
+#define MIN_SLICE_HEIGHT 360
+
+struct scale_filter {
+	uint32_t taps;
+	uint32_t stride; /* coefficients per sample, taps padded */
+	int32_t *pos;    /* first source sample of each output sample */
+	int16_t *coeffs;
+};
+
+struct scale_plane {
+	uint32_t src_width;
+	uint32_t src_height;
+	uint32_t dst_width;
+	uint32_t dst_height;
+	bool interleaved; /* NV12 UV */
+
+	struct scale_filter h;
+	struct scale_filter v;
+};
+
+struct scale_slice {
+	struct simd_scaler *scaler;
+	size_t index;
+
+	/* vertical pass output, two rows for the interleaved plane */
+	int16_t *temp[2];
+
+	pthread_t thread;
+	bool thread_initialized;
+	os_sem_t *start;
+};
+
+struct simd_scaler {
+	size_t num_planes;
+	struct scale_plane planes[3];
+
+	size_t num_slices;
+	struct scale_slice slices[MAX_SLICES];
+	os_sem_t *done;
+	volatile bool stop;
+
+	uint8_t **output;
+	const uint32_t *out_linesize;
+	const uint8_t *const *input;
+	const uint32_t *in_linesize;
+};
+
+/* ------------------------------------------------------------------------- */
+
+static double filter_radius(enum video_scale_type type)
+{
+	return type == VIDEO_SCALE_BICUBIC ? 2.0 : 1.0;
+}
+
+static double filter_kernel(enum video_scale_type type, double x)
+{
+	x = fabs(x);
+
+	if (type == VIDEO_SCALE_BICUBIC) {
+		/* Keys cubic, a = -0.5 */
+		const double a = -0.5;
+		if (x < 1.0)
+			return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+		if (x < 2.0)
+			return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+		return 0.0;
+	}
+
+	return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+static void free_filter(struct scale_filter *filter)
+{
+	bfree(filter->pos);
+	bfree(filter->coeffs);
+}
+
+/* the support of the filter widens with the ratio when downscaling, except
+ * for fast bilinear which stays on the 2 nearest samples as in swscale;
+ * samples past the edges fold on the first and last ones so that every
+ * window lies within the source */
+static bool init_filter(struct scale_filter *filter, uint32_t src,
+			uint32_t dst, enum video_scale_type type,
+			uint32_t align)
+{
+	const double scale = (double)src / (double)dst;
+	const double factor =
+		scale > 1.0 && type != VIDEO_SCALE_FAST_BILINEAR ? scale
+								 : 1.0;
+	const double support = filter_radius(type) * factor;
+	double weights[MAX_TAPS];
+
+	uint32_t taps = (uint32_t)ceil(support) * 2;
+	if (taps > MAX_TAPS || taps > src)
+		return false;
+
+	filter->taps = taps;
+	filter->stride = (taps + align - 1) / align * align;
+	filter->pos = bmalloc(sizeof(int32_t) * dst);
+	filter->coeffs = bzalloc(sizeof(int16_t) * filter->stride * dst);
+
+	for (uint32_t i = 0; i < dst; i++) {
+		const double center = ((double)i + 0.5) * scale - 0.5;
+		int32_t start = (int32_t)floor(center - support) + 1;
+		int32_t pos = start;
+		double sum = 0.0;
+
+		if (pos < 0)
+			pos = 0;
+		else if (pos > (int32_t)(src - taps))
+			pos = (int32_t)(src - taps);
+
+		memset(weights, 0, sizeof(weights));
+
+		for (uint32_t k = 0; k < taps; k++) {
+			int32_t idx = start + (int32_t)k;
+			double w = filter_kernel(
+				type, ((double)idx - center) / factor);
+
+			if (idx < 0)
+				idx = 0;
+			else if (idx > (int32_t)src - 1)
+				idx = (int32_t)src - 1;
+
+			weights[idx - pos] += w;
+			sum += w;
+		}
+
+		int16_t *coeffs = filter->coeffs + i * filter->stride;
+		int32_t total = 0;
+		uint32_t peak = 0;
+
+		for (uint32_t k = 0; k < taps; k++) {
+			coeffs[k] = (int16_t)lrint(weights[k] / sum *
+						   (1 << FILTER_BITS));
+			total += coeffs[k];
+			if (weights[k] > weights[peak])
+				peak = k;
+		}
+
+		/* rounding error on the main tap, flat areas stay exact */
+		coeffs[peak] += (int16_t)((1 << FILTER_BITS) - total);
+		filter->pos[i] = pos;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline void store_inter(int16_t *const dst[2], uint32_t x, __m128i val,
+			       bool interleaved)
+{
+	if (interleaved) {
+		/* UVUVUVUV -> UUUU VVVV */
+		val = _mm_shufflelo_epi16(val, _MM_SHUFFLE(3, 1, 2, 0));
+		val = _mm_shufflehi_epi16(val, _MM_SHUFFLE(3, 1, 2, 0));
+		val = _mm_shuffle_epi32(val, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm_storel_epi64((__m128i *)(dst[0] + x / 2), val);
+		_mm_storel_epi64((__m128i *)(dst[1] + x / 2),
+				 _mm_unpackhi_epi64(val, val));
+	} else {
+		_mm_storeu_si128((__m128i *)(dst[0] + x), val);
+	}
+}
+
+/* 16 bytes of each of the rows, two rows a time */
+static inline void vertical_taps(__m128i out[2], const uint8_t *const *rows,
+				 const __m128i *pairs, uint32_t taps, uint32_t x)
+{
+	const int shift = FILTER_BITS - INTER_BITS;
+	const __m128i zero = _mm_setzero_si128();
+	__m128i sum[4];
+
+	sum[0] = _mm_set1_epi32(1 << (shift - 1));
+	sum[1] = sum[2] = sum[3] = sum[0];
+
+	for (uint32_t k = 0; k < taps; k += 2) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(rows[k] + x));
+		__m128i b = _mm_loadu_si128((const __m128i *)(rows[k + 1] + x));
+		__m128i lo = _mm_unpacklo_epi8(a, b); /* a0 b0 a1 b1 ... */
+		__m128i hi = _mm_unpackhi_epi8(a, b);
+		__m128i c = pairs[k / 2];
+
+		sum[0] = _mm_add_epi32(
+			sum[0], _mm_madd_epi16(_mm_unpacklo_epi8(lo, zero), c));
+		sum[1] = _mm_add_epi32(
+			sum[1], _mm_madd_epi16(_mm_unpackhi_epi8(lo, zero), c));
+		sum[2] = _mm_add_epi32(
+			sum[2], _mm_madd_epi16(_mm_unpacklo_epi8(hi, zero), c));
+		sum[3] = _mm_add_epi32(
+			sum[3], _mm_madd_epi16(_mm_unpackhi_epi8(hi, zero), c));
+	}
+
+	out[0] = _mm_packs_epi32(_mm_srai_epi32(sum[0], shift),
+				 _mm_srai_epi32(sum[1], shift));
+	out[1] = _mm_packs_epi32(_mm_srai_epi32(sum[2], shift),
+				 _mm_srai_epi32(sum[3], shift));
+}
+
+/* |width| bytes of each of the rows, deinterleaved to dst[0] and dst[1] for
+ * the UV plane of NV12 */
+static void scale_vertical(int16_t *const dst[2], const uint8_t *const *rows,
+			   const int16_t *coeffs, uint32_t taps, uint32_t width,
+			   bool interleaved)
+{
+	const int shift = FILTER_BITS - INTER_BITS;
+	__m128i pairs[MAX_TAPS / 2];
+	uint32_t x = 0;
+
+	/* pairs of coefficients, for the rows interleaved by two */
+	for (uint32_t k = 0; k < taps; k += 2)
+		pairs[k / 2] = _mm_set1_epi32(
+			(int)((uint32_t)(uint16_t)coeffs[k] |
+			      ((uint32_t)(uint16_t)coeffs[k + 1] << 16)));
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i out[2];
+		vertical_taps(out, rows, pairs, taps, x);
+		store_inter(dst, x, out[0], interleaved);
+		store_inter(dst, x + 8, out[1], interleaved);
+	}
+
+	for (; x < width; x++) {
+		int32_t sum = 1 << (shift - 1);
+		for (uint32_t k = 0; k < taps; k++)
+			sum += rows[k][x] * coeffs[k];
+		sum >>= shift;
+
+		if (sum < INT16_MIN)
+			sum = INT16_MIN;
+		else if (sum > INT16_MAX)
+			sum = INT16_MAX;
+
+		if (interleaved)
+			dst[x & 1][x / 2] = (int16_t)sum;
+		else
+			dst[0][x] = (int16_t)sum;
+	}
+}
+
+static inline __m128i dot_product(const int16_t *src, const int16_t *coeffs,
+				  uint32_t stride)
+{
+	__m128i sum =
+		_mm_madd_epi16(_mm_loadu_si128((const __m128i *)src),
+			       _mm_loadu_si128((const __m128i *)coeffs));
+	if (stride > 8)
+		sum = _mm_add_epi32(
+			sum, _mm_madd_epi16(
+				     _mm_loadu_si128((const __m128i *)(src + 8)),
+				     _mm_loadu_si128(
+					     (const __m128i *)(coeffs + 8))));
+	return sum;
+}
+
+/* four output samples per iteration, |step| 2 for the UV plane of NV12 */
+static void scale_horizontal(uint8_t *dst, uint32_t step, const int16_t *src,
+			     const struct scale_filter *filter, uint32_t width)
+{
+	const int shift = FILTER_BITS + INTER_BITS;
+	const __m128i round = _mm_set1_epi32(1 << (shift - 1));
+	const uint32_t stride = filter->stride;
+	uint32_t x = 0;
+
+	for (; x + 4 <= width; x += 4) {
+		const int16_t *coeffs = filter->coeffs + x * stride;
+		const int32_t *pos = filter->pos + x;
+
+		__m128i a = dot_product(src + pos[0], coeffs, stride);
+		__m128i b = dot_product(src + pos[1], coeffs + stride, stride);
+		__m128i c = dot_product(src + pos[2], coeffs + stride * 2,
+					stride);
+		__m128i d = dot_product(src + pos[3], coeffs + stride * 3,
+					stride);
+
+		/* horizontal sums of a, b, c and d */
+		__m128i ab = _mm_add_epi32(_mm_unpacklo_epi32(a, b),
+					   _mm_unpackhi_epi32(a, b));
+		__m128i cd = _mm_add_epi32(_mm_unpacklo_epi32(c, d),
+					   _mm_unpackhi_epi32(c, d));
+		__m128i sum = _mm_add_epi32(_mm_unpacklo_epi64(ab, cd),
+					    _mm_unpackhi_epi64(ab, cd));
+
+		sum = _mm_srai_epi32(_mm_add_epi32(sum, round), shift);
+		sum = _mm_packs_epi32(sum, sum);
+		sum = _mm_packus_epi16(sum, sum);
+
+		uint32_t px = (uint32_t)_mm_cvtsi128_si32(sum);
+		if (step == 1) {
+			memcpy(dst + x, &px, 4);
+		} else {
+			dst[x * step] = (uint8_t)px;
+			dst[(x + 1) * step] = (uint8_t)(px >> 8);
+			dst[(x + 2) * step] = (uint8_t)(px >> 16);
+			dst[(x + 3) * step] = (uint8_t)(px >> 24);
+		}
+	}
+
+	for (; x < width; x++) {
+		const int16_t *coeffs = filter->coeffs + x * stride;
+		const int16_t *in = src + filter->pos[x];
+		int32_t sum = 1 << (shift - 1);
+
+		for (uint32_t k = 0; k < filter->taps; k++)
+			sum += in[k] * coeffs[k];
+		sum >>= shift;
+
+		dst[x * step] = (uint8_t)(sum < 0 ? 0 : sum > 255 ? 255 : sum);
+	}
+}
+
+static void scale_row(const struct scale_plane *plane, int16_t *const temp[2],
+		      uint32_t y, uint8_t *output, uint32_t out_linesize,
+		      const uint8_t *input, uint32_t in_linesize)
+{
+	const struct scale_filter *v = &plane->v;
+	const int16_t *coeffs = v->coeffs + y * v->stride;
+	const uint8_t *rows[MAX_TAPS];
+
+	/* padded taps have no weight, any valid row will do */
+	for (uint32_t k = 0; k < v->stride; k++) {
+		uint32_t row = (uint32_t)v->pos[y] +
+			       (k < v->taps ? k : v->taps - 1);
+		rows[k] = input + (size_t)row * in_linesize;
+	}
+
+	uint8_t *dst = output + (size_t)y * out_linesize;
+
+	if (plane->interleaved) {
+		scale_vertical(temp, rows, coeffs, v->stride,
+			       plane->src_width * 2, true);
+		scale_horizontal(dst, 2, temp[0], &plane->h, plane->dst_width);
+		scale_horizontal(dst + 1, 2, temp[1], &plane->h,
+				 plane->dst_width);
+	} else {
+		scale_vertical(temp, rows, coeffs, v->stride, plane->src_width,
+			       false);
+		scale_horizontal(dst, 1, temp[0], &plane->h, plane->dst_width);
+	}
+}
+
+static void scale_slice(struct simd_scaler *scaler, struct scale_slice *slice)
+{
+	for (size_t i = 0; i < scaler->num_planes; i++) {
+		const struct scale_plane *plane = &scaler->planes[i];
+		uint32_t first = (uint32_t)(plane->dst_height * slice->index /
+					    scaler->num_slices);
+		uint32_t last = (uint32_t)(plane->dst_height *
+					   (slice->index + 1) /
+					   scaler->num_slices);
+
+		for (uint32_t y = first; y < last; y++)
+			scale_row(plane, slice->temp, y, scaler->output[i],
+				  scaler->out_linesize[i], scaler->input[i],
+				  scaler->in_linesize[i]);
+	}
+}
+
+static void *slice_thread(void *param)
+{
+	struct scale_slice *slice = param;
+	struct simd_scaler *scaler = slice->scaler;
+
+	os_set_thread_name("video-scaler: slice thread");
+
+	while (os_sem_wait(slice->start) == 0) {
+		if (os_atomic_load_bool(&scaler->stop))
+			break;
+
+		scale_slice(scaler, slice);
+		os_sem_post(scaler->done);
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static bool init_plane(struct scale_plane *plane,
+		       const struct video_scale_info *dst,
+		       const struct video_scale_info *src,
+		       enum video_scale_type type, bool chroma,
+		       bool interleaved)
+{
+	plane->src_width = chroma ? src->width / 2 : src->width;
+	plane->src_height = chroma ? src->height / 2 : src->height;
+	plane->dst_width = chroma ? dst->width / 2 : dst->width;
+	plane->dst_height = chroma ? dst->height / 2 : dst->height;
+	plane->interleaved = interleaved;
+
+	if (!plane->dst_width || !plane->dst_height)
+		return false;
+
+	return init_filter(&plane->h, plane->src_width, plane->dst_width,
+			   type, 8) &&
+	       init_filter(&plane->v, plane->src_height, plane->dst_height,
+			   type, 2);
+}
+
+static inline bool same_range(enum video_range_type a, enum video_range_type b)
+{
+	return (a == VIDEO_RANGE_FULL) == (b == VIDEO_RANGE_FULL);
+}
+
+/* same mapping as swscale gets in video-scaler-ffmpeg.c: 601 or 709 */
+static inline bool same_colorspace(enum video_colorspace a,
+				   enum video_colorspace b)
+{
+	return (a == VIDEO_CS_601) == (b == VIDEO_CS_601);
+}
+
+static const char *get_scale_type_name(enum video_scale_type type)
+{
+	switch (type) {
+	case VIDEO_SCALE_BICUBIC:
+		return "bicubic";
+	case VIDEO_SCALE_BILINEAR:
+		return "bilinear";
+	default:
+		return "fast bilinear";
+	}
+}
+
+static size_t get_num_slices(const struct video_scale_info *dst)
+{
+	size_t cores = (size_t)os_get_logical_cores();
+	size_t slices = dst->height / MIN_SLICE_HEIGHT;
+
+	/* leave cores to the encoders and the other inputs */
+	if (slices > cores / 2)
+		slices = cores / 2;
+	if (slices > MAX_SLICES)
+		slices = MAX_SLICES;
+	return slices ? slices : 1;
+}
+
+struct simd_scaler *simd_scaler_create(const struct video_scale_info *dst,
+				       const struct video_scale_info *src,
+				       enum video_scale_type type)
+{
+	struct simd_scaler *scaler;
+	bool success = true;
+
+	if (src->format != dst->format || !same_range(src->range, dst->range) ||
+	    !same_colorspace(src->colorspace, dst->colorspace))
+		return NULL;
+	if (type == VIDEO_SCALE_POINT)
+		return NULL;
+	/* same as swscale gets in video-scaler-ffmpeg.c */
+	if (type != VIDEO_SCALE_BICUBIC && type != VIDEO_SCALE_BILINEAR)
+		type = VIDEO_SCALE_FAST_BILINEAR;
+
+	scaler = bzalloc(sizeof(struct simd_scaler));
+
+	switch (src->format) {
+	case VIDEO_FORMAT_NV12:
+		scaler->num_planes = 2;
+		success = init_plane(&scaler->planes[0], dst, src, type, false,
+				     false) &&
+			  init_plane(&scaler->planes[1], dst, src, type, true,
+				     true);
+		break;
+	case VIDEO_FORMAT_I420:
+		scaler->num_planes = 3;
+		for (size_t i = 0; i < 3 && success; i++)
+			success = init_plane(&scaler->planes[i], dst, src, type,
+					     i > 0, false);
+		break;
+	case VIDEO_FORMAT_I444:
+		scaler->num_planes = 3;
+		for (size_t i = 0; i < 3 && success; i++)
+			success = init_plane(&scaler->planes[i], dst, src, type,
+					     false, false);
+		break;
+	default:
+		success = false;
+	}
+
+	if (!success)
+		goto fail;
+
+	/* horizontal reads go up to a full stride past the last window */
+	size_t temp_size = (src->width + MAX_TAPS) * sizeof(int16_t);
+
+	scaler->num_slices = get_num_slices(dst);
+	if (scaler->num_slices > 1 && os_sem_init(&scaler->done, 0) != 0)
+		scaler->num_slices = 1;
+
+	for (size_t i = 0; i < scaler->num_slices; i++) {
+		struct scale_slice *slice = &scaler->slices[i];
+		slice->scaler = scaler;
+		slice->index = i;
+		slice->temp[0] = bzalloc(temp_size);
+		slice->temp[1] = bzalloc(temp_size);
+
+		if (i == 0)
+			continue;
+
+		if (os_sem_init(&slice->start, 0) != 0 ||
+		    pthread_create(&slice->thread, NULL, slice_thread,
+				   slice) != 0)
+			goto fail;
+		slice->thread_initialized = true;
+	}
+
+	blog(LOG_DEBUG,
+	     "simd_scaler_create: %ux%u -> %ux%u %s, %d slice(s)",
+	     src->width, src->height, dst->width, dst->height,
+	     get_scale_type_name(type),
+	     (int)scaler->num_slices);
+	return scaler;
+
+fail:
+	simd_scaler_destroy(scaler);
+	return NULL;
+}
+
+void simd_scaler_destroy(struct simd_scaler *scaler)
+{
+	if (!scaler)
+		return;
+
+	os_atomic_set_bool(&scaler->stop, true);
+
+	for (size_t i = 0; i < MAX_SLICES; i++) {
+		struct scale_slice *slice = &scaler->slices[i];
+
+		if (slice->thread_initialized) {
+			os_sem_post(slice->start);
+			pthread_join(slice->thread, NULL);
+		}
+
+		os_sem_destroy(slice->start);
+		bfree(slice->temp[0]);
+		bfree(slice->temp[1]);
+	}
+
+	for (size_t i = 0; i < 3; i++) {
+		free_filter(&scaler->planes[i].h);
+		free_filter(&scaler->planes[i].v);
+	}
+
+	os_sem_destroy(scaler->done);
+	bfree(scaler);
+}
+
+void simd_scaler_scale(struct simd_scaler *scaler, uint8_t *output[],
+		       const uint32_t out_linesize[],
+		       const uint8_t *const input[],
+		       const uint32_t in_linesize[])
+{
+	scaler->output = output;
+	scaler->out_linesize = out_linesize;
+	scaler->input = input;
+	scaler->in_linesize = in_linesize;
+
+	for (size_t i = 1; i < scaler->num_slices; i++)
+		os_sem_post(scaler->slices[i].start);
+
+	scale_slice(scaler, &scaler->slices[0]);
+
+	for (size_t i = 1; i < scaler->num_slices; i++)
+		os_sem_wait(scaler->done);
+}
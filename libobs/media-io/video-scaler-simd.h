@@ -0,0 +1,43 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "video-io.h"
+
+/*
+ * Built-in scaler used by video_scaler_create for the common cases: NV12,
+ * I420 and I444 resized without format, range or colorspace conversion,
+ * fast bilinear, bilinear or bicubic. Separable fixed point filters with
+ * SSE2 kernels (NEON through sse2neon), large frames are split in slices
+ * scaled on a few threads.
+ */
+
+struct simd_scaler;
+
+/* returns NULL if the conversion is not handled, use swscale then */
+extern struct simd_scaler *
+simd_scaler_create(const struct video_scale_info *dst,
+		   const struct video_scale_info *src,
+		   enum video_scale_type type);
+extern void simd_scaler_destroy(struct simd_scaler *scaler);
+
+extern void simd_scaler_scale(struct simd_scaler *scaler, uint8_t *output[],
+			      const uint32_t out_linesize[],
+			      const uint8_t *const input[],
+			      const uint32_t in_linesize[]);
@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include "obs.h"
 #include "obs-internal.h"
 #include "util/util_uint64.h"
@@ -228,6 +229,16 @@ static void remove_connection(struct obs_encoder *encoder, bool shutdown)
 		if (gpu_encode_available(encoder)) {
 			stop_gpu_encode(encoder);
 		} else {
+			video_t *video = get_raw_video(encoder->media,
+						       receive_video, encoder);
+			uint32_t skipped = video_output_get_input_skipped_frames(
+				video, receive_video, encoder);
+			if (skipped)
+				blog(LOG_INFO,
+				     "Encoder '%s': Number of frames repeated "
+				     "due to encoding lag: %" PRIu32,
+				     encoder->context.name, skipped);
+
 			stop_raw_video(encoder->media, receive_video, encoder);
 		}
 	}
@@ -37,6 +37,7 @@
 #include "obs.h"
 
 #define NUM_TEXTURES 2
+#define MAX_STAGE_SURFACES 8
 #define NUM_CHANNELS 3
 #define MICROSECOND_DEN 1000000
 #define NUM_ENCODE_TEXTURES 3
@@ -226,6 +227,50 @@ struct obs_vframe_info {
 	int count;
 };
 
+/* Staging surfaces of a ring slot, in zero-copy mode they stay mapped until
+ * video-io released the frame (refs back to 0) */
+struct obs_stage_slot {
+	volatile long refs;
+	bool mapped[NUM_CHANNELS];
+	/* still in use when its turn to be staged came, or its copy was not
+	 * done when its turn to be downloaded came */
+	bool skipped;
+	/* not staged, only scaled videos were connected */
+	bool idle;
+};
+
+/* Main output scaled and converted on the GPU to another size, format,
+ * colorspace or range, shared by the raw video connections that asked the
+ * main output for it (see start_raw_video). Freed once the last of them
+ * disconnected. */
+#define MAX_SCALED_VIDEOS 8
+
+struct obs_scaled_video {
+	video_t *video;
+	struct video_scale_info info;
+	long refs;
+
+	float color_matrix[16];
+	gs_texture_t *output_texture;
+	gs_texture_t *convert_textures[NUM_CHANNELS];
+	const char *conversion_techs[NUM_CHANNELS];
+	float conversion_width_i;
+	gs_stagesurf_t *copy_surfaces[MAX_STAGE_SURFACES][NUM_CHANNELS];
+	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
+	bool textures_copied[MAX_STAGE_SURFACES];
+
+	/* downloaded on the graphics thread, output once unlocked */
+	struct video_data frame;
+	bool frame_ready;
+	bool frame_skipped;
+};
+
+struct obs_scaled_connection {
+	void (*callback)(void *param, struct video_data *frame);
+	void *param;
+	struct obs_scaled_video *scaled;
+};
+
 struct obs_tex_frame {
 	gs_texture_t *tex;
 	gs_texture_t *tex_uv;
@@ -243,12 +288,12 @@ struct obs_task_info {
 
 struct obs_core_video {
 	graphics_t *graphics;
-	gs_stagesurf_t *copy_surfaces[NUM_TEXTURES][NUM_CHANNELS];
+	gs_stagesurf_t *copy_surfaces[MAX_STAGE_SURFACES][NUM_CHANNELS];
 	gs_texture_t *render_texture;
 	gs_texture_t *output_texture;
 	gs_texture_t *convert_textures[NUM_CHANNELS];
 	bool texture_rendered;
-	bool textures_copied[NUM_TEXTURES];
+	bool textures_copied[MAX_STAGE_SURFACES];
 	bool texture_converted;
 	bool using_nv12_tex;
 	struct circlebuf vframe_info_buffer;
@@ -267,6 +312,17 @@ struct obs_core_video {
 	gs_samplerstate_t *point_sampler;
 	gs_stagesurf_t *mapped_surfaces[NUM_CHANNELS];
 	int cur_texture;
+	/* staging surfaces in the ring, NUM_TEXTURES unless zero-copy, plus
+	 * one per extra frame of readback delay */
+	int stage_depth;
+	/* frames between staging a texture and downloading it */
+	int readback_delay;
+	bool zero_copy;
+	struct obs_stage_slot stage_slots[MAX_STAGE_SURFACES];
+	/* obs_set_video_zero_copy/readback_delay, applied by obs_reset_video */
+	bool zero_copy_setting;
+	uint32_t stage_depth_setting;
+	uint32_t readback_delay_setting;
 	long raw_active;
 	long gpu_encoder_active;
 	pthread_mutex_t gpu_encoder_mutex;
@@ -316,6 +372,11 @@ struct obs_core_video {
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
+
+	/* graphics context first, then scaled_mutex */
+	pthread_mutex_t scaled_mutex;
+	DARRAY(struct obs_scaled_video *) scaled_videos;
+	DARRAY(struct obs_scaled_connection) scaled_connections;
 };
 
 struct audio_monitor;
@@ -472,6 +533,11 @@ extern void stop_raw_video(video_t *video,
 			   void (*callback)(void *param,
 					    struct video_data *frame),
 			   void *param);
+/* video a raw video callback was connected to, a scaled one or |video| */
+extern video_t *
+get_raw_video(video_t *video,
+	      void (*callback)(void *param, struct video_data *frame),
+	      void *param);
 
 /* ------------------------------------------------------------------------- */
 /* obs shared context data */
@@ -301,6 +301,9 @@ static inline bool data_active(struct obs_output *output)
 	return os_atomic_load_bool(&output->data_active);
 }
 
+static void default_raw_video_callback(void *param,
+				       struct video_data *frame);
+
 static void log_frame_info(struct obs_output *output)
 {
 	struct obs_core_video *video = &obs->video;
@@ -349,6 +352,34 @@ static void log_frame_info(struct obs_output *output)
 		     "to insufficient bandwidth/connection stalls: "
 		     "%d (%0.1f%%)",
 		     output->context.name, dropped, percentage_dropped);
+
+	if ((output->info.flags & OBS_OUTPUT_ENCODED) == 0) {
+		video_t *video = get_raw_video(
+			output->video, default_raw_video_callback, output);
+		uint32_t repeated = video_output_get_input_skipped_frames(
+			video, default_raw_video_callback, output);
+		if (repeated)
+			blog(LOG_INFO,
+			     "Output '%s': Number of frames repeated due "
+			     "to output lag: %" PRIu32,
+			     output->context.name, repeated);
+
+		/* scaled on the GPU, shared with the outputs of the same
+		 * size and format */
+		if (video != output->video) {
+			uint32_t skipped =
+				video_output_get_skipped_frames(video);
+			uint32_t frames =
+				video_output_get_total_frames(video);
+			if (skipped && frames)
+				blog(LOG_INFO,
+				     "Output '%s': Number of scaled frames "
+				     "skipped due to lag: %" PRIu32 "/%" PRIu32
+				     " (%0.1f%%)",
+				     output->context.name, skipped, frames,
+				     (double)skipped / (double)frames * 100.0);
+		}
+	}
 }
 
 static inline void signal_stop(struct obs_output *output);
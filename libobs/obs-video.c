@@ -122,6 +122,33 @@ static inline void unmap_last_surface(struct obs_core_video *video)
 	}
 }
 
+/* zero-copy: unmap the staging surfaces of the frames video-io released */
+static inline void unmap_released_surfaces(struct obs_core_video *video)
+{
+	for (int i = 0; i < video->stage_depth; i++) {
+		struct obs_stage_slot *slot = &video->stage_slots[i];
+		if (os_atomic_load_long(&slot->refs))
+			continue;
+
+		for (int c = 0; c < NUM_CHANNELS; ++c) {
+			if (slot->mapped[c]) {
+				gs_stagesurface_unmap(
+					video->copy_surfaces[i][c]);
+				slot->mapped[c] = false;
+			}
+		}
+	}
+}
+
+static inline bool stage_slot_mapped(const struct obs_stage_slot *slot)
+{
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		if (slot->mapped[c])
+			return true;
+	}
+	return false;
+}
+
 static const char *render_main_texture_name = "render_main_texture";
 static inline void render_main_texture(struct obs_core_video *video)
 {
@@ -158,13 +185,14 @@ static inline void render_main_texture(struct obs_core_video *video)
 }
 
 static inline gs_effect_t *
-get_scale_effect_internal(struct obs_core_video *video)
+get_scale_effect_internal(struct obs_core_video *video, uint32_t width,
+			  uint32_t height)
 {
 	/* if the dimension is under half the size of the original image,
 	 * bicubic/lanczos can't sample enough pixels to create an accurate
 	 * image, so use the bilinear low resolution effect instead */
-	if (video->output_width < (video->base_width / 2) &&
-	    video->output_height < (video->base_height / 2)) {
+	if (width < (video->base_width / 2) &&
+	    height < (video->base_height / 2)) {
 		return video->bilinear_lowres_effect;
 	}
 
@@ -199,7 +227,8 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 	} else {
 		/* if the scale method couldn't be loaded, use either bicubic
 		 * or bilinear by default */
-		gs_effect_t *effect = get_scale_effect_internal(video);
+		gs_effect_t *effect =
+			get_scale_effect_internal(video, width, height);
 		if (!effect)
 			effect = !!video->bicubic_effect
 					 ? video->bicubic_effect
@@ -208,6 +237,10 @@ static inline gs_effect_t *get_scale_effect(struct obs_core_video *video,
 	}
 }
 
+static void scale_texture(struct obs_core_video *video, gs_effect_t *effect,
+			  gs_technique_t *tech, gs_texture_t *texture,
+			  gs_texture_t *target);
+
 static const char *render_output_texture_name = "render_output_texture";
 static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 {
@@ -231,6 +264,18 @@ static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 	}
 
 	profile_start(render_output_texture_name);
+	scale_texture(video, effect, tech, texture, target);
+	profile_end(render_output_texture_name);
+
+	return target;
+}
+
+static void scale_texture(struct obs_core_video *video, gs_effect_t *effect,
+			  gs_technique_t *tech, gs_texture_t *texture,
+			  gs_texture_t *target)
+{
+	uint32_t width = gs_texture_get_width(target);
+	uint32_t height = gs_texture_get_height(target);
 
 	gs_eparam_t *image = gs_effect_get_param_by_name(effect, "image");
 	gs_eparam_t *bres =
@@ -267,10 +312,6 @@ static inline gs_texture_t *render_output_texture(struct obs_core_video *video)
 	}
 	gs_technique_end(tech);
 	gs_enable_blending(true);
-
-	profile_end(render_output_texture_name);
-
-	return target;
 }
 
 static void render_convert_plane(gs_effect_t *effect, gs_texture_t *target,
@@ -293,12 +334,12 @@ static void render_convert_plane(gs_effect_t *effect, gs_texture_t *target,
 	gs_technique_end(tech);
 }
 
-static const char *render_convert_texture_name = "render_convert_texture";
-static void render_convert_texture(struct obs_core_video *video,
-				   gs_texture_t *texture)
+static void convert_texture(struct obs_core_video *video,
+			    gs_texture_t *texture, const float color_matrix[16],
+			    gs_texture_t *const targets[NUM_CHANNELS],
+			    const char *const techs[NUM_CHANNELS],
+			    float conversion_width_i)
 {
-	profile_start(render_convert_texture_name);
-
 	gs_effect_t *effect = video->conversion_effect;
 	gs_eparam_t *color_vec0 =
 		gs_effect_get_param_by_name(effect, "color_vec0");
@@ -310,44 +351,51 @@ static void render_convert_texture(struct obs_core_video *video,
 	gs_eparam_t *width_i = gs_effect_get_param_by_name(effect, "width_i");
 
 	struct vec4 vec0, vec1, vec2;
-	vec4_set(&vec0, video->color_matrix[4], video->color_matrix[5],
-		 video->color_matrix[6], video->color_matrix[7]);
-	vec4_set(&vec1, video->color_matrix[0], video->color_matrix[1],
-		 video->color_matrix[2], video->color_matrix[3]);
-	vec4_set(&vec2, video->color_matrix[8], video->color_matrix[9],
-		 video->color_matrix[10], video->color_matrix[11]);
+	vec4_set(&vec0, color_matrix[4], color_matrix[5], color_matrix[6],
+		 color_matrix[7]);
+	vec4_set(&vec1, color_matrix[0], color_matrix[1], color_matrix[2],
+		 color_matrix[3]);
+	vec4_set(&vec2, color_matrix[8], color_matrix[9], color_matrix[10],
+		 color_matrix[11]);
 
 	gs_enable_blending(false);
 
-	if (video->convert_textures[0]) {
+	if (targets[0]) {
 		gs_effect_set_texture(image, texture);
 		gs_effect_set_vec4(color_vec0, &vec0);
-		render_convert_plane(effect, video->convert_textures[0],
-				     video->conversion_techs[0]);
+		render_convert_plane(effect, targets[0], techs[0]);
 
-		if (video->convert_textures[1]) {
+		if (targets[1]) {
 			gs_effect_set_texture(image, texture);
 			gs_effect_set_vec4(color_vec1, &vec1);
-			if (!video->convert_textures[2])
+			if (!targets[2])
 				gs_effect_set_vec4(color_vec2, &vec2);
-			gs_effect_set_float(width_i, video->conversion_width_i);
-			render_convert_plane(effect, video->convert_textures[1],
-					     video->conversion_techs[1]);
+			gs_effect_set_float(width_i, conversion_width_i);
+			render_convert_plane(effect, targets[1], techs[1]);
 
-			if (video->convert_textures[2]) {
+			if (targets[2]) {
 				gs_effect_set_texture(image, texture);
 				gs_effect_set_vec4(color_vec2, &vec2);
 				gs_effect_set_float(width_i,
-						    video->conversion_width_i);
-				render_convert_plane(
-					effect, video->convert_textures[2],
-					video->conversion_techs[2]);
+						    conversion_width_i);
+				render_convert_plane(effect, targets[2],
+						     techs[2]);
 			}
 		}
 	}
 
 	gs_enable_blending(true);
+}
+
+static const char *render_convert_texture_name = "render_convert_texture";
+static void render_convert_texture(struct obs_core_video *video,
+				   gs_texture_t *texture)
+{
+	profile_start(render_convert_texture_name);
 
+	convert_texture(video, texture, video->color_matrix,
+			video->convert_textures, video->conversion_techs,
+			video->conversion_width_i);
 	video->texture_converted = true;
 
 	profile_end(render_convert_texture_name);
@@ -355,12 +403,31 @@ static void render_convert_texture(struct obs_core_video *video,
 
 static const char *stage_output_texture_name = "stage_output_texture";
 static inline void stage_output_texture(struct obs_core_video *video,
-					int cur_texture)
+					int cur_texture, bool main_active)
 {
 	profile_start(stage_output_texture_name);
 
 	unmap_last_surface(video);
 
+	/* only scaled videos are connected, nothing to download */
+	video->stage_slots[cur_texture].idle = !main_active;
+	if (!main_active) {
+		video->textures_copied[cur_texture] = false;
+		profile_end(stage_output_texture_name);
+		return;
+	}
+
+	if (video->zero_copy) {
+		/* still read by video-io, its frame is skipped instead */
+		struct obs_stage_slot *slot = &video->stage_slots[cur_texture];
+		slot->skipped = stage_slot_mapped(slot);
+		if (slot->skipped) {
+			video->textures_copied[cur_texture] = false;
+			profile_end(stage_output_texture_name);
+			return;
+		}
+	}
+
 	if (!video->gpu_conversion) {
 		gs_stagesurf_t *copy = video->copy_surfaces[cur_texture][0];
 		if (copy)
@@ -382,6 +449,67 @@ static inline void stage_output_texture(struct obs_core_video *video,
 	profile_end(stage_output_texture_name);
 }
 
+static inline void unmap_scaled_surfaces(struct obs_scaled_video *scaled)
+{
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		if (scaled->mapped_surfaces[c]) {
+			gs_stagesurface_unmap(scaled->mapped_surfaces[c]);
+			scaled->mapped_surfaces[c] = NULL;
+		}
+	}
+}
+
+static const char *render_scaled_videos_name = "render_scaled_videos";
+static void render_scaled_videos(struct obs_core_video *video, int cur_texture)
+{
+	profile_start(render_scaled_videos_name);
+
+	pthread_mutex_lock(&video->scaled_mutex);
+
+	for (size_t i = 0; i < video->scaled_videos.num; i++) {
+		struct obs_scaled_video *scaled = video->scaled_videos.array[i];
+		gs_texture_t *texture = video->render_texture;
+		uint32_t width = scaled->info.width;
+		uint32_t height = scaled->info.height;
+
+		unmap_scaled_surfaces(scaled);
+
+		scaled->textures_copied[cur_texture] = false;
+		if (!scaled->refs)
+			continue;
+
+		gs_effect_t *effect = get_scale_effect(video, width, height);
+		if (effect != video->default_effect ||
+		    width != video->base_width ||
+		    height != video->base_height) {
+			gs_technique_t *tech =
+				gs_effect_get_technique(effect, "Draw");
+			scale_texture(video, effect, tech, texture,
+				      scaled->output_texture);
+			texture = scaled->output_texture;
+		}
+
+		convert_texture(video, texture, scaled->color_matrix,
+				scaled->convert_textures,
+				scaled->conversion_techs,
+				scaled->conversion_width_i);
+
+		for (int c = 0; c < NUM_CHANNELS; c++) {
+			gs_stagesurf_t *copy =
+				scaled->copy_surfaces[cur_texture][c];
+			if (copy)
+				gs_stage_texture(copy,
+						 scaled->convert_textures[c]);
+		}
+
+		scaled->textures_copied[cur_texture] = true;
+	}
+
+	pthread_mutex_unlock(&video->scaled_mutex);
+
+	profile_end(render_scaled_videos_name);
+}
+
 #ifdef _WIN32
 static inline bool queue_frame(struct obs_core_video *video, bool raw_active,
 			       struct obs_vframe_info *vframe_info)
@@ -476,7 +604,8 @@ end:
 #endif
 
 static inline void render_video(struct obs_core_video *video, bool raw_active,
-				const bool gpu_active, int cur_texture)
+				const bool gpu_active, int cur_texture,
+				bool main_active)
 {
 	gs_begin_scene();
 
@@ -485,7 +614,9 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 
 	render_main_texture(video);
 
-	if (raw_active || gpu_active) {
+	/* only scaled videos are connected: they scale and convert the main
+	 * texture themselves, the main output is not rendered */
+	if (main_active || gpu_active) {
 		gs_texture_t *texture = render_output_texture(video);
 
 #ifdef _WIN32
@@ -495,7 +626,9 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 
 		if (video->gpu_conversion)
 			render_convert_texture(video, texture);
+	}
 
+	if (raw_active || gpu_active) {
 #ifdef _WIN32
 		if (gpu_active) {
 			gs_flush();
@@ -503,8 +636,10 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 		}
 #endif
 
-		if (raw_active)
-			stage_output_texture(video, cur_texture);
+		if (raw_active) {
+			stage_output_texture(video, cur_texture, main_active);
+			render_scaled_videos(video, cur_texture);
+		}
 	}
 
 	gs_set_render_target(NULL, NULL);
@@ -513,24 +648,100 @@ static inline void render_video(struct obs_core_video *video, bool raw_active,
 	gs_end_scene();
 }
 
+/* with the default readback delay of 1, mapping waits for the copy as it
+ * always did; only a longer, configured delay skips a copy not done yet */
+static inline bool
+stage_surfaces_ready(struct obs_core_video *video,
+		     gs_stagesurf_t *const surfaces[NUM_CHANNELS])
+{
+	if (video->readback_delay <= 1)
+		return true;
+
+	for (int c = 0; c < NUM_CHANNELS; ++c) {
+		if (surfaces[c] && !gs_stagesurface_ready(surfaces[c]))
+			return false;
+	}
+	return true;
+}
+
+static const char *map_stage_surface_name = "gs_stagesurface_map";
 static inline bool download_frame(struct obs_core_video *video,
 				  int prev_texture, struct video_data *frame)
 {
 	if (!video->textures_copied[prev_texture])
 		return false;
 
+	/* still copying, not waited for: the last frame is repeated */
+	if (!stage_surfaces_ready(video, video->copy_surfaces[prev_texture])) {
+		video->textures_copied[prev_texture] = false;
+		video->stage_slots[prev_texture].skipped = true;
+		return false;
+	}
+
+	bool success = true;
+	profile_start(map_stage_surface_name);
+
 	for (int channel = 0; channel < NUM_CHANNELS; ++channel) {
 		gs_stagesurf_t *surface =
 			video->copy_surfaces[prev_texture][channel];
 		if (surface) {
 			if (!gs_stagesurface_map(surface, &frame->data[channel],
-						 &frame->linesize[channel]))
-				return false;
+						 &frame->linesize[channel])) {
+				success = false;
+				break;
+			}
 
-			video->mapped_surfaces[channel] = surface;
+			if (video->zero_copy)
+				video->stage_slots[prev_texture]
+					.mapped[channel] = true;
+			else
+				video->mapped_surfaces[channel] = surface;
 		}
 	}
-	return true;
+
+	profile_end(map_stage_surface_name);
+	return success;
+}
+
+static void download_scaled_frames(struct obs_core_video *video,
+				   int prev_texture)
+{
+	pthread_mutex_lock(&video->scaled_mutex);
+
+	for (size_t i = 0; i < video->scaled_videos.num; i++) {
+		struct obs_scaled_video *scaled = video->scaled_videos.array[i];
+
+		scaled->frame_ready = false;
+		scaled->frame_skipped = false;
+		if (!scaled->refs || !scaled->textures_copied[prev_texture])
+			continue;
+
+		gs_stagesurf_t **surfaces = scaled->copy_surfaces[prev_texture];
+		if (!stage_surfaces_ready(video, surfaces)) {
+			scaled->frame_skipped = true;
+			continue;
+		}
+
+		profile_start(map_stage_surface_name);
+		scaled->frame_ready = true;
+		for (int c = 0; c < NUM_CHANNELS; ++c) {
+			gs_stagesurf_t *surface = surfaces[c];
+			if (!surface)
+				continue;
+
+			if (!gs_stagesurface_map(surface,
+						 &scaled->frame.data[c],
+						 &scaled->frame.linesize[c])) {
+				scaled->frame_ready = false;
+				break;
+			}
+
+			scaled->mapped_surfaces[c] = surface;
+		}
+		profile_end(map_stage_surface_name);
+	}
+
+	pthread_mutex_unlock(&video->scaled_mutex);
 }
 
 static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
@@ -553,12 +764,12 @@ static const uint8_t *set_gpu_converted_plane(uint32_t width, uint32_t height,
 	return in;
 }
 
-static void set_gpu_converted_data(struct obs_core_video *video,
+static void set_gpu_converted_data(bool using_nv12_tex,
 				   struct video_frame *output,
 				   const struct video_data *input,
 				   const struct video_output_info *info)
 {
-	if (video->using_nv12_tex) {
+	if (using_nv12_tex) {
 		const uint32_t width = info->width;
 		const uint32_t height = info->height;
 
@@ -697,8 +908,9 @@ static inline void output_video_data(struct obs_core_video *video,
 					 input_frame->timestamp);
 	if (locked) {
 		if (video->gpu_conversion) {
-			set_gpu_converted_data(video, &output_frame,
-					       input_frame, info);
+			set_gpu_converted_data(video->using_nv12_tex,
+					       &output_frame, input_frame,
+					       info);
 		} else {
 			copy_rgbx_frame(&output_frame, input_frame, info);
 		}
@@ -707,6 +919,80 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
+static void output_scaled_frames(struct obs_core_video *video,
+				 const struct obs_vframe_info *vframe_info)
+{
+	bool lagged = false;
+
+	pthread_mutex_lock(&video->scaled_mutex);
+
+	for (size_t i = 0; i < video->scaled_videos.num; i++) {
+		struct obs_scaled_video *scaled = video->scaled_videos.array[i];
+		const struct video_output_info *info;
+		struct video_frame output_frame;
+
+		if (scaled->frame_skipped) {
+			scaled->frame_skipped = false;
+			video_output_skip_frame(scaled->video,
+						vframe_info->count);
+			lagged = true;
+		}
+		if (!scaled->frame_ready)
+			continue;
+
+		scaled->frame_ready = false;
+		scaled->frame.timestamp = vframe_info->timestamp;
+		info = video_output_get_info(scaled->video);
+
+		if (video_output_lock_frame(scaled->video, &output_frame,
+					    vframe_info->count,
+					    vframe_info->timestamp)) {
+			set_gpu_converted_data(false, &output_frame,
+					       &scaled->frame, info);
+			video_output_unlock_frame(scaled->video);
+		}
+	}
+
+	pthread_mutex_unlock(&video->scaled_mutex);
+
+	/* rendered but not read back in time: lagged, once however many
+	 * scaled videos missed it (the other frames of the tick already
+	 * are, see video_sleep) */
+	if (lagged)
+		video->lagged_frames++;
+}
+
+static void release_stage_slot(void *param)
+{
+	struct obs_stage_slot *slot = param;
+	os_atomic_dec_long(&slot->refs);
+}
+
+/* zero-copy: video-io gets the mapped planes, the surfaces stay mapped until
+ * it released them (see unmap_released_surfaces) */
+static inline void push_video_data(struct obs_core_video *video,
+				   struct video_data *input_frame, int count,
+				   int texture)
+{
+	struct obs_stage_slot *slot = &video->stage_slots[texture];
+
+	if (video->using_nv12_tex) {
+		/* single NV12 surface, UV follows Y */
+		const struct video_output_info *info =
+			video_output_get_info(video->video);
+
+		input_frame->data[1] = input_frame->data[0] +
+				       (size_t)input_frame->linesize[0] *
+					       (size_t)info->height;
+		input_frame->linesize[1] = input_frame->linesize[0];
+	}
+
+	os_atomic_set_long(&slot->refs, 1);
+	if (!video_output_push_frame(video->video, input_frame, count,
+				     release_stage_slot, slot))
+		os_atomic_set_long(&slot->refs, 0);
+}
+
 static inline void video_sleep(struct obs_core_video *video, bool raw_active,
 			       const bool gpu_active, uint64_t *p_time,
 			       uint64_t interval_ns)
@@ -747,26 +1033,33 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture = video->cur_texture;
-	int prev_texture = cur_texture == 0 ? NUM_TEXTURES - 1
-					    : cur_texture - 1;
+	int prev_texture = cur_texture - video->readback_delay;
 	struct video_data frame;
 	bool frame_ready = 0;
+	bool main_active = video_output_active(video->video);
+
+	if (prev_texture < 0)
+		prev_texture += video->stage_depth;
 
 	memset(&frame, 0, sizeof(struct video_data));
 
 	profile_start(output_frame_gs_context_name);
 	gs_enter_context(video->graphics);
 
+	if (video->zero_copy)
+		unmap_released_surfaces(video);
+
 	profile_start(output_frame_render_video_name);
 	GS_DEBUG_MARKER_BEGIN(GS_DEBUG_COLOR_RENDER_VIDEO,
 			      output_frame_render_video_name);
-	render_video(video, raw_active, gpu_active, cur_texture);
+	render_video(video, raw_active, gpu_active, cur_texture, main_active);
 	GS_DEBUG_MARKER_END();
 	profile_end(output_frame_render_video_name);
 
 	if (raw_active) {
 		profile_start(output_frame_download_frame_name);
 		frame_ready = download_frame(video, prev_texture, &frame);
+		download_scaled_frames(video, prev_texture);
 		profile_end(output_frame_download_frame_name);
 	}
 
@@ -777,18 +1070,35 @@ static inline void output_frame(bool raw_active, const bool gpu_active)
 	gs_leave_context();
 	profile_end(output_frame_gs_context_name);
 
-	if (raw_active && frame_ready) {
+	struct obs_stage_slot *slot = &video->stage_slots[prev_texture];
+	if (raw_active && (frame_ready || slot->skipped || slot->idle)) {
 		struct obs_vframe_info vframe_info;
 		circlebuf_pop_front(&video->vframe_info_buffer, &vframe_info,
 				    sizeof(vframe_info));
 
 		frame.timestamp = vframe_info.timestamp;
 		profile_start(output_frame_output_video_data_name);
-		output_video_data(video, &frame, vframe_info.count);
+		if (!frame_ready) {
+			/* not staged or not copied in time, the last
+			 * frame is repeated in its place */
+			if (slot->skipped)
+				video_output_skip_frame(video->video,
+							vframe_info.count);
+		} else if (video->zero_copy) {
+			push_video_data(video, &frame, vframe_info.count,
+					prev_texture);
+		} else {
+			output_video_data(video, &frame, vframe_info.count);
+		}
+
+		output_scaled_frames(video, &vframe_info);
 		profile_end(output_frame_output_video_data_name);
+
+		slot->skipped = false;
+		slot->idle = false;
 	}
 
-	if (++video->cur_texture == NUM_TEXTURES)
+	if (++video->cur_texture == video->stage_depth)
 		video->cur_texture = 0;
 }
 
@@ -807,7 +1117,19 @@ static void clear_raw_frame_data(void)
 {
 	struct obs_core_video *video = &obs->video;
 	memset(video->textures_copied, 0, sizeof(video->textures_copied));
+	for (size_t i = 0; i < MAX_STAGE_SURFACES; i++) {
+		video->stage_slots[i].skipped = false;
+		video->stage_slots[i].idle = false;
+	}
 	circlebuf_free(&video->vframe_info_buffer);
+
+	pthread_mutex_lock(&video->scaled_mutex);
+	for (size_t i = 0; i < video->scaled_videos.num; i++) {
+		struct obs_scaled_video *scaled = video->scaled_videos.array[i];
+		memset(scaled->textures_copied, 0,
+		       sizeof(scaled->textures_copied));
+	}
+	pthread_mutex_unlock(&video->scaled_mutex);
 }
 
 #ifdef _WIN32
@@ -40,39 +40,82 @@ static inline void make_video_info(struct video_output_info *vi,
 	vi->range = ovi->range;
 	vi->colorspace = ovi->colorspace;
 	vi->cache_size = 6;
+	vi->input_queue_size = 0;
+}
+
+static bool set_conversion_techs(enum video_format format, uint32_t width,
+				 const char *techs[NUM_CHANNELS],
+				 float *width_i)
+{
+	techs[0] = NULL;
+	techs[1] = NULL;
+	techs[2] = NULL;
+	*width_i = 0.f;
+
+	switch ((uint32_t)format) {
+	case VIDEO_FORMAT_I420:
+		techs[0] = "Planar_Y";
+		techs[1] = "Planar_U_Left";
+		techs[2] = "Planar_V_Left";
+		*width_i = 1.f / (float)width;
+		return true;
+	case VIDEO_FORMAT_NV12:
+		techs[0] = "NV12_Y";
+		techs[1] = "NV12_UV";
+		*width_i = 1.f / (float)width;
+		return true;
+	case VIDEO_FORMAT_I444:
+		techs[0] = "Planar_Y";
+		techs[1] = "Planar_U";
+		techs[2] = "Planar_V";
+		return true;
+	}
+
+	return false;
 }
 
 static inline void calc_gpu_conversion_sizes(const struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	video->conversion_needed = false;
-	video->conversion_techs[0] = NULL;
-	video->conversion_techs[1] = NULL;
-	video->conversion_techs[2] = NULL;
-	video->conversion_width_i = 0.f;
+	video->conversion_needed = set_conversion_techs(
+		ovi->output_format, ovi->output_width, video->conversion_techs,
+		&video->conversion_width_i);
+}
+
+static bool init_convert_textures(gs_texture_t *textures[NUM_CHANNELS],
+				  enum video_format format, uint32_t width,
+				  uint32_t height)
+{
+	textures[0] = gs_texture_create(width, height, GS_R8, 1, NULL,
+					GS_RENDER_TARGET);
 
-	switch ((uint32_t)ovi->output_format) {
+	switch (format) {
 	case VIDEO_FORMAT_I420:
-		video->conversion_needed = true;
-		video->conversion_techs[0] = "Planar_Y";
-		video->conversion_techs[1] = "Planar_U_Left";
-		video->conversion_techs[2] = "Planar_V_Left";
-		video->conversion_width_i = 1.f / (float)ovi->output_width;
+		textures[1] = gs_texture_create(width / 2, height / 2, GS_R8, 1,
+						NULL, GS_RENDER_TARGET);
+		textures[2] = gs_texture_create(width / 2, height / 2, GS_R8, 1,
+						NULL, GS_RENDER_TARGET);
+		if (!textures[2])
+			return false;
 		break;
 	case VIDEO_FORMAT_NV12:
-		video->conversion_needed = true;
-		video->conversion_techs[0] = "NV12_Y";
-		video->conversion_techs[1] = "NV12_UV";
-		video->conversion_width_i = 1.f / (float)ovi->output_width;
+		textures[1] = gs_texture_create(width / 2, height / 2, GS_R8G8,
+						1, NULL, GS_RENDER_TARGET);
 		break;
 	case VIDEO_FORMAT_I444:
-		video->conversion_needed = true;
-		video->conversion_techs[0] = "Planar_Y";
-		video->conversion_techs[1] = "Planar_U";
-		video->conversion_techs[2] = "Planar_V";
+		textures[1] = gs_texture_create(width, height, GS_R8, 1, NULL,
+						GS_RENDER_TARGET);
+		textures[2] = gs_texture_create(width, height, GS_R8, 1, NULL,
+						GS_RENDER_TARGET);
+		if (!textures[2])
+			return false;
+		break;
+	default:
 		break;
 	}
+
+	return textures[0] && textures[1];
 }
 
 static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
@@ -107,41 +150,12 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 				       GS_RENDER_TARGET | GS_SHARED_KM_TEX);
 	} else {
 #endif
-		video->convert_textures[0] =
-			gs_texture_create(ovi->output_width, ovi->output_height,
-					  GS_R8, 1, NULL, GS_RENDER_TARGET);
-
 		const struct video_output_info *info =
 			video_output_get_info(video->video);
-		switch (info->format) {
-		case VIDEO_FORMAT_I420:
-			video->convert_textures[1] = gs_texture_create(
-				ovi->output_width / 2, ovi->output_height / 2,
-				GS_R8, 1, NULL, GS_RENDER_TARGET);
-			video->convert_textures[2] = gs_texture_create(
-				ovi->output_width / 2, ovi->output_height / 2,
-				GS_R8, 1, NULL, GS_RENDER_TARGET);
-			if (!video->convert_textures[2])
-				return false;
-			break;
-		case VIDEO_FORMAT_NV12:
-			video->convert_textures[1] = gs_texture_create(
-				ovi->output_width / 2, ovi->output_height / 2,
-				GS_R8G8, 1, NULL, GS_RENDER_TARGET);
-			break;
-		case VIDEO_FORMAT_I444:
-			video->convert_textures[1] = gs_texture_create(
-				ovi->output_width, ovi->output_height, GS_R8, 1,
-				NULL, GS_RENDER_TARGET);
-			video->convert_textures[2] = gs_texture_create(
-				ovi->output_width, ovi->output_height, GS_R8, 1,
-				NULL, GS_RENDER_TARGET);
-			if (!video->convert_textures[2])
-				return false;
-			break;
-		default:
-			break;
-		}
+		if (!init_convert_textures(video->convert_textures,
+					   info->format, ovi->output_width,
+					   ovi->output_height))
+			return false;
 #ifdef _WIN32
 	}
 #endif
@@ -154,42 +168,37 @@ static bool obs_init_gpu_conversion(struct obs_video_info *ovi)
 	return true;
 }
 
-static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
+static bool init_copy_surfaces(gs_stagesurf_t *surfaces[NUM_CHANNELS],
+			       enum video_format format, uint32_t width,
+			       uint32_t height)
 {
-	struct obs_core_video *video = &obs->video;
-
-	video->copy_surfaces[i][0] = gs_stagesurface_create(
-		ovi->output_width, ovi->output_height, GS_R8);
-	if (!video->copy_surfaces[i][0])
+	surfaces[0] = gs_stagesurface_create(width, height, GS_R8);
+	if (!surfaces[0])
 		return false;
 
-	const struct video_output_info *info =
-		video_output_get_info(video->video);
-	switch (info->format) {
+	switch (format) {
 	case VIDEO_FORMAT_I420:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
-			ovi->output_width / 2, ovi->output_height / 2, GS_R8);
-		if (!video->copy_surfaces[i][1])
+		surfaces[1] =
+			gs_stagesurface_create(width / 2, height / 2, GS_R8);
+		if (!surfaces[1])
 			return false;
-		video->copy_surfaces[i][2] = gs_stagesurface_create(
-			ovi->output_width / 2, ovi->output_height / 2, GS_R8);
-		if (!video->copy_surfaces[i][2])
+		surfaces[2] =
+			gs_stagesurface_create(width / 2, height / 2, GS_R8);
+		if (!surfaces[2])
 			return false;
 		break;
 	case VIDEO_FORMAT_NV12:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
-			ovi->output_width / 2, ovi->output_height / 2, GS_R8G8);
-		if (!video->copy_surfaces[i][1])
+		surfaces[1] =
+			gs_stagesurface_create(width / 2, height / 2, GS_R8G8);
+		if (!surfaces[1])
 			return false;
 		break;
 	case VIDEO_FORMAT_I444:
-		video->copy_surfaces[i][1] = gs_stagesurface_create(
-			ovi->output_width, ovi->output_height, GS_R8);
-		if (!video->copy_surfaces[i][1])
+		surfaces[1] = gs_stagesurface_create(width, height, GS_R8);
+		if (!surfaces[1])
 			return false;
-		video->copy_surfaces[i][2] = gs_stagesurface_create(
-			ovi->output_width, ovi->output_height, GS_R8);
-		if (!video->copy_surfaces[i][2])
+		surfaces[2] = gs_stagesurface_create(width, height, GS_R8);
+		if (!surfaces[2])
 			return false;
 		break;
 	default:
@@ -199,11 +208,21 @@ static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
 	return true;
 }
 
+static bool obs_init_gpu_copy_surfaces(struct obs_video_info *ovi, size_t i)
+{
+	struct obs_core_video *video = &obs->video;
+	const struct video_output_info *info =
+		video_output_get_info(video->video);
+
+	return init_copy_surfaces(video->copy_surfaces[i], info->format,
+				  ovi->output_width, ovi->output_height);
+}
+
 static bool obs_init_textures(struct obs_video_info *ovi)
 {
 	struct obs_core_video *video = &obs->video;
 
-	for (size_t i = 0; i < NUM_TEXTURES; i++) {
+	for (int i = 0; i < video->stage_depth; i++) {
 #ifdef _WIN32
 		if (video->using_nv12_tex) {
 			video->copy_surfaces[i][0] =
@@ -360,15 +379,16 @@ static int obs_init_graphics(struct obs_video_info *ovi)
 	return success ? OBS_VIDEO_SUCCESS : OBS_VIDEO_FAIL;
 }
 
-static inline void set_video_matrix(struct obs_core_video *video,
-				    struct obs_video_info *ovi)
+static void make_color_matrix(float color_matrix[16], enum video_format format,
+			      enum video_colorspace colorspace,
+			      enum video_range_type range)
 {
 	struct matrix4 mat;
 	struct vec4 r_row;
 
-	if (format_is_yuv(ovi->output_format)) {
-		video_format_get_parameters(ovi->colorspace, ovi->range,
-					    (float *)&mat, NULL, NULL);
+	if (format_is_yuv(format)) {
+		video_format_get_parameters(colorspace, range, (float *)&mat,
+					    NULL, NULL);
 		matrix4_inv(&mat, &mat);
 
 		/* swap R and G */
@@ -379,7 +399,14 @@ static inline void set_video_matrix(struct obs_core_video *video,
 		matrix4_identity(&mat);
 	}
 
-	memcpy(video->color_matrix, &mat, sizeof(float) * 16);
+	memcpy(color_matrix, &mat, sizeof(float) * 16);
+}
+
+static inline void set_video_matrix(struct obs_core_video *video,
+				    struct obs_video_info *ovi)
+{
+	make_color_matrix(video->color_matrix, ovi->output_format,
+			  ovi->colorspace, ovi->range);
 }
 
 static int obs_init_video(struct obs_video_info *ovi)
@@ -396,6 +423,26 @@ static int obs_init_video(struct obs_video_info *ovi)
 	video->output_height = ovi->output_height;
 	video->gpu_conversion = ovi->gpu_conversion;
 	video->scale_type = ovi->scale_type;
+	video->zero_copy = video->zero_copy_setting;
+	video->stage_depth = video->zero_copy ? (int)video->stage_depth_setting
+					      : NUM_TEXTURES;
+	video->readback_delay = 1;
+	if (video->readback_delay_setting > 1) {
+		int depth = video->stage_depth +
+			    (int)video->readback_delay_setting - 1;
+		if (depth > MAX_STAGE_SURFACES)
+			depth = MAX_STAGE_SURFACES;
+
+		video->readback_delay += depth - video->stage_depth;
+		video->stage_depth = depth;
+
+		if (video->readback_delay < (int)video->readback_delay_setting)
+			blog(LOG_WARNING,
+			     "Readback delay of %u frames reduced to %d, "
+			     "%d staging surfaces at most",
+			     video->readback_delay_setting,
+			     video->readback_delay, MAX_STAGE_SURFACES);
+	}
 
 	set_video_matrix(video, ovi);
 
@@ -428,6 +475,8 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	if (pthread_mutex_init(&video->task_mutex, NULL) < 0)
 		return OBS_VIDEO_FAIL;
+	if (pthread_mutex_init(&video->scaled_mutex, NULL) < 0)
+		return OBS_VIDEO_FAIL;
 
 #ifdef __APPLE__
 	errorcode = pthread_create(&video->video_thread, NULL,
@@ -444,6 +493,84 @@ static int obs_init_video(struct obs_video_info *ovi)
 	return OBS_VIDEO_SUCCESS;
 }
 
+/* call in the graphics context, its video closed */
+static void free_scaled_video(struct obs_scaled_video *scaled)
+{
+	for (size_t c = 0; c < NUM_CHANNELS; c++) {
+		if (scaled->mapped_surfaces[c])
+			gs_stagesurface_unmap(scaled->mapped_surfaces[c]);
+	}
+
+	for (size_t i = 0; i < MAX_STAGE_SURFACES; i++) {
+		for (size_t c = 0; c < NUM_CHANNELS; c++)
+			gs_stagesurface_destroy(scaled->copy_surfaces[i][c]);
+	}
+
+	for (size_t c = 0; c < NUM_CHANNELS; c++)
+		gs_texture_destroy(scaled->convert_textures[c]);
+	gs_texture_destroy(scaled->output_texture);
+
+	bfree(scaled);
+}
+
+/* call in the graphics context */
+static struct obs_scaled_video *
+create_scaled_video(const struct video_scale_info *info)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_scaled_video *scaled = bzalloc(sizeof(*scaled));
+	struct video_output_info vi = *video_output_get_info(video->video);
+
+	scaled->info = *info;
+
+	vi.name = "scaled video";
+	vi.format = info->format;
+	vi.width = info->width;
+	vi.height = info->height;
+	vi.colorspace = info->colorspace;
+	vi.range = info->range;
+
+	make_color_matrix(scaled->color_matrix, info->format, info->colorspace,
+			  info->range);
+
+	if (video_output_open(&scaled->video, &vi) != VIDEO_OUTPUT_SUCCESS)
+		goto fail;
+
+	set_conversion_techs(info->format, info->width,
+			     scaled->conversion_techs,
+			     &scaled->conversion_width_i);
+
+	scaled->output_texture = gs_texture_create(info->width, info->height,
+						   GS_RGBA, 1, NULL,
+						   GS_RENDER_TARGET);
+	if (!scaled->output_texture)
+		goto fail;
+	if (!init_convert_textures(scaled->convert_textures, info->format,
+				   info->width, info->height))
+		goto fail;
+
+	for (int i = 0; i < video->stage_depth; i++) {
+		if (!init_copy_surfaces(scaled->copy_surfaces[i], info->format,
+					info->width, info->height))
+			goto fail;
+	}
+
+	blog(LOG_INFO, "Scaled video: %ux%u %s %s/%s, scaled on the GPU",
+	     info->width, info->height, get_video_format_name(info->format),
+	     get_video_colorspace_name(info->colorspace),
+	     get_video_range_name(info->format, info->range));
+	return scaled;
+
+fail:
+	blog(LOG_WARNING,
+	     "Failed to create a %ux%u scaled video, "
+	     "scaling on the CPU instead",
+	     info->width, info->height);
+	video_output_close(scaled->video);
+	free_scaled_video(scaled);
+	return NULL;
+}
+
 static void stop_video(void)
 {
 	struct obs_core_video *video = &obs->video;
@@ -466,11 +593,24 @@ static void obs_free_video(void)
 		video_output_close(video->video);
 		video->video = NULL;
 
+		/* the outputs are stopped, nothing is connected anymore */
+		for (size_t i = 0; i < video->scaled_videos.num; i++) {
+			struct obs_scaled_video *scaled =
+				video->scaled_videos.array[i];
+			video_output_close(scaled->video);
+			scaled->video = NULL;
+		}
+
 		if (!video->graphics)
 			return;
 
 		gs_enter_context(video->graphics);
 
+		for (size_t i = 0; i < video->scaled_videos.num; i++)
+			free_scaled_video(video->scaled_videos.array[i]);
+		da_free(video->scaled_videos);
+		da_free(video->scaled_connections);
+
 		for (size_t c = 0; c < NUM_CHANNELS; c++) {
 			if (video->mapped_surfaces[c]) {
 				gs_stagesurface_unmap(
@@ -479,7 +619,19 @@ static void obs_free_video(void)
 			}
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		/* zero-copy: video-io is closed, frames it still had are
+		 * never released */
+		for (size_t i = 0; i < MAX_STAGE_SURFACES; i++) {
+			struct obs_stage_slot *slot = &video->stage_slots[i];
+			for (size_t c = 0; c < NUM_CHANNELS; c++) {
+				if (slot->mapped[c])
+					gs_stagesurface_unmap(
+						video->copy_surfaces[i][c]);
+			}
+			memset(slot, 0, sizeof(*slot));
+		}
+
+		for (size_t i = 0; i < MAX_STAGE_SURFACES; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
 					gs_stagesurface_destroy(
@@ -498,7 +650,7 @@ static void obs_free_video(void)
 			}
 		}
 
-		for (size_t i = 0; i < NUM_TEXTURES; i++) {
+		for (size_t i = 0; i < MAX_STAGE_SURFACES; i++) {
 			for (size_t c = 0; c < NUM_CHANNELS; c++) {
 				if (video->copy_surfaces[i][c]) {
 					gs_stagesurface_destroy(
@@ -530,6 +682,9 @@ static void obs_free_video(void)
 		pthread_mutex_init_value(&video->task_mutex);
 		circlebuf_free(&video->tasks);
 
+		pthread_mutex_destroy(&video->scaled_mutex);
+		pthread_mutex_init_value(&video->scaled_mutex);
+
 		video->gpu_encoder_active = 0;
 		video->cur_texture = 0;
 	}
@@ -1181,6 +1336,12 @@ int obs_reset_video(struct obs_video_info *ovi)
 	     ovi->output_height, scale_type_name, ovi->fps_num, ovi->fps_den,
 	     get_video_format_name(ovi->output_format),
 	     yuv ? yuv_format : "None", yuv ? "/" : "", yuv ? yuv_range : "");
+	if (video->zero_copy_setting)
+		blog(LOG_INFO, "\tzero-copy:         %u staging surfaces",
+		     video->stage_depth_setting);
+	if (video->readback_delay_setting > 1)
+		blog(LOG_INFO, "\treadback delay:    %u frames",
+		     video->readback_delay_setting);
 
 	return obs_init_video(ovi);
 }
@@ -2337,12 +2498,128 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+/* a different size, YUV format, colorspace or range of the main output,
+ * rendered on the GPU when it converts the main output already */
+static bool scaled_video_needed(video_t *v,
+				const struct video_scale_info *conversion,
+				struct video_scale_info *info)
+{
+	struct obs_core_video *video = &obs->video;
+	const struct video_output_info *voi;
+
+	if (!conversion || v != video->video || !video->gpu_conversion)
+		return false;
+
+	voi = video_output_get_info(v);
+	*info = *conversion;
+	if (!info->width)
+		info->width = voi->width;
+	if (!info->height)
+		info->height = voi->height;
+	if (info->colorspace == VIDEO_CS_DEFAULT)
+		info->colorspace = voi->colorspace;
+	if (info->range == VIDEO_RANGE_DEFAULT)
+		info->range = voi->range;
+
+	if (info->width == voi->width && info->height == voi->height &&
+	    info->format == voi->format &&
+	    info->colorspace == voi->colorspace && info->range == voi->range)
+		return false;
+
+	switch (info->format) {
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_NV12:
+		return info->width % 2 == 0 && info->height % 2 == 0;
+	case VIDEO_FORMAT_I444:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* call in the graphics context with scaled_mutex held */
+static struct obs_scaled_video *
+acquire_scaled_video(const struct video_scale_info *info)
+{
+	struct obs_core_video *video = &obs->video;
+	struct obs_scaled_video *scaled = NULL;
+
+	for (size_t i = 0; i < video->scaled_videos.num; i++) {
+		struct obs_scaled_video *cur = video->scaled_videos.array[i];
+		if (cur->info.width == info->width &&
+		    cur->info.height == info->height &&
+		    cur->info.format == info->format &&
+		    cur->info.colorspace == info->colorspace &&
+		    cur->info.range == info->range) {
+			scaled = cur;
+			break;
+		}
+	}
+
+	if (!scaled) {
+		if (video->scaled_videos.num == MAX_SCALED_VIDEOS)
+			return NULL;
+
+		scaled = create_scaled_video(info);
+		if (!scaled)
+			return NULL;
+
+		da_push_back(video->scaled_videos, &scaled);
+	}
+
+	scaled->refs++;
+	return scaled;
+}
+
+static size_t
+find_scaled_connection(void (*callback)(void *param, struct video_data *frame),
+		       void *param)
+{
+	struct obs_core_video *video = &obs->video;
+
+	for (size_t i = 0; i < video->scaled_connections.num; i++) {
+		struct obs_scaled_connection *connection =
+			&video->scaled_connections.array[i];
+		if (connection->callback == callback &&
+		    connection->param == param)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
 void start_raw_video(video_t *v, const struct video_scale_info *conversion,
 		     void (*callback)(void *param, struct video_data *frame),
 		     void *param)
 {
 	struct obs_core_video *video = &obs->video;
+	struct video_scale_info info;
+
 	os_atomic_inc_long(&video->raw_active);
+
+	if (scaled_video_needed(v, conversion, &info)) {
+		struct obs_scaled_video *scaled;
+
+		obs_enter_graphics();
+		pthread_mutex_lock(&video->scaled_mutex);
+
+		scaled = acquire_scaled_video(&info);
+		if (scaled) {
+			struct obs_scaled_connection connection = {
+				callback, param, scaled};
+			da_push_back(video->scaled_connections, &connection);
+		}
+
+		pthread_mutex_unlock(&video->scaled_mutex);
+		obs_leave_graphics();
+
+		if (scaled) {
+			video_output_connect(scaled->video, NULL, callback,
+					     param);
+			return;
+		}
+	}
+
 	video_output_connect(v, conversion, callback, param);
 }
 
@@ -2351,8 +2628,60 @@ void stop_raw_video(video_t *v,
 		    void *param)
 {
 	struct obs_core_video *video = &obs->video;
+	struct obs_scaled_video *scaled = NULL;
+
 	os_atomic_dec_long(&video->raw_active);
-	video_output_disconnect(v, callback, param);
+
+	if (v == video->video) {
+		pthread_mutex_lock(&video->scaled_mutex);
+		size_t idx = find_scaled_connection(callback, param);
+		if (idx != DARRAY_INVALID) {
+			scaled = video->scaled_connections.array[idx].scaled;
+			da_erase(video->scaled_connections, idx);
+		}
+		pthread_mutex_unlock(&video->scaled_mutex);
+	}
+
+	if (scaled) {
+		bool release;
+
+		video_output_disconnect(scaled->video, callback, param);
+
+		/* no longer rendered nor output once out of the list */
+		pthread_mutex_lock(&video->scaled_mutex);
+		release = --scaled->refs == 0;
+		if (release)
+			da_erase_item(video->scaled_videos, &scaled);
+		pthread_mutex_unlock(&video->scaled_mutex);
+
+		if (release) {
+			video_output_close(scaled->video);
+
+			obs_enter_graphics();
+			free_scaled_video(scaled);
+			obs_leave_graphics();
+		}
+	} else {
+		video_output_disconnect(v, callback, param);
+	}
+}
+
+video_t *get_raw_video(video_t *v,
+		       void (*callback)(void *param, struct video_data *frame),
+		       void *param)
+{
+	struct obs_core_video *video = &obs->video;
+
+	if (v != video->video)
+		return v;
+
+	pthread_mutex_lock(&video->scaled_mutex);
+	size_t idx = find_scaled_connection(callback, param);
+	if (idx != DARRAY_INVALID)
+		v = video->scaled_connections.array[idx].scaled->video;
+	pthread_mutex_unlock(&video->scaled_mutex);
+
+	return v;
 }
 
 void obs_add_raw_video_callback(const struct video_scale_info *conversion,
@@ -2465,6 +2794,33 @@ bool obs_nv12_tex_active(void)
 	return video->using_nv12_tex;
 }
 
+void obs_set_video_zero_copy(bool enable, uint32_t stage_depth)
+{
+	if (!obs)
+		return;
+
+	if (stage_depth < NUM_TEXTURES)
+		stage_depth = NUM_TEXTURES;
+	else if (stage_depth > MAX_STAGE_SURFACES)
+		stage_depth = MAX_STAGE_SURFACES;
+
+	obs->video.zero_copy_setting = enable;
+	obs->video.stage_depth_setting = stage_depth;
+}
+
+void obs_set_video_readback_delay(uint32_t frames)
+{
+	if (!obs)
+		return;
+
+	if (frames < 1)
+		frames = 1;
+	else if (frames > MAX_STAGE_SURFACES - 1)
+		frames = MAX_STAGE_SURFACES - 1;
+
+	obs->video.readback_delay_setting = frames;
+}
+
 /* ------------------------------------------------------------------------- */
 /* task stuff                                                                */
 
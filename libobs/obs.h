@@ -386,6 +386,28 @@ EXPORT bool obs_reset_audio(const struct obs_audio_info *oai);
 /** Gets the current video settings, returns false if no video */
 EXPORT bool obs_get_video_info(struct obs_video_info *ovi);
 
+/**
+ * Zero-copy raw video: the raw outputs get the planes of the mapped staging
+ * surfaces instead of a copy of them. A surface stays mapped until all the
+ * outputs got its frame, with |stage_depth| surfaces (2 to 8) they have
+ * stage_depth - 1 frames to do so before frames get skipped.
+ *
+ * @note Takes effect on the next obs_reset_video.
+ */
+EXPORT void obs_set_video_zero_copy(bool enable, uint32_t stage_depth);
+
+/**
+ * Raw video frames are downloaded |frames| frames (1 to 7) after they were
+ * rendered, giving the GPU that long to finish the copy. At 1 (the default)
+ * the download waits for the copy; above 1, a frame still not copied by then
+ * is not waited for, the last frame is repeated instead. The delay is
+ * reduced (with a warning) when it does not fit the staging surfaces left
+ * by zero-copy.
+ *
+ * @note Takes effect on the next obs_reset_video.
+ */
+EXPORT void obs_set_video_readback_delay(uint32_t frames);
+
 /** Gets the current audio settings, returns false if no audio */
 EXPORT bool obs_get_audio_info(struct obs_audio_info *oai);
 
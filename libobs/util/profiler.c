@@ -439,6 +439,17 @@ void profile_end(const char *name)
 	merge_context(call);
 }
 
+void profile_record(const char *name, uint64_t start_time,
+		    uint64_t end_time)
+{
+	profile_call *call = bzalloc(sizeof(profile_call));
+	call->name = name;
+	call->start_time = start_time;
+	call->end_time = end_time;
+
+	merge_context(call);
+}
+
 static int profiler_time_entry_compare(const void *first, const void *second)
 {
 	int64_t diff = ((profiler_time_entry *)second)->time_delta -
@@ -22,6 +22,11 @@ EXPORT void profile_end(const char *name);
 
 EXPORT void profile_reenable_thread(void);
 
+/* Record an interval measured outside of profile_start/profile_end, e.g.
+ * spanning several threads, as a call of root |name| (os_gettime_ns times) */
+EXPORT void profile_record(const char *name, uint64_t start_time,
+			   uint64_t end_time);
+
 /* ------------------------------------------------------------------------- */
 /* Profiler control */
 
@@ -54,6 +54,20 @@
 #define _mm_srai_epi16 simde_mm_srai_epi16
 #define _mm_shufflelo_epi16 simde_mm_shufflelo_epi16
 #define _mm_storeu_si128 simde_mm_storeu_si128
+#define _mm_setzero_si128 simde_mm_setzero_si128
+#define _mm_loadu_si128 simde_mm_loadu_si128
+#define _mm_storel_epi64 simde_mm_storel_epi64
+#define _mm_unpacklo_epi8 simde_mm_unpacklo_epi8
+#define _mm_unpackhi_epi8 simde_mm_unpackhi_epi8
+#define _mm_unpacklo_epi32 simde_mm_unpacklo_epi32
+#define _mm_unpackhi_epi32 simde_mm_unpackhi_epi32
+#define _mm_unpacklo_epi64 simde_mm_unpacklo_epi64
+#define _mm_unpackhi_epi64 simde_mm_unpackhi_epi64
+#define _mm_madd_epi16 simde_mm_madd_epi16
+#define _mm_add_epi32 simde_mm_add_epi32
+#define _mm_srai_epi32 simde_mm_srai_epi32
+#define _mm_shufflehi_epi16 simde_mm_shufflehi_epi16
+#define _mm_cvtsi128_si32 simde_mm_cvtsi128_si32
 
 #define _MM_SHUFFLE SIMDE_MM_SHUFFLE
 #define _MM_TRANSPOSE4_PS SIMDE_MM_TRANSPOSE4_PS
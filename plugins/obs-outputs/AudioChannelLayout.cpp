@@ -0,0 +1,146 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "AudioChannelLayout.h"
+
+enum Speaker { FL, FR, FC, LFE, BL, BR, BC, SL, SR };
+
+// Speakers of the OBS layouts, in channel order (see audio-io.h)
+static std::vector<Speaker> obsSpeakers(enum speaker_layout speakers)
+{
+	switch (speakers) {
+	case SPEAKERS_MONO:
+		return {FC};
+	case SPEAKERS_2POINT1:
+		return {FL, FR, LFE};
+	case SPEAKERS_4POINT0:
+		return {FL, FR, FC, BC};
+	case SPEAKERS_4POINT1:
+		return {FL, FR, FC, LFE, BC};
+	case SPEAKERS_5POINT1:
+		return {FL, FR, FC, LFE, BL, BR};
+	case SPEAKERS_7POINT1:
+		return {FL, FR, FC, LFE, BL, BR, SL, SR};
+	case SPEAKERS_STEREO:
+	case SPEAKERS_UNKNOWN:
+	default:
+		return {FL, FR};
+	}
+}
+
+// Speakers of the sent layouts, same order
+static std::vector<Speaker> sentSpeakers(size_t channels)
+{
+	switch (channels) {
+	case 1:
+		return {FC};
+	case 6:
+		return {FL, FR, FC, LFE, BL, BR};
+	case 8:
+		return {FL, FR, FC, LFE, BL, BR, SL, SR};
+	default:
+		return {FL, FR};
+	}
+}
+
+AudioChannelLayout AudioChannelLayout::ForSpeakers(enum speaker_layout speakers)
+{
+	AudioChannelLayout layout = Stereo();
+	switch (speakers) {
+	case SPEAKERS_MONO:
+		layout.channels = 1;
+		break;
+	case SPEAKERS_2POINT1:
+	case SPEAKERS_4POINT0:
+	case SPEAKERS_4POINT1:
+	case SPEAKERS_5POINT1:
+		// Same stream layout as libwebrtc and the browsers
+		layout.channels = 6;
+		layout.num_streams = 4;
+		layout.coupled_streams = 2;
+		layout.channel_mapping = "0,4,1,2,3,5";
+		break;
+	case SPEAKERS_7POINT1:
+		layout.channels = 8;
+		layout.num_streams = 5;
+		layout.coupled_streams = 3;
+		layout.channel_mapping = "0,6,1,4,5,2,3,7";
+		break;
+	default:
+		break;
+	}
+	return layout;
+}
+
+AudioChannelLayout AudioChannelLayout::Stereo()
+{
+	AudioChannelLayout layout;
+	layout.channels = 2;
+	layout.num_streams = 1;
+	layout.coupled_streams = 1;
+	return layout;
+}
+
+static int find(const std::vector<Speaker> &layout, Speaker speaker)
+{
+	for (size_t i = 0; i < layout.size(); i++)
+		if (layout[i] == speaker)
+			return (int)i;
+	return -1;
+}
+
+std::vector<float> AudioMixMatrix(enum speaker_layout speakers,
+				  size_t channels)
+{
+	static const float kHalfPower = 0.70710678f;
+
+	const std::vector<Speaker> in = obsSpeakers(speakers);
+	const std::vector<Speaker> out = sentSpeakers(channels);
+	if (in == out)
+		return {};
+
+	std::vector<float> matrix(out.size() * in.size(), 0.0f);
+	auto add = [&](size_t input, Speaker speaker, float gain) {
+		int output = find(out, speaker);
+		if (output != -1)
+			matrix[output * in.size() + input] += gain;
+	};
+	for (size_t i = 0; i < in.size(); i++) {
+		Speaker speaker = in[i];
+		if (find(out, speaker) != -1) {
+			add(i, speaker, 1.0f);
+			continue;
+		}
+		switch (speaker) {
+		case FL:
+		case FR:
+			// Mono
+			add(i, FC, kHalfPower);
+			break;
+		case FC:
+			add(i, FL, kHalfPower);
+			add(i, FR, kHalfPower);
+			break;
+		case BC:
+			// Into the surround pair if any, else the front one
+			if (find(out, BL) != -1) {
+				add(i, BL, kHalfPower);
+				add(i, BR, kHalfPower);
+			} else {
+				add(i, FL, 0.5f);
+				add(i, FR, 0.5f);
+			}
+			break;
+		case BL:
+		case SL:
+			add(i, FL, kHalfPower);
+			break;
+		case BR:
+		case SR:
+			add(i, FR, kHalfPower);
+			break;
+		case LFE:
+			break;
+		}
+	}
+	return matrix;
+}
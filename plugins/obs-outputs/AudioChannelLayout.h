@@ -0,0 +1,44 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _AUDIO_CHANNEL_LAYOUT_H_
+#define _AUDIO_CHANNEL_LAYOUT_H_
+
+// lib obs include
+#include <media-io/audio-io.h>
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// Audio layout the WebRTC outputs send for an OBS speaker layout.
+//
+// Mono and stereo go as opus. Surround goes as multiopus in one of the two
+// layouts libwebrtc (and the browsers) decode, 5.1 and 7.1, the other OBS
+// surround layouts are upmixed into 5.1. The channels are interleaved in the
+// OBS (WAVE) order on both sides, the multiopus channel_mapping of the SDP
+// assigns them to the coupled and mono Opus streams.
+struct AudioChannelLayout {
+	// Channels sent: 1, 2, 6 or 8
+	size_t channels;
+	// Multiopus fmtp parameters, unused for opus
+	int num_streams;
+	int coupled_streams;
+	std::string channel_mapping;
+
+	bool surround() const { return channels > 2; }
+	// "opus" or "multiopus"
+	const char *codec() const { return surround() ? "multiopus" : "opus"; }
+
+	static AudioChannelLayout ForSpeakers(enum speaker_layout speakers);
+	static AudioChannelLayout Stereo();
+};
+
+// Mix matrix from the channels of |speakers| to the |channels| of a sent
+// layout (2, 6 or 8), |channels| rows of |get_audio_channels(speakers)|
+// coefficients. Speakers missing from the sent layout are folded into the
+// closest ones (ITU-R BS.775 coefficients, LFE dropped when downmixing).
+// Empty if the channels go through as they are.
+std::vector<float> AudioMixMatrix(enum speaker_layout speakers,
+				  size_t channels);
+
+#endif
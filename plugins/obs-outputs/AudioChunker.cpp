@@ -0,0 +1,206 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "AudioChunker.h"
+
+#include <string.h>
+#include <util/sse-intrin.h>
+
+static inline int16_t fromU8(uint8_t sample)
+{
+	return (int16_t)((sample - 128) << 8);
+}
+
+static inline int16_t from32(int32_t sample)
+{
+	return (int16_t)(sample >> 16);
+}
+
+static inline int16_t fromFloat(float sample)
+{
+	if (sample >= 1.0f)
+		return 32767;
+	if (sample <= -1.0f)
+		return -32768;
+	return (int16_t)(sample * 32767.0f);
+}
+
+AudioChunker::AudioChunker()
+	: format_(AUDIO_FORMAT_16BIT),
+	  sample_rate_(48000),
+	  input_channels_(2),
+	  channels_(2),
+	  chunk_frames_(480),
+	  filled_(0)
+{
+	chunk_.resize(chunk_frames_ * channels_);
+}
+
+void AudioChunker::Configure(enum audio_format format, uint32_t sample_rate,
+			     size_t channels)
+{
+	format_ = format;
+	sample_rate_ = sample_rate;
+	input_channels_ = channels;
+	channels_ = channels;
+	mix_.clear();
+	chunk_frames_ = sample_rate / 100;
+	filled_ = 0;
+	chunk_.resize(chunk_frames_ * channels_);
+}
+
+void AudioChunker::SetMix(size_t channels, const std::vector<float> &matrix)
+{
+	channels_ = matrix.empty() ? input_channels_ : channels;
+	mix_ = matrix;
+	filled_ = 0;
+	chunk_.resize(chunk_frames_ * channels_);
+}
+
+// Sample |frame| of |channel| in [-1, 1]
+static inline float sampleAt(enum audio_format format, uint8_t *const *data,
+			     size_t channels, size_t channel, size_t frame)
+{
+	const size_t index = frame * channels + channel;
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+		return (data[0][index] - 128) / 128.0f;
+	case AUDIO_FORMAT_16BIT:
+		return ((const int16_t *)data[0])[index] / 32768.0f;
+	case AUDIO_FORMAT_32BIT:
+		return ((const int32_t *)data[0])[index] / 2147483648.0f;
+	case AUDIO_FORMAT_FLOAT:
+		return ((const float *)data[0])[index];
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		return (data[channel][frame] - 128) / 128.0f;
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		return ((const int16_t *)data[channel])[frame] / 32768.0f;
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		return ((const int32_t *)data[channel])[frame] / 2147483648.0f;
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		return ((const float *)data[channel])[frame];
+	case AUDIO_FORMAT_UNKNOWN:
+	default:
+		return 0.0f;
+	}
+}
+
+void AudioChunker::Mix(uint8_t *const *data, size_t offset, size_t frames)
+{
+	int16_t *out = chunk_.data() + filled_ * channels_;
+
+	if (format_ != AUDIO_FORMAT_FLOAT_PLANAR) {
+		for (size_t i = 0; i < frames; i++) {
+			for (size_t ch = 0; ch < channels_; ch++) {
+				const float *gains =
+					mix_.data() + ch * input_channels_;
+				float sum = 0.0f;
+				for (size_t k = 0; k < input_channels_; k++)
+					if (gains[k] != 0.0f)
+						sum += gains[k] *
+						       sampleAt(format_, data,
+								input_channels_,
+								k, offset + i);
+				out[i * channels_ + ch] = fromFloat(sum);
+			}
+		}
+		return;
+	}
+
+	// Format of the OBS audio output: planes mixed 4 frames at a time
+	const __m128 scale = _mm_set1_ps(32767.0f);
+	for (size_t ch = 0; ch < channels_; ch++) {
+		const float *gains = mix_.data() + ch * input_channels_;
+		size_t i = 0;
+		for (; i + 4 <= frames; i += 4) {
+			__m128 sum = _mm_setzero_ps();
+			for (size_t k = 0; k < input_channels_; k++) {
+				if (gains[k] == 0.0f)
+					continue;
+				const float *in =
+					(const float *)data[k] + offset + i;
+				sum = _mm_add_ps(sum,
+						 _mm_mul_ps(_mm_set1_ps(gains[k]),
+							    _mm_loadu_ps(in)));
+			}
+			// Clamped like fromFloat
+			__m128i samples = _mm_cvtps_epi32(_mm_mul_ps(
+				_mm_min_ps(_mm_max_ps(sum, _mm_set1_ps(-1.0f)),
+					   _mm_set1_ps(1.0f)),
+				scale));
+			int16_t packed[8];
+			_mm_storeu_si128((__m128i *)packed,
+					 _mm_packs_epi32(samples, samples));
+			for (size_t j = 0; j < 4; j++)
+				out[(i + j) * channels_ + ch] = packed[j];
+		}
+		for (; i < frames; i++) {
+			float sum = 0.0f;
+			for (size_t k = 0; k < input_channels_; k++)
+				sum += gains[k] *
+				       ((const float *)data[k])[offset + i];
+			out[i * channels_ + ch] = fromFloat(sum);
+		}
+	}
+}
+
+void AudioChunker::Convert(uint8_t *const *data, size_t offset, size_t frames)
+{
+	int16_t *out = chunk_.data() + filled_ * channels_;
+	const size_t samples = frames * channels_;
+
+	switch (format_) {
+	case AUDIO_FORMAT_U8BIT: {
+		const uint8_t *in = data[0] + offset * channels_;
+		for (size_t i = 0; i < samples; i++)
+			out[i] = fromU8(in[i]);
+		break;
+	}
+	case AUDIO_FORMAT_16BIT:
+		memcpy(out, (const int16_t *)data[0] + offset * channels_,
+		       samples * sizeof(int16_t));
+		break;
+	case AUDIO_FORMAT_32BIT: {
+		const int32_t *in = (const int32_t *)data[0] + offset * channels_;
+		for (size_t i = 0; i < samples; i++)
+			out[i] = from32(in[i]);
+		break;
+	}
+	case AUDIO_FORMAT_FLOAT: {
+		const float *in = (const float *)data[0] + offset * channels_;
+		for (size_t i = 0; i < samples; i++)
+			out[i] = fromFloat(in[i]);
+		break;
+	}
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		for (size_t ch = 0; ch < channels_; ch++) {
+			const uint8_t *in = data[ch] + offset;
+			for (size_t i = 0; i < frames; i++)
+				out[i * channels_ + ch] = fromU8(in[i]);
+		}
+		break;
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		for (size_t ch = 0; ch < channels_; ch++) {
+			const int16_t *in = (const int16_t *)data[ch] + offset;
+			for (size_t i = 0; i < frames; i++)
+				out[i * channels_ + ch] = in[i];
+		}
+		break;
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		for (size_t ch = 0; ch < channels_; ch++) {
+			const int32_t *in = (const int32_t *)data[ch] + offset;
+			for (size_t i = 0; i < frames; i++)
+				out[i * channels_ + ch] = from32(in[i]);
+		}
+		break;
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		for (size_t ch = 0; ch < channels_; ch++) {
+			const float *in = (const float *)data[ch] + offset;
+			for (size_t i = 0; i < frames; i++)
+				out[i * channels_ + ch] = fromFloat(in[i]);
+		}
+		break;
+	case AUDIO_FORMAT_UNKNOWN:
+		memset(out, 0, samples * sizeof(int16_t));
+		break;
+	}
+}
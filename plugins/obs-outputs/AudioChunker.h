@@ -0,0 +1,85 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _AUDIO_CHUNKER_H_
+#define _AUDIO_CHUNKER_H_
+
+// lib obs include
+#include <media-io/audio-io.h>
+
+#include <stdint.h>
+#include <vector>
+
+// Re-chunks OBS audio blocks of any size into the 10 ms blocks libwebrtc
+// audio sinks expect, for any OBS sample rate, format and channel count.
+// libwebrtc sinks only take 16 bit interleaved samples: planar and float
+// input is converted straight into the chunk, so every sample is written
+// once, and 16 bit interleaved input is handed over in place when it is
+// aligned on a chunk. Surround layouts can be remixed on the way (see
+// AudioMixMatrix). Single producer (the OBS audio thread), no locking.
+class AudioChunker {
+public:
+	AudioChunker();
+
+	void Configure(enum audio_format format, uint32_t sample_rate,
+		       size_t channels);
+	// Mix the channels of Configure into |channels| chunk channels with
+	// |matrix| (AudioMixMatrix), empty to keep them as they are
+	void SetMix(size_t channels, const std::vector<float> &matrix);
+	// Drop the pending partial chunk
+	void Reset() { filled_ = 0; }
+
+	// Calls |callback(const int16_t *data, size_t frames)| for each complete
+	// 10 ms chunk, the remainder is kept for the next call
+	template<typename Callback>
+	void Push(uint8_t *const *data, uint32_t frames, Callback &&callback)
+	{
+		size_t offset = 0;
+		while (offset < frames) {
+			size_t count = chunk_frames_ - filled_;
+			if (count > frames - offset)
+				count = frames - offset;
+
+			if (filled_ == 0 && count == chunk_frames_ &&
+			    format_ == AUDIO_FORMAT_16BIT && mix_.empty()) {
+				callback((const int16_t *)data[0] +
+						 offset * channels_,
+					 chunk_frames_);
+			} else {
+				if (mix_.empty())
+					Convert(data, offset, count);
+				else
+					Mix(data, offset, count);
+				filled_ += count;
+				if (filled_ == chunk_frames_) {
+					callback(chunk_.data(), chunk_frames_);
+					filled_ = 0;
+				}
+			}
+			offset += count;
+		}
+	}
+
+	uint32_t sample_rate() const { return sample_rate_; }
+	// Channels of the chunks
+	size_t channels() const { return channels_; }
+	size_t frames_per_chunk() const { return chunk_frames_; }
+
+private:
+	// Convert |frames| frames from |offset| into the chunk
+	void Convert(uint8_t *const *data, size_t offset, size_t frames);
+	// Same, through the mix matrix
+	void Mix(uint8_t *const *data, size_t offset, size_t frames);
+
+	enum audio_format format_;
+	uint32_t sample_rate_;
+	// Channels of the OBS audio, and of the chunks
+	size_t input_channels_;
+	size_t channels_;
+	// |channels_| rows of |input_channels_| gains, empty if no mix
+	std::vector<float> mix_;
+	size_t chunk_frames_;
+	size_t filled_;
+	std::vector<int16_t> chunk_;
+};
+
+#endif
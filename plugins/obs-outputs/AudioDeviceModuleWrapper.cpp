@@ -41,21 +41,25 @@ bool AudioDeviceModuleWrapper::Initialized() const
 }
 
 void AudioDeviceModuleWrapper::onIncomingData(uint8_t *data,
-					      size_t samples_per_channel)
+					      size_t samples_per_channel,
+					      size_t channels)
 {
-	_critSect.Lock();
-	if (!audioTransport)
-		return;
-	_critSect.Unlock();
+	{
+		webrtc::MutexLock lock(&_critSect);
+		if (!audioTransport)
+			return;
+	}
 
 	// Get audio
 	audio_t *audio = obs_get_audio();
-	// This info is set on the stream before starting capture
-	size_t channels = 2;
-	uint32_t sample_rate = 48000;
+	// 16 bit interleaved, |channels| in the OBS (WAVE) order
+	uint32_t sample_rate = audio ? audio_output_get_sample_rate(audio)
+				     : 48000;
 	size_t sample_size = 2;
 	// Get chunk for 10ms
 	size_t chunk = (sample_rate / 100);
+	if (channels > kMaxChannels || chunk > kMaxChunkFrames)
+		return;
 
 	size_t i = 0;
 	uint32_t level;
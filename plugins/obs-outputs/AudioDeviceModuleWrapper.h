@@ -31,7 +31,13 @@ public:
 	int32_t Terminate() override;
 	bool Initialized() const override;
 
-	void onIncomingData(uint8_t *data, size_t samples_per_channel);
+	// 16 bit interleaved samples, up to kMaxChannels (7.1)
+	void onIncomingData(uint8_t *data, size_t samples_per_channel,
+			    size_t channels);
+
+	static const size_t kMaxChannels = 8;
+	// 10 ms at 48 kHz
+	static const size_t kMaxChunkFrames = 480;
 
 	virtual int64_t TimeUntilNextProcess() { return 1000; }
 	virtual void Process() {}
@@ -85,7 +91,7 @@ public:
 	bool _initialized;
 	webrtc::Mutex _critSect;
 	AudioTransport *audioTransport;
-	uint8_t pending[640 * 2 * 2];
+	uint8_t pending[kMaxChunkFrames * kMaxChannels * 2];
 	size_t pendingLength;
 };
 
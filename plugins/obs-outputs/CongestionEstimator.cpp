@@ -0,0 +1,58 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "CongestionEstimator.h"
+
+#include <algorithm>
+
+static double clamp01(double value)
+{
+	return std::min(1.0, std::max(0.0, value));
+}
+
+CongestionEstimator::CongestionEstimator(double smoothing)
+	: smoothing_(smoothing)
+{
+	Reset();
+}
+
+void CongestionEstimator::Reset()
+{
+	congestion_ = 0.0;
+	has_previous_ = false;
+	previous_packets_sent_ = 0;
+	previous_packet_send_delay_ = 0.0;
+}
+
+float CongestionEstimator::Update(const webrtc_stats &stats,
+				  double target_bps)
+{
+	double bandwidth = 0.0;
+	if (stats.available_outgoing_bitrate > 0.0 && target_bps > 0.0)
+		bandwidth = 1.0 - stats.available_outgoing_bitrate / target_bps;
+
+	uint64_t packets_sent = 0;
+	double packet_send_delay = 0.0;
+	for (uint32_t i = 0; i < stats.num_layers; i++) {
+		packets_sent += stats.layers[i].packets_sent;
+		packet_send_delay += stats.layers[i].total_packet_send_delay;
+	}
+
+	double pacer = 0.0;
+	if (has_previous_ && packets_sent > previous_packets_sent_) {
+		double delay = (packet_send_delay -
+				previous_packet_send_delay_) /
+			       (double)(packets_sent - previous_packets_sent_);
+		pacer = delay / kMaxPacerDelay;
+	}
+	has_previous_ = true;
+	previous_packets_sent_ = packets_sent;
+	previous_packet_send_delay_ = packet_send_delay;
+
+	double loss = std::max(stats.video_fraction_lost,
+			       stats.audio_fraction_lost) /
+		      kMaxFractionLost;
+
+	double raw = clamp01(std::max(bandwidth, std::max(pacer, loss)));
+	congestion_ += smoothing_ * (raw - congestion_);
+	return (float)congestion_;
+}
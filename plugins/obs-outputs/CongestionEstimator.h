@@ -0,0 +1,38 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _CONGESTION_ESTIMATOR_H_
+#define _CONGESTION_ESTIMATOR_H_
+
+#include "webrtc-stats.h"
+
+// Turns the send-side estimates of libwebrtc (transport-cc / GCC) into the
+// 0..1 congestion value of obs_output_get_congestion. The worst of three
+// signals is taken and smoothed over the stats samples:
+// - bandwidth: available outgoing bitrate of the candidate pair below the
+//   configured bitrate
+// - pacer: average time packets waited in the pacer queue since the
+//   previous sample
+// - loss: fraction lost reported by the receiver (RTCP)
+class CongestionEstimator {
+public:
+	explicit CongestionEstimator(double smoothing = 0.3);
+
+	void Reset();
+	// |target_bps| is the configured audio + video bitrate
+	float Update(const webrtc_stats &stats, double target_bps);
+	float congestion() const { return (float)congestion_; }
+
+private:
+	// Pacer queue delay considered as full congestion (seconds)
+	static constexpr double kMaxPacerDelay = 0.5;
+	// Fraction lost considered as full congestion
+	static constexpr double kMaxFractionLost = 0.1;
+
+	const double smoothing_;
+	double congestion_;
+	bool has_previous_;
+	uint64_t previous_packets_sent_;
+	double previous_packet_send_delay_;
+};
+
+#endif
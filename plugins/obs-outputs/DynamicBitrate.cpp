@@ -0,0 +1,79 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "DynamicBitrate.h"
+
+#include <algorithm>
+
+DynamicBitrate::DynamicBitrate()
+{
+	Reset(0, 0);
+}
+
+void DynamicBitrate::Reset(long bitrate, int64_t now_ms)
+{
+	original_ = bitrate;
+	current_ = bitrate;
+	target_ = 0;
+	last_change_ms_ = now_ms;
+	Restart(now_ms);
+}
+
+void DynamicBitrate::Restart(int64_t now_ms)
+{
+	ramping_up_ = true;
+	start_ms_ = now_ms;
+	ramp_target_ = 0;
+}
+
+long DynamicBitrate::Update(const webrtc_stats &stats, double audio_bps,
+			    int64_t now_ms)
+{
+	if (original_ <= 0)
+		return 0;
+
+	// Video share of the transport target, from the bitrate allocation of
+	// the layers, or the estimate of the candidate pair less the audio
+	double target_bps = 0.0;
+	for (uint32_t i = 0; i < stats.num_layers; i++)
+		target_bps += stats.layers[i].target_bitrate;
+	if (target_bps <= 0.0 && stats.available_outgoing_bitrate > 0.0)
+		target_bps = stats.available_outgoing_bitrate - audio_bps;
+	if (target_bps <= 0.0)
+		return 0;
+	target_ = (long)(target_bps / 1000.0);
+
+	long min_bitrate =
+		std::max((long)kMinBitrate, original_ * kMinPercent / 100);
+	long target = std::min(original_, std::max(min_bitrate, target_));
+	long band = current_ * kHysteresisPercent / 100;
+	int64_t elapsed = now_ms - last_change_ms_;
+
+	// Ramped up once the estimate stops growing
+	if (ramping_up_) {
+		if (target >= current_ - band || target_ <= ramp_target_ ||
+		    now_ms - start_ms_ >= kRampUpMs)
+			ramping_up_ = false;
+		else
+			ramp_target_ = target_;
+	}
+
+	long bitrate = current_;
+	if (target < current_ - band) {
+		if (!ramping_up_ && elapsed >= kDecreaseHoldMs)
+			bitrate = std::max(min_bitrate, target / 100 * 100);
+	} else if (target > current_ + band ||
+		   (target == original_ && current_ < original_)) {
+		// Up by one step, the configured bitrate is reached even if
+		// within the dead band
+		long step = std::max(100L, original_ * kIncreasePercent / 100);
+		if (elapsed >= kIncreaseHoldMs)
+			bitrate = std::min(original_,
+					   std::min(target, current_ + step));
+	}
+	if (bitrate == current_)
+		return 0;
+
+	current_ = bitrate;
+	last_change_ms_ = now_ms;
+	return current_;
+}
@@ -0,0 +1,68 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _DYNAMIC_BITRATE_H_
+#define _DYNAMIC_BITRATE_H_
+
+#include "webrtc-stats.h"
+
+#include <stdint.h>
+
+// Dynamic bitrate of the encoded WebRTC outputs, the counterpart of the
+// dbr_* functions of rtmp-stream.c. libwebrtc adapts its own encoders to the
+// send-side estimate (transport-cc / GCC) but the OBS encoder of an encoded
+// output keeps the configured bitrate: this turns the video target bitrate of
+// the transport controller into bitrates for obs_encoder_update.
+//
+// Reconfiguring x264 is expensive, so the bitrate only changes when the
+// target moved out of a dead band around it, not more often than the hold
+// times, by steps rounded to 100 kbps and within [min, configured bitrate].
+// Decreases apply at once, increases one step at a time, as in rtmp-stream.c.
+//
+// A new peer connection starts from the GCC start bitrate, a few hundred
+// kbps, and ramps up from there: decreases wait until its estimate stopped
+// growing or reached the current bitrate, so the encoder is not cut to the
+// start estimate on every connection.
+class DynamicBitrate {
+public:
+	DynamicBitrate();
+
+	// |bitrate| configured on the encoder (kbps), the maximum, for a
+	// connection starting at |now_ms|
+	void Reset(long bitrate, int64_t now_ms);
+	// A new peer connection starts at |now_ms|, the bitrate is kept
+	void Restart(int64_t now_ms);
+	// New encoder bitrate (kbps) for this stats sample, 0 to keep it
+	long Update(const webrtc_stats &stats, double audio_bps,
+		    int64_t now_ms);
+
+	long bitrate() const { return current_; }
+	long original() const { return original_; }
+	// Target of the last sample (kbps)
+	long target() const { return target_; }
+
+private:
+	// Dead band around the current bitrate, in percent
+	static const long kHysteresisPercent = 15;
+	// Hold times after a change
+	static const int64_t kDecreaseHoldMs = 2000;
+	static const int64_t kIncreaseHoldMs = 10000;
+	// Longest ramp up of the estimate of a new connection
+	static const int64_t kRampUpMs = 30000;
+	// Lowest bitrate, absolute (same as rtmp-stream.c) and relative to the
+	// configured one, in percent
+	static const long kMinBitrate = 50;
+	static const long kMinPercent = 20;
+	// Increase step, in percent of the configured bitrate
+	static const long kIncreasePercent = 10;
+
+	long original_;
+	long current_;
+	long target_;
+	int64_t last_change_ms_;
+	// Ramp up of the connection: start and highest target so far
+	bool ramping_up_;
+	int64_t start_ms_;
+	long ramp_target_;
+};
+
+#endif
@@ -0,0 +1,363 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "FanoutVideoEncoder.h"
+
+#include <api/video/video_frame.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include <algorithm>
+#include <atomic>
+
+// Completion callback of a member encoder, registered on its own queue and
+// read by the group from whichever queue encodes
+typedef std::atomic<webrtc::EncodedImageCallback *> MemberCallback;
+
+// Single real encoder shared by the encoders of the group
+class FanoutEncoderGroup : public webrtc::EncodedImageCallback {
+public:
+	FanoutEncoderGroup() : last_timestamp_us_(-1), keyframe_pending_(false)
+	{
+	}
+	~FanoutEncoderGroup() override
+	{
+		if (encoder_)
+			encoder_->Release();
+	}
+
+	// The first member initializes its encoder and the group adopts it
+	int Join(MemberCallback *member,
+		 std::unique_ptr<webrtc::VideoEncoder> &encoder,
+		 const webrtc::VideoCodec *codec_settings,
+		 const webrtc::VideoEncoder::Settings &settings,
+		 webrtc::VideoEncoder::EncoderInfo *info)
+	{
+		std::lock_guard<std::mutex> lock(encode_mutex_);
+		if (!encoder_) {
+			int result = encoder->InitEncode(codec_settings,
+							 settings);
+			if (result != WEBRTC_VIDEO_CODEC_OK)
+				return result;
+			encoder_ = std::move(encoder);
+			encoder_->RegisterEncodeCompleteCallback(this);
+			streams_ = std::max<int>(
+				1, codec_settings->numberOfSimulcastStreams);
+		}
+		// The new destination needs a key frame to start decoding
+		keyframe_pending_ = true;
+		*info = encoder_->GetEncoderInfo();
+
+		std::lock_guard<std::mutex> members_lock(members_mutex_);
+		members_.push_back({member, {}, false});
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	void Leave(MemberCallback *member)
+	{
+		std::lock_guard<std::mutex> lock(members_mutex_);
+		members_.erase(std::remove_if(members_.begin(), members_.end(),
+					      [member](const Member &m) {
+						      return m.callback ==
+							     member;
+					      }),
+			       members_.end());
+	}
+
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType> *frame_types)
+	{
+		bool keyframe =
+			frame_types &&
+			std::find(frame_types->begin(), frame_types->end(),
+				  webrtc::VideoFrameType::kVideoFrameKey) !=
+				frame_types->end();
+
+		std::lock_guard<std::mutex> lock(encode_mutex_);
+		if (keyframe)
+			keyframe_pending_ = true;
+		// Already encoded for an other destination
+		if (frame.timestamp_us() <= last_timestamp_us_)
+			return WEBRTC_VIDEO_CODEC_OK;
+		last_timestamp_us_ = frame.timestamp_us();
+
+		if (!keyframe_pending_)
+			return encoder_->Encode(frame, frame_types);
+		keyframe_pending_ = false;
+		std::vector<webrtc::VideoFrameType> keyframes(
+			frame_types ? frame_types->size() : (size_t)streams_,
+			webrtc::VideoFrameType::kVideoFrameKey);
+		return encoder_->Encode(frame, &keyframes);
+	}
+
+	// The encoder follows the most constrained destination. Paused
+	// destinations (no bitrate) are left out, unless all of them are.
+	void SetRates(MemberCallback *member,
+		      const webrtc::VideoEncoder::RateControlParameters &rates)
+	{
+		webrtc::VideoEncoder::RateControlParameters lowest = rates;
+		{
+			std::lock_guard<std::mutex> lock(members_mutex_);
+			for (Member &m : members_) {
+				if (m.callback == member) {
+					m.rates = rates;
+					m.has_rates = true;
+				}
+			}
+			uint32_t lowest_bps = 0;
+			for (const Member &m : members_) {
+				uint32_t bps = m.rates.bitrate.get_sum_bps();
+				if (!m.has_rates || bps == 0)
+					continue;
+				if (lowest_bps == 0 || bps < lowest_bps) {
+					lowest_bps = bps;
+					lowest = m.rates;
+				}
+			}
+		}
+		std::lock_guard<std::mutex> lock(encode_mutex_);
+		encoder_->SetRates(lowest);
+	}
+
+	void OnPacketLossRateUpdate(float packet_loss_rate)
+	{
+		std::lock_guard<std::mutex> lock(encode_mutex_);
+		encoder_->OnPacketLossRateUpdate(packet_loss_rate);
+	}
+	void OnRttUpdate(int64_t rtt_ms)
+	{
+		std::lock_guard<std::mutex> lock(encode_mutex_);
+		encoder_->OnRttUpdate(rtt_ms);
+	}
+
+	// webrtc::EncodedImageCallback, called by the real encoder
+	Result OnEncodedImage(
+		const webrtc::EncodedImage &image,
+		const webrtc::CodecSpecificInfo *codec_specific_info) override
+	{
+		// Members can not leave while their callback runs
+		std::lock_guard<std::mutex> lock(members_mutex_);
+		for (const Member &m : members_) {
+			webrtc::EncodedImageCallback *callback = *m.callback;
+			if (callback)
+				callback->OnEncodedImage(image,
+							 codec_specific_info);
+		}
+		return Result(Result::OK, image.Timestamp());
+	}
+	void OnDroppedFrame(DropReason reason) override
+	{
+		std::lock_guard<std::mutex> lock(members_mutex_);
+		for (const Member &m : members_) {
+			webrtc::EncodedImageCallback *callback = *m.callback;
+			if (callback)
+				callback->OnDroppedFrame(reason);
+		}
+	}
+
+private:
+	struct Member {
+		MemberCallback *callback;
+		webrtc::VideoEncoder::RateControlParameters rates;
+		bool has_rates;
+	};
+
+	// Lock order: encode_mutex_, then members_mutex_
+	std::mutex encode_mutex_;
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	int streams_ = 1;
+	int64_t last_timestamp_us_;
+	bool keyframe_pending_;
+
+	std::mutex members_mutex_;
+	std::vector<Member> members_;
+};
+
+std::shared_ptr<FanoutEncoderGroup>
+FanoutEncoderGroups::Get(const std::string &key)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	// Forget the groups whose encoders are all gone
+	for (auto it = groups_.begin(); it != groups_.end();) {
+		if (it->second.expired())
+			it = groups_.erase(it);
+		else
+			++it;
+	}
+	std::shared_ptr<FanoutEncoderGroup> group = groups_[key].lock();
+	if (!group) {
+		group = std::make_shared<FanoutEncoderGroup>();
+		groups_[key] = group;
+	}
+	return group;
+}
+
+namespace {
+
+// Encoders share their group when everything that shapes the bitstream is
+// the same. The bitrates are not part of it, they are reconciled by SetRates.
+std::string GroupKey(const webrtc::SdpVideoFormat &format,
+		     const webrtc::VideoCodec &codec)
+{
+	std::string key = format.ToString() + " " +
+			  std::to_string(codec.width) + "x" +
+			  std::to_string(codec.height) + " mode " +
+			  std::to_string((int)codec.mode);
+	for (int i = 0; i < codec.numberOfSimulcastStreams; i++) {
+		const webrtc::SimulcastStream &stream = codec.simulcastStream[i];
+		key += " s" + std::to_string(stream.width) + "x" +
+		       std::to_string(stream.height) +
+		       (stream.active ? "" : "-");
+	}
+	if (codec.codecType == webrtc::kVideoCodecVP9) {
+		for (int i = 0; i < codec.VP9().numberOfSpatialLayers; i++) {
+			const webrtc::SpatialLayer &layer =
+				codec.spatialLayers[i];
+			key += " l" + std::to_string(layer.width) + "x" +
+			       std::to_string(layer.height) + "t" +
+			       std::to_string(layer.numberOfTemporalLayers);
+		}
+	}
+	return key;
+}
+
+// Encoder of a single peer connection, a member of a group
+class FanoutVideoEncoder : public webrtc::VideoEncoder {
+public:
+	FanoutVideoEncoder(webrtc::VideoEncoderFactory *factory,
+			   const webrtc::SdpVideoFormat &format,
+			   std::shared_ptr<FanoutEncoderGroups> groups)
+		: factory_(factory),
+		  format_(format),
+		  groups_(groups),
+		  callback_(nullptr)
+	{
+		encoder_ = factory_->CreateVideoEncoder(format_);
+		if (encoder_)
+			info_ = encoder_->GetEncoderInfo();
+	}
+	~FanoutVideoEncoder() override { Release(); }
+
+	int InitEncode(const webrtc::VideoCodec *codec_settings,
+		       const Settings &settings) override
+	{
+		// Reconfiguration: the group may change with the settings
+		Release();
+		if (!encoder_)
+			encoder_ = factory_->CreateVideoEncoder(format_);
+		if (!encoder_)
+			return WEBRTC_VIDEO_CODEC_ERROR;
+
+		std::shared_ptr<FanoutEncoderGroup> group =
+			groups_->Get(GroupKey(format_, *codec_settings));
+		EncoderInfo info;
+		int result = group->Join(&callback_, encoder_, codec_settings,
+					 settings, &info);
+		if (result != WEBRTC_VIDEO_CODEC_OK)
+			return result;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		group_ = group;
+		info_ = info;
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback *callback) override
+	{
+		callback_ = callback;
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	int32_t Release() override
+	{
+		std::shared_ptr<FanoutEncoderGroup> group;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			group.swap(group_);
+		}
+		// The real encoder goes with the last member of the group
+		if (group)
+			group->Leave(&callback_);
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType> *frame_types)
+		override
+	{
+		std::shared_ptr<FanoutEncoderGroup> group = Group();
+		if (!group)
+			return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+		return group->Encode(frame, frame_types);
+	}
+	void SetRates(const RateControlParameters &parameters) override
+	{
+		std::shared_ptr<FanoutEncoderGroup> group = Group();
+		if (group)
+			group->SetRates(&callback_, parameters);
+	}
+	void OnPacketLossRateUpdate(float packet_loss_rate) override
+	{
+		std::shared_ptr<FanoutEncoderGroup> group = Group();
+		if (group)
+			group->OnPacketLossRateUpdate(packet_loss_rate);
+	}
+	void OnRttUpdate(int64_t rtt_ms) override
+	{
+		std::shared_ptr<FanoutEncoderGroup> group = Group();
+		if (group)
+			group->OnRttUpdate(rtt_ms);
+	}
+	// Cached: may be called from the completion callback, which runs
+	// with the group locked
+	EncoderInfo GetEncoderInfo() const override
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return info_;
+	}
+
+private:
+	std::shared_ptr<FanoutEncoderGroup> Group()
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return group_;
+	}
+
+	webrtc::VideoEncoderFactory *const factory_;
+	const webrtc::SdpVideoFormat format_;
+	const std::shared_ptr<FanoutEncoderGroups> groups_;
+	// Moved into the group if this member is the first one
+	std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	// Read by the group when it delivers the encoded images
+	MemberCallback callback_;
+
+	mutable std::mutex mutex_;
+	std::shared_ptr<FanoutEncoderGroup> group_;
+	EncoderInfo info_;
+};
+
+} // namespace
+
+FanoutVideoEncoderFactory::FanoutVideoEncoderFactory(
+	std::unique_ptr<webrtc::VideoEncoderFactory> factory)
+	: factory_(std::move(factory)),
+	  groups_(std::make_shared<FanoutEncoderGroups>())
+{
+}
+
+std::vector<webrtc::SdpVideoFormat>
+FanoutVideoEncoderFactory::GetSupportedFormats() const
+{
+	return factory_->GetSupportedFormats();
+}
+
+webrtc::VideoEncoderFactory::CodecInfo
+FanoutVideoEncoderFactory::QueryVideoEncoder(
+	const webrtc::SdpVideoFormat &format) const
+{
+	return factory_->QueryVideoEncoder(format);
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+FanoutVideoEncoderFactory::CreateVideoEncoder(
+	const webrtc::SdpVideoFormat &format)
+{
+	return std::make_unique<FanoutVideoEncoder>(factory_.get(), format,
+						    groups_);
+}
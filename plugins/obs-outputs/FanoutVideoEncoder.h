@@ -0,0 +1,55 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _FANOUT_VIDEO_ENCODER_H_
+#define _FANOUT_VIDEO_ENCODER_H_
+
+// webrtc includes
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FanoutEncoderGroup;
+
+// Encoder groups of a fan-out output, by codec configuration
+class FanoutEncoderGroups {
+public:
+	// Existing group of the configuration, or a new one
+	std::shared_ptr<FanoutEncoderGroup> Get(const std::string &key);
+
+private:
+	std::mutex mutex_;
+	std::map<std::string, std::weak_ptr<FanoutEncoderGroup>> groups_;
+};
+
+// Encoder factory of the peer connections of a fan-out output.
+//
+// The peer connections get the same frames from the shared video track. The
+// encoders created with the same configuration (codec, resolution, simulcast
+// and spatial layers) join a group that runs a single real encoder: the first
+// peer connection to submit a frame encodes it, the encoded image is handed
+// to the RTP senders of all of them. Rates follow the most constrained
+// destination and key frame requests of any destination are honoured, so a
+// destination joining late or recovering from loss gets a key frame.
+class FanoutVideoEncoderFactory : public webrtc::VideoEncoderFactory {
+public:
+	explicit FanoutVideoEncoderFactory(
+		std::unique_ptr<webrtc::VideoEncoderFactory> factory);
+
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+	CodecInfo
+	QueryVideoEncoder(const webrtc::SdpVideoFormat &format) const override;
+	std::unique_ptr<webrtc::VideoEncoder>
+	CreateVideoEncoder(const webrtc::SdpVideoFormat &format) override;
+
+private:
+	const std::unique_ptr<webrtc::VideoEncoderFactory> factory_;
+	const std::shared_ptr<FanoutEncoderGroups> groups_;
+};
+
+#endif
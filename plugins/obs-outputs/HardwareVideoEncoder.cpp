@@ -0,0 +1,513 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "HardwareVideoEncoder.h"
+#include "obs-outputs-config.h"
+
+#include <api/video/encoded_image.h>
+#include <api/video/video_frame.h>
+#include <api/video_codecs/video_encoder_software_fallback_wrapper.h>
+#include <media/base/media_constants.h>
+#include <modules/video_coding/codecs/h264/include/h264.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+#include <rtc_base/time_utils.h>
+#include <libyuv.h>
+
+#include <util/base.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#if WEBRTC_HW_ENCODER
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/opt.h>
+}
+#endif
+
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+#define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
+
+#if WEBRTC_HW_ENCODER
+
+struct HardwareEncoderBackend {
+	const char *name;
+	// libavcodec encoder
+	const char *encoder;
+	// Frames are uploaded to a device of this type. AV_HWDEVICE_TYPE_NONE:
+	// the encoder takes NV12 frames in system memory.
+	AVHWDeviceType device_type;
+	const char *device;
+};
+
+// In "auto" order. Same encoders and default device as obs-ffmpeg.
+static const HardwareEncoderBackend backends[] = {
+	{"nvenc", "h264_nvenc", AV_HWDEVICE_TYPE_NONE, nullptr},
+	{"vaapi", "h264_vaapi", AV_HWDEVICE_TYPE_VAAPI, "/dev/dri/renderD128"},
+};
+
+namespace {
+
+// H.264 through libavcodec, set up for real time like the obs-ffmpeg
+// encoders with the low latency options: no B-frames, CBR, key frames on
+// request, SPS/PPS in band.
+class FFmpegH264Encoder : public webrtc::VideoEncoder {
+public:
+	explicit FFmpegH264Encoder(const HardwareEncoderBackend *backend)
+		: backend_(backend)
+	{
+	}
+	~FFmpegH264Encoder() override { Release(); }
+
+	int InitEncode(const webrtc::VideoCodec *codec_settings,
+		       const Settings & /* settings */) override
+	{
+		if (!codec_settings ||
+		    codec_settings->codecType != webrtc::kVideoCodecH264)
+			return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+		// One layer per encoder, the software path does simulcast
+		if (codec_settings->numberOfSimulcastStreams > 1)
+			return WEBRTC_VIDEO_CODEC_ERR_SIMULCAST_PARAMETERS_NOT_SUPPORTED;
+
+		Release();
+		width_ = codec_settings->width;
+		height_ = codec_settings->height;
+		framerate_ = codec_settings->maxFramerate
+				     ? codec_settings->maxFramerate
+				     : 30;
+		target_bitrate_bps_ = codec_settings->startBitrate * 1000;
+		if (!Open(target_bitrate_bps_))
+			return WEBRTC_VIDEO_CODEC_FALLBACK_SOFTWARE;
+		info("%s: %dx%d, %d kbps", backend_->encoder, width_, height_,
+		     target_bitrate_bps_ / 1000);
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback *callback) override
+	{
+		callback_ = callback;
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	int32_t Release() override
+	{
+		Close();
+		av_buffer_unref(&device_);
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType> *frame_types)
+		override
+	{
+		if (!context_ || !callback_)
+			return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+
+		bool keyframe =
+			frame_types &&
+			std::find(frame_types->begin(), frame_types->end(),
+				  webrtc::VideoFrameType::kVideoFrameKey) !=
+				frame_types->end();
+
+		// Only a new resolution needs a new encoder, rates are changed
+		// on the open one
+		const rtc::scoped_refptr<webrtc::VideoFrameBuffer> &buffer =
+			frame.video_frame_buffer();
+		if (buffer->width() != width_ || buffer->height() != height_) {
+			Close();
+			width_ = buffer->width();
+			height_ = buffer->height();
+			if (!Open(target_bitrate_bps_))
+				return WEBRTC_VIDEO_CODEC_FALLBACK_SOFTWARE;
+			keyframe = true;
+		}
+
+		if (!CopyFrame(frame))
+			return WEBRTC_VIDEO_CODEC_ERROR;
+		// Capture time in microseconds: monotonic, unlike the RTP
+		// timestamp which wraps
+		frame_->pts = frame.timestamp_us();
+		frame_->pict_type = keyframe ? AV_PICTURE_TYPE_I
+					     : AV_PICTURE_TYPE_NONE;
+		pending_.push_back({frame_->pts, frame});
+
+		AVFrame *input = frame_;
+		AVFrame *hwframe = nullptr;
+		if (context_->hw_frames_ctx) {
+			hwframe = av_frame_alloc();
+			if (!hwframe ||
+			    av_hwframe_get_buffer(context_->hw_frames_ctx,
+						  hwframe, 0) < 0 ||
+			    av_hwframe_transfer_data(hwframe, frame_, 0) < 0 ||
+			    av_frame_copy_props(hwframe, frame_) < 0) {
+				av_frame_free(&hwframe);
+				return WEBRTC_VIDEO_CODEC_FALLBACK_SOFTWARE;
+			}
+			input = hwframe;
+		}
+		int ret = avcodec_send_frame(context_, input);
+		av_frame_free(&hwframe);
+		if (ret < 0) {
+			warn("%s: failed to encode, falling back to software",
+			     backend_->encoder);
+			return WEBRTC_VIDEO_CODEC_FALLBACK_SOFTWARE;
+		}
+		return Deliver();
+	}
+
+	void SetRates(const RateControlParameters &parameters) override
+	{
+		// Paused, keep the encoder as it is
+		if (parameters.bitrate.get_sum_bps() == 0)
+			return;
+		target_bitrate_bps_ = (int)parameters.bitrate.get_sum_bps();
+		if (parameters.framerate_fps > 0)
+			framerate_ = parameters.framerate_fps;
+		// nvenc and vaapi reconfigure the rate control on the next
+		// frame, without a key frame
+		if (context_)
+			SetBitrate(context_, target_bitrate_bps_);
+	}
+
+	EncoderInfo GetEncoderInfo() const override
+	{
+		EncoderInfo info;
+		info.implementation_name =
+			std::string("FFmpeg ") + backend_->encoder;
+		info.is_hardware_accelerated = true;
+		info.has_internal_source = false;
+		// Native buffers are not mapped, Encode takes NV12 and I420
+		info.supports_native_handle = false;
+		info.has_trusted_rate_controller = true;
+		info.scaling_settings = VideoEncoder::ScalingSettings::kOff;
+		return info;
+	}
+
+	// Opens and closes an encoder, true if the backend works here
+	static bool Probe(const HardwareEncoderBackend *backend)
+	{
+		FFmpegH264Encoder encoder(backend);
+		encoder.width_ = 640;
+		encoder.height_ = 360;
+		encoder.framerate_ = 30;
+		return encoder.Open(500000);
+	}
+
+private:
+	bool Open(int bitrate_bps)
+	{
+		const AVCodec *codec =
+			avcodec_find_encoder_by_name(backend_->encoder);
+		if (!codec)
+			return false;
+		if (backend_->device_type != AV_HWDEVICE_TYPE_NONE &&
+		    !device_ &&
+		    av_hwdevice_ctx_create(&device_, backend_->device_type,
+					   backend_->device, nullptr, 0) < 0)
+			return false;
+
+		context_ = avcodec_alloc_context3(codec);
+		if (!context_)
+			return false;
+		context_->width = width_;
+		context_->height = height_;
+		context_->time_base = {1, (int)rtc::kNumMicrosecsPerSec};
+		context_->framerate = av_d2q(framerate_, 1000);
+		SetBitrate(context_, bitrate_bps);
+		// Key frames are requested by the receivers (PLI/FIR)
+		context_->gop_size = (int)(framerate_ * kKeyframeIntervalSec);
+		context_->max_b_frames = 0;
+		context_->profile = FF_PROFILE_H264_CONSTRAINED_BASELINE;
+		context_->pix_fmt = AV_PIX_FMT_NV12;
+
+		if (device_) {
+			AVBufferRef *frames = av_hwframe_ctx_alloc(device_);
+			if (!frames) {
+				Close();
+				return false;
+			}
+			AVHWFramesContext *frames_ctx =
+				(AVHWFramesContext *)frames->data;
+			frames_ctx->format = AV_PIX_FMT_VAAPI;
+			frames_ctx->sw_format = AV_PIX_FMT_NV12;
+			frames_ctx->width = width_;
+			frames_ctx->height = height_;
+			frames_ctx->initial_pool_size = 4;
+			if (av_hwframe_ctx_init(frames) < 0) {
+				av_buffer_unref(&frames);
+				Close();
+				return false;
+			}
+			context_->pix_fmt = AV_PIX_FMT_VAAPI;
+			context_->hw_frames_ctx = frames;
+			av_opt_set(context_->priv_data, "rc_mode", "CBR", 0);
+		} else {
+			av_opt_set(context_->priv_data, "preset", "llhq", 0);
+			av_opt_set(context_->priv_data, "profile", "baseline",
+				   0);
+			av_opt_set_int(context_->priv_data, "cbr", true, 0);
+			av_opt_set_int(context_->priv_data, "zerolatency", 1,
+				       0);
+			av_opt_set_int(context_->priv_data, "delay", 0, 0);
+			av_opt_set_int(context_->priv_data, "forced-idr", 1,
+				       0);
+		}
+
+		if (avcodec_open2(context_, codec, nullptr) < 0) {
+			Close();
+			return false;
+		}
+
+		frame_ = av_frame_alloc();
+		if (!frame_) {
+			Close();
+			return false;
+		}
+		frame_->format = AV_PIX_FMT_NV12;
+		frame_->width = width_;
+		frame_->height = height_;
+		if (av_frame_get_buffer(frame_, 32) < 0) {
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	// CBR with a one second buffer
+	static void SetBitrate(AVCodecContext *context, int bitrate_bps)
+	{
+		context->bit_rate = bitrate_bps;
+		context->rc_max_rate = bitrate_bps;
+		context->rc_buffer_size = bitrate_bps;
+	}
+
+	void Close()
+	{
+		av_frame_free(&frame_);
+		avcodec_free_context(&context_);
+		pending_.clear();
+	}
+
+	bool CopyFrame(const webrtc::VideoFrame &frame)
+	{
+		if (av_frame_make_writable(frame_) < 0)
+			return false;
+		rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer =
+			frame.video_frame_buffer();
+
+		// NV12 frames of the OBS output (nv12_passthrough): no
+		// conversion at all
+		if (buffer->type() == webrtc::VideoFrameBuffer::Type::kNV12) {
+			const webrtc::NV12BufferInterface *nv12 =
+				buffer->GetNV12();
+			libyuv::CopyPlane(nv12->DataY(), nv12->StrideY(),
+					  frame_->data[0], frame_->linesize[0],
+					  width_, height_);
+			libyuv::CopyPlane(nv12->DataUV(), nv12->StrideUV(),
+					  frame_->data[1], frame_->linesize[1],
+					  (width_ + 1) & ~1, (height_ + 1) / 2);
+			return true;
+		}
+
+		rtc::scoped_refptr<webrtc::I420BufferInterface> i420 =
+			buffer->ToI420();
+		libyuv::I420ToNV12(i420->DataY(), i420->StrideY(),
+				   i420->DataU(), i420->StrideU(),
+				   i420->DataV(), i420->StrideV(),
+				   frame_->data[0], frame_->linesize[0],
+				   frame_->data[1], frame_->linesize[1],
+				   width_, height_);
+		return true;
+	}
+
+	int32_t Deliver()
+	{
+		AVPacket *packet = av_packet_alloc();
+		int ret;
+		while ((ret = avcodec_receive_packet(context_, packet)) == 0) {
+			// Frame the packet was encoded from
+			while (pending_.size() > 1 &&
+			       pending_.front().first < packet->pts)
+				pending_.pop_front();
+			const webrtc::VideoFrame &frame =
+				pending_.front().second;
+
+			webrtc::EncodedImage image;
+			image.SetEncodedData(webrtc::EncodedImageBuffer::Create(
+				packet->data, packet->size));
+			image._encodedWidth = width_;
+			image._encodedHeight = height_;
+			image._frameType =
+				(packet->flags & AV_PKT_FLAG_KEY)
+					? webrtc::VideoFrameType::kVideoFrameKey
+					: webrtc::VideoFrameType::
+						  kVideoFrameDelta;
+			image.SetTimestamp(frame.timestamp());
+			image.ntp_time_ms_ = frame.ntp_time_ms();
+			image.capture_time_ms_ = frame.render_time_ms();
+			image.rotation_ = frame.rotation();
+			image.content_type_ =
+				webrtc::VideoContentType::UNSPECIFIED;
+			image.timing_.flags = webrtc::VideoSendTiming::kInvalid;
+
+			webrtc::CodecSpecificInfo codec_info;
+			codec_info.codecType = webrtc::kVideoCodecH264;
+			codec_info.codecSpecific.H264.packetization_mode =
+				webrtc::H264PacketizationMode::NonInterleaved;
+			codec_info.codecSpecific.H264.temporal_idx =
+				webrtc::kNoTemporalIdx;
+			codec_info.codecSpecific.H264.idr_frame =
+				image._frameType ==
+				webrtc::VideoFrameType::kVideoFrameKey;
+			codec_info.codecSpecific.H264.base_layer_sync = false;
+
+			callback_->OnEncodedImage(image, &codec_info);
+			if (pending_.front().first == packet->pts)
+				pending_.pop_front();
+			av_packet_unref(packet);
+		}
+		av_packet_free(&packet);
+		if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+			return WEBRTC_VIDEO_CODEC_FALLBACK_SOFTWARE;
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+
+	static const int kKeyframeIntervalSec = 10;
+
+	const HardwareEncoderBackend *backend_;
+	webrtc::EncodedImageCallback *callback_ = nullptr;
+	AVBufferRef *device_ = nullptr;
+	AVCodecContext *context_ = nullptr;
+	// NV12, in system memory
+	AVFrame *frame_ = nullptr;
+	int width_ = 0;
+	int height_ = 0;
+	double framerate_ = 30;
+	// Bitrate libwebrtc wants
+	int target_bitrate_bps_ = 0;
+	// Frames sent to the encoder and not output yet, by pts
+	std::deque<std::pair<int64_t, webrtc::VideoFrame>> pending_;
+};
+
+} // namespace
+
+std::vector<std::string> HardwareVideoEncoderFactory::AvailableBackends()
+{
+	static std::once_flag probed;
+	static std::vector<std::string> available;
+	std::call_once(probed, []() {
+		for (const HardwareEncoderBackend &backend : backends) {
+			bool ok = FFmpegH264Encoder::Probe(&backend);
+			info("WebRTC: hardware encoder %s (%s): %s",
+			     backend.name, backend.encoder,
+			     ok ? "available" : "not available");
+			if (ok)
+				available.push_back(backend.name);
+		}
+	});
+	return available;
+}
+
+#else
+
+// Built without FFmpeg: software only
+struct HardwareEncoderBackend {
+	const char *name;
+};
+
+std::vector<std::string> HardwareVideoEncoderFactory::AvailableBackends()
+{
+	return {};
+}
+
+#endif
+
+HardwareVideoEncoderFactory::HardwareVideoEncoderFactory(
+	std::unique_ptr<webrtc::VideoEncoderFactory> software,
+	const std::string &preference)
+	: software_(std::move(software)), backend_(nullptr)
+{
+#if WEBRTC_HW_ENCODER
+	if (preference != "none") {
+		std::vector<std::string> available = AvailableBackends();
+		for (const HardwareEncoderBackend &backend : backends) {
+			if (preference != "auto" && preference != backend.name)
+				continue;
+			if (std::find(available.begin(), available.end(),
+				      backend.name) != available.end()) {
+				backend_ = &backend;
+				break;
+			}
+		}
+	}
+#endif
+	if (backend_)
+		info("WebRTC: H.264 encoded with %s", backend_->name);
+	else if (preference != "none" && preference != "auto")
+		warn("WebRTC: hardware encoder %s not available, using software",
+		     preference.c_str());
+	else
+		info("WebRTC: software video encoders");
+}
+
+std::vector<webrtc::SdpVideoFormat>
+HardwareVideoEncoderFactory::GetSupportedFormats() const
+{
+	std::vector<webrtc::SdpVideoFormat> formats =
+		software_->GetSupportedFormats();
+	if (!backend_)
+		return formats;
+	// libwebrtc built without H.264: advertise what the hardware does
+	for (const webrtc::SdpVideoFormat &format : formats)
+		if (format.name == cricket::kH264CodecName)
+			return formats;
+	formats.push_back(webrtc::CreateH264Format(
+		webrtc::H264::kProfileConstrainedBaseline,
+		webrtc::H264::kLevel3_1, "1"));
+	return formats;
+}
+
+webrtc::VideoEncoderFactory::CodecInfo
+HardwareVideoEncoderFactory::QueryVideoEncoder(
+	const webrtc::SdpVideoFormat &format) const
+{
+	if (backend_ && format.name == cricket::kH264CodecName) {
+		CodecInfo info;
+		info.is_hardware_accelerated = true;
+		info.has_internal_source = false;
+		return info;
+	}
+	return software_->QueryVideoEncoder(format);
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+HardwareVideoEncoderFactory::CreateVideoEncoder(
+	const webrtc::SdpVideoFormat &format)
+{
+#if WEBRTC_HW_ENCODER
+	if (backend_ && format.name == cricket::kH264CodecName) {
+		std::unique_ptr<webrtc::VideoEncoder> hardware =
+			std::make_unique<FFmpegH264Encoder>(backend_);
+		std::vector<webrtc::SdpVideoFormat> formats =
+			software_->GetSupportedFormats();
+		for (const webrtc::SdpVideoFormat &supported : formats)
+			if (supported.name == cricket::kH264CodecName)
+				return webrtc::
+					CreateVideoEncoderSoftwareFallbackWrapper(
+						software_->CreateVideoEncoder(
+							format),
+						std::move(hardware));
+		// No software H.264 to fall back to
+		return hardware;
+	}
+#endif
+	return software_->CreateVideoEncoder(format);
+}
+
+std::string HardwareVideoEncoderFactory::backend() const
+{
+	return backend_ ? backend_->name : "none";
+}
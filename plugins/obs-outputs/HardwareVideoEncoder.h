@@ -0,0 +1,50 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _HARDWARE_VIDEO_ENCODER_H_
+#define _HARDWARE_VIDEO_ENCODER_H_
+
+// webrtc includes
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Hardware H.264 encoders of libavcodec, the ones obs-ffmpeg drives for its
+// VAAPI and NVENC encoders
+struct HardwareEncoderBackend;
+
+// Video encoder factory of the raw WebRTC outputs. H.264 goes to a hardware
+// encoder when one can encode on this machine, the other codecs and the
+// machines without one use the software encoders of |software|. A hardware
+// encoder failing to initialize or to encode falls back to software on the
+// fly (libwebrtc software fallback wrapper). The encoder in use is reported
+// by the "encoder_implementation" of the outbound RTP stats.
+class HardwareVideoEncoderFactory : public webrtc::VideoEncoderFactory {
+public:
+	// |preference|: "auto" (first backend available), a backend name
+	// ("nvenc", "vaapi") or "none" for software only
+	HardwareVideoEncoderFactory(
+		std::unique_ptr<webrtc::VideoEncoderFactory> software,
+		const std::string &preference);
+
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+	CodecInfo
+	QueryVideoEncoder(const webrtc::SdpVideoFormat &format) const override;
+	std::unique_ptr<webrtc::VideoEncoder>
+	CreateVideoEncoder(const webrtc::SdpVideoFormat &format) override;
+
+	// Backend in use, "none" for software
+	std::string backend() const;
+
+	// Backends able to encode on this machine, probed once per process
+	static std::vector<std::string> AvailableBackends();
+
+private:
+	const std::unique_ptr<webrtc::VideoEncoderFactory> software_;
+	const HardwareEncoderBackend *backend_;
+};
+
+#endif
@@ -0,0 +1,286 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "LatencyProbes.h"
+
+#include <api/rtc_event_log/rtc_event_log_factory.h>
+#include <logging/rtc_event_log/events/rtc_event_audio_send_stream_config.h>
+#include <logging/rtc_event_log/events/rtc_event_rtp_packet_outgoing.h>
+#include <logging/rtc_event_log/rtc_stream_config.h>
+
+#include <algorithm>
+#include <map>
+
+LatencyTracerSet::LatencyTracerSet()
+	: tracers_(std::make_shared<const Tracers>())
+{
+}
+
+void LatencyTracerSet::Add(const std::shared_ptr<LatencyTracer> &tracer)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto tracers = std::make_shared<Tracers>(*tracers_);
+	tracers->push_back(tracer);
+	std::atomic_store(&tracers_, std::shared_ptr<const Tracers>(tracers));
+}
+
+void LatencyTracerSet::Remove(const std::shared_ptr<LatencyTracer> &tracer)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto tracers = std::make_shared<Tracers>(*tracers_);
+	tracers->erase(std::remove(tracers->begin(), tracers->end(), tracer),
+		       tracers->end());
+	std::atomic_store(&tracers_, std::shared_ptr<const Tracers>(tracers));
+}
+
+void LatencyTracerSet::MapRtpTimestamp(uint16_t frame_id,
+				       uint32_t rtp_timestamp)
+{
+	auto tracers = std::atomic_load(&tracers_);
+	for (const auto &tracer : *tracers) {
+		if (tracer->Traces(frame_id)) {
+			tracer->MapRtpTimestamp(frame_id, rtp_timestamp);
+			return;
+		}
+	}
+}
+
+void LatencyTracerSet::MarkRtpTimestamp(uint32_t rtp_timestamp,
+					webrtc_latency_stage stage)
+{
+	// Only the tracer that mapped the timestamp has it
+	auto tracers = std::atomic_load(&tracers_);
+	for (const auto &tracer : *tracers)
+		tracer->MarkRtpTimestamp(rtp_timestamp, stage);
+}
+
+void LatencyTracerSet::AliasRtpTimestamp(uint32_t rtp_timestamp,
+					 uint32_t alias)
+{
+	auto tracers = std::atomic_load(&tracers_);
+	for (const auto &tracer : *tracers)
+		tracer->AliasRtpTimestamp(rtp_timestamp, alias);
+}
+
+namespace {
+
+class TracingVideoEncoder : public webrtc::VideoEncoder,
+			    public webrtc::EncodedImageCallback {
+public:
+	TracingVideoEncoder(std::unique_ptr<webrtc::VideoEncoder> encoder,
+			    std::shared_ptr<LatencyTracerSet> tracers)
+		: encoder_(std::move(encoder)),
+		  tracers_(tracers),
+		  callback_(nullptr)
+	{
+	}
+
+	// webrtc::VideoEncoder
+	void SetFecControllerOverride(
+		webrtc::FecControllerOverride *fec_controller_override) override
+	{
+		encoder_->SetFecControllerOverride(fec_controller_override);
+	}
+	int InitEncode(const webrtc::VideoCodec *codec_settings,
+		       const Settings &settings) override
+	{
+		return encoder_->InitEncode(codec_settings, settings);
+	}
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback *callback) override
+	{
+		callback_ = callback;
+		return encoder_->RegisterEncodeCompleteCallback(callback ? this
+									 : nullptr);
+	}
+	int32_t Release() override { return encoder_->Release(); }
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType> *frame_types)
+		override
+	{
+		// The encoded image only carries the RTP timestamp
+		tracers_->MapRtpTimestamp(frame.id(), frame.timestamp());
+		return encoder_->Encode(frame, frame_types);
+	}
+	void SetRates(const RateControlParameters &parameters) override
+	{
+		encoder_->SetRates(parameters);
+	}
+	void OnPacketLossRateUpdate(float packet_loss_rate) override
+	{
+		encoder_->OnPacketLossRateUpdate(packet_loss_rate);
+	}
+	void OnRttUpdate(int64_t rtt_ms) override
+	{
+		encoder_->OnRttUpdate(rtt_ms);
+	}
+	void OnLossNotification(const LossNotification &loss_notification) override
+	{
+		encoder_->OnLossNotification(loss_notification);
+	}
+	EncoderInfo GetEncoderInfo() const override
+	{
+		return encoder_->GetEncoderInfo();
+	}
+
+	// webrtc::EncodedImageCallback
+	Result OnEncodedImage(
+		const webrtc::EncodedImage &image,
+		const webrtc::CodecSpecificInfo *codec_specific_info) override
+	{
+		tracers_->MarkRtpTimestamp(image.Timestamp(),
+					  WEBRTC_LATENCY_ENCODED);
+
+		// RtpVideoSender sends the image with the random start
+		// timestamp of its stream added, and returns that RTP
+		// timestamp as the frame id. The pacer may send the packets
+		// before the call returns: map them with the offset the
+		// stream had for the previous image first.
+		const int stream = image.SpatialIndex().value_or(0);
+		auto offset = rtp_offsets_.find(stream);
+		if (offset != rtp_offsets_.end())
+			tracers_->AliasRtpTimestamp(
+				image.Timestamp(),
+				image.Timestamp() + offset->second);
+		Result result =
+			callback_->OnEncodedImage(image, codec_specific_info);
+		if (result.error == Result::OK) {
+			const uint32_t rtp_offset =
+				result.frame_id - image.Timestamp();
+			if (offset == rtp_offsets_.end() ||
+			    offset->second != rtp_offset) {
+				rtp_offsets_[stream] = rtp_offset;
+				tracers_->AliasRtpTimestamp(image.Timestamp(),
+							    result.frame_id);
+			}
+		}
+		return result;
+	}
+	void OnDroppedFrame(DropReason reason) override
+	{
+		callback_->OnDroppedFrame(reason);
+	}
+
+private:
+	const std::unique_ptr<webrtc::VideoEncoder> encoder_;
+	const std::shared_ptr<LatencyTracerSet> tracers_;
+	webrtc::EncodedImageCallback *callback_;
+	// RTP timestamp offset of each simulcast stream, encoder thread only
+	std::map<int, uint32_t> rtp_offsets_;
+};
+
+class PacketSentEventLog : public webrtc::RtcEventLog {
+public:
+	PacketSentEventLog(std::unique_ptr<webrtc::RtcEventLog> event_log,
+			   std::shared_ptr<LatencyTracerSet> tracers)
+		: event_log_(std::move(event_log)), tracers_(tracers)
+	{
+	}
+
+	bool StartLogging(std::unique_ptr<webrtc::RtcEventLogOutput> output,
+			  int64_t output_period_ms) override
+	{
+		return event_log_->StartLogging(std::move(output),
+						output_period_ms);
+	}
+	void StopLogging() override { event_log_->StopLogging(); }
+
+	// Called on the pacer thread for every packet sent
+	void Log(std::unique_ptr<webrtc::RtcEvent> event) override
+	{
+		switch (event->GetType()) {
+		case webrtc::RtcEvent::Type::AudioSendStreamConfig: {
+			auto config = static_cast<
+				const webrtc::RtcEventAudioSendStreamConfig *>(
+				event.get());
+			std::lock_guard<std::mutex> lock(mutex_);
+			audio_ssrcs_.push_back(config->config().local_ssrc);
+			break;
+		}
+		case webrtc::RtcEvent::Type::RtpPacketOutgoing: {
+			const webrtc::RtpPacket &header =
+				static_cast<const webrtc::
+						    RtcEventRtpPacketOutgoing *>(
+					event.get())
+					->header();
+			// Marker bit: last packet of a video frame
+			if (header.Marker() && !IsAudio(header.Ssrc()))
+				tracers_->MarkRtpTimestamp(
+					header.Timestamp(),
+					WEBRTC_LATENCY_SENT);
+			break;
+		}
+		default:
+			break;
+		}
+		event_log_->Log(std::move(event));
+	}
+
+private:
+	// The marker bit of audio is set on talk spurts
+	bool IsAudio(uint32_t ssrc)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return std::find(audio_ssrcs_.begin(), audio_ssrcs_.end(),
+				 ssrc) != audio_ssrcs_.end();
+	}
+
+	const std::unique_ptr<webrtc::RtcEventLog> event_log_;
+	const std::shared_ptr<LatencyTracerSet> tracers_;
+	std::mutex mutex_;
+	std::vector<uint32_t> audio_ssrcs_;
+};
+
+}
+
+TracingVideoEncoderFactory::TracingVideoEncoderFactory(
+	std::unique_ptr<webrtc::VideoEncoderFactory> factory,
+	std::shared_ptr<LatencyTracerSet> tracers)
+	: factory_(std::move(factory)), tracers_(tracers)
+{
+}
+
+std::vector<webrtc::SdpVideoFormat>
+TracingVideoEncoderFactory::GetSupportedFormats() const
+{
+	return factory_->GetSupportedFormats();
+}
+
+std::vector<webrtc::SdpVideoFormat>
+TracingVideoEncoderFactory::GetImplementations() const
+{
+	return factory_->GetImplementations();
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+TracingVideoEncoderFactory::CreateVideoEncoder(
+	const webrtc::SdpVideoFormat &format)
+{
+	std::unique_ptr<webrtc::VideoEncoder> encoder =
+		factory_->CreateVideoEncoder(format);
+	if (!encoder)
+		return nullptr;
+	return std::make_unique<TracingVideoEncoder>(std::move(encoder),
+						     tracers_);
+}
+
+std::unique_ptr<webrtc::VideoEncoderFactory::EncoderSelectorInterface>
+TracingVideoEncoderFactory::GetEncoderSelector() const
+{
+	return factory_->GetEncoderSelector();
+}
+
+PacketSentEventLogFactory::PacketSentEventLogFactory(
+	webrtc::TaskQueueFactory *task_queue_factory,
+	std::shared_ptr<LatencyTracerSet> tracers)
+	: task_queue_factory_(task_queue_factory), tracers_(tracers)
+{
+}
+
+std::unique_ptr<webrtc::RtcEventLog>
+PacketSentEventLogFactory::CreateRtcEventLog(
+	webrtc::RtcEventLog::EncodingType encoding_type)
+{
+	webrtc::RtcEventLogFactory factory(task_queue_factory_);
+	return std::make_unique<PacketSentEventLog>(
+		factory.CreateRtcEventLog(encoding_type), tracers_);
+}
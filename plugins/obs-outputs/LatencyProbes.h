@@ -0,0 +1,82 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _LATENCY_PROBES_H_
+#define _LATENCY_PROBES_H_
+
+#include "LatencyTracer.h"
+
+// webrtc includes
+#include <api/rtc_event_log/rtc_event_log.h>
+#include <api/rtc_event_log/rtc_event_log_factory_interface.h>
+#include <api/task_queue/task_queue_factory.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Points of the publish path inside libwebrtc, feeding the LatencyTracer of
+// each output.
+
+// Tracers of the outputs sharing a PeerConnectionFactory. The probes only
+// see frame ids and RTP timestamps, each event goes to the tracer owning
+// the frame. Lookups are lock free, outputs are added and removed rarely.
+class LatencyTracerSet {
+public:
+	LatencyTracerSet();
+
+	void Add(const std::shared_ptr<LatencyTracer> &tracer);
+	void Remove(const std::shared_ptr<LatencyTracer> &tracer);
+
+	void MapRtpTimestamp(uint16_t frame_id, uint32_t rtp_timestamp);
+	void MarkRtpTimestamp(uint32_t rtp_timestamp,
+			      webrtc_latency_stage stage);
+	void AliasRtpTimestamp(uint32_t rtp_timestamp, uint32_t alias);
+
+private:
+	typedef std::vector<std::shared_ptr<LatencyTracer>> Tracers;
+	std::mutex mutex_;
+	// Copy on write, use std::atomic_load/std::atomic_store
+	std::shared_ptr<const Tracers> tracers_;
+};
+
+// Encoders of this factory report their output (WEBRTC_LATENCY_ENCODED)
+class TracingVideoEncoderFactory : public webrtc::VideoEncoderFactory {
+public:
+	TracingVideoEncoderFactory(
+		std::unique_ptr<webrtc::VideoEncoderFactory> factory,
+		std::shared_ptr<LatencyTracerSet> tracers);
+
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+	std::vector<webrtc::SdpVideoFormat> GetImplementations() const override;
+	std::unique_ptr<webrtc::VideoEncoder>
+	CreateVideoEncoder(const webrtc::SdpVideoFormat &format) override;
+	std::unique_ptr<EncoderSelectorInterface>
+	GetEncoderSelector() const override;
+
+private:
+	const std::unique_ptr<webrtc::VideoEncoderFactory> factory_;
+	const std::shared_ptr<LatencyTracerSet> tracers_;
+};
+
+// RTC event logs of this factory report the last RTP packet of each frame
+// leaving the pacer (WEBRTC_LATENCY_SENT), then forward every event to the
+// regular libwebrtc event log. The packets are matched by their RTP timestamp
+// as sent, which the encoders of TracingVideoEncoderFactory map; the audio
+// streams are left out.
+class PacketSentEventLogFactory : public webrtc::RtcEventLogFactoryInterface {
+public:
+	PacketSentEventLogFactory(webrtc::TaskQueueFactory *task_queue_factory,
+				  std::shared_ptr<LatencyTracerSet> tracers);
+
+	std::unique_ptr<webrtc::RtcEventLog>
+	CreateRtcEventLog(webrtc::RtcEventLog::EncodingType encoding_type)
+		override;
+
+private:
+	webrtc::TaskQueueFactory *const task_queue_factory_;
+	const std::shared_ptr<LatencyTracerSet> tracers_;
+};
+
+#endif
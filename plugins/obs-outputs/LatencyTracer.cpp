@@ -0,0 +1,172 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "LatencyTracer.h"
+
+#include <util/platform.h>
+#include <util/profiler.h>
+
+// Profiler roots, compared by address
+static const char *profiler_names[WEBRTC_LATENCY_STAGES] = {
+	"webrtc_latency_delivered",
+	"webrtc_latency_converted",
+	"webrtc_latency_encoded",
+	"webrtc_latency_sent",
+};
+
+LatencyTracer::LatencyTracer()
+{
+	Reset();
+}
+
+void LatencyTracer::Reset()
+{
+	for (auto &slot : slots_) {
+		slot.id = 0;
+		slot.tick_ns = 0;
+		slot.marked = 0;
+	}
+	for (auto &slot : rtp_slots_) {
+		slot.rtp_timestamp = 0;
+		slot.frame_id = 0;
+	}
+	for (auto &histogram : histograms_) {
+		for (auto &bucket : histogram.buckets)
+			bucket = 0;
+		histogram.count = 0;
+		histogram.max_us = 0;
+	}
+}
+
+size_t LatencyTracer::bucketOf(uint64_t usec)
+{
+	if (usec < 8)
+		return (size_t)usec;
+	size_t log = 3;
+	while (usec >> (log + 1))
+		log++;
+	size_t bucket = (log - 2) * 8 + ((usec >> (log - 3)) & 7);
+	return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+uint64_t LatencyTracer::bucketValue(size_t bucket)
+{
+	if (bucket < 8)
+		return bucket;
+	size_t log = bucket / 8 + 2;
+	return (uint64_t)(8 + bucket % 8) << (log - 3);
+}
+
+void LatencyTracer::Delivered(uint16_t frame_id, uint64_t tick_ns)
+{
+	Slot &slot = slots_[frame_id % kSlots];
+	// Invalidate first, readers check the id before and after
+	slot.id.store(0, std::memory_order_release);
+	slot.tick_ns.store(tick_ns, std::memory_order_relaxed);
+	slot.marked.store(0, std::memory_order_relaxed);
+	slot.id.store((uint32_t)frame_id + 1, std::memory_order_release);
+	Mark(frame_id, WEBRTC_LATENCY_DELIVERED);
+}
+
+void LatencyTracer::Mark(uint16_t frame_id, webrtc_latency_stage stage)
+{
+	const uint64_t now = os_gettime_ns();
+	const uint32_t id = (uint32_t)frame_id + 1;
+
+	Slot &slot = slots_[frame_id % kSlots];
+	if (slot.id.load(std::memory_order_acquire) != id)
+		return;
+	const uint64_t tick_ns = slot.tick_ns.load(std::memory_order_relaxed);
+	if (slot.marked.fetch_or(1u << stage, std::memory_order_relaxed) &
+	    (1u << stage))
+		return;
+	if (slot.id.load(std::memory_order_acquire) != id || now < tick_ns)
+		return;
+
+	const uint64_t usec = (now - tick_ns) / 1000;
+	Histogram &histogram = histograms_[stage];
+	histogram.buckets[bucketOf(usec)].fetch_add(1,
+						    std::memory_order_relaxed);
+	histogram.count.fetch_add(1, std::memory_order_relaxed);
+	uint64_t max_us = histogram.max_us.load(std::memory_order_relaxed);
+	while (usec > max_us &&
+	       !histogram.max_us.compare_exchange_weak(max_us, usec))
+		;
+
+	profile_record(profiler_names[stage], tick_ns, now);
+}
+
+bool LatencyTracer::Traces(uint16_t frame_id) const
+{
+	return slots_[frame_id % kSlots].id.load(std::memory_order_acquire) ==
+	       (uint32_t)frame_id + 1;
+}
+
+void LatencyTracer::MapRtpTimestamp(uint16_t frame_id, uint32_t rtp_timestamp)
+{
+	RtpSlot &slot = rtp_slots_[(rtp_timestamp * 2654435761u) >> 24];
+	slot.rtp_timestamp.store(0, std::memory_order_release);
+	slot.frame_id.store(frame_id, std::memory_order_relaxed);
+	slot.rtp_timestamp.store((uint64_t)rtp_timestamp + 1,
+				 std::memory_order_release);
+}
+
+bool LatencyTracer::FrameOfRtpTimestamp(uint32_t rtp_timestamp,
+					uint16_t *frame_id) const
+{
+	const uint64_t key = (uint64_t)rtp_timestamp + 1;
+	const RtpSlot &slot = rtp_slots_[(rtp_timestamp * 2654435761u) >> 24];
+	if (slot.rtp_timestamp.load(std::memory_order_acquire) != key)
+		return false;
+	*frame_id = (uint16_t)slot.frame_id.load(std::memory_order_relaxed);
+	return slot.rtp_timestamp.load(std::memory_order_acquire) == key;
+}
+
+void LatencyTracer::MarkRtpTimestamp(uint32_t rtp_timestamp,
+				     webrtc_latency_stage stage)
+{
+	uint16_t frame_id;
+	if (FrameOfRtpTimestamp(rtp_timestamp, &frame_id))
+		Mark(frame_id, stage);
+}
+
+void LatencyTracer::AliasRtpTimestamp(uint32_t rtp_timestamp, uint32_t alias)
+{
+	uint16_t frame_id;
+	if (FrameOfRtpTimestamp(rtp_timestamp, &frame_id))
+		MapRtpTimestamp(frame_id, alias);
+}
+
+double LatencyTracer::percentile(const uint64_t *buckets, uint64_t count,
+				 double p)
+{
+	if (!count)
+		return 0.0;
+	uint64_t rank = (uint64_t)(p * (double)(count - 1));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < kBuckets; i++) {
+		seen += buckets[i];
+		if (seen > rank)
+			return bucketValue(i) / 1000.0;
+	}
+	return bucketValue(kBuckets - 1) / 1000.0;
+}
+
+void LatencyTracer::GetStats(
+	webrtc_latency_stats stats[WEBRTC_LATENCY_STAGES]) const
+{
+	uint64_t buckets[kBuckets];
+	for (size_t stage = 0; stage < WEBRTC_LATENCY_STAGES; stage++) {
+		const Histogram &histogram = histograms_[stage];
+		uint64_t count = 0;
+		for (size_t i = 0; i < kBuckets; i++) {
+			buckets[i] = histogram.buckets[i].load(
+				std::memory_order_relaxed);
+			count += buckets[i];
+		}
+		stats[stage].count = count;
+		stats[stage].p50 = percentile(buckets, count, 0.50);
+		stats[stage].p95 = percentile(buckets, count, 0.95);
+		stats[stage].p99 = percentile(buckets, count, 0.99);
+		stats[stage].max = histogram.max_us.load() / 1000.0;
+	}
+}
@@ -0,0 +1,84 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _LATENCY_TRACER_H_
+#define _LATENCY_TRACER_H_
+
+#include "webrtc-stats.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// Capture to wire latency of the video frames of a WebRTC output.
+//
+// Frames are keyed by the frame_id WebRTCStream gives them, unique across
+// the outputs of the process. The OBS video
+// tick time is stored when the frame is delivered, then every later point
+// of the publish path (see webrtc_latency_stage) records its latency from
+// that tick into a histogram and into the libobs profiler.
+// Points are reached from the video-io, encoder and pacer threads: slots
+// and histograms are atomics only, nothing locks.
+class LatencyTracer {
+public:
+	LatencyTracer();
+
+	// Forget the traced frames and clear the histograms
+	void Reset();
+
+	// Frame delivered to the output, |tick_ns| is the OBS video tick time
+	void Delivered(uint16_t frame_id, uint64_t tick_ns);
+	void Mark(uint16_t frame_id, webrtc_latency_stage stage);
+	// True if |frame_id| was delivered to this tracer and is in flight
+	bool Traces(uint16_t frame_id) const;
+
+	// Frames are only known by their RTP timestamp down in libwebrtc
+	void MapRtpTimestamp(uint16_t frame_id, uint32_t rtp_timestamp);
+	void MarkRtpTimestamp(uint32_t rtp_timestamp,
+			      webrtc_latency_stage stage);
+	// The frame of |rtp_timestamp| goes by |alias| too: the RTP packets
+	// carry the encoder timestamp plus the random offset of their stream
+	void AliasRtpTimestamp(uint32_t rtp_timestamp, uint32_t alias);
+
+	void GetStats(webrtc_latency_stats stats[WEBRTC_LATENCY_STAGES]) const;
+
+private:
+	// Frames in flight between the tick and the wire
+	static const size_t kSlots = 256;
+	// Log-linear buckets of microseconds, 8 per power of 2 (~12%)
+	static const size_t kBuckets = 240;
+
+	struct Slot {
+		// frame_id + 1, 0 when empty
+		std::atomic<uint32_t> id;
+		std::atomic<uint64_t> tick_ns;
+		// Stages already recorded, once per frame (simulcast layers
+		// and RTP packets all reach the same point)
+		std::atomic<uint32_t> marked;
+	};
+
+	struct RtpSlot {
+		// rtp_timestamp + 1, 0 when empty
+		std::atomic<uint64_t> rtp_timestamp;
+		std::atomic<uint32_t> frame_id;
+	};
+
+	struct Histogram {
+		std::atomic<uint64_t> buckets[kBuckets];
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> max_us;
+	};
+
+	bool FrameOfRtpTimestamp(uint32_t rtp_timestamp,
+				 uint16_t *frame_id) const;
+
+	static size_t bucketOf(uint64_t usec);
+	static uint64_t bucketValue(size_t bucket);
+	static double percentile(const uint64_t *buckets, uint64_t count,
+				 double p);
+
+	Slot slots_[kSlots];
+	RtpSlot rtp_slots_[kSlots];
+	Histogram histograms_[WEBRTC_LATENCY_STAGES];
+};
+
+#endif
@@ -0,0 +1,203 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "PassthroughVideoEncoder.h"
+
+#include <api/video/i420_buffer.h>
+#include <modules/video_coding/include/video_codec_interface.h>
+#include <modules/video_coding/include/video_error_codes.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include <algorithm>
+#include <string.h>
+
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+#define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
+#define error(format, ...) blog(LOG_ERROR, format, ##__VA_ARGS__)
+
+std::mutex EncodedFrameBuffer::instances_mutex_;
+std::unordered_set<const webrtc::VideoFrameBuffer *>
+	EncodedFrameBuffer::instances_;
+
+rtc::scoped_refptr<EncodedFrameBuffer>
+EncodedFrameBuffer::Create(const encoder_packet *packet, const uint8_t *header,
+			   size_t header_size, int width, int height)
+{
+	size_t size = packet->size;
+	if (packet->keyframe && header)
+		size += header_size;
+	else
+		header_size = 0;
+
+	rtc::scoped_refptr<webrtc::EncodedImageBuffer> data =
+		webrtc::EncodedImageBuffer::Create(size);
+	if (header_size)
+		memcpy(data->data(), header, header_size);
+	memcpy(data->data() + header_size, packet->data, packet->size);
+
+	return new rtc::RefCountedObject<EncodedFrameBuffer>(
+		data, packet->keyframe, width, height);
+}
+
+EncodedFrameBuffer::EncodedFrameBuffer(
+	rtc::scoped_refptr<webrtc::EncodedImageBuffer> data, bool keyframe,
+	int width, int height)
+	: data_(data), keyframe_(keyframe), width_(width), height_(height)
+{
+	std::lock_guard<std::mutex> lock(instances_mutex_);
+	instances_.insert(this);
+}
+
+EncodedFrameBuffer::~EncodedFrameBuffer()
+{
+	std::lock_guard<std::mutex> lock(instances_mutex_);
+	instances_.erase(this);
+}
+
+EncodedFrameBuffer *EncodedFrameBuffer::From(webrtc::VideoFrameBuffer *buffer)
+{
+	if (!buffer || buffer->type() != Type::kNative)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(instances_mutex_);
+	if (!instances_.count(buffer))
+		return nullptr;
+	return static_cast<EncodedFrameBuffer *>(buffer);
+}
+
+rtc::scoped_refptr<webrtc::I420BufferInterface> EncodedFrameBuffer::ToI420()
+{
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+		webrtc::I420Buffer::Create(width_, height_);
+	webrtc::I420Buffer::SetBlack(buffer);
+	return buffer;
+}
+
+PassthroughVideoEncoder::PassthroughVideoEncoder()
+	: callback_(nullptr), keyframe_requests_(0), foreign_frames_(0)
+{
+}
+
+int PassthroughVideoEncoder::InitEncode(
+	const webrtc::VideoCodec *codec_settings,
+	const Settings & /* settings */)
+{
+	if (!codec_settings ||
+	    codec_settings->codecType != webrtc::kVideoCodecH264)
+		return WEBRTC_VIDEO_CODEC_ERR_PARAMETER;
+
+	info("PassthroughVideoEncoder: %ux%u", codec_settings->width,
+	     codec_settings->height);
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t PassthroughVideoEncoder::RegisterEncodeCompleteCallback(
+	webrtc::EncodedImageCallback *callback)
+{
+	callback_ = callback;
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t PassthroughVideoEncoder::Release()
+{
+	if (keyframe_requests_)
+		info("PassthroughVideoEncoder: %llu key frame request(s) left to the OBS encoder keyint",
+		     (unsigned long long)keyframe_requests_);
+	if (foreign_frames_)
+		warn("PassthroughVideoEncoder: %llu frame(s) dropped, not OBS encoder packets",
+		     (unsigned long long)foreign_frames_);
+	callback_ = nullptr;
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+int32_t PassthroughVideoEncoder::Encode(
+	const webrtc::VideoFrame &frame,
+	const std::vector<webrtc::VideoFrameType> *frame_types)
+{
+	if (!callback_)
+		return WEBRTC_VIDEO_CODEC_UNINITIALIZED;
+
+	// Raw frames, or native ones of another source (the track was
+	// switched), have nothing to forward: dropped
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer =
+		frame.video_frame_buffer();
+	EncodedFrameBuffer *encoded = EncodedFrameBuffer::From(buffer.get());
+	if (!encoded) {
+		if (!foreign_frames_++)
+			error("PassthroughVideoEncoder: dropping frame, not an OBS encoder packet");
+		return WEBRTC_VIDEO_CODEC_ERROR;
+	}
+
+	// The OBS encoder can not be asked for a key frame, the receiver has
+	// to wait for the next one
+	if (frame_types && !encoded->keyframe() &&
+	    std::find(frame_types->begin(), frame_types->end(),
+		      webrtc::VideoFrameType::kVideoFrameKey) !=
+		    frame_types->end())
+		keyframe_requests_++;
+
+	webrtc::EncodedImage image;
+	image.SetEncodedData(encoded->data());
+	image._encodedWidth = encoded->width();
+	image._encodedHeight = encoded->height();
+	image._frameType = encoded->keyframe()
+				   ? webrtc::VideoFrameType::kVideoFrameKey
+				   : webrtc::VideoFrameType::kVideoFrameDelta;
+	image.SetTimestamp(frame.timestamp());
+	image.ntp_time_ms_ = frame.ntp_time_ms();
+	image.capture_time_ms_ = frame.render_time_ms();
+	image.rotation_ = frame.rotation();
+	image.content_type_ = webrtc::VideoContentType::UNSPECIFIED;
+	image.timing_.flags = webrtc::VideoSendTiming::kInvalid;
+
+	webrtc::CodecSpecificInfo codec_info;
+	codec_info.codecType = webrtc::kVideoCodecH264;
+	codec_info.codecSpecific.H264.packetization_mode =
+		webrtc::H264PacketizationMode::NonInterleaved;
+	codec_info.codecSpecific.H264.temporal_idx = webrtc::kNoTemporalIdx;
+	codec_info.codecSpecific.H264.idr_frame = encoded->keyframe();
+	codec_info.codecSpecific.H264.base_layer_sync = false;
+
+	webrtc::EncodedImageCallback::Result result =
+		callback_->OnEncodedImage(image, &codec_info);
+	if (result.error != webrtc::EncodedImageCallback::Result::OK)
+		return WEBRTC_VIDEO_CODEC_ERROR;
+	return WEBRTC_VIDEO_CODEC_OK;
+}
+
+void PassthroughVideoEncoder::SetRates(
+	const RateControlParameters & /* parameters */)
+{
+	// Bitrate is owned by the OBS encoder
+}
+
+webrtc::VideoEncoder::EncoderInfo PassthroughVideoEncoder::GetEncoderInfo() const
+{
+	EncoderInfo info;
+	info.supports_native_handle = true;
+	info.implementation_name = "obs_passthrough";
+	info.has_trusted_rate_controller = true;
+	info.is_hardware_accelerated = true;
+	info.scaling_settings = VideoEncoder::ScalingSettings::kOff;
+	return info;
+}
+
+std::vector<webrtc::SdpVideoFormat>
+PassthroughVideoEncoderFactory::GetSupportedFormats() const
+{
+	// Same profile as the one kept by SDPModif::forcePayload
+	return {webrtc::SdpVideoFormat("H264",
+				       {{"level-asymmetry-allowed", "1"},
+					{"packetization-mode", "1"},
+					{"profile-level-id", "42e01f"}})};
+}
+
+std::unique_ptr<webrtc::VideoEncoder>
+PassthroughVideoEncoderFactory::CreateVideoEncoder(
+	const webrtc::SdpVideoFormat &format)
+{
+	if (format.name != "H264") {
+		warn("PassthroughVideoEncoderFactory: unsupported codec %s",
+		     format.name.c_str());
+		return nullptr;
+	}
+	return std::make_unique<PassthroughVideoEncoder>();
+}
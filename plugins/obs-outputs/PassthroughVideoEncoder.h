@@ -0,0 +1,97 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _PASSTHROUGH_VIDEO_ENCODER_H_
+#define _PASSTHROUGH_VIDEO_ENCODER_H_
+
+// lib obs includes
+#include "obs.h"
+
+// webrtc includes
+#include <api/scoped_refptr.h>
+#include <api/video/encoded_image.h>
+#include <api/video/video_frame_buffer.h>
+#include <api/video_codecs/sdp_video_format.h>
+#include <api/video_codecs/video_encoder.h>
+#include <api/video_codecs/video_encoder_factory.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+// Frame buffer carrying an already encoded OBS video packet through the
+// libwebrtc video track, down to PassthroughVideoEncoder.
+class EncodedFrameBuffer : public webrtc::VideoFrameBuffer {
+public:
+	// |header| (SPS/PPS) is prepended to key frames, OBS encoders only
+	// output it once as extra data
+	static rtc::scoped_refptr<EncodedFrameBuffer>
+	Create(const encoder_packet *packet, const uint8_t *header,
+	       size_t header_size, int width, int height);
+	// |buffer| as an EncodedFrameBuffer, nullptr if it is another kind of
+	// native buffer. libwebrtc is built without RTTI, the live instances
+	// are registered instead.
+	static EncodedFrameBuffer *From(webrtc::VideoFrameBuffer *buffer);
+
+	Type type() const override { return Type::kNative; }
+	int width() const override { return width_; }
+	int height() const override { return height_; }
+	// Only reached if a sink needs raw pixels, returns a black frame
+	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+
+	bool keyframe() const { return keyframe_; }
+	rtc::scoped_refptr<webrtc::EncodedImageBuffer> data() const
+	{
+		return data_;
+	}
+
+protected:
+	EncodedFrameBuffer(rtc::scoped_refptr<webrtc::EncodedImageBuffer> data,
+			   bool keyframe, int width, int height);
+	~EncodedFrameBuffer() override;
+
+private:
+	static std::mutex instances_mutex_;
+	static std::unordered_set<const webrtc::VideoFrameBuffer *> instances_;
+
+	const rtc::scoped_refptr<webrtc::EncodedImageBuffer> data_;
+	const bool keyframe_;
+	const int width_;
+	const int height_;
+};
+
+// H.264 "encoder" that forwards the packets produced by the OBS video
+// encoder (x264, NVENC, VAAPI...) to the RTP packetizer.
+class PassthroughVideoEncoder : public webrtc::VideoEncoder {
+public:
+	PassthroughVideoEncoder();
+	~PassthroughVideoEncoder() override = default;
+
+	int InitEncode(const webrtc::VideoCodec *codec_settings,
+		       const Settings &settings) override;
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback *callback) override;
+	int32_t Release() override;
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType> *frame_types)
+		override;
+	void SetRates(const RateControlParameters &parameters) override;
+	EncoderInfo GetEncoderInfo() const override;
+
+private:
+	webrtc::EncodedImageCallback *callback_;
+	uint64_t keyframe_requests_;
+	uint64_t foreign_frames_;
+};
+
+// Encoder factory used by the encoded WebRTC outputs. Only advertises the
+// H.264 format the OBS encoder output is negotiated as.
+class PassthroughVideoEncoderFactory : public webrtc::VideoEncoderFactory {
+public:
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override;
+	std::unique_ptr<webrtc::VideoEncoder>
+	CreateVideoEncoder(const webrtc::SdpVideoFormat &format) override;
+};
+
+#endif
@@ -0,0 +1,642 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "SDPModif.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <initializer_list>
+#include <set>
+#include <stdlib.h>
+#include <string.h>
+
+static bool startsWith(const std::string &s, const char *prefix)
+{
+	return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// Payload type of "a=<attribute>:<payload> ...", -1 if none
+static int attributePayload(const std::string &line, const char *attribute)
+{
+	if (!startsWith(line, attribute))
+		return -1;
+	const char *s = line.c_str() + strlen(attribute);
+	if (*s < '0' || *s > '9')
+		return -1;
+	char *end;
+	long payload = strtol(s, &end, 10);
+	if (*end != ' ' && *end != '\0')
+		return -1;
+	return (int)payload;
+}
+
+// Value of |key| in "key=value;key=value", empty if none
+static std::string getParameter(const std::string &params,
+				const std::string &key)
+{
+	size_t pos = 0;
+	while (pos < params.size()) {
+		size_t end = params.find(';', pos);
+		if (end == std::string::npos)
+			end = params.size();
+		size_t eq = params.find('=', pos);
+		if (eq < end && params.compare(pos, eq - pos, key) == 0)
+			return params.substr(eq + 1, end - eq - 1);
+		pos = end + 1;
+	}
+	return "";
+}
+
+// Replace the value of |key| in "key=value;key=value", or append it
+static std::string setParameter(const std::string &params,
+				const std::string &key,
+				const std::string &value)
+{
+	std::string result;
+	bool found = false;
+	size_t pos = 0;
+	while (pos < params.size()) {
+		size_t end = params.find(';', pos);
+		if (end == std::string::npos)
+			end = params.size();
+		size_t eq = params.find('=', pos);
+		if (!result.empty())
+			result += ';';
+		if (eq < end && params.compare(pos, eq - pos, key) == 0) {
+			result += key + "=" + value;
+			found = true;
+		} else {
+			result.append(params, pos, end - pos);
+		}
+		pos = end + 1;
+	}
+	if (!found) {
+		if (!result.empty())
+			result += ';';
+		result += key + "=" + value;
+	}
+	return result;
+}
+
+std::string SDPModif::MediaSection::codec(int payload) const
+{
+	auto it = rtpmap.find(payload);
+	if (it == rtpmap.end())
+		return "";
+	const std::string &line = lines[it->second];
+	size_t start = line.find(' ');
+	if (start == std::string::npos)
+		return "";
+	size_t end = line.find('/', start);
+	return line.substr(start + 1, end == std::string::npos
+					      ? std::string::npos
+					      : end - start - 1);
+}
+
+std::string SDPModif::MediaSection::fmtpParameters(int payload) const
+{
+	auto it = fmtp.find(payload);
+	if (it == fmtp.end())
+		return "";
+	const std::string &line = lines[it->second];
+	size_t start = line.find(' ');
+	return start == std::string::npos ? "" : line.substr(start + 1);
+}
+
+int SDPModif::MediaSection::findLine(const std::string &prefix) const
+{
+	for (size_t i = 0; i < lines.size(); i++)
+		if (startsWith(lines[i], prefix.c_str()))
+			return (int)i;
+	return -1;
+}
+
+void SDPModif::MediaSection::reindex()
+{
+	rtpmap.clear();
+	fmtp.clear();
+	for (size_t i = 0; i < lines.size(); i++) {
+		int payload = attributePayload(lines[i], "a=rtpmap:");
+		if (payload != -1) {
+			rtpmap[payload] = i;
+			continue;
+		}
+		payload = attributePayload(lines[i], "a=fmtp:");
+		if (payload != -1)
+			fmtp[payload] = i;
+	}
+}
+
+SDPModif::SDPModif(const std::string &sdp)
+{
+	MediaSection *section = nullptr;
+	size_t pos = 0;
+	while (pos < sdp.size()) {
+		size_t end = sdp.find_first_of("\r\n", pos);
+		if (end == std::string::npos)
+			end = sdp.size();
+		if (end == pos) {
+			pos++;
+			continue;
+		}
+		std::string line = sdp.substr(pos, end - pos);
+		pos = end;
+
+		if (!startsWith(line, "m=")) {
+			if (section)
+				section->lines.push_back(std::move(line));
+			else
+				session.push_back(std::move(line));
+			continue;
+		}
+
+		// m=<media> <port> <proto> <fmt> ...
+		sections.emplace_back();
+		section = &sections.back();
+		size_t type_end = line.find(' ');
+		section->type = line.substr(2, type_end == std::string::npos
+						       ? std::string::npos
+						       : type_end - 2);
+		if (type_end == std::string::npos)
+			continue;
+		size_t port_end = line.find(' ', type_end + 1);
+		size_t proto_end = port_end == std::string::npos
+					   ? std::string::npos
+					   : line.find(' ', port_end + 1);
+		section->transport = line.substr(
+			type_end + 1, proto_end == std::string::npos
+					      ? std::string::npos
+					      : proto_end - type_end - 1);
+		while (proto_end != std::string::npos) {
+			size_t start = proto_end + 1;
+			proto_end = line.find(' ', start);
+			if (start < line.size() && line[start] != ' ')
+				section->formats.push_back(line.substr(
+					start, proto_end == std::string::npos
+						       ? std::string::npos
+						       : proto_end - start));
+		}
+	}
+
+	for (auto &media : sections)
+		media.reindex();
+}
+
+std::string SDPModif::toString() const
+{
+	std::string sdp;
+	for (const auto &line : session)
+		sdp += line + "\r\n";
+	for (const auto &section : sections) {
+		sdp += "m=" + section.type + " " + section.transport;
+		for (const auto &format : section.formats)
+			sdp += " " + format;
+		sdp += "\r\n";
+		for (const auto &line : section.lines)
+			sdp += line + "\r\n";
+	}
+	return sdp;
+}
+
+SDPModif::MediaSection *SDPModif::media(const std::string &type)
+{
+	for (auto &section : sections)
+		if (section.type == type)
+			return &section;
+	return nullptr;
+}
+
+// |codecs|: codec name or comma separated list of names
+static bool matchesCodec(const std::string &codecs, const std::string &codec)
+{
+	size_t pos = 0;
+	while (pos <= codecs.size()) {
+		size_t end = codecs.find(',', pos);
+		if (end == std::string::npos)
+			end = codecs.size();
+		if (SDPModif::caseInsensitiveStringCompare(
+			    codecs.substr(pos, end - pos), codec))
+			return true;
+		pos = end + 1;
+	}
+	return false;
+}
+
+void SDPModif::forcePayload(std::vector<int> &audio_payload_numbers,
+			    std::vector<int> &video_payload_numbers,
+			    const std::string &audio_codec,
+			    const std::string &video_codec,
+			    int h264_packetization_mode,
+			    const std::string &h264_profile_level_id,
+			    int vp9_profile_id)
+{
+	MediaSection *audio = media("audio");
+	if (audio)
+		filterPayloads(*audio, audio_payload_numbers, audio_codec,
+			       h264_packetization_mode, h264_profile_level_id,
+			       vp9_profile_id);
+	MediaSection *video = media("video");
+	if (video)
+		filterPayloads(*video, video_payload_numbers, video_codec,
+			       h264_packetization_mode, h264_profile_level_id,
+			       vp9_profile_id);
+}
+
+void SDPModif::filterPayloads(MediaSection &section,
+			      std::vector<int> &payload_numbers,
+			      const std::string &media_codec,
+			      int h264_packetization_mode,
+			      const std::string &h264_profile_level_id,
+			      int vp9_profile_id)
+{
+	const bool all = media_codec.empty();
+
+	// RTX payload of each payload (fmtp "apt=<payload>")
+	std::map<int, int> rtx;
+	for (const auto &fmtp : section.fmtp) {
+		std::string apt =
+			getParameter(section.fmtpParameters(fmtp.first), "apt");
+		if (!apt.empty())
+			rtx[atoi(apt.c_str())] = fmtp.first;
+	}
+
+	// rtpmap lines in SDP order
+	std::vector<std::pair<size_t, int>> payloads;
+	for (const auto &rtpmap : section.rtpmap)
+		payloads.emplace_back(rtpmap.second, rtpmap.first);
+	std::sort(payloads.begin(), payloads.end());
+
+	std::vector<int> apt_payload_numbers;
+	std::vector<std::string> formats;
+	std::set<int> removed;
+	for (const auto &entry : payloads) {
+		const int payload = entry.second;
+		const std::string payloadCodec = section.codec(payload);
+		const std::string params = section.fmtpParameters(payload);
+		bool keep = false;
+		if (matchesCodec(media_codec, payloadCodec)) {
+			std::string pkt_mode =
+				getParameter(params, "packetization-mode");
+			std::string p_level_id =
+				getParameter(params, "profile-level-id");
+			std::string profile_id =
+				getParameter(params, "profile-id");
+			if (caseInsensitiveStringCompare("h264",
+							 payloadCodec) &&
+			    !pkt_mode.empty() && !p_level_id.empty())
+				keep = caseInsensitiveStringCompare(
+					       h264_profile_level_id,
+					       p_level_id) &&
+				       h264_packetization_mode ==
+					       atoi(pkt_mode.c_str());
+			else if (caseInsensitiveStringCompare("vp9",
+							      payloadCodec) &&
+				 !profile_id.empty())
+				keep = vp9_profile_id ==
+				       atoi(profile_id.c_str());
+			else
+				keep = true;
+		} else if (all) {
+			keep = true;
+		}
+
+		auto apt = rtx.find(payload);
+		bool aptKeep = keep && apt != rtx.end();
+		if (keep) {
+			formats.push_back(std::to_string(payload));
+			payload_numbers.push_back(payload);
+		}
+		if (aptKeep) {
+			if (!all)
+				formats.push_back(std::to_string(apt->second));
+			apt_payload_numbers.push_back(apt->second);
+		}
+		if (!keep && !aptKeep &&
+		    std::find(apt_payload_numbers.begin(),
+			      apt_payload_numbers.end(),
+			      payload) == apt_payload_numbers.end() &&
+		    std::find(payload_numbers.begin(), payload_numbers.end(),
+			      payload) == payload_numbers.end())
+			removed.insert(payload);
+	}
+
+	section.formats = formats;
+	removePayloads(section, removed);
+}
+
+void SDPModif::removePayloads(MediaSection &section,
+			      const std::set<int> &removed)
+{
+	if (removed.empty())
+		return;
+
+	section.formats.erase(
+		std::remove_if(section.formats.begin(), section.formats.end(),
+			       [&removed](const std::string &format) {
+				       return removed.count(atoi(
+						      format.c_str())) != 0;
+			       }),
+		section.formats.end());
+
+	// Drop the rtpmap, fmtp & rtcp-fb lines of the removed payloads
+	auto isRemoved = [&removed](const std::string &line) {
+		for (const char *attribute :
+		     {"a=rtpmap:", "a=fmtp:", "a=rtcp-fb:"}) {
+			int payload = attributePayload(line, attribute);
+			if (payload != -1)
+				return removed.count(payload) != 0;
+		}
+		return false;
+	};
+	section.lines.erase(std::remove_if(section.lines.begin(),
+					   section.lines.end(), isRemoved),
+			    section.lines.end());
+	section.reindex();
+}
+
+// b=AS goes after the c= line of the section, if any
+static void insertBandwidth(SDPModif::MediaSection &section, int newBitrate)
+{
+	size_t line = !section.lines.empty() &&
+				      startsWith(section.lines[0], "c=")
+			      ? 1
+			      : 0;
+	section.lines.insert(section.lines.begin() + line,
+			     "b=AS:" + std::to_string(newBitrate));
+	section.reindex();
+}
+
+void SDPModif::bitrate(int newBitrate)
+{
+	MediaSection *video = media("video");
+	if (!video || video->findLine("b=AS:") != -1)
+		return;
+	insertBandwidth(*video, newBitrate);
+}
+
+void SDPModif::bitrateMaxMin(int newBitrate,
+			     const std::vector<int> &video_payload_numbers)
+{
+	MediaSection *video = media("video");
+	if (!video)
+		return;
+
+	std::string kbps = std::to_string(newBitrate);
+	int line = video->findLine("b=AS:");
+	if (line != -1)
+		video->lines[line] = "b=AS:" + kbps;
+	else
+		insertBandwidth(*video, newBitrate);
+
+	for (const auto &num : video_payload_numbers) {
+		auto fmtp = video->fmtp.find(num);
+		if (fmtp != video->fmtp.end()) {
+			std::string params = video->fmtpParameters(num);
+			params = setParameter(params, "x-google-min-bitrate",
+					      kbps);
+			params = setParameter(params, "x-google-max-bitrate",
+					      kbps);
+			video->lines[fmtp->second] =
+				"a=fmtp:" + std::to_string(num) + " " + params;
+			continue;
+		}
+		// insert fmtp line below rtpmap line
+		auto rtpmap = video->rtpmap.find(num);
+		if (rtpmap == video->rtpmap.end())
+			continue;
+		video->lines.insert(video->lines.begin() + rtpmap->second + 1,
+				    "a=fmtp:" + std::to_string(num) +
+					    " x-google-min-bitrate=" + kbps +
+					    ";x-google-max-bitrate=" + kbps);
+		video->reindex();
+	}
+}
+
+void SDPModif::stereo(int audioBitrate)
+{
+	MediaSection *audio = media("audio");
+	if (!audio)
+		return;
+	// audio section contains at least 1 stereo codec
+	for (const auto &line : audio->lines)
+		if (line.find("stereo=1;sprop-stereo=1") != std::string::npos)
+			return;
+
+	int payload = -1;
+	size_t rtpmap = 0;
+	for (const auto &entry : audio->rtpmap) {
+		if (caseInsensitiveStringCompare(audio->codec(entry.first),
+						 "opus") &&
+		    (payload == -1 || entry.second < rtpmap)) {
+			payload = entry.first;
+			rtpmap = entry.second;
+		}
+	}
+	if (payload == -1)
+		return;
+
+	std::string params = "stereo=1;sprop-stereo=1"
+			     ";maxplaybackrate=48000"
+			     ";sprop-maxcapturerate=48000";
+	if (audioBitrate > 0) {
+		std::string aBitrate = std::to_string(audioBitrate);
+		params += ";maxaveragebitrate=" +
+			  std::to_string(audioBitrate * 1024) +
+			  ";x-google-min-bitrate=" + aBitrate +
+			  ";x-google-max-bitrate=" + aBitrate;
+	}
+
+	auto fmtp = audio->fmtp.find(payload);
+	if (fmtp != audio->fmtp.end()) {
+		audio->lines[fmtp->second] += ";" + params;
+	} else {
+		audio->lines.insert(audio->lines.begin() + rtpmap + 1,
+				    "a=fmtp:" + std::to_string(payload) +
+					    " minptime=10;useinbandfec=1;" +
+					    params);
+		audio->reindex();
+	}
+}
+
+bool SDPModif::surround(size_t channels, int num_streams, int coupled_streams,
+			const std::string &channel_mapping, int audioBitrate)
+{
+	MediaSection *audio = media("audio");
+	if (!audio)
+		return false;
+
+	// a=rtpmap:<payload> multiopus/48000/<channels>
+	const std::string encoding =
+		"multiopus/48000/" + std::to_string(channels);
+	int payload = -1;
+	std::set<int> removed;
+	for (const auto &entry : audio->rtpmap) {
+		if (!caseInsensitiveStringCompare(audio->codec(entry.first),
+						  "multiopus"))
+			continue;
+		const std::string &line = audio->lines[entry.second];
+		size_t start = line.find(' ');
+		if (payload == -1 && start != std::string::npos &&
+		    caseInsensitiveStringCompare(line.substr(start + 1),
+						 encoding))
+			payload = entry.first;
+		else
+			removed.insert(entry.first);
+	}
+	// The multiopus payloads of the other layouts
+	removePayloads(*audio, removed);
+	if (payload == -1)
+		return false;
+
+	// Preferred over the opus fallback
+	const std::string format = std::to_string(payload);
+	auto it = std::find(audio->formats.begin(), audio->formats.end(),
+			    format);
+	if (it != audio->formats.end())
+		audio->formats.erase(it);
+	audio->formats.insert(audio->formats.begin(), format);
+
+	std::string params = audio->fmtpParameters(payload);
+	if (params.empty())
+		params = "minptime=10;useinbandfec=1";
+	params = setParameter(params, "num_streams",
+			      std::to_string(num_streams));
+	params = setParameter(params, "coupled_streams",
+			      std::to_string(coupled_streams));
+	params = setParameter(params, "channel_mapping", channel_mapping);
+	if (audioBitrate > 0)
+		params = setParameter(params, "maxaveragebitrate",
+				      std::to_string(audioBitrate * 1024));
+
+	const std::string line = "a=fmtp:" + format + " " + params;
+	auto fmtp = audio->fmtp.find(payload);
+	if (fmtp != audio->fmtp.end()) {
+		audio->lines[fmtp->second] = line;
+	} else {
+		audio->lines.insert(audio->lines.begin() +
+					    audio->rtpmap[payload] + 1,
+				    line);
+		audio->reindex();
+	}
+	return true;
+}
+
+void SDPModif::opus(const OpusParameters &params)
+{
+	MediaSection *audio = media("audio");
+	if (!audio)
+		return;
+
+	int opus = -1;
+	int red = -1;
+	for (const auto &format : audio->formats) {
+		int payload = atoi(format.c_str());
+		std::string codec = audio->codec(payload);
+		if (caseInsensitiveStringCompare(codec, "red")) {
+			if (red == -1)
+				red = payload;
+			continue;
+		}
+		if (!caseInsensitiveStringCompare(codec, "opus") &&
+		    !caseInsensitiveStringCompare(codec, "multiopus"))
+			continue;
+		if (opus == -1 && caseInsensitiveStringCompare(codec, "opus"))
+			opus = payload;
+
+		std::string fmtp = audio->fmtpParameters(payload);
+		fmtp = setParameter(fmtp, "minptime", "10");
+		fmtp = setParameter(fmtp, "useinbandfec", params.fec ? "1" : "0");
+		fmtp = setParameter(fmtp, "usedtx", params.dtx ? "1" : "0");
+		fmtp = setParameter(fmtp, "cbr", params.cbr ? "1" : "0");
+		const std::string line =
+			"a=fmtp:" + std::to_string(payload) + " " + fmtp;
+		auto it = audio->fmtp.find(payload);
+		if (it != audio->fmtp.end()) {
+			audio->lines[it->second] = line;
+		} else {
+			audio->lines.insert(audio->lines.begin() +
+						    audio->rtpmap[payload] + 1,
+					    line);
+			audio->reindex();
+		}
+	}
+
+	// Packet time of the whole section
+	const std::string ptime = "a=ptime:" + std::to_string(params.ptime);
+	int line = audio->findLine("a=ptime:");
+	if (line != -1)
+		audio->lines[line] = ptime;
+	else
+		audio->lines.push_back(ptime);
+
+	if (red == -1)
+		return;
+	// RED of opus only, multiopus first means surround
+	bool first_multiopus =
+		!audio->formats.empty() &&
+		caseInsensitiveStringCompare(
+			audio->codec(atoi(audio->formats.front().c_str())),
+			"multiopus");
+	if (!params.red || opus == -1 || first_multiopus) {
+		removePayloads(*audio, {red});
+		return;
+	}
+	const std::string format = std::to_string(red);
+	audio->formats.erase(std::find(audio->formats.begin(),
+				       audio->formats.end(), format));
+	audio->formats.insert(audio->formats.begin(), format);
+	// Redundancy of the opus payload: "<opus>/<opus>"
+	const std::string redundancy = "a=fmtp:" + format + " " +
+				       std::to_string(opus) + "/" +
+				       std::to_string(opus);
+	auto it = audio->fmtp.find(red);
+	if (it != audio->fmtp.end()) {
+		audio->lines[it->second] = redundancy;
+	} else {
+		audio->lines.insert(audio->lines.begin() + audio->rtpmap[red] +
+					    1,
+				    redundancy);
+		audio->reindex();
+	}
+}
+
+std::string SDPModif::audioCodec()
+{
+	MediaSection *audio = media("audio");
+	if (!audio || audio->formats.empty())
+		return "";
+	return audio->codec(atoi(audio->formats.front().c_str()));
+}
+
+bool SDPModif::filterIceCandidates(const std::string &candidate,
+				   const std::string &protocol)
+{
+	// candidate:<foundation> <component> <transport> ...
+	size_t pos = candidate.find("candidate:");
+	if (pos == std::string::npos)
+		return false;
+	pos += strlen("candidate:");
+	for (int field = 0; field < 2; field++) {
+		size_t end = candidate.find(' ', pos);
+		if (end == std::string::npos || end == pos)
+			return false;
+		pos = end + 1;
+	}
+	size_t end = candidate.find(' ', pos);
+	return caseInsensitiveStringCompare(
+		candidate.substr(pos, end == std::string::npos
+					      ? std::string::npos
+					      : end - pos),
+		protocol);
+}
+
+bool SDPModif::caseInsensitiveStringCompare(const std::string &s1,
+					    const std::string &s2)
+{
+	if (s1.size() != s2.size())
+		return false;
+	for (size_t i = 0; i < s1.size(); i++)
+		if (tolower((unsigned char)s1[i]) !=
+		    tolower((unsigned char)s2[i]))
+			return false;
+	return true;
+}
@@ -0,0 +1,202 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "SharedPeerConnectionFactory.h"
+#include "FanoutVideoEncoder.h"
+#include "HardwareVideoEncoder.h"
+#include "PassthroughVideoEncoder.h"
+
+#include "api/audio_codecs/builtin_audio_decoder_factory.h"
+#include "api/audio_codecs/builtin_audio_encoder_factory.h"
+#include "api/call/call_factory_interface.h"
+#include "api/create_peerconnection_factory.h"
+#include "api/task_queue/default_task_queue_factory.h"
+#include "api/transport/field_trial_based_config.h"
+#include "api/video_codecs/builtin_video_decoder_factory.h"
+#include "api/video_codecs/builtin_video_encoder_factory.h"
+#include "media/engine/webrtc_media_engine.h"
+#include "modules/audio_processing/include/audio_processing.h"
+#include "rtc_base/ref_counted_object.h"
+#include "system_wrappers/include/field_trial.h"
+
+#include <util/base.h>
+
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+
+std::mutex SharedPeerConnectionFactory::instance_mutex_;
+std::weak_ptr<SharedPeerConnectionFactory>
+	SharedPeerConnectionFactory::instance_;
+
+std::shared_ptr<SharedPeerConnectionFactory>
+SharedPeerConnectionFactory::Acquire()
+{
+	std::lock_guard<std::mutex> lock(instance_mutex_);
+	std::shared_ptr<SharedPeerConnectionFactory> instance =
+		instance_.lock();
+	if (!instance) {
+		instance = std::shared_ptr<SharedPeerConnectionFactory>(
+			new SharedPeerConnectionFactory());
+		instance_ = instance;
+	}
+	return instance;
+}
+
+SharedPeerConnectionFactory::SharedPeerConnectionFactory()
+	: tracers_(std::make_shared<LatencyTracerSet>()), outputs_(0)
+{
+	// Process wide, before any factory:
+	// - lets the outputs offer RED for Opus (opus_red), it is removed
+	//   from the offers of the others
+	// - lets them offer the dependency descriptor, and sends a playout
+	//   delay of min = max = 0 (render at once) when they negotiate the
+	//   playout-delay extension. Each output chooses the extensions it
+	//   offers, see WebRTCStream::setHeaderExtensions.
+	webrtc::field_trial::InitFieldTrialsFromString(
+		"WebRTC-Audio-Red-For-Opus/Enabled/"
+		"WebRTC-DependencyDescriptorAdvertised/Enabled/"
+		"WebRTC-ForceSendPlayoutDelay/min_ms:0,max_ms:0/");
+
+	// Create audio device module
+	// NOTE ALEX: check if we still need this
+	adm_ = new rtc::RefCountedObject<AudioDeviceModuleWrapper>();
+
+	// Network thread
+	network_ = rtc::Thread::CreateWithSocketServer();
+	network_->SetName("network", nullptr);
+	network_->Start();
+
+	// Worker thread
+	worker_ = rtc::Thread::Create();
+	worker_->SetName("worker", nullptr);
+	worker_->Start();
+
+	// Signaling thread
+	signaling_ = rtc::Thread::Create();
+	signaling_->SetName("signaling", nullptr);
+	signaling_->Start();
+
+	info("WebRTC: shared network, worker and signaling threads started");
+}
+
+SharedPeerConnectionFactory::~SharedPeerConnectionFactory()
+{
+	// Free factories
+	factories_.clear();
+	adm_ = nullptr;
+
+	// Stop all threads
+	if (!network_->IsCurrent())
+		network_->Stop();
+	if (!worker_->IsCurrent())
+		worker_->Stop();
+	if (!signaling_->IsCurrent())
+		signaling_->Stop();
+
+	network_.release();
+	worker_.release();
+	signaling_.release();
+
+	info("WebRTC: shared threads stopped");
+}
+
+rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+SharedPeerConnectionFactory::GetFactory(bool encoded,
+					const std::string &hw_encoder)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> &factory =
+		factories_[encoded ? "passthrough" : hw_encoder];
+	if (factory)
+		return factory;
+
+	info("WebRTC: creating the %s peer connection factory",
+	     encoded ? "passthrough" : "encoding");
+
+	// Encoded outputs forward the OBS encoder packets instead of encoding
+	if (encoded)
+		factory = CreateFactory(
+			std::make_unique<PassthroughVideoEncoderFactory>());
+	else
+		factory = CreateFactory(
+			std::make_unique<HardwareVideoEncoderFactory>(
+				webrtc::CreateBuiltinVideoEncoderFactory(),
+				hw_encoder));
+	return factory;
+}
+
+rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+SharedPeerConnectionFactory::CreateFanoutFactory(const std::string &hw_encoder)
+{
+	info("WebRTC: creating a fan-out peer connection factory");
+	return CreateFactory(std::make_unique<FanoutVideoEncoderFactory>(
+		std::make_unique<HardwareVideoEncoderFactory>(
+			webrtc::CreateBuiltinVideoEncoderFactory(),
+			hw_encoder)));
+}
+
+rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+SharedPeerConnectionFactory::CreateFactory(
+	std::unique_ptr<webrtc::VideoEncoderFactory> video_encoder_factory)
+{
+	// Same as webrtc::CreatePeerConnectionFactory, with the latency probes
+	// on the encoders and the RTC event log
+	webrtc::PeerConnectionFactoryDependencies dependencies;
+	dependencies.network_thread = network_.get();
+	dependencies.worker_thread = worker_.get();
+	dependencies.signaling_thread = signaling_.get();
+	dependencies.task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+	dependencies.call_factory = webrtc::CreateCallFactory();
+	dependencies.event_log_factory =
+		std::make_unique<PacketSentEventLogFactory>(
+			dependencies.task_queue_factory.get(), tracers_);
+	dependencies.trials = std::make_unique<webrtc::FieldTrialBasedConfig>();
+
+	cricket::MediaEngineDependencies media_dependencies;
+	media_dependencies.task_queue_factory =
+		dependencies.task_queue_factory.get();
+	media_dependencies.adm = adm_;
+	media_dependencies.audio_encoder_factory =
+		webrtc::CreateBuiltinAudioEncoderFactory();
+	media_dependencies.audio_decoder_factory =
+		webrtc::CreateBuiltinAudioDecoderFactory();
+	media_dependencies.audio_processing =
+		webrtc::AudioProcessingBuilder().Create();
+	media_dependencies.video_encoder_factory =
+		std::make_unique<TracingVideoEncoderFactory>(
+			std::move(video_encoder_factory), tracers_);
+	media_dependencies.video_decoder_factory =
+		webrtc::CreateBuiltinVideoDecoderFactory();
+	media_dependencies.trials = dependencies.trials.get();
+	dependencies.media_engine =
+		cricket::CreateMediaEngine(std::move(media_dependencies));
+
+	return webrtc::CreateModularPeerConnectionFactory(
+		std::move(dependencies));
+}
+
+void SharedPeerConnectionFactory::AddTracer(
+	const std::shared_ptr<LatencyTracer> &tracer)
+{
+	tracers_->Add(tracer);
+	std::lock_guard<std::mutex> lock(mutex_);
+	outputs_++;
+}
+
+void SharedPeerConnectionFactory::RemoveTracer(
+	const std::shared_ptr<LatencyTracer> &tracer)
+{
+	tracers_->Remove(tracer);
+	std::lock_guard<std::mutex> lock(mutex_);
+	outputs_--;
+}
+
+int SharedPeerConnectionFactory::outputs()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return outputs_;
+}
+
+int SharedPeerConnectionFactory::factories()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return (int)factories_.size();
+}
@@ -0,0 +1,79 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _SHARED_PEER_CONNECTION_FACTORY_H_
+#define _SHARED_PEER_CONNECTION_FACTORY_H_
+
+#include "AudioDeviceModuleWrapper.h"
+#include "LatencyProbes.h"
+
+// webrtc includes
+#include <api/peer_connection_interface.h>
+#include <api/scoped_refptr.h>
+#include <api/video_codecs/video_encoder_factory.h>
+#include <rtc_base/thread.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// PeerConnectionFactory and rtc::Threads of the process, shared by all the
+// WebRTC outputs. Created with the first output and destroyed with the
+// last one, so running several outputs (several streams, fan-out)
+// costs one set of threads and one media engine instead of one each.
+class SharedPeerConnectionFactory {
+public:
+	// Reference to the instance of the process
+	static std::shared_ptr<SharedPeerConnectionFactory> Acquire();
+	~SharedPeerConnectionFactory();
+
+	// Raw outputs encode with libwebrtc, on the hardware encoder of
+	// |hw_encoder| when available (see HardwareVideoEncoderFactory),
+	// encoded outputs send the OBS encoder packets as-is: one factory of
+	// each kind, created on demand
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+	GetFactory(bool encoded, const std::string &hw_encoder = "none");
+	// Factory of its own for a fan-out output, on the shared threads: its
+	// peer connections share the encoders of their layers
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+	CreateFanoutFactory(const std::string &hw_encoder = "none");
+
+	rtc::Thread *network() const { return network_.get(); }
+	rtc::Thread *worker() const { return worker_.get(); }
+	rtc::Thread *signaling() const { return signaling_.get(); }
+
+	// The latency probes of the factories report to the tracer of the
+	// output that owns the frame
+	void AddTracer(const std::shared_ptr<LatencyTracer> &tracer);
+	void RemoveTracer(const std::shared_ptr<LatencyTracer> &tracer);
+
+	// Resource accounting, for the logs
+	int outputs();
+	int factories();
+
+private:
+	SharedPeerConnectionFactory();
+
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+	CreateFactory(std::unique_ptr<webrtc::VideoEncoderFactory>
+			      video_encoder_factory);
+
+	static std::mutex instance_mutex_;
+	static std::weak_ptr<SharedPeerConnectionFactory> instance_;
+
+	std::unique_ptr<rtc::Thread> network_;
+	std::unique_ptr<rtc::Thread> worker_;
+	std::unique_ptr<rtc::Thread> signaling_;
+	rtc::scoped_refptr<AudioDeviceModuleWrapper> adm_;
+	std::shared_ptr<LatencyTracerSet> tracers_;
+
+	std::mutex mutex_;
+	// "passthrough" for the encoded outputs, the hardware encoder
+	// preference for the raw ones
+	std::map<std::string,
+		 rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>>
+		factories_;
+	int outputs_;
+};
+
+#endif
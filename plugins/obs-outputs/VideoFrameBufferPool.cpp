@@ -0,0 +1,139 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "VideoFrameBufferPool.h"
+
+#include <libyuv.h>
+
+#include <string.h>
+
+rtc::scoped_refptr<webrtc::I420Buffer>
+I420BufferPool::Create(int width, int height, bool *hit)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	// Resolution changed: drop the buffers we are the only owner of
+	for (auto it = buffers_.begin(); it != buffers_.end();) {
+		if ((*it)->width() != width || (*it)->height() != height)
+			it = buffers_.erase(it);
+		else
+			++it;
+	}
+
+	// Reuse a buffer libwebrtc is done with
+	for (const auto &buffer : buffers_) {
+		if (buffer->HasOneRef()) {
+			*hit = true;
+			return buffer;
+		}
+	}
+
+	*hit = false;
+	if (buffers_.size() >= kMaxBuffers)
+		return webrtc::I420Buffer::Create(width, height);
+
+	const int stride_uv = (width + 1) / 2;
+	rtc::scoped_refptr<PooledI420Buffer> buffer(
+		new PooledI420Buffer(width, height, width, stride_uv,
+				     stride_uv));
+	buffers_.push_back(buffer);
+	return buffer;
+}
+
+NV12VideoFrameBuffer::NV12VideoFrameBuffer(
+	int width, int height, std::weak_ptr<I420BufferPool> i420_pool)
+	: width_(width),
+	  height_(height),
+	  stride_y_(width),
+	  stride_uv_(width + (width & 1)),
+	  data_(new uint8_t[width * height +
+			    (width + (width & 1)) * ((height + 1) / 2)]),
+	  i420_pool_(i420_pool)
+{
+}
+
+NV12VideoFrameBuffer::~NV12VideoFrameBuffer() = default;
+
+void NV12VideoFrameBuffer::CopyFrom(const uint8_t *src_y, int src_stride_y,
+				    const uint8_t *src_uv, int src_stride_uv)
+{
+	{
+		std::lock_guard<std::mutex> lock(i420_mutex_);
+		i420_ = nullptr;
+	}
+	libyuv::CopyPlane(src_y, src_stride_y, MutableDataY(), stride_y_,
+			  width_, height_);
+	libyuv::CopyPlane(src_uv, src_stride_uv, MutableDataUV(), stride_uv_,
+			  stride_uv_, (height_ + 1) / 2);
+}
+
+rtc::scoped_refptr<webrtc::I420BufferInterface> NV12VideoFrameBuffer::ToI420()
+{
+	// Simulcast encoders convert the same frame once per layer
+	std::lock_guard<std::mutex> lock(i420_mutex_);
+	if (i420_)
+		return i420_;
+
+	// The pool may be gone with its output, frames in flight still convert
+	std::shared_ptr<I420BufferPool> i420_pool = i420_pool_.lock();
+	bool hit;
+	rtc::scoped_refptr<webrtc::I420Buffer> i420 =
+		i420_pool ? i420_pool->Create(width_, height_, &hit)
+			  : webrtc::I420Buffer::Create(width_, height_);
+	libyuv::NV12ToI420(DataY(), stride_y_, DataUV(), stride_uv_,
+			   i420->MutableDataY(), i420->StrideY(),
+			   i420->MutableDataU(), i420->StrideU(),
+			   i420->MutableDataV(), i420->StrideV(), width_,
+			   height_);
+	i420_ = i420;
+	return i420;
+}
+
+rtc::scoped_refptr<VideoFrameBufferPool> VideoFrameBufferPool::Create()
+{
+	return new rtc::RefCountedObject<VideoFrameBufferPool>();
+}
+
+VideoFrameBufferPool::VideoFrameBufferPool()
+	: i420_pool_(std::make_shared<I420BufferPool>())
+{
+}
+
+rtc::scoped_refptr<webrtc::I420Buffer>
+VideoFrameBufferPool::CreateI420Buffer(int width, int height)
+{
+	bool hit;
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+		i420_pool_->Create(width, height, &hit);
+	if (hit)
+		hits_++;
+	else
+		misses_++;
+	return buffer;
+}
+
+rtc::scoped_refptr<NV12VideoFrameBuffer>
+VideoFrameBufferPool::CreateNV12Buffer(int width, int height)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	for (auto it = nv12_buffers_.begin(); it != nv12_buffers_.end();) {
+		if ((*it)->width() != width || (*it)->height() != height)
+			it = nv12_buffers_.erase(it);
+		else
+			++it;
+	}
+
+	for (const auto &buffer : nv12_buffers_) {
+		if (buffer->HasOneRef()) {
+			hits_++;
+			return buffer;
+		}
+	}
+
+	misses_++;
+	rtc::scoped_refptr<PooledNV12Buffer> buffer(
+		new PooledNV12Buffer(width, height, i420_pool_));
+	if (nv12_buffers_.size() < kMaxBuffers)
+		nv12_buffers_.push_back(buffer);
+	return buffer;
+}
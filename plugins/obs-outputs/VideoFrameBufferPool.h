@@ -0,0 +1,118 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _VIDEO_FRAME_BUFFER_POOL_H_
+#define _VIDEO_FRAME_BUFFER_POOL_H_
+
+#include <api/scoped_refptr.h>
+#include <api/video/i420_buffer.h>
+#include <api/video/video_frame_buffer.h>
+#include <rtc_base/ref_count.h>
+#include <rtc_base/ref_counted_object.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+
+// Recycled I420 buffers of a VideoFrameBufferPool. The NV12 buffers of the
+// pool only hold a weak reference to it, for their ToI420() conversion.
+class I420BufferPool {
+public:
+	// |hit| tells whether a recycled buffer was returned
+	rtc::scoped_refptr<webrtc::I420Buffer> Create(int width, int height,
+						      bool *hit);
+
+private:
+	// Upper bound of buffers kept, libwebrtc holds at most a few frames
+	// in flight (capturer -> encoder queue)
+	static const size_t kMaxBuffers = 8;
+
+	typedef rtc::RefCountedObject<webrtc::I420Buffer> PooledI420Buffer;
+
+	std::mutex mutex_;
+	std::list<rtc::scoped_refptr<PooledI420Buffer>> buffers_;
+};
+
+// NV12 frame buffer backed by recycled memory. It is handed to libwebrtc as
+// an NV12 buffer, so encoders that take NV12 get the planes as-is, and the
+// I420 conversion only happens (lazily, on the encoder queue) for encoders
+// that call ToI420(). The conversion is done once per frame, even when every
+// simulcast layer asks for it.
+class NV12VideoFrameBuffer : public webrtc::NV12BufferInterface {
+public:
+	int width() const override { return width_; }
+	int height() const override { return height_; }
+	rtc::scoped_refptr<webrtc::I420BufferInterface> ToI420() override;
+
+	const uint8_t *DataY() const override { return data_.get(); }
+	const uint8_t *DataUV() const override
+	{
+		return data_.get() + stride_y_ * height_;
+	}
+	int StrideY() const override { return stride_y_; }
+	int StrideUV() const override { return stride_uv_; }
+
+	uint8_t *MutableDataY() { return data_.get(); }
+	uint8_t *MutableDataUV() { return data_.get() + stride_y_ * height_; }
+
+	// Copy the planes of an OBS NV12 frame into this buffer
+	void CopyFrom(const uint8_t *src_y, int src_stride_y,
+		      const uint8_t *src_uv, int src_stride_uv);
+
+protected:
+	NV12VideoFrameBuffer(int width, int height,
+			     std::weak_ptr<I420BufferPool> i420_pool);
+	~NV12VideoFrameBuffer() override;
+
+private:
+	const int width_;
+	const int height_;
+	const int stride_y_;
+	const int stride_uv_;
+	const std::unique_ptr<uint8_t[]> data_;
+	// Used to get a recycled I420 buffer in ToI420(), weak so that the
+	// pooled NV12 buffers don't keep their pool alive
+	const std::weak_ptr<I420BufferPool> i420_pool_;
+	// Result of the first ToI420() call, cleared by CopyFrom()
+	std::mutex i420_mutex_;
+	rtc::scoped_refptr<webrtc::I420BufferInterface> i420_;
+};
+
+// Recycles I420 and NV12 frame buffers of a single resolution so that the
+// video-io thread does not allocate a new frame for every raw frame.
+// A buffer is reused once libwebrtc released its last reference to it.
+class VideoFrameBufferPool : public rtc::RefCountInterface {
+public:
+	static rtc::scoped_refptr<VideoFrameBufferPool> Create();
+
+	rtc::scoped_refptr<webrtc::I420Buffer> CreateI420Buffer(int width,
+								int height);
+	rtc::scoped_refptr<NV12VideoFrameBuffer> CreateNV12Buffer(int width,
+								  int height);
+
+	uint64_t hits() const { return hits_; }
+	uint64_t misses() const { return misses_; }
+	void ResetCounters()
+	{
+		hits_ = 0;
+		misses_ = 0;
+	}
+
+protected:
+	VideoFrameBufferPool();
+	~VideoFrameBufferPool() override = default;
+
+private:
+	// Upper bound of NV12 buffers kept, as for I420BufferPool
+	static const size_t kMaxBuffers = 8;
+
+	typedef rtc::RefCountedObject<NV12VideoFrameBuffer> PooledNV12Buffer;
+
+	const std::shared_ptr<I420BufferPool> i420_pool_;
+	std::mutex mutex_;
+	std::list<rtc::scoped_refptr<PooledNV12Buffer>> nv12_buffers_;
+	std::atomic<uint64_t> hits_{0};
+	std::atomic<uint64_t> misses_{0};
+};
+
+#endif
@@ -0,0 +1,327 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "WebRTCFanout.h"
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+#define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
+
+WebRTCFanout::WebRTCFanout(obs_output_t *output)
+	: capturing(false), stopping(false), output(output)
+{
+	shared_factory = SharedPeerConnectionFactory::Acquire();
+
+	proc_handler_add(
+		obs_output_get_proc_handler(output),
+		"void get_webrtc_stats(in ptr stats, in int destination, out int destinations, out bool success)",
+		getTypedStatsProc, this);
+}
+
+WebRTCFanout::~WebRTCFanout()
+{
+	stop();
+
+	// Destroyed outside the lock, they may be calling us
+	std::vector<Destination> old;
+	rtc::scoped_refptr<WebRTCStream> old_media;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		old.swap(destinations);
+		old_media.swap(media);
+	}
+	old.clear();
+	old_media = nullptr;
+
+	factory = nullptr;
+	shared_factory = nullptr;
+}
+
+std::vector<WebRTCFanout::Destination> WebRTCFanout::loadDestinations()
+{
+	std::vector<Destination> list;
+
+	// The service destination comes first
+	list.push_back(Destination());
+
+	// "<url>" or "<url> <token>"
+	obs_data_t *settings = obs_output_get_settings(output);
+	obs_data_array_t *array =
+		obs_data_get_array(settings, OPT_FANOUT_DESTINATIONS);
+	size_t count = obs_data_array_count(array);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *item = obs_data_array_item(array, i);
+		std::istringstream value(obs_data_get_string(item, "value"));
+		obs_data_release(item);
+
+		Destination destination;
+		value >> destination.url >> destination.token;
+		if (destination.url.empty())
+			continue;
+		if (list.size() == (size_t)kMaxDestinations) {
+			warn("Fan-out: more than %d destinations, %s ignored",
+			     kMaxDestinations, destination.url.c_str());
+			continue;
+		}
+		list.push_back(destination);
+	}
+	obs_data_array_release(array);
+	obs_data_release(settings);
+	return list;
+}
+
+bool WebRTCFanout::start()
+{
+	info("WebRTCFanout::start");
+
+	// Previous destinations, destroyed outside the lock
+	std::vector<Destination> old;
+	rtc::scoped_refptr<WebRTCStream> old_media;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		old.swap(destinations);
+		old_media.swap(media);
+	}
+	old.clear();
+	old_media = nullptr;
+
+	// New factory for the hardware encoder setting, the previous
+	// destinations were its only users
+	obs_data_t *settings = obs_output_get_settings(output);
+	factory = shared_factory->CreateFanoutFactory(
+		obs_data_get_string(settings, OPT_HW_ENCODER));
+	WebRTCStream::setVideoConversion(
+		output, obs_data_get_bool(settings, OPT_NV12_PASSTHROUGH));
+	obs_data_release(settings);
+
+	std::vector<Destination> list = loadDestinations();
+	for (Destination &destination : list) {
+		destination.stream = new WebRTCStream(output, this, factory);
+		if (!destination.url.empty())
+			destination.stream->setDestination(destination.url,
+							   destination.token);
+	}
+
+	// The first destination converts the frames for all of them
+	rtc::scoped_refptr<WebRTCStream> first = list.front().stream;
+	first->createTracks();
+	for (size_t i = 1; i < list.size(); i++)
+		list[i].stream->shareMedia(first);
+
+	std::vector<rtc::scoped_refptr<WebRTCStream>> streams;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		destinations = list;
+		media = first;
+		capturing = false;
+		stopping = false;
+		for (const Destination &destination : destinations)
+			streams.push_back(destination.stream);
+	}
+	info("Fan-out: publishing to %d destination(s)", (int)streams.size());
+
+	// The ones failing now are released alone, see onDestinationStopped
+	bool started = false;
+	for (const auto &stream : streams)
+		started |= stream->start(WebRTCStream::Type::CustomWebrtc);
+	return started;
+}
+
+bool WebRTCFanout::stop()
+{
+	info("WebRTCFanout::stop");
+	std::vector<rtc::scoped_refptr<WebRTCStream>> streams;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		for (const Destination &destination : destinations)
+			streams.push_back(destination.stream);
+	}
+	for (const auto &stream : streams)
+		stream->stop();
+	obs_output_end_data_capture(output);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		capturing = false;
+	}
+	return true;
+}
+
+void WebRTCFanout::onAudioFrame(audio_data *frame)
+{
+	// Each destination converts the audio to the channel layout of its
+	// answer
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const Destination &destination : destinations)
+		destination.stream->onAudioFrame(frame);
+}
+
+void WebRTCFanout::onVideoFrame(video_data *frame)
+{
+	// Kept alive by the reference while converting, a restart may
+	// replace it meanwhile
+	rtc::scoped_refptr<WebRTCStream> stream;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stream = media;
+	}
+	if (stream)
+		stream->onVideoFrame(frame);
+}
+
+void WebRTCFanout::onDestinationOpened(WebRTCStream *destination)
+{
+	bool begin = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (Destination &d : destinations)
+			if (d.stream.get() == destination &&
+			    d.state == State::Connecting)
+				d.state = State::Publishing;
+		if (!capturing && !stopping) {
+			capturing = true;
+			begin = true;
+		}
+	}
+	if (begin) {
+		info("Fan-out: begin data capture");
+		obs_output_begin_data_capture(output, 0);
+	}
+}
+
+void WebRTCFanout::onDestinationStopped(WebRTCStream *destination, int code)
+{
+	rtc::scoped_refptr<WebRTCStream> stream;
+	size_t index = 0;
+	int left = 0;
+	bool stop_output = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		for (size_t i = 0; i < destinations.size(); i++) {
+			Destination &d = destinations[i];
+			if (d.stream.get() == destination &&
+			    d.state != State::Stopped) {
+				d.state = State::Stopped;
+				stream = d.stream;
+				index = i;
+			}
+			if (d.state != State::Stopped)
+				left++;
+		}
+		// Stopped already, or an other failure of the same destination
+		if (!stream)
+			return;
+		if (left == 0 && !stopping) {
+			stopping = true;
+			stop_output = true;
+		}
+	}
+	warn("Fan-out: destination %d stopped [code: %d], %d left",
+	     (int)index, code, left);
+
+	// Called from the signaling threads: release the session of the
+	// destination on a separate thread in order to avoid deadlock
+	obs_output_t *output = this->output;
+	std::thread([stream, stop_output, output, code]() {
+		stream->close(false);
+		// Disconnect, this will call stop on main thread
+		if (stop_output)
+			obs_output_signal_stop(output, code);
+	}).detach();
+}
+
+void WebRTCFanout::getStats()
+{
+	static const char *state_names[] = {"connecting", "publishing",
+					    "stopped"};
+	std::vector<Destination> list;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		list = destinations;
+	}
+
+	std::string destinations_list;
+	int publishing = 0;
+	for (size_t i = 0; i < list.size(); i++) {
+		const Destination &destination = list[i];
+		if (destination.state == State::Publishing)
+			publishing++;
+		std::string prefix = "destination" + std::to_string(i) + "_";
+		destinations_list +=
+			prefix + "state:" +
+			state_names[(int)destination.state] + "\n";
+		destination.stream->getStats();
+		std::istringstream lines(destination.stream->get_stats_list());
+		std::string line;
+		while (std::getline(lines, line))
+			if (!line.empty())
+				destinations_list += prefix + line + "\n";
+	}
+	stats_list = "destinations:" + std::to_string(list.size()) + "\n";
+	stats_list += "destinations_publishing:" +
+		      std::to_string(publishing) + "\n";
+	stats_list += destinations_list;
+}
+
+const char *WebRTCFanout::get_stats_list()
+{
+	return stats_list.c_str();
+}
+
+uint64_t WebRTCFanout::getBitrate()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	uint64_t total = 0;
+	for (const Destination &destination : destinations)
+		total += destination.stream->getBitrate();
+	return total;
+}
+
+int WebRTCFanout::getDroppedFrames()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	int total = 0;
+	for (const Destination &destination : destinations)
+		total += destination.stream->getDroppedFrames();
+	return total;
+}
+
+float WebRTCFanout::getCongestion()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	float congestion = 0.0f;
+	for (const Destination &destination : destinations)
+		if (destination.state == State::Publishing)
+			congestion = std::max(
+				congestion, destination.stream->getCongestion());
+	return congestion;
+}
+
+bool WebRTCFanout::getTypedStats(size_t index, webrtc_stats *stats)
+{
+	rtc::scoped_refptr<WebRTCStream> stream;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (index >= destinations.size())
+			return false;
+		stream = destinations[index].stream;
+	}
+	return stream->getTypedStats(stats);
+}
+
+void WebRTCFanout::getTypedStatsProc(void *data, calldata_t *cd)
+{
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	webrtc_stats *stats = (webrtc_stats *)calldata_ptr(cd, "stats");
+	long long index = calldata_int(cd, "destination");
+	{
+		std::lock_guard<std::mutex> lock(fanout->mutex);
+		calldata_set_int(cd, "destinations",
+				 (long long)fanout->destinations.size());
+	}
+	calldata_set_bool(cd, "success",
+			  index >= 0 &&
+				  fanout->getTypedStats((size_t)index, stats));
+}
@@ -0,0 +1,86 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#ifndef _WEBRTC_FANOUT_H_
+#define _WEBRTC_FANOUT_H_
+
+#include "WebRTCStream.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Output settings of the fan-out output
+#define OPT_FANOUT_DESTINATIONS "fanout_destinations"
+
+// WebRTC output publishing the same media to several destinations: the
+// service one, then the ones of the output settings.
+//
+// Each destination is a WebRTCStream with its own peer connection, signaling
+// session, reconnection and stats. The video frames are converted once, by
+// the first destination, into a video track shared by all of them, and the
+// encoders of their peer connections share a single encoder per video layer
+// (FanoutVideoEncoderFactory). The audio goes to an audio source per
+// destination, which may downmix to stereo if its receiver does not accept
+// multiopus. A destination that gives up is released alone, the output stops
+// when none is left.
+class WebRTCFanout : public WebRTCFanoutListener {
+public:
+	WebRTCFanout(obs_output_t *output);
+	~WebRTCFanout() override;
+
+	bool start();
+	bool stop();
+	void onAudioFrame(audio_data *frame);
+	void onVideoFrame(video_data *frame);
+
+	// Stats of the destinations, "destination<index>_" prefixed
+	void getStats();
+	const char *get_stats_list();
+	// Sums over the destinations, the congestion is the worst one
+	uint64_t getBitrate();
+	int getDroppedFrames();
+	float getCongestion();
+	bool getTypedStats(size_t index, webrtc_stats *stats);
+
+	// WebRTCFanoutListener
+	void onDestinationOpened(WebRTCStream *destination) override;
+	void onDestinationStopped(WebRTCStream *destination, int code) override;
+
+	static const int kMaxDestinations = 8;
+
+private:
+	enum class State { Connecting, Publishing, Stopped };
+	struct Destination {
+		// Empty for the service destination
+		std::string url;
+		std::string token;
+		rtc::scoped_refptr<WebRTCStream> stream;
+		State state = State::Connecting;
+	};
+
+	std::vector<Destination> loadDestinations();
+	static void getTypedStatsProc(void *data, calldata_t *cd);
+
+	std::mutex mutex;
+	std::vector<Destination> destinations;
+	// Data capture begun, for the first destination that opened
+	bool capturing;
+	// Set by stop and once the output is signaled to stop
+	bool stopping;
+
+	// Destination the video frames are handed to. Protected by mutex,
+	// the frames are converted outside of it
+	rtc::scoped_refptr<WebRTCStream> media;
+
+	std::string stats_list;
+
+	// Threads shared with the other outputs, factory of this fan-out,
+	// created on start
+	std::shared_ptr<SharedPeerConnectionFactory> shared_factory;
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
+
+	obs_output_t *output;
+};
+
+#endif
@@ -5,18 +5,20 @@
 
 #include "media-io/video-io.h"
 
-#include "api/audio_codecs/builtin_audio_decoder_factory.h"
-#include "api/audio_codecs/builtin_audio_encoder_factory.h"
-#include "api/video_codecs/builtin_video_decoder_factory.h"
-#include "api/video_codecs/builtin_video_encoder_factory.h"
+#include "api/media_types.h"
+#include "api/rtp_parameters.h"
 #include "api/video/i420_buffer.h"
 #include "common_video/libyuv/include/webrtc_libyuv.h"
 #include "pc/rtc_stats_collector.h"
 #include "rtc_base/checks.h"
+#include "rtc_base/task_utils/pending_task_safety_flag.h"
+#include "rtc_base/task_utils/to_queued_task.h"
+#include "rtc_base/time_utils.h"
 #include <libyuv.h>
 
 #include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <iterator>
 #include <memory>
 #include <mutex>
@@ -29,26 +31,30 @@
 #define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
 #define error(format, ...) blog(LOG_ERROR, format, ##__VA_ARGS__)
 
+// Forwards the stats report to the stream sampler, on the signaling thread
 class StatsCallback : public webrtc::RTCStatsCollectorCallback {
 public:
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> report()
+	StatsCallback(WebRTCStream *stream,
+		      rtc::scoped_refptr<webrtc::PendingTaskSafetyFlag> safety,
+		      uint64_t generation)
+		: stream_(stream), safety_(safety), generation_(generation)
 	{
-		return report_;
 	}
-	bool called() const { return called_; }
 
 protected:
 	void OnStatsDelivered(
 		const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report)
 		override
 	{
-		report_ = report;
-		called_ = true;
+		// The stream may be gone, the signaling thread is shared
+		if (safety_->alive())
+			stream_->onStatsReport(report, generation_);
 	}
 
 private:
-	bool called_ = false;
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> report_;
+	WebRTCStream *stream_;
+	rtc::scoped_refptr<webrtc::PendingTaskSafetyFlag> safety_;
+	uint64_t generation_;
 };
 
 class CustomLogger : public rtc::LogSink {
@@ -61,49 +67,92 @@ public:
 
 CustomLogger logger;
 
-WebRTCStream::WebRTCStream(obs_output_t *output)
+// Output setting and URI of the RTP header extensions the settings control.
+// The playout delay sent is min = max = 0, see SharedPeerConnectionFactory.
+static const std::pair<const char *, const char *> kHeaderExtensions[] = {
+	{OPT_RTP_ABS_SEND_TIME, webrtc::RtpExtension::kAbsSendTimeUri},
+	{OPT_RTP_TRANSPORT_CC,
+	 webrtc::RtpExtension::kTransportSequenceNumberUri},
+	{OPT_RTP_PLAYOUT_DELAY, webrtc::RtpExtension::kPlayoutDelayUri},
+	{OPT_RTP_VIDEO_TIMING, webrtc::RtpExtension::kVideoTimingUri},
+	{OPT_RTP_ABS_CAPTURE_TIME,
+	 webrtc::RtpExtension::kAbsoluteCaptureTimeUri},
+	{OPT_RTP_DEPENDENCY_DESCRIPTOR,
+	 webrtc::RtpExtension::kDependencyDescriptorUri},
+};
+
+// Ids of the video frames, unique across the outputs: the latency probes of
+// the shared factory find the output of a frame by its id
+static std::atomic<uint16_t> frame_ids{0};
+
+WebRTCStream::WebRTCStream(
+	obs_output_t *output, WebRTCFanoutListener *fanout,
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+		fanout_factory)
 {
 	rtc::LogMessage::RemoveLogToStream(&logger);
 	rtc::LogMessage::AddLogToStream(&logger,
 					rtc::LoggingSeverity::LS_VERBOSE);
 
+	latency_tracer = std::make_shared<LatencyTracer>();
 	resetStats();
 
 	audio_bitrate = 128;
+	audio_layout = AudioChannelLayout::Stereo();
 	video_bitrate = 2500;
+	nv12_passthrough = false;
+	dbr_enabled = false;
+	hw_encoder = "auto";
+	stats_interval_ms = 1000;
+	stats_generation = 0;
+	stopped = false;
+	ice_restarting = false;
+	ice_restart_attempts = 0;
+	capturing = false;
+	reconnecting = false;
+	reconnect_attempts = 0;
+	reconnect_start_ms = 0;
+	encoded = (obs_output_get_flags(output) & OBS_OUTPUT_ENCODED) != 0;
+	audio_connected = false;
 
 	// Store output
 	this->output = output;
 	this->client = nullptr;
-
-	// Create audio device module
-	// NOTE ALEX: check if we still need this
-	adm = new rtc::RefCountedObject<AudioDeviceModuleWrapper>();
-
-	// Network thread
-	network = rtc::Thread::CreateWithSocketServer();
-	network->SetName("network", nullptr);
-	network->Start();
-
-	// Worker thread
-	worker = rtc::Thread::Create();
-	worker->SetName("worker", nullptr);
-	worker->Start();
-
-	// Signaling thread
-	signaling = rtc::Thread::Create();
-	signaling->SetName("signaling", nullptr);
-	signaling->Start();
-
-	factory = webrtc::CreatePeerConnectionFactory(
-		network.get(), worker.get(), signaling.get(), adm,
-		webrtc::CreateBuiltinAudioEncoderFactory(),
-		webrtc::CreateBuiltinAudioDecoderFactory(),
-		webrtc::CreateBuiltinVideoEncoderFactory(),
-		webrtc::CreateBuiltinVideoDecoderFactory(), nullptr, nullptr);
+	this->fanout = fanout;
+
+	// Threads and factory shared with the other WebRTC outputs
+	shared_factory = SharedPeerConnectionFactory::Acquire();
+	shared_factory->AddTracer(latency_tracer);
+	network = shared_factory->network();
+	worker = shared_factory->worker();
+	signaling = shared_factory->signaling();
+	// Raw outputs get theirs on start, with the hardware encoder setting
+	if (fanout_factory)
+		factory = fanout_factory;
+	else if (encoded)
+		factory = shared_factory->GetFactory(encoded);
+
+	// Tasks posted to the shared signaling thread must not outlive us
+	task_safety = signaling->Invoke<
+		rtc::scoped_refptr<webrtc::PendingTaskSafetyFlag>>(
+		RTC_FROM_HERE,
+		[]() { return webrtc::PendingTaskSafetyFlag::Create(); });
+
+	info("WebRTC output created: %d output(s) share the threads and %d peer connection factory(ies)",
+	     shared_factory->outputs(), shared_factory->factories());
 
 	// Create video capture module
 	videoCapturer = new rtc::RefCountedObject<VideoCapturer>();
+
+	// Frame buffers reused across onVideoFrame calls
+	buffer_pool = VideoFrameBufferPool::Create();
+
+	// Typed stats, see webrtc-stats.h. The fan-out has its own.
+	if (!fanout)
+		proc_handler_add(
+			obs_output_get_proc_handler(output),
+			"void get_webrtc_stats(in ptr stats, out bool success)",
+			getTypedStatsProc, this);
 }
 
 WebRTCStream::~WebRTCStream()
@@ -113,34 +162,46 @@ WebRTCStream::~WebRTCStream()
 	// Shutdown websocket connection and close Peer Connection
 	close(false);
 
+	// Drop the tasks still queued on the shared signaling thread
+	signaling->Invoke<void>(RTC_FROM_HERE,
+				[this]() { task_safety->SetNotAlive(); });
+
 	// Free factories
-	adm = nullptr;
 	pc = nullptr;
 	factory = nullptr;
 	videoCapturer = nullptr;
 
-	// Stop all threads
-	if (!network->IsCurrent())
-		network->Stop();
-	if (!worker->IsCurrent())
-		worker->Stop();
-	if (!signaling->IsCurrent())
-		signaling->Stop();
-
-	network.release();
-	worker.release();
-	signaling.release();
+	// The threads stop with the last output
+	shared_factory->RemoveTracer(latency_tracer);
+	info("WebRTC output destroyed: %d output(s) left on the shared threads",
+	     shared_factory->outputs());
+	network = nullptr;
+	worker = nullptr;
+	signaling = nullptr;
+	shared_factory = nullptr;
+
+	// No stats sample can run anymore
+	buffer_pool = nullptr;
 }
 
 void WebRTCStream::resetStats()
 {
-	stats_list = "";
-	frame_id = 0;
-	pli_received = 0;
 	audio_bytes_sent = 0;
 	video_bytes_sent = 0;
-	total_bytes_sent = 0;
+	previous_audio_bytes = 0;
 	previous_frames_sent = 0;
+	std::atomic_store(&stats_snapshot,
+			  std::make_shared<const WebRTCStatsSnapshot>());
+	congestion_estimator.Reset();
+	congestion = 0.0f;
+	previous_layer_bytes.clear();
+	previous_layer_timestamp_us = 0;
+	reconnect_bytes_sent = 0;
+	reconnects = 0;
+	last_reconnect_ms = 0;
+	if (buffer_pool)
+		buffer_pool->ResetCounters();
+	latency_tracer->Reset();
 }
 
 bool WebRTCStream::start(WebRTCStream::Type type)
@@ -149,6 +210,12 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	this->type = type;
 
 	resetStats();
+	capturing = false;
+	reconnecting = false;
+	{
+		webrtc::MutexLock lock(&crit_);
+		stopped = false;
+	}
 
 	// Access service if started, or fail
 
@@ -157,7 +224,7 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 		obs_output_set_last_error(
 			output,
 			"An unexpected error occurred during stream startup.");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
+		signalStop(OBS_OUTPUT_CONNECT_FAILED);
 		return false;
 	}
 
@@ -188,12 +255,62 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 		                publishApiUrl.empty()) {
 		publishApiUrl = url;
 	}
+	// Fan-out destination other than the service one
+	if (!destination_url.empty()) {
+		url = destination_url;
+		publishApiUrl = destination_url;
+		password = destination_token;
+	}
 
 	// Some extra log
 
+	// Extract setting from output
+
+	obs_data_t *settings = obs_output_get_settings(output);
+	nv12_passthrough = obs_data_get_bool(settings, OPT_NV12_PASSTHROUGH);
+	stats_interval_ms = (int)obs_data_get_int(settings, OPT_STATS_INTERVAL);
+	if (stats_interval_ms < 100)
+		stats_interval_ms = 100;
+	hw_encoder = obs_data_get_string(settings, OPT_HW_ENCODER);
+	opus_params.ptime = (int)obs_data_get_int(settings, OPT_OPUS_PTIME);
+	if (opus_params.ptime != 10 && opus_params.ptime != 40 &&
+	    opus_params.ptime != 60)
+		opus_params.ptime = 20;
+	opus_params.fec = obs_data_get_bool(settings, OPT_OPUS_FEC);
+	opus_params.dtx = obs_data_get_bool(settings, OPT_OPUS_DTX);
+	opus_params.cbr = obs_data_get_bool(settings, OPT_OPUS_CBR);
+	opus_params.red = obs_data_get_bool(settings, OPT_OPUS_RED);
+	header_extensions.clear();
+	for (const auto &extension : kHeaderExtensions)
+		header_extensions[extension.second] =
+			obs_data_get_bool(settings, extension.first);
+	obs_data_release(settings);
+	if (!fanout && !encoded) {
+		factory = shared_factory->GetFactory(encoded, hw_encoder);
+		setVideoConversion(output, nv12_passthrough);
+	}
+
 	info("Video codec: %s",
 	     video_codec.empty() ? "Automatic" : video_codec.c_str());
 	info("Simulcast: %s", simulcast ? "true" : "false");
+	if (simulcast)
+		loadSimulcastLayers(service);
+	obs_data_t *service_settings = obs_service_get_settings(service);
+	scalability_mode =
+		obs_data_get_string(service_settings, "scalability_mode");
+	obs_data_release(service_settings);
+	info("NV12 passthrough: %s", nv12_passthrough ? "true" : "false");
+	info("Opus: ptime %d ms, FEC %s, DTX %s, %s, RED %s", opus_params.ptime,
+	     opus_params.fec ? "on" : "off", opus_params.dtx ? "on" : "off",
+	     opus_params.cbr ? "CBR" : "VBR", opus_params.red ? "on" : "off");
+	std::string offered;
+	for (const auto &extension : header_extensions)
+		if (extension.second)
+			offered += "\n  " + extension.first;
+	info("RTP header extensions:%s",
+	     offered.empty() ? " none" : offered.c_str());
+	if (!encoded)
+		info("Hardware encoder: %s", hw_encoder.c_str());
 	info("Publish API URL: %s", publishApiUrl.c_str());
 	info("Protocol:    %s",
 	     protocol.empty() ? "Automatic" : protocol.c_str());
@@ -224,7 +341,7 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 		obs_output_set_last_error(
 			output,
 			"Your service settings are not complete. Open the settings => stream window and complete them.");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
+		signalStop(OBS_OUTPUT_CONNECT_FAILED);
 		return false;
 	}
 
@@ -241,49 +358,88 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	obs_encoder_t *vencoder = obs_output_get_video_encoder(context);
 	obs_data_t *vsettings = obs_encoder_get_settings(vencoder);
 	video_bitrate = (int)obs_data_get_int(vsettings, "bitrate");
+	if (encoded && obs_data_get_int(vsettings, "bf") > 0)
+		warn("B-frames are enabled on the video encoder, WebRTC receivers do not support them");
 	obs_data_release(vsettings);
 
+	if (encoded) {
+		// Only H.264 encoders can be passed through
+		const char *vcodec = obs_encoder_get_codec(vencoder);
+		if (!vcodec || strcmp(vcodec, "h264") != 0) {
+			obs_output_set_last_error(
+				output,
+				"The selected video encoder does not produce H.264.");
+			signalStop(OBS_OUTPUT_INVALID_STREAM);
+			return false;
+		}
+		if (!video_codec.empty() && video_codec != "h264")
+			warn("Codec %s ignored, the OBS encoder output is sent as h264",
+			     video_codec.c_str());
+		video_codec = "h264";
+		if (simulcast) {
+			// A single OBS encoder can not produce the layers
+			warn("Simulcast is not supported with the OBS encoder output");
+			simulcast = false;
+		}
+		info("Video encoder: %s (passthrough)",
+		     obs_encoder_get_id(vencoder));
+	}
+	setupDynamicBitrate(vencoder);
+
+	// SVC: layers of a single VP9 / AV1 stream
+	if (!scalability_mode.empty()) {
+		if (video_codec != "vp9" && video_codec != "av1") {
+			warn("Scalability mode %s needs the vp9 or av1 codec, ignored",
+			     scalability_mode.c_str());
+			scalability_mode.clear();
+		} else if (simulcast) {
+			warn("Simulcast replaced by scalability mode %s",
+			     scalability_mode.c_str());
+			simulcast = false;
+		}
+	}
+	info("Scalability mode: %s", scalability_mode.empty()
+					     ? "None"
+					     : scalability_mode.c_str());
+
 	struct obs_audio_info audio_info;
 	if (!obs_get_audio_info(&audio_info)) {
 		warn("Failed to load audio settings.  Defaulting to opus.");
-		audio_codec = "opus";
+		audio_layout = AudioChannelLayout::Stereo();
 	} else {
-		// NOTE ALEX: if input # channel > output we should down mix
-		//            if input is > 2 but < 6 we might have a porblem with multiopus.
-		channel_count = (int)(audio_info.speakers);
-		audio_codec = channel_count <= 2 ? "opus" : "multiopus";
+		// Surround goes as 5.1 or 7.1 multiopus (see AudioChannelLayout)
+		audio_layout = AudioChannelLayout::ForSpeakers(
+			audio_info.speakers);
 	}
+	channel_count = (int)audio_layout.channels;
+	audio_codec = audio_layout.codec();
 
 	// Shutdown websocket connection and close Peer Connection (just in case)
-	if (close(false))
+	if (close(false) && !fanout)
 		obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
 
-	webrtc::PeerConnectionInterface::RTCConfiguration config;
-	webrtc::PeerConnectionInterface::IceServer server;
-	server.urls = {"stun:stun.l.google.com:19302"};
-	config.servers.push_back(server);
-	// config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
-	// config.disable_ipv6 = true;
-	// config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
-	config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
-	// config.set_cpu_adaptation(false);
-	// config.set_suspend_below_min_bitrate(false);
+	// Fan-out destinations get the tracks of the fan-out
+	if (!fanout)
+		createTracks();
 
-	webrtc::PeerConnectionDependencies dependencies(this);
-
-	pc = factory->CreatePeerConnection(config, std::move(dependencies));
-
-	if (!pc.get()) {
-		error("Error creating Peer Connection");
-		obs_output_set_last_error(
-			output,
-			"There was an error connecting to the server. Are you connected to the internet?");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
+	if (!connectSession()) {
+		signalStop(OBS_OUTPUT_CONNECT_FAILED);
 		return false;
-	} else {
-		info("PEER CONNECTION CREATED\n");
 	}
+	return true;
+}
+
+void WebRTCStream::createTracks()
+{
+	createAudioTrack();
+
+	video_track = factory->CreateVideoTrack("video", videoCapturer);
+	// pc->AddTrack(video_track, {"obs"});
+	stream->AddTrack(video_track);
+}
 
+void WebRTCStream::createAudioTrack()
+{
 	cricket::AudioOptions options;
 	options.echo_cancellation.emplace(false); // default: true
 	options.auto_gain_control.emplace(false); // default: true
@@ -298,58 +454,159 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	options.residual_echo_detector.emplace(false); // default: true
 	// options.tx_agc_limiter.emplace(false);
 
+	// The tracks are kept across reconnections
 	stream = factory->CreateLocalMediaStream("obs");
 
 	audio_source = obsWebrtcAudioSource::Create(&options);
 	audio_track = factory->CreateAudioTrack("audio", audio_source);
 	// pc->AddTrack(audio_track, {"obs"});
 	stream->AddTrack(audio_track);
+}
 
-	video_track = factory->CreateVideoTrack("video", videoCapturer);
-	// pc->AddTrack(video_track, {"obs"});
+void WebRTCStream::shareMedia(WebRTCStream *source)
+{
+	// Same frames, same video track: the peer connections of the fan-out
+	// share the encoders of the video layers. The audio source is per
+	// destination, each one sends the channel layout its answer accepts
+	createAudioTrack();
+	videoCapturer = source->videoCapturer;
+	video_track = source->video_track;
 	stream->AddTrack(video_track);
+}
+
+void WebRTCStream::setDestination(const std::string &url,
+				  const std::string &token)
+{
+	destination_url = url;
+	destination_token = token;
+}
+
+void WebRTCStream::signalStop(int code)
+{
+	if (fanout)
+		// Only this destination stops, the fan-out decides for the output
+		fanout->onDestinationStopped(this, code);
+	else
+		obs_output_signal_stop(output, code);
+}
+
+bool WebRTCStream::connectSession()
+{
+	ice_restarting = false;
+	ice_restart_attempts = 0;
+
+	webrtc::PeerConnectionInterface::RTCConfiguration config;
+	webrtc::PeerConnectionInterface::IceServer server;
+	server.urls = {"stun:stun.l.google.com:19302"};
+	config.servers.push_back(server);
+	// config.bundle_policy = webrtc::PeerConnectionInterface::kBundlePolicyMaxBundle;
+	// config.disable_ipv6 = true;
+	// config.rtcp_mux_policy = webrtc::PeerConnectionInterface::kRtcpMuxPolicyRequire;
+	config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+	// config.set_cpu_adaptation(false);
+	// config.set_suspend_below_min_bitrate(false);
+
+	webrtc::PeerConnectionDependencies dependencies(this);
+
+	rtc::scoped_refptr<webrtc::PeerConnectionInterface> peer =
+		factory->CreatePeerConnection(config, std::move(dependencies));
+
+	if (!peer.get()) {
+		error("Error creating Peer Connection");
+		obs_output_set_last_error(
+			output,
+			"There was an error connecting to the server. Are you connected to the internet?");
+		return false;
+	} else {
+		info("PEER CONNECTION CREATED\n");
+	}
+
+	// Sample stats in the background from now on
+	uint64_t generation;
+	{
+		webrtc::MutexLock lock(&crit_);
+		// Stopped while the peer connection was created
+		if (stopped) {
+			peer->Close();
+			return false;
+		}
+		pc = peer;
+		generation = ++stats_generation;
+	}
+	scheduleStats(generation);
 
 	//Add audio track
 	webrtc::RtpTransceiverInit audio_init;
 	audio_init.stream_ids.push_back(stream->id());
 	audio_init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
-	pc->AddTransceiver(audio_track, audio_init);
-
-	bool simulcast = false;
+	auto audio_transceiver = peer->AddTransceiver(audio_track, audio_init);
+	if (audio_transceiver.ok()) {
+		setHeaderExtensions(audio_transceiver.value());
+		// Same bitrate as the SDP, packet time from the SDP only
+		auto sender = audio_transceiver.value()->sender();
+		webrtc::RtpParameters parameters = sender->GetParameters();
+		for (auto &encoding : parameters.encodings) {
+			encoding.max_bitrate_bps = audio_bitrate * 1000;
+			encoding.adaptive_ptime = false;
+		}
+		sender->SetParameters(parameters);
+	}
 
 	//Add video track
 	webrtc::RtpTransceiverInit video_init;
 	video_init.stream_ids.push_back(stream->id());
 	video_init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
 	if (simulcast) {
-		webrtc::RtpEncodingParameters large;
-		webrtc::RtpEncodingParameters medium;
-		webrtc::RtpEncodingParameters small;
-		large.rid = "L";
-		large.scale_resolution_down_by = 1;
-		medium.rid = "M";
-		medium.scale_resolution_down_by = 2;
-		small.rid = "S";
-		small.scale_resolution_down_by = 4;
 		//In reverse order so large is dropped first on low network condition
-		video_init.send_encodings.push_back(small);
-		video_init.send_encodings.push_back(medium);
-		video_init.send_encodings.push_back(large);
+		for (auto it = simulcast_layers.rbegin();
+		     it != simulcast_layers.rend(); ++it) {
+			webrtc::RtpEncodingParameters encoding;
+			encoding.rid = it->rid;
+			encoding.scale_resolution_down_by =
+				it->scale_resolution_down_by;
+			if (it->max_bitrate_bps > 0)
+				encoding.max_bitrate_bps = it->max_bitrate_bps;
+			if (it->max_framerate > 0.0)
+				encoding.max_framerate = it->max_framerate;
+			video_init.send_encodings.push_back(encoding);
+		}
+	} else if (!scalability_mode.empty()) {
+		webrtc::RtpEncodingParameters encoding;
+		encoding.scalability_mode = scalability_mode;
+		video_init.send_encodings.push_back(encoding);
+	}
+	auto video_transceiver = peer->AddTransceiver(video_track, video_init);
+	if (video_transceiver.ok())
+		setHeaderExtensions(video_transceiver.value());
+
+	if (encoded && video_transceiver.ok()) {
+		// Encoded frames can be neither scaled nor dropped by libwebrtc
+		auto sender = video_transceiver.value()->sender();
+		webrtc::RtpParameters parameters = sender->GetParameters();
+		parameters.degradation_preference =
+			webrtc::DegradationPreference::DISABLED;
+		sender->SetParameters(parameters);
 	}
-	pc->AddTransceiver(video_track, video_init);
 
-	client = createWebsocketClient(type);
-	if (!client) {
+	WebsocketClient *session_client = createWebsocketClient(type);
+	if (!session_client) {
 		warn("Error creating Websocket client");
 		// Close Peer Connection
-		close(false);
-		// Disconnect, this will call stop on main thread
+		closeSession(false);
 		obs_output_set_last_error(
 			output,
 			"There was a problem creating the websocket connection.  Are you behind a firewall?");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
 		return false;
 	}
+	{
+		webrtc::MutexLock lock(&crit_);
+		// Stopped meanwhile, the peer connection is closed already
+		if (stopped) {
+			delete session_client;
+			return false;
+		}
+		client = session_client;
+	}
 
 	// Extra logging
 
@@ -361,19 +618,51 @@ bool WebRTCStream::start(WebRTCStream::Type type)
 	info("CONNECTING TO %s", url.c_str());
 
 	// Connect to the signalling server
-	if (!client->connect(url, room, username, password, this)) {
+	if (!session_client->connect(url, room, username, password, this)) {
 		warn("Error connecting to server");
 		// Shutdown websocket connection and close Peer Connection
-		close(false);
-		// Disconnect, this will call stop on main thread
+		closeSession(false);
 		obs_output_set_last_error(
 			output, "There was a problem connecting to your room.");
-		obs_output_signal_stop(output, OBS_OUTPUT_CONNECT_FAILED);
 		return false;
 	}
 	return true;
 }
 
+void WebRTCStream::loadSimulcastLayers(obs_service_t *service)
+{
+	static const char *rids[] = {"L", "M", "S"};
+	const int max_layers = sizeof(rids) / sizeof(rids[0]);
+
+	obs_data_t *settings = obs_service_get_settings(service);
+	int count = (int)obs_data_get_int(settings, "simulcast_layers");
+	if (count < 2 || count > max_layers)
+		count = max_layers;
+
+	simulcast_layers.clear();
+	for (int i = 0; i < count; i++) {
+		SimulcastLayer layer;
+		std::string prefix = "simulcast_layer" + std::to_string(i);
+		layer.rid = rids[i];
+		layer.scale_resolution_down_by = obs_data_get_double(
+			settings, (prefix + "_scale").c_str());
+		// Unset or invalid: same defaults as the service, 1, 2, 4
+		if (layer.scale_resolution_down_by < 1.0)
+			layer.scale_resolution_down_by = (double)(1 << i);
+		layer.max_bitrate_bps =
+			(int)obs_data_get_int(settings,
+					      (prefix + "_bitrate").c_str()) *
+			1000;
+		layer.max_framerate = (double)obs_data_get_int(
+			settings, (prefix + "_framerate").c_str());
+		info("Simulcast layer %s: scale %.2f, max bitrate %d kbps, max framerate %.0f",
+		     layer.rid.c_str(), layer.scale_resolution_down_by,
+		     layer.max_bitrate_bps / 1000, layer.max_framerate);
+		simulcast_layers.push_back(layer);
+	}
+	obs_data_release(settings);
+}
+
 void WebRTCStream::onConnected()
 {
 	info("WebRTCStream::onConnected");
@@ -383,7 +672,7 @@ void WebRTCStream::onLogged(int /* code */)
 {
 	info("WebRTCStream::onLogged\nCreating offer...");
 	webrtc::PeerConnectionInterface::RTCOfferAnswerOptions offer_options;
-	offer_options.voice_activity_detection = false;
+	offer_options.voice_activity_detection = opus_params.dtx;
 	pc->CreateOffer(this, offer_options);
 }
 
@@ -400,33 +689,74 @@ void WebRTCStream::OnSuccess(webrtc::SessionDescriptionInterface *desc)
 	info("Video bitrate:    %d\n", video_bitrate);
 	info("OFFER:\n\n%s\n", sdp.c_str());
 
-	std::string sdpCopy = sdp;
+	if (ice_restarting) {
+		// Same media, only the ICE credentials are sent
+		pc->SetLocalDescription(this, desc);
+		if (!client->restartIce(sdp)) {
+			ice_restarting = false;
+			warn("ICE restart not supported by the signaling");
+			if (reconnectOnFailure())
+				return;
+			close(false);
+			signalStop(OBS_OUTPUT_ERROR);
+		}
+		return;
+	}
+
+	SDPModif offerModif(sdp);
 	std::vector<int> audio_payloads;
 	std::vector<int> video_payloads;
 	// If codec setting is Automatic, set it to h264 by default
 	if (video_codec.empty()) {
 		video_codec = "h264"; // h264 must be in lowercase (Firefox)
 	}
-	// Force specific video/audio payload
-	SDPModif::forcePayload(sdpCopy, audio_payloads, video_payloads,
-			       // the packaging mode needs to be 1
-			       audio_codec, video_codec, 1, "42e01f", 0);
+	// libwebrtc names AV1 "AV1X" until its RTP format is final
+	std::string sdp_video_codec = video_codec;
+	if (video_codec == "av1" &&
+	    sdp.find(" AV1X/90000") != std::string::npos)
+		sdp_video_codec = "AV1X";
+	// Force specific video/audio payload. Surround keeps stereo opus for
+	// the receivers without multiopus
+	offerModif.forcePayload(audio_payloads, video_payloads,
+				audio_layout.surround()
+					? "multiopus,opus"
+					: (opus_params.red ? "opus,red"
+							   : audio_codec),
+				// the packaging mode needs to be 1
+				sdp_video_codec, 1, "42e01f", 0);
 	// Constrain video bitrate
-	SDPModif::bitrateMaxMinSDP(sdpCopy, video_bitrate, video_payloads);
+	offerModif.bitrateMaxMin(video_bitrate, video_payloads);
 	// Enable stereo & constrain audio bitrate
-	// NOTE ALEX: check that it does not incorrectly detect multiopus as opus
-	SDPModif::stereoSDP(sdpCopy, audio_bitrate);
-	// NOTE ALEX: nothing special to do about multiopus with CoSMo libwebrtc package.
+	offerModif.stereo(audio_bitrate);
+	// Channel mapping of the surround layout, the previous session may
+	// have fallen back to stereo
+	if (audio_source)
+		audio_source->SetChannels(audio_layout.channels);
+	if (audio_layout.surround() &&
+	    !offerModif.surround(audio_layout.channels,
+				 audio_layout.num_streams,
+				 audio_layout.coupled_streams,
+				 audio_layout.channel_mapping, audio_bitrate)) {
+		warn("No multiopus codec for %zu channels, sending stereo",
+		     audio_layout.channels);
+		if (audio_source)
+			audio_source->SetChannels(2);
+	}
+	// ptime, FEC, DTX, CBR and RED
+	offerModif.opus(opus_params);
+	std::string offer = offerModif.toString();
 
 	info("SETTING LOCAL DESCRIPTION\n\n");
 	pc->SetLocalDescription(this, desc);
 
-	info("Sending OFFER (SDP) to remote peer:\n\n%s", sdpCopy.c_str());
-	if (!client->open(sdpCopy, video_codec, audio_codec, username)) {
+	info("Sending OFFER (SDP) to remote peer:\n\n%s", offer.c_str());
+	if (!client->open(offer, video_codec, audio_codec, username)) {
+		if (reconnectOnFailure())
+			return;
 		// Shutdown websocket connection and close Peer Connection
 		close(false);
 		// Disconnect, this will call stop on main thread
-		obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+		signalStop(OBS_OUTPUT_ERROR);
 	}
 }
 
@@ -438,14 +768,18 @@ void WebRTCStream::OnSuccess()
 void WebRTCStream::OnFailure(webrtc::RTCError error)
 {
 	warn("WebRTCStream::OnFailure [%s]", error.message());
+	if (reconnectOnFailure())
+		return;
 	// Shutdown websocket connection and close Peer Connection
 	close(false);
 	// Disconnect, this will call stop on main thread
-	obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+	signalStop(OBS_OUTPUT_ERROR);
 }
 
 void WebRTCStream::OnIceCandidate(const webrtc::IceCandidateInterface *candidate)
 {
+	if (!client)
+		return;
 	std::string str;
 	candidate->ToString(&str);
 	// Send candidate to remote peer
@@ -453,6 +787,14 @@ void WebRTCStream::OnIceCandidate(const webrtc::IceCandidateInterface *candidate
 			false);
 }
 
+void WebRTCStream::OnIceGatheringChange(
+	webrtc::PeerConnectionInterface::IceGatheringState state)
+{
+	if (client &&
+	    state == webrtc::PeerConnectionInterface::kIceGatheringComplete)
+		client->trickle("", 0, "", true);
+}
+
 void WebRTCStream::OnIceConnectionChange(
 	webrtc::PeerConnectionInterface::IceConnectionState
 		state /* new_state */)
@@ -461,14 +803,34 @@ void WebRTCStream::OnIceConnectionChange(
 	info("WebRTCStream::OnIceConnectionChange [%u]", state);
 
 	switch (state) {
+	case PeerConnectionInterface::IceConnectionState::kIceConnectionConnected:
+	case PeerConnectionInterface::IceConnectionState::kIceConnectionCompleted:
+		ice_restart_attempts = 0;
+		break;
+	case PeerConnectionInterface::IceConnectionState::
+		kIceConnectionDisconnected: {
+		// Give the connection a chance to recover by itself (e.g.
+		// consent freshness glitch) before restarting ICE
+		uint64_t generation;
+		{
+			webrtc::MutexLock lock(&crit_);
+			generation = stats_generation;
+		}
+		scheduleIceRestart(generation);
+		break;
+	}
 	case PeerConnectionInterface::IceConnectionState::kIceConnectionFailed: {
+		// A network change: new candidates on the same session, or a
+		// new session once the restarts are exhausted
+		if (restartIce() || reconnectOnFailure())
+			break;
 		// Close must be carried out on a separate thread in order to avoid deadlock
 		auto thread = std::thread([=]() {
 			obs_output_set_last_error(
 				output,
 				"We found your room, but streaming failed. Are you behind a firewall?\n\n");
 			// Disconnect, this will call stop on main thread
-			obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+			signalStop(OBS_OUTPUT_ERROR);
 		});
 		thread.detach();
 		break;
@@ -485,14 +847,26 @@ void WebRTCStream::OnConnectionChange(
 	info("WebRTCStream::OnConnectionChange [%u]", state);
 
 	switch (state) {
+	case PeerConnectionInterface::PeerConnectionState::kConnected:
+		if (reconnecting) {
+			reconnecting = false;
+			reconnects++;
+			last_reconnect_ms = rtc::TimeMillis() - reconnect_start_ms;
+			info("Reconnected in %lld ms after %d attempt(s)",
+			     (long long)last_reconnect_ms, reconnect_attempts);
+		}
+		break;
 	case PeerConnectionInterface::PeerConnectionState::kFailed: {
+		// Follows the ICE failure, unless ICE is being restarted
+		if (ice_restarting || reconnectOnFailure())
+			break;
 
 		// Close must be carried out on a separate thread in order to avoid deadlock
 		auto thread = std::thread([=]() {
 			obs_output_set_last_error(output,
 						  "Connection failure\n\n");
 			// Disconnect, this will call stop on main thread
-			obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+			signalStop(OBS_OUTPUT_ERROR);
 		});
 		//Detach
 		thread.detach();
@@ -503,6 +877,175 @@ void WebRTCStream::OnConnectionChange(
 	}
 }
 
+bool WebRTCStream::restartIce()
+{
+	if (ice_restarting)
+		return true;
+	if (!pc || ice_restart_attempts >= kMaxIceRestarts)
+		return false;
+	ice_restarting = true;
+	ice_restart_attempts++;
+	info("WebRTCStream::restartIce [attempt %d]", ice_restart_attempts);
+	webrtc::PeerConnectionInterface::RTCOfferAnswerOptions offer_options;
+	offer_options.voice_activity_detection = opus_params.dtx;
+	offer_options.ice_restart = true;
+	pc->CreateOffer(this, offer_options);
+	return true;
+}
+
+void WebRTCStream::scheduleIceRestart(uint64_t generation)
+{
+	signaling->PostDelayedTask(
+		webrtc::ToQueuedTask(task_safety, [this, generation]() {
+			{
+				webrtc::MutexLock lock(&crit_);
+				if (generation != stats_generation)
+					return;
+			}
+			if (pc && pc->ice_connection_state() ==
+					  webrtc::PeerConnectionInterface::
+						  kIceConnectionDisconnected)
+				restartIce();
+		}),
+		kIceRestartDelayMs);
+}
+
+void WebRTCStream::onIceRestarted(const std::string &sdp)
+{
+	// Called from the signaling client thread
+	uint64_t generation;
+	{
+		webrtc::MutexLock lock(&crit_);
+		generation = stats_generation;
+	}
+	signaling->PostTask(webrtc::ToQueuedTask(task_safety, [this, generation, sdp]() {
+		{
+			webrtc::MutexLock lock(&crit_);
+			if (generation != stats_generation || !pc)
+				return;
+		}
+		info("WebRTCStream::onIceRestarted");
+		ice_restarting = false;
+		setAnswer(sdp);
+	}));
+}
+
+void WebRTCStream::onIceRestartError(int code)
+{
+	info("WebRTCStream::onIceRestartError [code: %d]", code);
+	if (reconnectOnFailure())
+		return;
+	// Close must be carried out on a separate thread in order to avoid
+	// deadlock (the signaling client joins the thread calling us)
+	auto thread = std::thread([=]() {
+		obs_output_set_last_error(output, "Connection failure\n\n");
+		// Disconnect, this will call stop on main thread
+		signalStop(OBS_OUTPUT_ERROR);
+	});
+	thread.detach();
+}
+
+bool WebRTCStream::reconnectOnFailure()
+{
+	if (!capturing)
+		return false;
+	// Called from the signaling client threads as well, which the
+	// teardown joins: always go through the signaling thread
+	uint64_t generation;
+	{
+		webrtc::MutexLock lock(&crit_);
+		generation = stats_generation;
+	}
+	signaling->PostTask(webrtc::ToQueuedTask(
+		task_safety,
+		[this, generation]() { beginReconnect(generation); }));
+	return true;
+}
+
+void WebRTCStream::beginReconnect(uint64_t generation)
+{
+	{
+		// Stopped, or an other failure of the same session came first
+		webrtc::MutexLock lock(&crit_);
+		if (generation != stats_generation || !pc)
+			return;
+	}
+	if (!reconnecting) {
+		warn("Connection lost, reconnecting");
+		reconnecting = true;
+		reconnect_attempts = 0;
+		reconnect_start_ms = rtc::TimeMillis();
+	}
+	// The counters of the next peer connection start from 0
+	reconnect_bytes_sent =
+		std::atomic_load(&stats_snapshot)->total_bytes_sent;
+	closeSession(false);
+	previous_frames_sent = 0;
+	previous_audio_bytes = 0;
+	previous_layer_bytes.clear();
+	previous_layer_timestamp_us = 0;
+	congestion_estimator.Reset();
+	// The estimate of the next peer connection ramps up again
+	dynamic_bitrate.Restart(rtc::TimeMillis());
+	scheduleReconnect();
+}
+
+void WebRTCStream::scheduleReconnect()
+{
+	if (reconnect_attempts >= kMaxReconnectAttempts) {
+		warn("Reconnection failed after %d attempts",
+		     reconnect_attempts);
+		reconnecting = false;
+		// Close must be carried out on a separate thread in order to avoid deadlock
+		auto thread = std::thread([=]() {
+			obs_output_set_last_error(output,
+						  "Connection failure\n\n");
+			// Disconnect, this will call stop on main thread
+			signalStop(OBS_OUTPUT_DISCONNECTED);
+		});
+		thread.detach();
+		return;
+	}
+	int delay = kReconnectBaseDelayMs << reconnect_attempts;
+	if (delay > kReconnectMaxDelayMs)
+		delay = kReconnectMaxDelayMs;
+	reconnect_attempts++;
+	uint64_t generation;
+	{
+		webrtc::MutexLock lock(&crit_);
+		generation = stats_generation;
+	}
+	info("Reconnecting in %d ms [attempt %d/%d]", delay,
+	     reconnect_attempts, kMaxReconnectAttempts);
+	signaling->PostDelayedTask(
+		webrtc::ToQueuedTask(
+			task_safety,
+			[this, generation]() { reconnect(generation); }),
+		delay);
+}
+
+void WebRTCStream::reconnect(uint64_t generation)
+{
+	{
+		// Stopped while waiting
+		webrtc::MutexLock lock(&crit_);
+		if (generation != stats_generation || stopped)
+			return;
+	}
+	info("WebRTCStream::reconnect");
+	// Same factory, threads and tracks: only the peer connection and
+	// the signaling session are rebuilt
+	if (connectSession())
+		return;
+	{
+		// Stopped while connecting, nothing to retry
+		webrtc::MutexLock lock(&crit_);
+		if (stopped)
+			return;
+	}
+	scheduleReconnect();
+}
+
 void WebRTCStream::onRemoteIceCandidate(const std::string &sdpData)
 {
 	if (sdpData.empty()) {
@@ -533,12 +1076,57 @@ void WebRTCStream::onOpened(const std::string &sdp)
 {
 	info("ANSWER:\n\n%s\n", sdp.c_str());
 
-	std::string sdpCopy = sdp;
+	setAnswer(sdp);
 
+	// Reconnection: the media never stopped
+	if (capturing)
+		return;
+
+	// No audio conversion: the OBS audio (planar float, OBS sample rate)
+	// is chunked and converted in a single pass by obsWebrtcAudioSource
+	if (encoded) {
+		// Encoded outputs only carry video, get audio directly
+		webrtc::MutexLock lock(&crit_);
+		audio_connected = audio_output_connect(obs_get_audio(), 0,
+						       nullptr, onRawAudio,
+						       this);
+		if (!audio_connected)
+			warn("Failed to connect to the OBS audio output");
+	}
+
+	info("Begin data capture...");
+	if (fanout)
+		fanout->onDestinationOpened(this);
+	else
+		obs_output_begin_data_capture(output, 0);
+	capturing = true;
+}
+
+void WebRTCStream::setAnswer(const std::string &sdp)
+{
+	SDPModif answerModif(sdp);
 	// Constrain video bitrate
-	SDPModif::bitrateSDP(sdpCopy, video_bitrate);
+	answerModif.bitrate(video_bitrate);
 	// Enable stereo & constrain audio bitrate
-	SDPModif::stereoSDP(sdpCopy, audio_bitrate);
+	answerModif.stereo(audio_bitrate);
+	if (audio_layout.surround()) {
+		if (SDPModif::caseInsensitiveStringCompare(
+			    answerModif.audioCodec(), "multiopus")) {
+			// Same stream layout as the offer, whatever the
+			// receiver echoed
+			answerModif.surround(audio_layout.channels,
+					     audio_layout.num_streams,
+					     audio_layout.coupled_streams,
+					     audio_layout.channel_mapping,
+					     audio_bitrate);
+		} else if (audio_source) {
+			info("Receiver does not accept multiopus, downmixing to stereo");
+			audio_source->SetChannels(2);
+		}
+	}
+	// The send side encodes with the parameters of the answer
+	answerModif.opus(opus_params);
+	std::string sdpCopy = answerModif.toString();
 
 	// SetRemoteDescription observer
 	srd_observer = make_scoped_refptr(this);
@@ -551,16 +1139,6 @@ void WebRTCStream::onOpened(const std::string &sdp)
 
 	info("SETTING REMOTE DESCRIPTION\n\n%s", sdpCopy.c_str());
 	pc->SetRemoteDescription(std::move(answer), srd_observer);
-
-	// Set audio conversion info
-	audio_convert_info conversion;
-	conversion.format = AUDIO_FORMAT_16BIT;
-	conversion.samples_per_sec = 48000;
-	conversion.speakers = (speaker_layout)channel_count;
-	obs_output_set_audio_conversion(output, &conversion);
-
-	info("Begin data capture...");
-	obs_output_begin_data_capture(output, 0);
 }
 
 void WebRTCStream::OnSetRemoteDescriptionComplete(webrtc::RTCError error)
@@ -571,36 +1149,108 @@ void WebRTCStream::OnSetRemoteDescriptionComplete(webrtc::RTCError error)
 		warn("Error setting Remote Description: %s\n", error.message());
 }
 
+void WebRTCStream::onRawAudio(void *param, size_t /* mix_idx */,
+			      struct audio_data *frame)
+{
+	WebRTCStream *stream = (WebRTCStream *)param;
+	stream->onAudioFrame(frame);
+}
+
+void WebRTCStream::disconnectAudio()
+{
+	// The audio callback does not take the lock
+	webrtc::MutexLock lock(&crit_);
+	if (!audio_connected)
+		return;
+	audio_output_disconnect(obs_get_audio(), 0, onRawAudio, this);
+	audio_connected = false;
+}
+
 bool WebRTCStream::close(bool wait)
 {
-	if (!pc.get())
-		return false;
-	// Get pointer
-	auto old = pc.release();
+	disconnectAudio();
+	return closeSession(wait);
+}
+
+bool WebRTCStream::closeSession(bool wait)
+{
+	rtc::scoped_refptr<webrtc::PeerConnectionInterface> old;
+	WebsocketClient *old_client;
+	{
+		// Stop the stats sampler and cancel pending reconnections
+		webrtc::MutexLock lock(&crit_);
+		stats_generation++;
+		old_client = client;
+		client = nullptr;
+		// Released once closed, when going out of scope
+		old.swap(pc);
+	}
 	// Close Peer Connection
-	old->Close();
+	if (old)
+		old->Close();
 	// Shutdown websocket connection
-	if (client) {
-		client->disconnect(wait);
-		delete (client);
-		client = nullptr;
+	if (old_client) {
+		old_client->disconnect(wait);
+		delete (old_client);
 	}
-	return true;
+	return old != nullptr;
 }
 
 bool WebRTCStream::stop()
 {
 	info("WebRTCStream::stop");
+	capturing = false;
+	{
+		webrtc::MutexLock lock(&crit_);
+		stopped = true;
+	}
 	// Shutdown websocket connection and close Peer Connection
 	close(true);
-	// Disconnect, this will call stop on main thread
-	obs_output_end_data_capture(output);
+	// Back to the configured bitrate, the sampler is stopped
+	if (dbr_enabled &&
+	    dynamic_bitrate.bitrate() != dynamic_bitrate.original()) {
+		info("Dynamic bitrate: restoring %ld kbps",
+		     dynamic_bitrate.original());
+		setEncoderBitrate(dynamic_bitrate.original());
+	}
+	// The fan-out ends the data capture once all destinations stopped
+	if (!fanout)
+		obs_output_end_data_capture(output);
 	return true;
 }
 
+void WebRTCStream::setupDynamicBitrate(obs_encoder_t *vencoder)
+{
+	// Raw outputs: the libwebrtc encoders follow the estimate already
+	dbr_enabled = false;
+	if (encoded) {
+		obs_data_t *settings = obs_output_get_settings(output);
+		dbr_enabled = obs_data_get_bool(settings, OPT_DYN_BITRATE);
+		obs_data_release(settings);
+		// Same conditions as rtmp-stream.c
+		if ((obs_encoder_get_caps(vencoder) &
+		     OBS_ENCODER_CAP_DYN_BITRATE) == 0)
+			dbr_enabled = false;
+	}
+	dynamic_bitrate.Reset(video_bitrate, rtc::TimeMillis());
+	if (dbr_enabled)
+		info("Dynamic bitrate: enabled, up to %d kbps", video_bitrate);
+}
+
+void WebRTCStream::setEncoderBitrate(long bitrate)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(output);
+	obs_data_t *settings = obs_encoder_get_settings(vencoder);
+	obs_data_set_int(settings, "bitrate", bitrate);
+	obs_encoder_update(vencoder, settings);
+	obs_data_release(settings);
+}
+
 void WebRTCStream::onDisconnected()
 {
 	info("WebRTCStream::onDisconnected");
+	if (reconnectOnFailure())
+		return;
 
 	// are we done retrying?
 	if (thread_closeAsync.joinable())
@@ -610,39 +1260,118 @@ void WebRTCStream::onDisconnected()
 	thread_closeAsync = std::thread([&]() {
 		close(false);
 		// Disconnect, this will call stop on main thread
-		obs_output_signal_stop(output, OBS_OUTPUT_DISCONNECTED);
+		signalStop(OBS_OUTPUT_DISCONNECTED);
 	});
 }
 
 void WebRTCStream::onLoggedError(int code)
 {
 	info("WebRTCStream::onLoggedError [code: %d]", code);
-	// Shutdown websocket connection and close Peer Connection
-	close(false);
-	// Disconnect, this will call stop on main thread
-	obs_output_set_last_error(
-		output,
-		"We are having trouble connecting to your room. Are you behind a firewall?\n");
-	obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+	if (reconnectOnFailure())
+		return;
+
+	if (thread_closeAsync.joinable())
+		thread_closeAsync.join();
+
+	// Called from the signaling client thread, which the close joins:
+	// shutdown websocket connection and close Peer Connection
+	// asynchronously
+	thread_closeAsync = std::thread([&]() {
+		close(false);
+		// Disconnect, this will call stop on main thread
+		obs_output_set_last_error(
+			output,
+			"We are having trouble connecting to your room. Are you behind a firewall?\n");
+		signalStop(OBS_OUTPUT_ERROR);
+	});
 }
 
 void WebRTCStream::onOpenedError(int code)
 {
 	info("WebRTCStream::onOpenedError [code: %d]", code);
-	// Shutdown websocket connection and close Peer Connection
-	close(false);
-	// Disconnect, this will call stop on main thread
-	obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+	if (reconnectOnFailure())
+		return;
+
+	if (thread_closeAsync.joinable())
+		thread_closeAsync.join();
+
+	// Called from the signaling client thread, which the close joins:
+	// shutdown websocket connection and close Peer Connection
+	// asynchronously
+	thread_closeAsync = std::thread([&]() {
+		close(false);
+		// Disconnect, this will call stop on main thread
+		signalStop(OBS_OUTPUT_ERROR);
+	});
 }
 
 void WebRTCStream::onAudioFrame(audio_data *frame)
 {
-	if (!frame)
+	if (!frame || !audio_source)
 		return;
 	// Push it to the device
 	audio_source->OnAudioData(frame);
 }
 
+void WebRTCStream::setHeaderExtensions(
+	rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver)
+{
+	std::vector<webrtc::RtpHeaderExtensionCapability> extensions =
+		transceiver->HeaderExtensionsToOffer();
+	std::map<std::string, bool> missing = header_extensions;
+	for (auto &extension : extensions) {
+		auto it = header_extensions.find(extension.uri);
+		if (it == header_extensions.end())
+			continue;
+		missing.erase(extension.uri);
+		extension.direction =
+			it->second ? webrtc::RtpTransceiverDirection::kSendRecv
+				   : webrtc::RtpTransceiverDirection::kStopped;
+	}
+
+	webrtc::RTCError result =
+		transceiver->SetOfferedRtpHeaderExtensions(extensions);
+	if (!result.ok()) {
+		warn("Failed to set the RTP header extensions of the %s "
+		     "transceiver: %s",
+		     cricket::MediaTypeToString(transceiver->media_type())
+			     .c_str(),
+		     result.message());
+		return;
+	}
+
+	// Extensions of the other media kind are expected to be missing
+	if (transceiver->media_type() != cricket::MEDIA_TYPE_VIDEO)
+		return;
+	for (const auto &extension : missing)
+		if (extension.second)
+			warn("RTP header extension %s not supported",
+			     extension.first.c_str());
+}
+
+void WebRTCStream::setVideoConversion(obs_output_t *output, bool nv12)
+{
+	const struct video_output_info *voi =
+		video_output_get_info(obs_output_video(output));
+
+	// Same color space and range as the OBS video: when the OBS output
+	// format is already the requested one, the frames come straight from
+	// the GPU conversion without any video-io scaler
+	struct video_scale_info conversion = {};
+	conversion.format = nv12 ? VIDEO_FORMAT_NV12 : VIDEO_FORMAT_I420;
+	conversion.colorspace = voi ? voi->colorspace : VIDEO_CS_DEFAULT;
+	conversion.range = voi ? voi->range : VIDEO_RANGE_DEFAULT;
+	// Width and height of the output (rescaled or not) when 0
+	obs_output_set_video_conversion(output, &conversion);
+
+	if (voi && voi->format != conversion.format)
+		info("Video: %s frames converted to %s by video-io, set the "
+		     "OBS color format to %s to get them from the GPU",
+		     get_video_format_name(voi->format),
+		     get_video_format_name(conversion.format),
+		     get_video_format_name(conversion.format));
+}
+
 void WebRTCStream::onVideoFrame(video_data *frame)
 {
 	if (!frame)
@@ -655,34 +1384,41 @@ void WebRTCStream::onVideoFrame(video_data *frame)
 		// First frame sent: Initialize previous_time
 		previous_time = std::chrono::system_clock::now();
 
-	// Calculate size
+	// frame->timestamp is the OBS video tick that rendered the frame
+	const uint16_t id = ++frame_ids;
+	latency_tracer->Delivered(id, frame->timestamp);
+
 	int outputWidth = obs_output_get_width(output);
 	int outputHeight = obs_output_get_height(output);
-	auto videoType = webrtc::VideoType::kNV12;
-	uint32_t size = outputWidth * outputHeight * 3 / 2;
 
-	int stride_y = outputWidth;
-	int stride_uv = (outputWidth + 1) / 2;
-	int target_width = abs(outputWidth);
-	int target_height = abs(outputHeight);
-
-	// Convert frame
-	rtc::scoped_refptr<webrtc::I420Buffer> buffer =
-		webrtc::I420Buffer::Create(target_width, target_height,
-					   stride_y, stride_uv, stride_uv);
-
-	libyuv::RotationMode rotation_mode = libyuv::kRotate0;
-
-	const int conversionResult = libyuv::ConvertToI420(
-		frame->data[0], size, buffer.get()->MutableDataY(),
-		buffer.get()->StrideY(), buffer.get()->MutableDataU(),
-		buffer.get()->StrideU(), buffer.get()->MutableDataV(),
-		buffer.get()->StrideV(), 0, 0, outputWidth, outputHeight,
-		target_width, target_height, rotation_mode,
-		ConvertVideoType(videoType));
-
-	// not using the result yet, silence compiler
-	(void)conversionResult;
+	// Get a recycled buffer instead of allocating one per frame
+	rtc::scoped_refptr<webrtc::VideoFrameBuffer> buffer;
+	if (nv12_passthrough) {
+		// Keep NV12, encoders that only take I420 convert on their
+		// own queue through ToI420()
+		rtc::scoped_refptr<NV12VideoFrameBuffer> nv12 =
+			buffer_pool->CreateNV12Buffer(outputWidth,
+						      outputHeight);
+		nv12->CopyFrom(frame->data[0], (int)frame->linesize[0],
+			       frame->data[1], (int)frame->linesize[1]);
+		buffer = nv12;
+	} else {
+		// Already I420 (see setVideoConversion), the planes are only
+		// valid during this call and are encoded on another thread,
+		// so they are copied as-is
+		rtc::scoped_refptr<webrtc::I420Buffer> i420 =
+			buffer_pool->CreateI420Buffer(outputWidth,
+						      outputHeight);
+		libyuv::I420Copy(frame->data[0], (int)frame->linesize[0],
+				 frame->data[1], (int)frame->linesize[1],
+				 frame->data[2], (int)frame->linesize[2],
+				 i420->MutableDataY(), i420->StrideY(),
+				 i420->MutableDataU(), i420->StrideU(),
+				 i420->MutableDataV(), i420->StrideV(),
+				 outputWidth, outputHeight);
+		buffer = i420;
+	}
+	latency_tracer->Mark(id, WEBRTC_LATENCY_CONVERTED);
 
 	const int64_t obs_timestamp_us =
 		(int64_t)frame->timestamp / rtc::kNumNanosecsPerMicrosec;
@@ -698,36 +1434,384 @@ void WebRTCStream::onVideoFrame(video_data *frame)
 			.set_video_frame_buffer(buffer)
 			.set_rotation(webrtc::kVideoRotation_0)
 			.set_timestamp_us(aligned_timestamp_us)
-			.set_id(++frame_id)
+			.set_id(id)
 			.build();
 
 	// Send frame to video capturer
 	videoCapturer->OnFrameCaptured(video_frame);
 }
 
+void WebRTCStream::onEncodedPacket(encoder_packet *packet)
+{
+	if (!packet || packet->type != OBS_ENCODER_VIDEO)
+		return;
+	if (!videoCapturer)
+		return;
+
+	if (std::chrono::system_clock::time_point(
+		    std::chrono::duration<int>(0)) == previous_time)
+		// First frame sent: Initialize previous_time
+		previous_time = std::chrono::system_clock::now();
+
+	// No tick time for encoded packets, the system time of their dts is
+	// the closest
+	const uint16_t id = ++frame_ids;
+	latency_tracer->Delivered(id, (uint64_t)packet->sys_dts_usec * 1000);
+
+	// SPS/PPS, prepended to key frames
+	uint8_t *header = nullptr;
+	size_t header_size = 0;
+	if (packet->keyframe)
+		obs_encoder_get_extra_data(packet->encoder, &header,
+					   &header_size);
+
+	rtc::scoped_refptr<EncodedFrameBuffer> buffer =
+		EncodedFrameBuffer::Create(
+			packet, header, header_size,
+			(int)obs_encoder_get_width(packet->encoder),
+			(int)obs_encoder_get_height(packet->encoder));
+
+	const int64_t obs_timestamp_us =
+		packet->pts * rtc::kNumMicrosecsPerSec * packet->timebase_num /
+		packet->timebase_den;
+
+	// Align timestamps from OBS encoder with rtc::TimeMicros timebase
+	const int64_t aligned_timestamp_us =
+		timestamp_aligner_.TranslateTimestamp(obs_timestamp_us,
+						      rtc::TimeMicros());
+
+	webrtc::VideoFrame video_frame =
+		webrtc::VideoFrame::Builder()
+			.set_video_frame_buffer(buffer)
+			.set_rotation(webrtc::kVideoRotation_0)
+			.set_timestamp_us(aligned_timestamp_us)
+			.set_id(id)
+			.build();
+
+	// Send frame to video capturer, PassthroughVideoEncoder unwraps it
+	videoCapturer->OnFrameCaptured(video_frame);
+}
+
+// Typed value of a stats member, |def| when it is not reported
+template<typename T, typename M>
+static T statValue(const webrtc::RTCStatsMember<M> &member, T def = T())
+{
+	return member.is_defined() ? static_cast<T>(*member) : def;
+}
+
+static enum webrtc_quality_limitation
+qualityLimitation(const webrtc::RTCStatsMember<std::string> &reason)
+{
+	if (!reason.is_defined() || *reason == "none")
+		return WEBRTC_QUALITY_LIMITATION_NONE;
+	if (*reason == "cpu")
+		return WEBRTC_QUALITY_LIMITATION_CPU;
+	if (*reason == "bandwidth")
+		return WEBRTC_QUALITY_LIMITATION_BANDWIDTH;
+	return WEBRTC_QUALITY_LIMITATION_OTHER;
+}
+
+void WebRTCStream::fillStats(
+	const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report,
+	webrtc_stats &stats)
+{
+	memset(&stats, 0, sizeof(stats));
+	stats.timestamp_us = report->timestamp_us();
+
+	// Outbound RTP, one video stream per simulcast layer
+	for (const auto &stat :
+	     report->GetStatsOfType<webrtc::RTCOutboundRTPStreamStats>()) {
+		if (!stat->kind.is_defined())
+			continue;
+		if (*stat->kind == "audio") {
+			stats.audio_packets_sent +=
+				statValue<uint64_t>(stat->packets_sent);
+			stats.audio_bytes_sent +=
+				statValue<uint64_t>(stat->bytes_sent);
+			continue;
+		}
+		stats.video_packets_sent +=
+			statValue<uint64_t>(stat->packets_sent);
+		stats.video_bytes_sent += statValue<uint64_t>(stat->bytes_sent);
+
+		if (stats.num_layers == WEBRTC_STATS_MAX_LAYERS)
+			continue;
+		webrtc_layer_stats &layer = stats.layers[stats.num_layers++];
+		if (stat->rid.is_defined())
+			strncpy(layer.rid, stat->rid->c_str(),
+				WEBRTC_STATS_RID_SIZE - 1);
+		layer.packets_sent = statValue<uint64_t>(stat->packets_sent);
+		layer.bytes_sent = statValue<uint64_t>(stat->bytes_sent);
+		layer.target_bitrate = statValue<double>(stat->target_bitrate);
+		layer.frame_width = statValue<uint32_t>(stat->frame_width);
+		layer.frame_height = statValue<uint32_t>(stat->frame_height);
+		layer.frames_per_second =
+			statValue<double>(stat->frames_per_second);
+		layer.frames_encoded = statValue<uint32_t>(stat->frames_encoded);
+		layer.qp_sum = statValue<uint64_t>(stat->qp_sum);
+		layer.nack_count = statValue<uint32_t>(stat->nack_count);
+		layer.pli_count = statValue<uint32_t>(stat->pli_count);
+		layer.fir_count = statValue<uint32_t>(stat->fir_count);
+		layer.total_packet_send_delay =
+			statValue<double>(stat->total_packet_send_delay);
+		layer.quality_limitation =
+			qualityLimitation(stat->quality_limitation_reason);
+		if (stat->encoder_implementation.is_defined())
+			strncpy(layer.encoder,
+				stat->encoder_implementation->c_str(),
+				WEBRTC_STATS_ENCODER_SIZE - 1);
+	}
+
+	// Remote inbound RTP (receiver reports)
+	for (const auto &stat : report->GetStatsOfType<
+				webrtc::RTCRemoteInboundRtpStreamStats>()) {
+		if (!stat->kind.is_defined())
+			continue;
+		if (*stat->kind == "audio") {
+			stats.audio_round_trip_time =
+				statValue<double>(stat->round_trip_time);
+			stats.audio_fraction_lost =
+				statValue<double>(stat->fraction_lost);
+		} else {
+			stats.video_round_trip_time =
+				statValue<double>(stat->round_trip_time);
+			stats.video_fraction_lost =
+				statValue<double>(stat->fraction_lost);
+			stats.video_packets_lost +=
+				statValue<int64_t>(stat->packets_lost);
+		}
+	}
+
+	// Selected candidate pair
+	for (const auto &transport :
+	     report->GetStatsOfType<webrtc::RTCTransportStats>()) {
+		if (!transport->selected_candidate_pair_id.is_defined())
+			continue;
+		const webrtc::RTCIceCandidatePairStats *pair =
+			report->GetAs<webrtc::RTCIceCandidatePairStats>(
+				*transport->selected_candidate_pair_id);
+		if (!pair)
+			continue;
+		stats.available_outgoing_bitrate =
+			statValue<double>(pair->available_outgoing_bitrate);
+		stats.current_round_trip_time =
+			statValue<double>(pair->current_round_trip_time);
+	}
+}
+
+bool WebRTCStream::getTypedStats(webrtc_stats *stats)
+{
+	std::shared_ptr<const WebRTCStatsSnapshot> snapshot =
+		std::atomic_load(&stats_snapshot);
+	if (!stats || !snapshot->stats.timestamp_us)
+		return false;
+	*stats = snapshot->stats;
+	return true;
+}
+
+void WebRTCStream::getTypedStatsProc(void *data, calldata_t *cd)
+{
+	WebRTCStream *stream = (WebRTCStream *)data;
+	webrtc_stats *stats = (webrtc_stats *)calldata_ptr(cd, "stats");
+	calldata_set_bool(cd, "success", stream->getTypedStats(stats));
+}
+
 // NOTE LUDO: #80 add getStats
 void WebRTCStream::getStats()
 {
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> report = NewGetStats();
+	// Keep the latest sample alive while the caller reads the stats list
+	std::atomic_store(&stats_view, std::atomic_load(&stats_snapshot));
+}
+
+const char *WebRTCStream::get_stats_list()
+{
+	std::shared_ptr<const WebRTCStatsSnapshot> view =
+		std::atomic_load(&stats_view);
+	return view ? view->stats_list.c_str() : "";
+}
+
+uint64_t WebRTCStream::getBitrate()
+{
+	return std::atomic_load(&stats_snapshot)->total_bytes_sent;
+}
+
+int WebRTCStream::getDroppedFrames()
+{
+	return std::atomic_load(&stats_snapshot)->pli_received;
+}
+
+float WebRTCStream::getCongestion()
+{
+	return congestion;
+}
+
+void WebRTCStream::scheduleStats(uint64_t generation)
+{
+	signaling->PostDelayedTask(
+		webrtc::ToQueuedTask(
+			task_safety,
+			[this, generation]() { sampleStats(generation); }),
+		stats_interval_ms);
+}
+
+void WebRTCStream::sampleStats(uint64_t generation)
+{
+	// Runs on the signaling thread, GetStats answers on it as well
+	rtc::scoped_refptr<webrtc::PeerConnectionInterface> current;
+	{
+		webrtc::MutexLock lock(&crit_);
+		if (generation != stats_generation)
+			return;
+		current = pc;
+	}
+	if (!current)
+		return;
+	current->GetStats(
+		new rtc::RefCountedObject<StatsCallback>(this, task_safety,
+							 generation));
+}
+
+void WebRTCStream::onStatsReport(
+	const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report,
+	uint64_t generation)
+{
+	{
+		webrtc::MutexLock lock(&crit_);
+		if (generation != stats_generation)
+			return;
+	}
+	// Next sample
+	scheduleStats(generation);
+
 	if (nullptr == report) {
 		return;
 	}
-	stats_list = "";
 
-	std::vector<const webrtc::RTCOutboundRTPStreamStats *> send_stream_stats =
-		report->GetStatsOfType<webrtc::RTCOutboundRTPStreamStats>();
-	for (const auto &stat : send_stream_stats) {
-		if (stat->kind.ValueToString() == "audio") {
-			audio_bytes_sent =
-				std::stoll(stat->bytes_sent.ValueToJson());
-		}
-		if (stat->kind.ValueToString() == "video") {
-			video_bytes_sent =
-				std::stoll(stat->bytes_sent.ValueToJson());
-			pli_received = std::stoi(stat->pli_count.ValueToJson());
+	std::shared_ptr<WebRTCStatsSnapshot> snapshot =
+		std::make_shared<WebRTCStatsSnapshot>();
+	std::string &stats_list = snapshot->stats_list;
+	int pli_received = 0;
+
+	// Typed stats
+	webrtc_stats &stats = snapshot->stats;
+	fillStats(report, stats);
+	audio_bytes_sent = stats.audio_bytes_sent;
+	video_bytes_sent = stats.video_bytes_sent;
+	for (uint32_t i = 0; i < stats.num_layers; i++)
+		pli_received += (int)stats.layers[i].pli_count;
+	snapshot->total_bytes_sent =
+		reconnect_bytes_sent + audio_bytes_sent + video_bytes_sent;
+	snapshot->pli_received = pli_received;
+
+	// Congestion, from the transport-cc/GCC estimates
+	stats.congestion = congestion_estimator.Update(
+		stats, (video_bitrate + audio_bitrate) * 1000.0);
+	congestion = stats.congestion;
+	stats_list += "congestion:" + std::to_string(stats.congestion) + "\n";
+
+	// Dynamic bitrate of the OBS encoder, from the same estimates
+	if (dbr_enabled) {
+		long previous = dynamic_bitrate.bitrate();
+		long bitrate = dynamic_bitrate.Update(
+			stats, audio_bitrate * 1000.0, rtc::TimeMillis());
+		if (bitrate) {
+			info("Dynamic bitrate: target %ld kbps, encoder bitrate %s to %ld kbps",
+			     dynamic_bitrate.target(),
+			     bitrate < previous ? "lowered" : "raised", bitrate);
+			setEncoderBitrate(bitrate);
 		}
+		stats_list += "dbr_bitrate:" +
+			      std::to_string(dynamic_bitrate.bitrate()) + "\n";
+		stats_list += "dbr_target:" +
+			      std::to_string(dynamic_bitrate.target()) + "\n";
 	}
-	total_bytes_sent = audio_bytes_sent + video_bytes_sent;
+
+	// In-output reconnections
+	stats.reconnects = reconnects;
+	stats.last_reconnect_time = last_reconnect_ms / 1000.0;
+	stats_list += "reconnects:" + std::to_string(stats.reconnects) + "\n";
+	stats_list += "reconnect_time_ms:" +
+		      std::to_string(last_reconnect_ms) + "\n";
+
+	// Video layers, one per simulcast encoding
+	if (!scalability_mode.empty())
+		stats_list += "scalability_mode:" + scalability_mode + "\n";
+	double elapsed = (stats.timestamp_us - previous_layer_timestamp_us) /
+			 1000000.0;
+	previous_layer_timestamp_us = stats.timestamp_us;
+	for (uint32_t i = 0; i < stats.num_layers; i++) {
+		webrtc_layer_stats &layer = stats.layers[i];
+		std::string prefix =
+			"layer_" +
+			(layer.rid[0] ? std::string(layer.rid)
+				      : std::to_string(i)) +
+			"_";
+		auto previous = previous_layer_bytes.find(prefix);
+		if (previous != previous_layer_bytes.end() && elapsed > 0 &&
+		    layer.bytes_sent >= previous->second)
+			layer.bitrate =
+				(layer.bytes_sent - previous->second) * 8 /
+				elapsed;
+		previous_layer_bytes[prefix] = layer.bytes_sent;
+		stats_list += prefix + "bitrate:" +
+			      std::to_string(layer.bitrate) + "\n";
+		stats_list += prefix + "bytes_sent:" +
+			      std::to_string(layer.bytes_sent) + "\n";
+		stats_list += prefix + "target_bitrate:" +
+			      std::to_string(layer.target_bitrate) + "\n";
+		stats_list += prefix + "frame_width:" +
+			      std::to_string(layer.frame_width) + "\n";
+		stats_list += prefix + "frame_height:" +
+			      std::to_string(layer.frame_height) + "\n";
+		stats_list += prefix + "fps:" +
+			      std::to_string(layer.frames_per_second) + "\n";
+		if (layer.encoder[0])
+			stats_list += prefix + "encoder:" +
+				      std::string(layer.encoder) + "\n";
+	}
+
+	// Audio, with the bandwidth cost of the Opus settings
+	if (elapsed > 0 && stats.audio_bytes_sent >= previous_audio_bytes)
+		stats.audio_bitrate =
+			(stats.audio_bytes_sent - previous_audio_bytes) * 8 /
+			elapsed;
+	previous_audio_bytes = stats.audio_bytes_sent;
+	stats_list += "audio_bytes_per_sec:" +
+		      std::to_string((uint64_t)(stats.audio_bitrate / 8)) + "\n";
+	stats_list += "audio_ptime_ms:" + std::to_string(opus_params.ptime) +
+		      "\n";
+	stats_list += std::string("audio_fec:") +
+		      (opus_params.fec ? "1" : "0") + "\n";
+	stats_list += std::string("audio_dtx:") +
+		      (opus_params.dtx ? "1" : "0") + "\n";
+	stats_list += std::string("audio_cbr:") +
+		      (opus_params.cbr ? "1" : "0") + "\n";
+	stats_list += std::string("audio_red:") +
+		      (opus_params.red ? "1" : "0") + "\n";
+
+	// Capture to wire latency
+	static const char *latency_names[WEBRTC_LATENCY_STAGES] = {
+		"delivered", "converted", "encoded", "sent"};
+	latency_tracer->GetStats(stats.latency);
+	for (size_t i = 0; i < WEBRTC_LATENCY_STAGES; i++) {
+		const webrtc_latency_stats &latency = stats.latency[i];
+		if (!latency.count)
+			continue;
+		std::string prefix =
+			std::string("latency_") + latency_names[i] + "_";
+		stats_list += prefix + "p50_ms:" +
+			      std::to_string(latency.p50) + "\n";
+		stats_list += prefix + "p95_ms:" +
+			      std::to_string(latency.p95) + "\n";
+		stats_list += prefix + "p99_ms:" +
+			      std::to_string(latency.p99) + "\n";
+	}
+
+	// Frame buffer pool
+	stats_list += "frame_pool_hits:" +
+		      std::to_string(buffer_pool->hits()) + "\n";
+	stats_list += "frame_pool_misses:" +
+		      std::to_string(buffer_pool->misses()) + "\n";
 
 	// RTCDataChannelStats
 	std::vector<const webrtc::RTCDataChannelStats *> data_channel_stats =
@@ -886,23 +1970,8 @@ void WebRTCStream::getStats()
 		stats_list += "transport_bytes_received:" +
 			      stat->bytes_received.ValueToJson() + "\n";
 	}
-}
-
-rtc::scoped_refptr<const webrtc::RTCStatsReport> WebRTCStream::NewGetStats()
-{
-	webrtc::MutexLock lock(&crit_);
-
-	if (nullptr == pc) {
-		return nullptr;
-	}
-
-	rtc::scoped_refptr<StatsCallback> stats_callback =
-		new rtc::RefCountedObject<StatsCallback>();
-
-	pc->GetStats(stats_callback);
-
-	while (!stats_callback->called())
-		std::this_thread::sleep_for(std::chrono::microseconds(1));
 
-	return stats_callback->report();
+	// Publish
+	std::atomic_store(&stats_snapshot,
+			  std::shared_ptr<const WebRTCStatsSnapshot>(snapshot));
 }
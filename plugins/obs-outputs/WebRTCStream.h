@@ -16,8 +16,16 @@
 // obs-webrtc includes
 #include "WebsocketClient.h"
 #include "VideoCapturer.h"
-#include "AudioDeviceModuleWrapper.h"
 #include "obsWebrtcAudioSource.h"
+#include "VideoFrameBufferPool.h"
+#include "PassthroughVideoEncoder.h"
+#include "webrtc-stats.h"
+#include "AudioChannelLayout.h"
+#include "CongestionEstimator.h"
+#include "DynamicBitrate.h"
+#include "SDPModif.h"
+#include "LatencyTracer.h"
+#include "SharedPeerConnectionFactory.h"
 
 // webrtc includes
 #include "api/create_peerconnection_factory.h"
@@ -29,6 +37,7 @@
 #include "modules/audio_processing/include/audio_processing.h"
 #include "rtc_base/synchronization/mutex.h"
 #include "rtc_base/ref_counted_object.h"
+#include "rtc_base/task_utils/pending_task_safety_flag.h"
 #include "rtc_base/thread.h"
 #include "rtc_base/timestamp_aligner.h"
 
@@ -39,6 +48,61 @@
 #include <vector>
 #include <chrono>
 #include <thread>
+#include <memory>
+#include <atomic>
+#include <map>
+
+// Simulcast layer, read from the service settings
+struct SimulcastLayer {
+	std::string rid;
+	double scale_resolution_down_by = 1.0;
+	// 0: left to the libwebrtc bitrate allocation
+	int max_bitrate_bps = 0;
+	// 0: OBS framerate
+	double max_framerate = 0.0;
+};
+
+// Output settings shared by the WebRTC outputs
+#define OPT_NV12_PASSTHROUGH "nv12_passthrough"
+#define OPT_STATS_INTERVAL "stats_interval_ms"
+#define OPT_HW_ENCODER "hw_encoder"
+// Same key as the RTMP output, set by the UI advanced output settings
+#define OPT_DYN_BITRATE "dyn_bitrate"
+// Opus tuning, see SDPModif::OpusParameters
+#define OPT_OPUS_PTIME "opus_ptime"
+#define OPT_OPUS_FEC "opus_fec"
+#define OPT_OPUS_DTX "opus_dtx"
+#define OPT_OPUS_CBR "opus_cbr"
+#define OPT_OPUS_RED "opus_red"
+// RTP header extensions offered, see WebRTCStream::setHeaderExtensions
+#define OPT_RTP_ABS_SEND_TIME "rtp_abs_send_time"
+#define OPT_RTP_TRANSPORT_CC "rtp_transport_cc"
+#define OPT_RTP_PLAYOUT_DELAY "rtp_playout_delay"
+#define OPT_RTP_VIDEO_TIMING "rtp_video_timing"
+#define OPT_RTP_ABS_CAPTURE_TIME "rtp_abs_capture_time"
+#define OPT_RTP_DEPENDENCY_DESCRIPTOR "rtp_dependency_descriptor"
+
+// Stats sample published by the stats sampler, never modified once published
+struct WebRTCStatsSnapshot {
+	std::string stats_list;
+	uint64_t total_bytes_sent = 0;
+	int pli_received = 0;
+	webrtc_stats stats = {};
+};
+
+class WebRTCStream;
+
+// Owner of the destinations of a fan-out output (WebRTCFanout): the data
+// capture and the stop of the OBS output are its decisions, not theirs
+class WebRTCFanoutListener {
+public:
+	virtual ~WebRTCFanoutListener() = default;
+	// First answer of the destination since it started
+	virtual void onDestinationOpened(WebRTCStream *destination) = 0;
+	// The destination gave up, |code| is an OBS_OUTPUT_* code
+	virtual void onDestinationStopped(WebRTCStream *destination,
+					  int code) = 0;
+};
 
 class WebRTCStreamInterface
 	: public WebsocketClient::Listener,
@@ -52,18 +116,37 @@ class WebRTCStream : public rtc::RefCountedObject<WebRTCStreamInterface> {
 public:
 	enum Type { Millicast = 0, CustomWebrtc = 1 };
 
-	WebRTCStream(obs_output_t *output);
+	// Fan-out destinations pass their fan-out and its factory
+	WebRTCStream(obs_output_t *output,
+		     WebRTCFanoutListener *fanout = nullptr,
+		     rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+			     fanout_factory = nullptr);
 	~WebRTCStream() override;
 
+	// Safe to call again or from several threads, only the first call
+	// releases the session. False if there was none.
 	bool close(bool wait);
 	bool start(Type type);
 	bool stop();
 	void onAudioFrame(audio_data *frame);
 	void onVideoFrame(video_data *frame);
+	// Encoded outputs: packets of the OBS video encoder
+	void onEncodedPacket(encoder_packet *packet);
 	void setCodec(const std::string &new_codec)
 	{
 		this->video_codec = new_codec;
 	}
+	// Raw outputs: have the OBS GPU conversion deliver the frames as I420
+	// (NV12 with |nv12|), before the data capture begins
+	static void setVideoConversion(obs_output_t *output, bool nv12);
+
+	// Fan-out: the fan-out creates the tracks of one destination and
+	// shares its video track with the others, before starting them. Each
+	// destination has its own audio track, fed by onAudioFrame
+	void createTracks();
+	void shareMedia(WebRTCStream *source);
+	// Fan-out: publish to |url| instead of the service URL
+	void setDestination(const std::string &url, const std::string &token);
 
 	//
 	// WebsocketClient::Listener implementation.
@@ -75,6 +158,8 @@ public:
 	void onOpened(const std::string &sdp) override;
 	void onOpenedError(int code) override;
 	void onRemoteIceCandidate(const std::string &sdpData) override;
+	void onIceRestarted(const std::string &sdp) override;
+	void onIceRestartError(int code) override;
 
 	//
 	// PeerConnectionObserver implementation.
@@ -104,10 +189,8 @@ public:
 		webrtc::PeerConnectionInterface::
 			IceConnectionState /* new_state */) override;
 	void OnIceGatheringChange(
-		webrtc::PeerConnectionInterface::
-			IceGatheringState /* new_state */) override
-	{
-	}
+		webrtc::PeerConnectionInterface::IceGatheringState new_state)
+		override;
 	void
 	OnIceCandidate(const webrtc::IceCandidateInterface *candidate) override;
 	void OnIceConnectionReceivingChange(bool /* receiving */) override {}
@@ -128,14 +211,19 @@ public:
 	void OnSetRemoteDescriptionComplete(webrtc::RTCError error) override;
 
 	// NOTE LUDO: #80 add getStats
-	// WebRTC stats
+	// WebRTC stats, read from the latest sample without blocking
 	void getStats();
-	const char *get_stats_list() { return stats_list.c_str(); }
+	const char *get_stats_list();
 	// Bitrate & dropped frames
-	uint64_t getBitrate() { return total_bytes_sent; }
-	int getDroppedFrames() { return pli_received; }
-	// Synchronously get stats
-	rtc::scoped_refptr<const webrtc::RTCStatsReport> NewGetStats();
+	uint64_t getBitrate();
+	int getDroppedFrames();
+	float getCongestion();
+	// Typed stats, false if no sample was taken yet
+	bool getTypedStats(webrtc_stats *stats);
+	// Stats sampler, runs on the signaling thread
+	void onStatsReport(
+		const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report,
+		uint64_t generation);
 
 	template<typename T> rtc::scoped_refptr<T> make_scoped_refptr(T *t)
 	{
@@ -154,36 +242,146 @@ private:
 	std::string protocol;
 	std::string audio_codec;
 	std::string video_codec;
+	// H.264 encoder of the raw outputs: "auto", "nvenc", "vaapi" or "none"
+	std::string hw_encoder;
 	bool simulcast;
+	std::vector<SimulcastLayer> simulcast_layers;
+	void loadSimulcastLayers(obs_service_t *service);
+	// SVC layer structure of a VP9 / AV1 stream (e.g. "L3T3")
+	std::string scalability_mode;
 	std::string publishApiUrl;
 	int channel_count;
+	// Audio sent for the OBS speaker layout
+	AudioChannelLayout audio_layout;
+	// Applied to the offer, the answer and the audio sender
+	SDPModif::OpusParameters opus_params;
+	// URI of the RTP header extensions the output settings turn on or off
+	std::map<std::string, bool> header_extensions;
+	// Offer (or not) those of |transceiver| per |header_extensions|
+	void setHeaderExtensions(
+		rtc::scoped_refptr<webrtc::RtpTransceiverInterface> transceiver);
+	// Hand NV12 frames to libwebrtc as-is instead of I420 ones
+	bool nv12_passthrough;
+	// Packets of the OBS video encoder are sent as-is (encoded outputs)
+	bool encoded;
+	// Encoded outputs get raw audio straight from the OBS audio output.
+	// Protected by crit_
+	bool audio_connected;
+	static void onRawAudio(void *param, size_t mix_idx,
+			       struct audio_data *frame);
+	void disconnectAudio();
+	// Media stream with the audio source and track of this output
+	void createAudioTrack();
 
 	void resetStats();
 
+	// obs_output_signal_stop, or the fan-out for its destinations
+	void signalStop(int code);
+	// Dynamic bitrate of the OBS video encoder (encoded outputs)
+	void setupDynamicBitrate(obs_encoder_t *vencoder);
+	void setEncoderBitrate(long bitrate);
+
+	WebRTCFanoutListener *fanout;
+	std::string destination_url;
+	std::string destination_token;
+
+	// Set the (munged) answer as remote description
+	void setAnswer(const std::string &sdp);
+	// ICE restart without media renegotiation, on the signaling thread.
+	// False if no more attempts are left.
+	bool restartIce();
+	void scheduleIceRestart(uint64_t generation);
+	// Set while the ice_restart offer / answer are in flight
+	bool ice_restarting;
+	int ice_restart_attempts;
+	static const int kMaxIceRestarts = 3;
+	// Grace period of a disconnected ICE connection
+	static const int kIceRestartDelayMs = 2000;
+
+	// Peer connection, transceivers and signaling session of the output.
+	// The factory, the threads, the tracks and the capturer outlive it.
+	// False on failure, or if the output was stopped meanwhile.
+	bool connectSession();
+	// Release the peer connection and the signaling client, returns
+	// false if there was no session
+	bool closeSession(bool wait);
+
+	// In-output reconnection: once the output captures, a lost session
+	// is rebuilt with exponential backoff while the media keep flowing.
+	// Returns false if the output is not capturing yet (caller stops).
+	bool reconnectOnFailure();
+	void beginReconnect(uint64_t generation);
+	void scheduleReconnect();
+	void reconnect(uint64_t generation);
+	// Data capture begun, set once per start
+	std::atomic<bool> capturing;
+	// Signaling thread only
+	bool reconnecting;
+	int reconnect_attempts;
+	int64_t reconnect_start_ms;
+	// Bytes sent by the previous peer connections of this start
+	uint64_t reconnect_bytes_sent;
+	// Reported in the stats
+	std::atomic<uint32_t> reconnects;
+	std::atomic<int64_t> last_reconnect_ms;
+	static const int kMaxReconnectAttempts = 8;
+	static const int kReconnectBaseDelayMs = 500;
+	static const int kReconnectMaxDelayMs = 16000;
+
 	// NOTE LUDO: #80 add getStats
-	std::string stats_list;
-	uint16_t frame_id;
+	void scheduleStats(uint64_t generation);
+	void sampleStats(uint64_t generation);
+	static void
+	fillStats(const rtc::scoped_refptr<const webrtc::RTCStatsReport> &report,
+		  webrtc_stats &stats);
+	static void getTypedStatsProc(void *data, calldata_t *cd);
+	// Sampling period
+	int stats_interval_ms;
+	// Bumped on start/close so that pending samples of a previous
+	// peer connection are ignored. Protected by crit_
+	uint64_t stats_generation;
+	// Set by stop(), a reconnection running on the signaling thread does
+	// not bring the session back. Protected by crit_
+	bool stopped;
+	// Latest sample, use std::atomic_load/std::atomic_store
+	std::shared_ptr<const WebRTCStatsSnapshot> stats_snapshot;
+	// Sample the stats list returned by get_stats_list points into, only
+	// replaced by getStats so that the list outlives a restart.
+	// Use std::atomic_load/std::atomic_store
+	std::shared_ptr<const WebRTCStatsSnapshot> stats_view;
+	// Updated by the stats sampler only
+	CongestionEstimator congestion_estimator;
+	std::atomic<float> congestion;
+	// OBS video encoder bitrate following the send-side target, encoded
+	// outputs only. Updated by the stats sampler, reset on start
+	DynamicBitrate dynamic_bitrate;
+	bool dbr_enabled;
 	uint64_t audio_bytes_sent;
 	uint64_t video_bytes_sent;
-	uint64_t total_bytes_sent;
-	int pli_received;
+	// Audio bytes of the previous sample, for the audio bitrate
+	uint64_t previous_audio_bytes;
 	// Used to compute fps
 	// NOTE ALEX: Should be initialized in constructor.
 	std::chrono::system_clock::time_point previous_time =
 		std::chrono::system_clock::time_point(
 			std::chrono::duration<int>(0));
 	uint32_t previous_frames_sent = 0;
+	// Per layer bytes sent of the previous sample, by rid
+	std::map<std::string, uint64_t> previous_layer_bytes;
+	int64_t previous_layer_timestamp_us = 0;
 
 	std::thread thread_closeAsync;
 
 	webrtc::Mutex crit_;
 
-	// Audio Wrapper
-	rtc::scoped_refptr<AudioDeviceModuleWrapper> adm;
-
 	// Video Capturer
 	rtc::scoped_refptr<VideoCapturer> videoCapturer;
 	rtc::TimestampAligner timestamp_aligner_;
+	// Recycled frame buffers for onVideoFrame
+	rtc::scoped_refptr<VideoFrameBufferPool> buffer_pool;
+	// Capture to wire latency of the video frames, shared with the
+	// encoders and the RTC event log
+	std::shared_ptr<LatencyTracer> latency_tracer;
 
 	// PeerConnection
 	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory;
@@ -203,10 +401,13 @@ private:
 	rtc::scoped_refptr<webrtc::AudioTrackInterface> audio_track;
 	rtc::scoped_refptr<webrtc::VideoTrackInterface> video_track;
 
-	// WebRTC threads
-	std::unique_ptr<rtc::Thread> network;
-	std::unique_ptr<rtc::Thread> worker;
-	std::unique_ptr<rtc::Thread> signaling;
+	// WebRTC threads, shared by all the outputs
+	std::shared_ptr<SharedPeerConnectionFactory> shared_factory;
+	rtc::Thread *network;
+	rtc::Thread *worker;
+	rtc::Thread *signaling;
+	// Guards the tasks this output posts to the signaling thread
+	rtc::scoped_refptr<webrtc::PendingTaskSafetyFlag> task_safety;
 
 	// Websocket client
 	WebsocketClient *client;
@@ -19,6 +19,9 @@ extern struct obs_output_info null_output_info;
 extern struct obs_output_info flv_output_info;
 extern struct obs_output_info millicast_output_info;
 extern struct obs_output_info webrtc_custom_output_info;
+extern struct obs_output_info millicast_encoded_output_info;
+extern struct obs_output_info webrtc_custom_encoded_output_info;
+extern struct obs_output_info webrtc_fanout_output_info;
 
 #if COMPILE_FTL
 extern struct obs_output_info ftl_output_info;
@@ -72,6 +75,9 @@ bool obs_module_load(void)
 	obs_register_output(&flv_output_info);
 	obs_register_output(&millicast_output_info);
 	obs_register_output(&webrtc_custom_output_info);
+	obs_register_output(&millicast_encoded_output_info);
+	obs_register_output(&webrtc_custom_encoded_output_info);
+	obs_register_output(&webrtc_fanout_output_info);
 #if COMPILE_FTL
 	obs_register_output(&ftl_output_info);
 #endif
@@ -1,6 +1,9 @@
 #include "obsWebrtcAudioSource.h"
+#include "AudioChannelLayout.h"
 #include <obs.h>
 
+#include <algorithm>
+
 rtc::scoped_refptr<obsWebrtcAudioSource>
 obsWebrtcAudioSource::Create(cricket::AudioOptions *options)
 {
@@ -19,74 +22,68 @@ obsWebrtcAudioSource::Create(cricket::AudioOptions *options)
 
 void obsWebrtcAudioSource::AddSink(webrtc::AudioTrackSinkInterface *sink)
 {
-	if (nullptr != sink_) {
-		blog(LOG_WARNING, "Replacing audio sink...");
+	webrtc::MutexLock lock(&sinks_lock_);
+	if (std::find(sinks_.begin(), sinks_.end(), sink) != sinks_.end()) {
+		blog(LOG_WARNING, "Audio sink added twice...");
+		return;
 	}
 
-	sink_ = sink;
+	sinks_.push_back(sink);
 }
 
 void obsWebrtcAudioSource::RemoveSink(webrtc::AudioTrackSinkInterface *sink)
 {
-	if (sink_ != sink) {
+	webrtc::MutexLock lock(&sinks_lock_);
+	auto it = std::find(sinks_.begin(), sinks_.end(), sink);
+	if (it == sinks_.end()) {
 		blog(LOG_WARNING, "Attempting to remove unassigned sink...");
 		return;
 	}
 
-	sink_ = nullptr;
+	sinks_.erase(it);
 }
 
-void obsWebrtcAudioSource::OnAudioData(audio_data *frame)
+void obsWebrtcAudioSource::SetChannels(size_t channels)
 {
-	webrtc::AudioTrackSinkInterface *sink = this->sink_;
-	if (nullptr == sink) {
-		return;
-	}
+	requested_channels_ = channels;
+}
 
-	// NOTE ALEX: should double check frame before -> it
-	uint8_t *data = frame->data[0];
-	size_t num_channels = audio_output_get_channels(audio_);
-	uint32_t sample_rate = 48000;
-	size_t chunk = (sample_rate / 100);
-	size_t sample_size = 2;
-	size_t i = 0;
-	uint8_t *position;
-
-	if (pending_remainder) {
-		// Copy missing chunks
-		i = chunk - pending_remainder;
-		memcpy(pending + pending_remainder * sample_size * num_channels,
-		       data, i * sample_size * num_channels);
-
-		// Send
-		sink->OnData(pending, 16, sample_rate, num_channels, chunk);
-
-		// No pending chunks
-		pending_remainder = 0;
+void obsWebrtcAudioSource::OnAudioData(audio_data *frame)
+{
+	// The chunker belongs to the audio thread
+	size_t channels = requested_channels_.exchange(0);
+	if (channels) {
+		chunker_.SetMix(channels, AudioMixMatrix(speakers_, channels));
+		blog(LOG_INFO, "WebRTC audio: %zu channel(s) sent, %s",
+		     chunker_.channels(),
+		     channels == audio_output_get_channels(audio_)
+			     ? "no remix"
+			     : "remixed from the OBS layout");
 	}
 
-	while (i + chunk < frame->frames) {
-		position = data + i * sample_size * num_channels;
-		sink->OnData(position, 16, sample_rate, num_channels, chunk);
-		i += chunk;
+	// Held while delivering, so that a removed sink is not called anymore
+	webrtc::MutexLock lock(&sinks_lock_);
+	if (sinks_.empty()) {
+		return;
 	}
 
-	if (i != frame->frames) {
-		pending_remainder = frame->frames - i;
-		memcpy(pending, data + i * sample_size * num_channels,
-		       pending_remainder * sample_size * num_channels);
-	}
+	chunker_.Push(frame->data, frame->frames,
+		      [this](const int16_t *data, size_t frames) {
+			      for (webrtc::AudioTrackSinkInterface *sink :
+				   sinks_)
+				      sink->OnData(data, 16,
+						   chunker_.sample_rate(),
+						   chunker_.channels(), frames);
+		      });
 }
 
 obsWebrtcAudioSource::obsWebrtcAudioSource()
 {
-	sink_ = nullptr;
+	speakers_ = SPEAKERS_STEREO;
+	requested_channels_ = 0;
 }
 
-obsWebrtcAudioSource::~obsWebrtcAudioSource()
-{
-	free(pending);
-}
+obsWebrtcAudioSource::~obsWebrtcAudioSource() {}
 
 void obsWebrtcAudioSource::Initialize(audio_t *audio,
 				      cricket::AudioOptions *options)
@@ -95,8 +92,12 @@ void obsWebrtcAudioSource::Initialize(audio_t *audio,
 	audio_ = audio;
 	options_ = *options;
 
-	size_t num_channels = audio_output_get_channels(audio_);
-	size_t pending_len = num_channels * 2 * 640;
-	pending = (uint8_t *)malloc(pending_len);
-	pending_remainder = 0;
+	// Take the OBS audio as-is, the chunker converts it
+	const struct audio_output_info *info = audio_output_get_info(audio_);
+	chunker_.Configure(info->format, info->samples_per_sec,
+			   audio_output_get_channels(audio_));
+	speakers_ = info->speakers;
+	blog(LOG_INFO, "WebRTC audio: %u Hz, %zu channel(s), %zu frames per chunk",
+	     chunker_.sample_rate(), chunker_.channels(),
+	     chunker_.frames_per_chunk());
 }
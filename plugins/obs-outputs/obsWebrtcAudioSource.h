@@ -7,12 +7,18 @@
 // lib obs include
 #include <media-io/audio-io.h>
 
+#include "AudioChunker.h"
+
+#include <atomic>
+#include <vector>
+
 // webrtc includes
 #include <api/scoped_refptr.h>
 #include <api/notifier.h>
 #include <api/peer_connection_interface.h>
 #include <api/media_stream_interface.h>
 #include <rtc_base/ref_counted_object.h>
+#include <rtc_base/synchronization/mutex.h>
 
 // Glue class to use OBS audio capturer and proxy the audio data through to
 // webrtc pipeline. Allows to fully control the audio capturing, and to reuse
@@ -37,15 +43,25 @@ public:
 	void AddSink(webrtc::AudioTrackSinkInterface *sink) override;
 	void RemoveSink(webrtc::AudioTrackSinkInterface *sink) override;
 	void OnAudioData(audio_data *frame);
+	// Channels handed to the sinks (AudioChannelLayout), the OBS audio is
+	// remixed if its layout differs. Applied with the next audio block
+	void SetChannels(size_t channels);
 
 protected:
 	audio_t *audio_;
-	uint16_t pending_remainder;
-	uint8_t *pending;
+	// OBS blocks -> 10 ms chunks, in the native OBS audio format
+	AudioChunker chunker_;
+	enum speaker_layout speakers_;
+	// Set by SetChannels, 0 once applied by the audio thread
+	std::atomic<size_t> requested_channels_;
 
 	// webrtc
 	cricket::AudioOptions options_;
-	webrtc::AudioTrackSinkInterface *sink_;
+	// Every sink gets the audio (e.g. the old and the new peer connection
+	// of a reconnection). Added and removed on the signaling thread, read
+	// by the audio thread
+	webrtc::Mutex sinks_lock_;
+	std::vector<webrtc::AudioTrackSinkInterface *> sinks_;
 	obsWebrtcAudioSource();
 	void Initialize(audio_t *audio, cricket::AudioOptions *options);
 };
@@ -92,6 +92,14 @@ extern "C" void webrtc_custom_receive_audio(void *data,
 	//Process audio
 	stream->onAudioFrame(frame);
 }
+extern "C" void webrtc_custom_receive_packet(void *data,
+					   struct encoder_packet *packet)
+{
+	//Get stream
+	WebRTCStream *stream = (WebRTCStream *)data;
+	//Process encoded video
+	stream->onEncodedPacket(packet);
+}
 
 extern "C" void webrtc_custom_stream_defaults(obs_data_t *defaults)
 {
@@ -102,6 +110,22 @@ extern "C" void webrtc_custom_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
+	obs_data_set_default_bool(defaults, OPT_NV12_PASSTHROUGH, false);
+	obs_data_set_default_int(defaults, OPT_STATS_INTERVAL, 1000);
+	obs_data_set_default_string(defaults, OPT_HW_ENCODER, "auto");
+	obs_data_set_default_int(defaults, OPT_OPUS_PTIME, 20);
+	obs_data_set_default_bool(defaults, OPT_OPUS_FEC, true);
+	obs_data_set_default_bool(defaults, OPT_OPUS_DTX, false);
+	obs_data_set_default_bool(defaults, OPT_OPUS_CBR, false);
+	obs_data_set_default_bool(defaults, OPT_OPUS_RED, false);
+	obs_data_set_default_bool(defaults, OPT_RTP_ABS_SEND_TIME, true);
+	obs_data_set_default_bool(defaults, OPT_RTP_TRANSPORT_CC, true);
+	obs_data_set_default_bool(defaults, OPT_RTP_PLAYOUT_DELAY, false);
+	obs_data_set_default_bool(defaults, OPT_RTP_VIDEO_TIMING, true);
+	obs_data_set_default_bool(defaults, OPT_RTP_ABS_CAPTURE_TIME, false);
+	obs_data_set_default_bool(defaults, OPT_RTP_DEPENDENCY_DESCRIPTOR,
+				  false);
+	obs_data_set_default_bool(defaults, OPT_DYN_BITRATE, false);
 }
 
 extern "C" obs_properties_t *webrtc_custom_stream_properties(void *unused)
@@ -122,6 +146,58 @@ extern "C" obs_properties_t *webrtc_custom_stream_properties(void *unused)
 	obs_properties_add_bool(
 		props, OPT_LOWLATENCY_ENABLED,
 		obs_module_text("webrtc_customStream.LowLatencyMode"));
+	obs_properties_add_bool(
+		props, OPT_NV12_PASSTHROUGH,
+		obs_module_text("webrtc_customStream.NV12Passthrough"));
+	obs_properties_add_int(props, OPT_STATS_INTERVAL,
+			       obs_module_text("webrtc_customStream.StatsInterval"),
+			       100, 10000, 100);
+	obs_property_t *hw_encoder = obs_properties_add_list(
+		props, OPT_HW_ENCODER,
+		obs_module_text("webrtc_customStream.HardwareEncoder"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(
+		hw_encoder, obs_module_text("HardwareEncoder.Auto"), "auto");
+	obs_property_list_add_string(hw_encoder, "NVENC", "nvenc");
+	obs_property_list_add_string(hw_encoder, "VAAPI", "vaapi");
+	obs_property_list_add_string(
+		hw_encoder, obs_module_text("HardwareEncoder.None"), "none");
+
+	obs_property_t *ptime = obs_properties_add_list(
+		props, OPT_OPUS_PTIME,
+		obs_module_text("webrtc_customStream.OpusPtime"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	for (int ms : {10, 20, 40, 60})
+		obs_property_list_add_int(
+			ptime, (std::to_string(ms) + " ms").c_str(), ms);
+	obs_properties_add_bool(props, OPT_OPUS_FEC,
+				obs_module_text("webrtc_customStream.OpusFec"));
+	obs_properties_add_bool(props, OPT_OPUS_DTX,
+				obs_module_text("webrtc_customStream.OpusDtx"));
+	obs_properties_add_bool(props, OPT_OPUS_CBR,
+				obs_module_text("webrtc_customStream.OpusCbr"));
+	obs_properties_add_bool(props, OPT_OPUS_RED,
+				obs_module_text("webrtc_customStream.OpusRed"));
+	obs_properties_add_bool(
+		props, OPT_RTP_ABS_SEND_TIME,
+		obs_module_text("webrtc_customStream.RtpAbsSendTime"));
+	obs_properties_add_bool(
+		props, OPT_RTP_TRANSPORT_CC,
+		obs_module_text("webrtc_customStream.RtpTransportCc"));
+	obs_properties_add_bool(
+		props, OPT_RTP_PLAYOUT_DELAY,
+		obs_module_text("webrtc_customStream.RtpPlayoutDelay"));
+	obs_properties_add_bool(
+		props, OPT_RTP_VIDEO_TIMING,
+		obs_module_text("webrtc_customStream.RtpVideoTiming"));
+	obs_properties_add_bool(
+		props, OPT_RTP_ABS_CAPTURE_TIME,
+		obs_module_text("webrtc_customStream.RtpAbsCaptureTime"));
+	obs_properties_add_bool(
+		props, OPT_RTP_DEPENDENCY_DESCRIPTOR,
+		obs_module_text("webrtc_customStream.RtpDependencyDescriptor"));
+	obs_properties_add_bool(props, OPT_DYN_BITRATE,
+				obs_module_text("webrtc_customStream.DynamicBitrate"));
 
 	return props;
 }
@@ -157,8 +233,9 @@ extern "C" int webrtc_custom_stream_dropped_frames(void *data)
 
 extern "C" float webrtc_custom_stream_congestion(void *data)
 {
-	UNUSED_PARAMETER(data);
-	return 0.0f;
+	//Get stream
+	WebRTCStream *stream = (WebRTCStream *)data;
+	return stream->getCongestion();
 }
 
 extern "C" {
@@ -190,6 +267,33 @@ struct obs_output_info webrtc_custom_output_info = {
 	"opus",                                //encoded_audio_codecs
 	nullptr                                //raw_audio2
 };
+
+struct obs_output_info webrtc_custom_encoded_output_info = {
+	"webrtc_custom_encoded_output",                             //id
+	OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE, //flags
+	webrtc_custom_stream_getname,                               //get_name
+	webrtc_custom_stream_create,                                //create
+	webrtc_custom_stream_destroy,                               //destroy
+	webrtc_custom_stream_start,                                 //start
+	webrtc_custom_stream_stop,                                  //stop
+	nullptr,                                                    //raw_video
+	nullptr,                                                    //raw_audio
+	webrtc_custom_receive_packet,                               //encoded_packet
+	nullptr,                                                    //update
+	webrtc_custom_stream_defaults,                              //get_defaults
+	webrtc_custom_stream_properties,                            //get_properties
+	nullptr,                                                    //unused1 (formerly pause)
+	webrtc_custom_stream_get_stats, webrtc_custom_stream_get_stats_list,
+	webrtc_custom_stream_total_bytes_sent,                      //get_total_bytes
+	webrtc_custom_stream_dropped_frames,                        //get_dropped_frames
+	nullptr,                                                    //type_data
+	nullptr,                                                    //free_type_data
+	webrtc_custom_stream_congestion,                            //get_congestion
+	nullptr,                                                    //get_connect_time_ms
+	"h264",                                                     //encoded_video_codecs
+	nullptr,                                                    //encoded_audio_codecs
+	nullptr                                                     //raw_audio2
+};
 #else
 struct obs_output_info webrtc_custom_output_info = {
 	.id = "webrtc_custom_output",
@@ -220,5 +324,33 @@ struct obs_output_info webrtc_custom_output_info = {
 	.raw_audio2 = nullptr
 	// .raw_audio2           = webrtc_custom_receive_multitrack_audio, //for multi-track
 };
+
+struct obs_output_info webrtc_custom_encoded_output_info = {
+	.id = "webrtc_custom_encoded_output",
+	.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED | OBS_OUTPUT_SERVICE,
+	.get_name = webrtc_custom_stream_getname,
+	.create = webrtc_custom_stream_create,
+	.destroy = webrtc_custom_stream_destroy,
+	.start = webrtc_custom_stream_start,
+	.stop = webrtc_custom_stream_stop,
+	.raw_video = nullptr,
+	.raw_audio = nullptr,
+	// Audio is pulled raw from the OBS audio output by WebRTCStream
+	.encoded_packet = webrtc_custom_receive_packet,
+	.update = nullptr,
+	.get_defaults = webrtc_custom_stream_defaults,
+	.get_properties = webrtc_custom_stream_properties,
+	.unused1 = nullptr,
+	.get_stats = webrtc_custom_stream_get_stats,
+	.get_stats_list = webrtc_custom_stream_get_stats_list,
+	.get_total_bytes = webrtc_custom_stream_total_bytes_sent,
+	.get_dropped_frames = webrtc_custom_stream_dropped_frames,
+	.type_data = nullptr,
+	.free_type_data = nullptr,
+	.get_congestion = webrtc_custom_stream_congestion,
+	.get_connect_time_ms = nullptr,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = nullptr,
+	.raw_audio2 = nullptr};
 #endif
 }
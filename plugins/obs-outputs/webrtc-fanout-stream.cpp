@@ -0,0 +1,251 @@
+// Copyright Dr. Alex. Gouaillard (2015, 2020)
+
+#include <stdio.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <inttypes.h>
+
+#define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) blog(LOG_INFO, format, ##__VA_ARGS__)
+#define debug(format, ...) blog(LOG_DEBUG, format, ##__VA_ARGS__)
+
+#include "WebRTCFanout.h"
+
+extern "C" const char *webrtc_fanout_stream_getname(void *unused)
+{
+	info("webrtc_fanout_stream_getname");
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("webrtc_fanoutStream");
+}
+
+extern "C" void webrtc_fanout_stream_destroy(void *data)
+{
+	info("webrtc_fanout_stream_destroy");
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	//Stops it and releases the destinations
+	delete fanout;
+}
+
+extern "C" void *webrtc_fanout_stream_create(obs_data_t *, obs_output_t *output)
+{
+	info("webrtc_fanout_stream_create");
+	// Create new fan-out, the destinations are created on start
+	return (void *)new WebRTCFanout(output);
+}
+
+extern "C" void webrtc_fanout_stream_stop(void *data, uint64_t ts)
+{
+	info("webrtc_fanout_stream_stop");
+	UNUSED_PARAMETER(ts);
+	// Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	// Stop all the destinations
+	fanout->stop();
+}
+
+extern "C" bool webrtc_fanout_stream_start(void *data)
+{
+	info("webrtc_fanout_stream_start");
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	//Start it
+	return fanout->start();
+}
+
+extern "C" void webrtc_fanout_receive_video(void *data,
+					    struct video_data *frame)
+{
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	//Process video, once for all the destinations
+	fanout->onVideoFrame(frame);
+}
+extern "C" void webrtc_fanout_receive_audio(void *data,
+					    struct audio_data *frame)
+{
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	//Process audio, once for all the destinations
+	fanout->onAudioFrame(frame);
+}
+
+extern "C" void webrtc_fanout_stream_defaults(obs_data_t *defaults)
+{
+	info("webrtc_fanout_stream_defaults");
+	obs_data_set_default_bool(defaults, OPT_NV12_PASSTHROUGH, false);
+	obs_data_set_default_int(defaults, OPT_STATS_INTERVAL, 1000);
+	obs_data_set_default_string(defaults, OPT_HW_ENCODER, "auto");
+	obs_data_set_default_int(defaults, OPT_OPUS_PTIME, 20);
+	obs_data_set_default_bool(defaults, OPT_OPUS_FEC, true);
+	obs_data_set_default_bool(defaults, OPT_OPUS_DTX, false);
+	obs_data_set_default_bool(defaults, OPT_OPUS_CBR, false);
+	obs_data_set_default_bool(defaults, OPT_OPUS_RED, false);
+	obs_data_set_default_bool(defaults, OPT_RTP_ABS_SEND_TIME, true);
+	obs_data_set_default_bool(defaults, OPT_RTP_TRANSPORT_CC, true);
+	obs_data_set_default_bool(defaults, OPT_RTP_PLAYOUT_DELAY, false);
+	obs_data_set_default_bool(defaults, OPT_RTP_VIDEO_TIMING, true);
+	obs_data_set_default_bool(defaults, OPT_RTP_ABS_CAPTURE_TIME, false);
+	obs_data_set_default_bool(defaults, OPT_RTP_DEPENDENCY_DESCRIPTOR,
+				  false);
+}
+
+extern "C" obs_properties_t *webrtc_fanout_stream_properties(void *unused)
+{
+	info("webrtc_fanout_stream_properties");
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_editable_list(
+		props, OPT_FANOUT_DESTINATIONS,
+		obs_module_text("webrtc_fanoutStream.Destinations"),
+		OBS_EDITABLE_LIST_TYPE_STRINGS, nullptr, nullptr);
+	obs_properties_add_bool(
+		props, OPT_NV12_PASSTHROUGH,
+		obs_module_text("webrtc_fanoutStream.NV12Passthrough"));
+	obs_properties_add_int(props, OPT_STATS_INTERVAL,
+			       obs_module_text("webrtc_fanoutStream.StatsInterval"),
+			       100, 10000, 100);
+	obs_property_t *hw_encoder = obs_properties_add_list(
+		props, OPT_HW_ENCODER,
+		obs_module_text("webrtc_fanoutStream.HardwareEncoder"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(
+		hw_encoder, obs_module_text("HardwareEncoder.Auto"), "auto");
+	obs_property_list_add_string(hw_encoder, "NVENC", "nvenc");
+	obs_property_list_add_string(hw_encoder, "VAAPI", "vaapi");
+	obs_property_list_add_string(
+		hw_encoder, obs_module_text("HardwareEncoder.None"), "none");
+
+	obs_property_t *ptime = obs_properties_add_list(
+		props, OPT_OPUS_PTIME,
+		obs_module_text("webrtc_fanoutStream.OpusPtime"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+	for (int ms : {10, 20, 40, 60})
+		obs_property_list_add_int(
+			ptime, (std::to_string(ms) + " ms").c_str(), ms);
+	obs_properties_add_bool(props, OPT_OPUS_FEC,
+				obs_module_text("webrtc_fanoutStream.OpusFec"));
+	obs_properties_add_bool(props, OPT_OPUS_DTX,
+				obs_module_text("webrtc_fanoutStream.OpusDtx"));
+	obs_properties_add_bool(props, OPT_OPUS_CBR,
+				obs_module_text("webrtc_fanoutStream.OpusCbr"));
+	obs_properties_add_bool(props, OPT_OPUS_RED,
+				obs_module_text("webrtc_fanoutStream.OpusRed"));
+	obs_properties_add_bool(
+		props, OPT_RTP_ABS_SEND_TIME,
+		obs_module_text("webrtc_fanoutStream.RtpAbsSendTime"));
+	obs_properties_add_bool(
+		props, OPT_RTP_TRANSPORT_CC,
+		obs_module_text("webrtc_fanoutStream.RtpTransportCc"));
+	obs_properties_add_bool(
+		props, OPT_RTP_PLAYOUT_DELAY,
+		obs_module_text("webrtc_fanoutStream.RtpPlayoutDelay"));
+	obs_properties_add_bool(
+		props, OPT_RTP_VIDEO_TIMING,
+		obs_module_text("webrtc_fanoutStream.RtpVideoTiming"));
+	obs_properties_add_bool(
+		props, OPT_RTP_ABS_CAPTURE_TIME,
+		obs_module_text("webrtc_fanoutStream.RtpAbsCaptureTime"));
+	obs_properties_add_bool(
+		props, OPT_RTP_DEPENDENCY_DESCRIPTOR,
+		obs_module_text("webrtc_fanoutStream.RtpDependencyDescriptor"));
+
+	return props;
+}
+
+extern "C" void webrtc_fanout_stream_get_stats(void *data)
+{
+	// Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	fanout->getStats();
+}
+
+extern "C" const char *webrtc_fanout_stream_get_stats_list(void *data)
+{
+	// Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	return fanout->get_stats_list();
+}
+
+extern "C" uint64_t webrtc_fanout_stream_total_bytes_sent(void *data)
+{
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	return fanout->getBitrate();
+}
+
+extern "C" int webrtc_fanout_stream_dropped_frames(void *data)
+{
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	return fanout->getDroppedFrames();
+}
+
+extern "C" float webrtc_fanout_stream_congestion(void *data)
+{
+	//Get fan-out
+	WebRTCFanout *fanout = (WebRTCFanout *)data;
+	return fanout->getCongestion();
+}
+
+extern "C" {
+#ifdef _WIN32
+struct obs_output_info webrtc_fanout_output_info = {
+	"webrtc_fanout_output",                //id
+	OBS_OUTPUT_AV | OBS_OUTPUT_SERVICE,    //flags
+	webrtc_fanout_stream_getname,          //get_name
+	webrtc_fanout_stream_create,           //create
+	webrtc_fanout_stream_destroy,          //destroy
+	webrtc_fanout_stream_start,            //start
+	webrtc_fanout_stream_stop,             //stop
+	webrtc_fanout_receive_video,           //raw_video
+	webrtc_fanout_receive_audio,           //raw_audio
+	nullptr,                               //encoded_packet
+	nullptr,                               //update
+	webrtc_fanout_stream_defaults,         //get_defaults
+	webrtc_fanout_stream_properties,       //get_properties
+	nullptr,                               //unused1 (formerly pause)
+	webrtc_fanout_stream_get_stats, webrtc_fanout_stream_get_stats_list,
+	webrtc_fanout_stream_total_bytes_sent, //get_total_bytes
+	webrtc_fanout_stream_dropped_frames,   //get_dropped_frames
+	nullptr,                               //type_data
+	nullptr,                               //free_type_data
+	webrtc_fanout_stream_congestion,       //get_congestion
+	nullptr,                               //get_connect_time_ms
+	"vp8",                                 //encoded_video_codecs
+	"opus",                                //encoded_audio_codecs
+	nullptr                                //raw_audio2
+};
+#else
+struct obs_output_info webrtc_fanout_output_info = {
+	.id = "webrtc_fanout_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_SERVICE,
+	.get_name = webrtc_fanout_stream_getname,
+	.create = webrtc_fanout_stream_create,
+	.destroy = webrtc_fanout_stream_destroy,
+	.start = webrtc_fanout_stream_start,
+	.stop = webrtc_fanout_stream_stop,
+	.raw_video = webrtc_fanout_receive_video,
+	.raw_audio = webrtc_fanout_receive_audio,
+	.encoded_packet = nullptr,
+	.update = nullptr,
+	.get_defaults = webrtc_fanout_stream_defaults,
+	.get_properties = webrtc_fanout_stream_properties,
+	.unused1 = nullptr,
+	.get_stats = webrtc_fanout_stream_get_stats,
+	.get_stats_list = webrtc_fanout_stream_get_stats_list,
+	.get_total_bytes = webrtc_fanout_stream_total_bytes_sent,
+	.get_dropped_frames = webrtc_fanout_stream_dropped_frames,
+	.type_data = nullptr,
+	.free_type_data = nullptr,
+	.get_congestion = webrtc_fanout_stream_congestion,
+	.get_connect_time_ms = nullptr,
+	.encoded_video_codecs = "vp8",
+	.encoded_audio_codecs = "opus",
+	.raw_audio2 = nullptr};
+#endif
+}
@@ -0,0 +1,118 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Typed stats of the WebRTC outputs.
+ *
+ * Filled by the "get_webrtc_stats" procedure of the output, with the latest
+ * sample of the background stats sampler. The call copies into caller
+ * memory and neither blocks nor allocates, so it can be polled often:
+ *
+ *   struct webrtc_stats stats;
+ *   calldata_t cd = {0};
+ *   calldata_set_ptr(&cd, "stats", &stats);
+ *   proc_handler_call(obs_output_get_proc_handler(output),
+ *                     "get_webrtc_stats", &cd);
+ *   if (calldata_bool(&cd, "success"))
+ *           ...
+ *   calldata_free(&cd);
+ *
+ * The fan-out output ("webrtc_fanout_output") takes the index of the
+ * destination in "destination" (0 for the service one) and returns their
+ * number in "destinations".
+ */
+
+#define WEBRTC_STATS_MAX_LAYERS 4
+#define WEBRTC_STATS_RID_SIZE 16
+#define WEBRTC_STATS_ENCODER_SIZE 32
+
+enum webrtc_quality_limitation {
+	WEBRTC_QUALITY_LIMITATION_NONE,
+	WEBRTC_QUALITY_LIMITATION_CPU,
+	WEBRTC_QUALITY_LIMITATION_BANDWIDTH,
+	WEBRTC_QUALITY_LIMITATION_OTHER,
+};
+
+/* Points of the publish path a video frame is traced at, the latency of
+ * each is measured from the OBS video tick that rendered the frame */
+enum webrtc_latency_stage {
+	WEBRTC_LATENCY_DELIVERED, /* video-io dispatch, onVideoFrame entry */
+	WEBRTC_LATENCY_CONVERTED, /* I420 (or NV12) copy done */
+	WEBRTC_LATENCY_ENCODED,   /* encoder output */
+	WEBRTC_LATENCY_SENT,      /* last RTP packet out of the pacer */
+	WEBRTC_LATENCY_STAGES,
+};
+
+struct webrtc_latency_stats {
+	uint64_t count; /* frames traced */
+	double p50;     /* milliseconds */
+	double p95;
+	double p99;
+	double max;
+};
+
+/* Outbound video RTP stream, one per simulcast layer. With SVC the spatial
+ * and temporal layers share a single stream. */
+struct webrtc_layer_stats {
+	char rid[WEBRTC_STATS_RID_SIZE];
+	uint64_t packets_sent;
+	uint64_t bytes_sent;
+	double target_bitrate; /* bps */
+	double bitrate;        /* bps, measured since the previous sample */
+	uint32_t frame_width;
+	uint32_t frame_height;
+	double frames_per_second;
+	uint32_t frames_encoded;
+	uint64_t qp_sum;
+	uint32_t nack_count;
+	uint32_t pli_count;
+	uint32_t fir_count;
+	double total_packet_send_delay; /* seconds spent in the pacer */
+	enum webrtc_quality_limitation quality_limitation;
+	/* Encoder implementation, "FFmpeg h264_nvenc" for a hardware one */
+	char encoder[WEBRTC_STATS_ENCODER_SIZE];
+};
+
+struct webrtc_stats {
+	/* Sample time (microseconds, libwebrtc clock), 0 if no sample yet */
+	int64_t timestamp_us;
+
+	/* Outbound RTP */
+	uint64_t audio_packets_sent;
+	uint64_t audio_bytes_sent;
+	uint64_t video_packets_sent;
+	uint64_t video_bytes_sent;
+	/* bps, measured since the previous sample: cost of the Opus packet
+	 * time, FEC, DTX, CBR and RED settings */
+	double audio_bitrate;
+
+	/* Remote inbound RTP (receiver reports) */
+	double audio_round_trip_time; /* seconds */
+	double audio_fraction_lost;
+	double video_round_trip_time; /* seconds */
+	double video_fraction_lost;
+	int64_t video_packets_lost;
+
+	/* Selected candidate pair */
+	double available_outgoing_bitrate; /* bps */
+	double current_round_trip_time;    /* seconds */
+
+	/* Smoothed congestion, 0..1 (see obs_output_get_congestion) */
+	float congestion;
+
+	/* Sessions rebuilt by the output since it started, and the time the
+	 * last one took, from the failure to the new connection */
+	uint32_t reconnects;
+	double last_reconnect_time; /* seconds */
+
+	/* Capture to wire latency since the output started */
+	struct webrtc_latency_stats latency[WEBRTC_LATENCY_STAGES];
+
+	/* Video layers, a single one without simulcast */
+	uint32_t num_layers;
+	struct webrtc_layer_stats layers[WEBRTC_STATS_MAX_LAYERS];
+};
@@ -2,6 +2,8 @@
 
 #include <obs-module.h>
 
+#include "webrtc-simulcast.h"
+
 struct webrtc_custom {
 	char *server;
 	char *password;
@@ -28,7 +30,11 @@ static void webrtc_custom_update(void *data, obs_data_t *settings)
 	service->server = bstrdup(obs_data_get_string(settings, "server"));
 	service->codec = bstrdup(obs_data_get_string(settings, "codec"));
 	service->simulcast = obs_data_get_bool(settings, "simulcast");
-	service->output = bstrdup("webrtc_custom_output");
+	// Send the OBS encoder output as-is instead of re-encoding in libwebrtc
+	service->output = bstrdup(
+		obs_data_get_bool(settings, "encoded_passthrough")
+			? "webrtc_custom_encoded_output"
+			: "webrtc_custom_output");
 }
 
 static void webrtc_custom_destroy(void *data)
@@ -51,6 +57,11 @@ static void *webrtc_custom_create(obs_data_t *settings, obs_service_t *service)
 	return data;
 }
 
+static void webrtc_custom_defaults(obs_data_t *settings)
+{
+	webrtc_simulcast_defaults(settings);
+}
+
 static bool use_auth_modified(obs_properties_t *ppts, obs_property_t *p,
 			      obs_data_t *settings)
 {
@@ -95,6 +106,9 @@ static obs_properties_t *webrtc_custom_properties(void *unused)
 
 	obs_properties_add_text(ppts, "codec", "Codec", OBS_TEXT_DEFAULT);
 	obs_properties_add_text(ppts, "protocol", "Protocol", OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(ppts, "encoded_passthrough",
+				"Send OBS encoder output (H.264 only)");
+	webrtc_simulcast_properties(ppts);
 
 	obs_property_list_add_string(obs_properties_get(ppts, "codec"), "AV1",
 				     "av1");
@@ -187,6 +201,7 @@ struct obs_service_info webrtc_custom_service = {
 	.create = webrtc_custom_create,
 	.destroy = webrtc_custom_destroy,
 	.update = webrtc_custom_update,
+	.get_defaults = webrtc_custom_defaults,
 	.get_properties = webrtc_custom_properties,
 	.get_url = webrtc_custom_url,
 	.get_key = webrtc_custom_key,
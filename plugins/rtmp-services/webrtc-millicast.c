@@ -2,6 +2,8 @@
 
 #include <obs-module.h>
 
+#include "webrtc-simulcast.h"
+
 struct webrtc_millicast {
 	char *server;
 	char *username;
@@ -36,7 +38,11 @@ static void webrtc_millicast_update(void *data, obs_data_t *settings)
 	service->simulcast = obs_data_get_bool(settings, "simulcast");
 	service->publishApiUrl =
 		bstrdup(obs_data_get_string(settings, "publish_api_url"));
-	service->output = bstrdup("millicast_output");
+	// Send the OBS encoder output as-is instead of re-encoding in libwebrtc
+	service->output = bstrdup(
+		obs_data_get_bool(settings, "encoded_passthrough")
+			? "millicast_encoded_output"
+			: "millicast_output");
 }
 
 static void webrtc_millicast_destroy(void *data)
@@ -63,6 +69,11 @@ static void *webrtc_millicast_create(obs_data_t *settings,
 	return data;
 }
 
+static void webrtc_millicast_defaults(obs_data_t *settings)
+{
+	webrtc_simulcast_defaults(settings);
+}
+
 static bool use_auth_modified(obs_properties_t *ppts, obs_property_t *p,
 			      obs_data_t *settings)
 {
@@ -112,6 +123,9 @@ static obs_properties_t *webrtc_millicast_properties(void *unused)
 
 	obs_properties_add_text(ppts, "codec", "Codec", OBS_TEXT_DEFAULT);
 	obs_properties_add_text(ppts, "protocol", "Protocol", OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(ppts, "encoded_passthrough",
+				"Send OBS encoder output (H.264 only)");
+	webrtc_simulcast_properties(ppts);
 
 	obs_property_list_add_string(obs_properties_get(ppts, "codec"), "AV1",
 				     "av1");
@@ -231,6 +245,7 @@ struct obs_service_info webrtc_millicast_service = {
 	.create = webrtc_millicast_create,
 	.destroy = webrtc_millicast_destroy,
 	.update = webrtc_millicast_update,
+	.get_defaults = webrtc_millicast_defaults,
 	.get_properties = webrtc_millicast_properties,
 	.get_url = webrtc_millicast_url,
 	.get_key = webrtc_millicast_key,
@@ -0,0 +1,63 @@
+/* Copyright Dr. Alex. Gouaillard (2015, 2020) */
+
+#include "webrtc-simulcast.h"
+
+static const char *scalability_modes[] = {"L1T2", "L1T3", "L2T1",
+					  "L2T2", "L2T3", "L3T1",
+					  "L3T2", "L3T3"};
+
+static const double default_scales[WEBRTC_SIMULCAST_MAX_LAYERS] = {1.0, 2.0,
+								   4.0};
+
+void webrtc_simulcast_defaults(obs_data_t *settings)
+{
+	char name[64];
+
+	obs_data_set_default_int(settings, "simulcast_layers",
+				 WEBRTC_SIMULCAST_MAX_LAYERS);
+	obs_data_set_default_string(settings, "scalability_mode", "");
+
+	for (int i = 0; i < WEBRTC_SIMULCAST_MAX_LAYERS; i++) {
+		snprintf(name, sizeof(name), "simulcast_layer%d_scale", i);
+		obs_data_set_default_double(settings, name, default_scales[i]);
+		snprintf(name, sizeof(name), "simulcast_layer%d_bitrate", i);
+		obs_data_set_default_int(settings, name, 0);
+		snprintf(name, sizeof(name), "simulcast_layer%d_framerate", i);
+		obs_data_set_default_int(settings, name, 0);
+	}
+}
+
+void webrtc_simulcast_properties(obs_properties_t *ppts)
+{
+	char name[64];
+	char desc[64];
+	obs_property_t *p;
+
+	p = obs_properties_add_list(ppts, "scalability_mode",
+				    "SVC layers (VP9 / AV1)",
+				    OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_STRING);
+	obs_property_list_add_string(p, "None", "");
+	for (size_t i = 0;
+	     i < sizeof(scalability_modes) / sizeof(scalability_modes[0]); i++)
+		obs_property_list_add_string(p, scalability_modes[i],
+					     scalability_modes[i]);
+
+	obs_properties_add_bool(ppts, "simulcast", "Simulcast");
+	obs_properties_add_int(ppts, "simulcast_layers", "Simulcast layers", 2,
+			       WEBRTC_SIMULCAST_MAX_LAYERS, 1);
+
+	for (int i = 0; i < WEBRTC_SIMULCAST_MAX_LAYERS; i++) {
+		snprintf(name, sizeof(name), "simulcast_layer%d_scale", i);
+		snprintf(desc, sizeof(desc), "Layer %d downscale", i + 1);
+		obs_properties_add_float(ppts, name, desc, 1.0, 16.0, 0.25);
+		snprintf(name, sizeof(name), "simulcast_layer%d_bitrate", i);
+		snprintf(desc, sizeof(desc), "Layer %d max bitrate (0: auto)",
+			 i + 1);
+		obs_properties_add_int(ppts, name, desc, 0, 100000, 50);
+		snprintf(name, sizeof(name), "simulcast_layer%d_framerate", i);
+		snprintf(desc, sizeof(desc), "Layer %d max framerate (0: auto)",
+			 i + 1);
+		obs_properties_add_int(ppts, name, desc, 0, 120, 1);
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <obs-module.h>
+
+/* Simulcast layers of the WebRTC services, largest first ("L", "M", "S").
+ * Per layer settings are "simulcast_layer<index>_<name>":
+ * - scale: scale_resolution_down_by of the layer
+ * - bitrate: max bitrate (kbps), 0 to let libwebrtc allocate it
+ * - framerate: max framerate, 0 for the OBS framerate */
+#define WEBRTC_SIMULCAST_MAX_LAYERS 3
+
+/* "scalability_mode": layer structure (e.g. "L3T3") of a single VP9 or AV1
+ * stream, empty to send a single layer. Replaces simulcast when set. */
+
+extern void webrtc_simulcast_defaults(obs_data_t *settings);
+extern void webrtc_simulcast_properties(obs_properties_t *ppts);
@@ -6,7 +6,11 @@
 
 #include <util/base.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <string>
 
 #define warn(format, ...) blog(LOG_WARNING, format, ##__VA_ARGS__)
@@ -14,11 +18,150 @@
 #define debug(format, ...) blog(LOG_DEBUG, format, ##__VA_ARGS__)
 #define error(format, ...) blog(LOG_ERROR, format, ##__VA_ARGS__)
 
-CustomWebrtcImpl::CustomWebrtcImpl()
+// Content type of the WHIP trickle ICE and ICE restart PATCH requests
+static const char *kSdpFragContentType = "application/trickle-ice-sdpfrag";
+
+static std::vector<std::string> splitLines(const std::string &sdp)
+{
+	std::vector<std::string> lines;
+	size_t pos = 0;
+	while (pos < sdp.size()) {
+		size_t end = sdp.find('\n', pos);
+		if (end == std::string::npos)
+			end = sdp.size();
+		std::string line = sdp.substr(pos, end - pos);
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty())
+			lines.push_back(line);
+		pos = end + 1;
+	}
+	return lines;
+}
+
+static bool startsWith(const std::string &s, const char *prefix)
+{
+	return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// HTTP header names are case insensitive
+static std::string findHeader(const RestClient::HeaderFields &headers,
+			      const std::string &name)
+{
+	for (const auto &header : headers) {
+		if (header.first.size() == name.size() &&
+		    std::equal(name.begin(), name.end(), header.first.begin(),
+			       [](char a, char b) {
+				       return tolower(a) == tolower(b);
+			       }))
+			return header.second;
+	}
+	return "";
+}
+
+static RestClient::Response whipRequest(const std::string &method,
+					const std::string &url,
+					const std::string &token,
+					const std::string &contentType,
+					const std::string &body,
+					const std::string &ifMatch, int timeout)
+{
+	RestClient::Connection conn("");
+	RestClient::HeaderFields headers;
+	headers["Authorization"] = "Bearer " + token;
+	if (!contentType.empty())
+		headers["Content-Type"] = contentType;
+	if (method == "POST")
+		headers["Accept"] = "application/sdp";
+	if (!ifMatch.empty())
+		headers["If-Match"] = ifMatch;
+	conn.SetHeaders(headers);
+	conn.SetTimeout(timeout);
+	// enable following of redirects (default is off)
+	// and limit the number of redirects (default is -1, unlimited)
+	conn.FollowRedirects(true, 3);
+	if (method == "POST")
+		return conn.post(url, body);
+	if (method == "PATCH")
+		return conn.patch(url, body);
+	return conn.del(url);
+}
+
+// trickle-ice-sdpfrag (RFC 8840): the ICE credentials, then the m-line and
+// mid of each media section followed by its candidates
+static std::string
+buildFragment(const std::string &ufrag, const std::string &pwd,
+	      const std::vector<std::pair<std::string, std::string>> &media,
+	      const std::vector<std::pair<std::string, std::string>> &candidates,
+	      bool endOfCandidates)
+{
+	std::string fragment = "a=ice-ufrag:" + ufrag + "\r\n" +
+			       "a=ice-pwd:" + pwd + "\r\n";
+	for (const auto &section : media) {
+		std::string lines;
+		for (const auto &candidate : candidates)
+			if (candidate.first == section.first)
+				lines += "a=" + candidate.second + "\r\n";
+		// Restarts list every section, trickles only those with
+		// candidates
+		if (lines.empty() && !candidates.empty())
+			continue;
+		fragment += section.second + "\r\n" + "a=mid:" +
+			    section.first + "\r\n" + lines;
+		if (endOfCandidates)
+			fragment += "a=end-of-candidates\r\n";
+	}
+	return fragment;
+}
+
+// Replace the ICE credentials and candidates of |answer| with the ones of
+// the ICE restart |fragment|, the media description is left untouched
+static bool mergeRestart(const std::string &answer,
+			 const std::string &fragment, std::string &merged)
 {
-	RestClient::init();
+	std::string ufrag;
+	std::string pwd;
+	// mid -> candidate lines, "" for candidates outside any section
+	std::map<std::string, std::string> candidates;
+	std::string mid;
+	for (const std::string &line : splitLines(fragment)) {
+		if (startsWith(line, "a=ice-ufrag:") && ufrag.empty())
+			ufrag = line.substr(12);
+		else if (startsWith(line, "a=ice-pwd:") && pwd.empty())
+			pwd = line.substr(10);
+		else if (startsWith(line, "a=mid:"))
+			mid = line.substr(6);
+		else if (startsWith(line, "a=candidate:"))
+			candidates[mid] += line + "\r\n";
+	}
+	if (ufrag.empty() || pwd.empty())
+		return false;
+
+	merged.clear();
+	bool first = true;
+	for (const std::string &line : splitLines(answer)) {
+		if (startsWith(line, "a=ice-ufrag:")) {
+			merged += "a=ice-ufrag:" + ufrag + "\r\n";
+		} else if (startsWith(line, "a=ice-pwd:")) {
+			merged += "a=ice-pwd:" + pwd + "\r\n";
+		} else if (startsWith(line, "a=candidate:") ||
+			   startsWith(line, "a=end-of-candidates")) {
+			continue;
+		} else {
+			merged += line + "\r\n";
+		}
+		if (startsWith(line, "a=mid:")) {
+			merged += candidates[line.substr(6)];
+			if (first)
+				merged += candidates[""];
+			first = false;
+		}
+	}
+	return true;
 }
 
+CustomWebrtcImpl::CustomWebrtcImpl() {}
+
 CustomWebrtcImpl::~CustomWebrtcImpl()
 {
 	// Disconnect just in case
@@ -48,48 +191,278 @@ bool CustomWebrtcImpl::open(const std::string &sdp,
 {
 	info("WS-OPEN: stream_name: %s", stream_name.c_str());
 
-	RestClient::Connection *conn = new RestClient::Connection("");
-	RestClient::HeaderFields headers;
-	headers["Authorization"] = "Bearer " + this->token;
-	headers["Content-Type"] = "application/sdp";
-	headers["Accept"] = "application/sdp";
-	conn->SetHeaders(headers);
-	conn->SetTimeout(5);
-	// enable following of redirects (default is off)
-	conn->FollowRedirects(true);
-	// and limit the number of redirects (default is -1, unlimited)
-	conn->FollowRedirects(true, 3);
-	RestClient::Response r = conn->post(this->serverUrl, sdp);
-	delete conn;
-	RestClient::disable();
+	{
+		// The offer does not wait for ICE gathering, the candidates
+		// are trickled once the session exists
+		std::lock_guard<std::mutex> lock(mutex);
+		resourceUrl.clear();
+		etag.clear();
+		iceUfrag.clear();
+		icePwd.clear();
+		mediaLines.clear();
+		trickleSupported = true;
+		for (const std::string &line : splitLines(sdp)) {
+			if (startsWith(line, "m="))
+				mediaLines.emplace_back("", line);
+			else if (startsWith(line, "a=mid:") &&
+				 !mediaLines.empty())
+				mediaLines.back().first = line.substr(6);
+			else if (startsWith(line, "a=ice-ufrag:") &&
+				 iceUfrag.empty())
+				iceUfrag = line.substr(12);
+			else if (startsWith(line, "a=ice-pwd:") &&
+				 icePwd.empty())
+				icePwd = line.substr(10);
+		}
+	}
+
+	// The answer comes through the listener, from the worker
+	post([this, sdp]() { sendOffer(sdp); });
+
+	// OK
+	return true;
+}
+
+bool CustomWebrtcImpl::trickle(const std::string &mid, int index,
+			       const std::string &candidate, bool last)
+{
+	bool flush = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!trickleSupported)
+			return true;
+		if (last) {
+			endOfCandidates = true;
+		} else {
+			std::string section = mid;
+			if (section.empty() && index >= 0 &&
+			    index < (int)mediaLines.size())
+				section = mediaLines[index].first;
+			candidates.emplace_back(section, candidate);
+		}
+		// Candidates gathered while a PATCH is queued go with it
+		if (!flushPending)
+			flush = flushPending = true;
+	}
+	if (flush)
+		post([this]() { sendCandidates(); });
+	return true;
+}
+
+bool CustomWebrtcImpl::restartIce(const std::string &sdp)
+{
+	std::string ufrag;
+	std::string pwd;
+	for (const std::string &line : splitLines(sdp)) {
+		if (startsWith(line, "a=ice-ufrag:") && ufrag.empty())
+			ufrag = line.substr(12);
+		else if (startsWith(line, "a=ice-pwd:") && pwd.empty())
+			pwd = line.substr(10);
+	}
+
+	std::string fragment;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (resourceUrl.empty() || ufrag.empty() || pwd.empty())
+			return false;
+		iceUfrag = ufrag;
+		icePwd = pwd;
+		// Candidates of the previous ICE generation are stale
+		candidates.clear();
+		endOfCandidates = false;
+		fragment = buildFragment(ufrag, pwd, mediaLines, {}, false);
+	}
+	info("WHIP ICE restart");
+	post([this, fragment]() { sendRestart(fragment); });
+	return true;
+}
+
+bool CustomWebrtcImpl::disconnect(bool /* wait */)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		// Pending candidates are of no use anymore
+		tasks.clear();
+	}
+	cv.notify_all();
+	if (worker.joinable())
+		worker.join();
+
+	std::string url;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = false;
+		flushPending = false;
+		candidates.clear();
+		url = resourceUrl;
+		resourceUrl.clear();
+	}
+	if (url.empty())
+		return true;
+
+	// Tear down the session on the endpoint
+	RestClient::Response r =
+		whipRequest("DELETE", url, this->token, "", "", "", 2);
+	if (r.code < 200 || r.code >= 300)
+		warn("WHIP DELETE %s failed, code: %d", url.c_str(), r.code);
+	return true;
+}
+
+void CustomWebrtcImpl::post(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+		if (!worker.joinable())
+			worker = std::thread(&CustomWebrtcImpl::run, this);
+	}
+	cv.notify_one();
+}
+
+void CustomWebrtcImpl::run()
+{
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock,
+				[this]() { return stopping || !tasks.empty(); });
+			if (stopping)
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void CustomWebrtcImpl::sendOffer(const std::string &sdp)
+{
+	RestClient::Response r = whipRequest("POST", this->serverUrl,
+					     this->token, "application/sdp",
+					     sdp, "", 5);
 
 	if (r.code < 200 || r.code >= 300) {
 		error("Error querying publishing websocket url");
 		error("code: %d", r.code);
 		error("body: %s", r.body.c_str());
-		return false;
+		listener->onOpenedError(r.code);
+		return;
 	}
 
-	std::string answer =
-		r.body + std::string("a=x-google-flag:conference\r\n");
+	std::string location = findHeader(r.headers, "Location");
+	std::string sdpAnswer;
+	bool flush = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (location.empty()) {
+			warn("No Location in the WHIP answer, trickle ICE and ICE restarts are disabled");
+			trickleSupported = false;
+			candidates.clear();
+		} else {
+			resourceUrl = resolveUrl(location);
+		}
+		info("WHIP resource: %s", resourceUrl.c_str());
+		etag = findHeader(r.headers, "ETag");
+		answer = r.body + std::string("a=x-google-flag:conference\r\n");
+		sdpAnswer = answer;
+		// Disconnected during the POST, the session is deleted there
+		if (stopping)
+			return;
+		// Candidates gathered during the POST, unless a flush is
+		// queued already
+		flush = (!candidates.empty() || endOfCandidates) &&
+			!flushPending;
+		if (flush)
+			flushPending = true;
+	}
 
-	listener->onOpened(answer);
+	listener->onOpened(sdpAnswer);
+	if (flush)
+		post([this]() { sendCandidates(); });
+}
 
-	// OK
-	return true;
+void CustomWebrtcImpl::sendCandidates()
+{
+	std::string url;
+	std::string match;
+	std::string fragment;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		flushPending = false;
+		if (!trickleSupported) {
+			candidates.clear();
+			return;
+		}
+		// Kept until the offer POST returns the session
+		if (resourceUrl.empty() ||
+		    (candidates.empty() && !endOfCandidates))
+			return;
+		fragment = buildFragment(iceUfrag, icePwd, mediaLines,
+					 candidates, endOfCandidates);
+		candidates.clear();
+		url = resourceUrl;
+		match = etag;
+	}
+
+	debug("WHIP trickle:\n%s", fragment.c_str());
+	RestClient::Response r = whipRequest(
+		"PATCH", url, this->token, kSdpFragContentType, fragment,
+		match, 2);
+	if (r.code == 405 || r.code == 501) {
+		// Not an error, the endpoint uses the candidates of the offer
+		// and the peer reflexive ones only
+		info("WHIP endpoint does not support trickle ICE");
+		std::lock_guard<std::mutex> lock(mutex);
+		trickleSupported = false;
+	} else if (r.code < 200 || r.code >= 300) {
+		warn("WHIP trickle failed, code: %d", r.code);
+	}
 }
 
-bool CustomWebrtcImpl::trickle(const std::string & /* mid       */,
-			       int /* index     */,
-			       const std::string & /* candidate */,
-			       bool /* last      */)
+void CustomWebrtcImpl::sendRestart(const std::string &fragment)
 {
-	return true;
+	std::string url;
+	std::string previous;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		url = resourceUrl;
+		previous = answer;
+	}
+
+	RestClient::Response r = whipRequest("PATCH", url, this->token,
+					     kSdpFragContentType, fragment,
+					     "*", 5);
+	std::string merged;
+	if (r.code != 200 || !mergeRestart(previous, r.body, merged)) {
+		warn("WHIP ICE restart failed, code: %d", r.code);
+		listener->onIceRestartError(r.code);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		answer = merged;
+		std::string tag = findHeader(r.headers, "ETag");
+		if (!tag.empty())
+			etag = tag;
+	}
+	listener->onIceRestarted(merged);
 }
 
-bool CustomWebrtcImpl::disconnect(bool /* wait */)
+// Location may be relative to the endpoint URL
+std::string CustomWebrtcImpl::resolveUrl(const std::string &location) const
 {
-	return true;
+	if (location.find("://") != std::string::npos)
+		return location;
+	size_t scheme = serverUrl.find("://");
+	size_t path = scheme == std::string::npos
+			      ? std::string::npos
+			      : serverUrl.find('/', scheme + 3);
+	std::string origin = serverUrl.substr(0, path);
+	if (location[0] == '/' || path == std::string::npos)
+		return origin + (location[0] == '/' ? "" : "/") + location;
+	return serverUrl.substr(0, serverUrl.rfind('/') + 1) + location;
 }
 
 std::string CustomWebrtcImpl::sanitizeString(const std::string &s)
@@ -14,6 +14,14 @@
 #include "websocketpp/config/asio_client.hpp"
 #include "websocketpp/client.hpp"
 
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
 typedef websocketpp::client<websocketpp::config::asio_tls_client> Client;
 
 class CustomWebrtcImpl : public WebsocketClient {
@@ -29,9 +37,9 @@ public:
 	bool open(const std::string &sdp, const std::string &video_codec,
 		  const std::string &audio_codec,
 		  const std::string &stream_name) override;
-	bool trickle(const std::string & /* mid */, int /* index */,
-		     const std::string & /* candidate */,
-		     bool /* last */) override;
+	bool trickle(const std::string &mid, int index,
+		     const std::string &candidate, bool last) override;
+	bool restartIce(const std::string &sdp) override;
 	bool disconnect(bool /* wait */) override;
 
 private:
@@ -39,4 +47,39 @@ private:
 	std::string token;
 	WebsocketClient::Listener *listener = nullptr;
 	std::string sanitizeString(const std::string &s);
+
+	// WHIP session: the resource created by the offer POST (Location
+	// header) takes the trickled candidates, the ICE restarts and the
+	// final DELETE. Protected by mutex.
+	std::string resourceUrl;
+	std::string etag;
+	// Answer handed to the listener, updated by ICE restarts
+	std::string answer;
+	// Local ICE credentials and (mid, m-line) of each media section,
+	// repeated in every trickle-ice-sdpfrag
+	std::string iceUfrag;
+	std::string icePwd;
+	std::vector<std::pair<std::string, std::string>> mediaLines;
+	// (mid, candidate) gathered but not sent yet
+	std::vector<std::pair<std::string, std::string>> candidates;
+	bool endOfCandidates = false;
+	bool flushPending = false;
+	// Cleared if the endpoint rejects trickle ICE
+	bool trickleSupported = true;
+
+	// The offer POST and the PATCH requests run on a worker so that the
+	// WebRTC signaling thread never waits for the endpoint. Candidates
+	// trickled before the POST returned the session (resourceUrl) are
+	// kept and sent right after it.
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable cv;
+	std::deque<std::function<void()>> tasks;
+	bool stopping = false;
+	void post(std::function<void()> task);
+	void run();
+	void sendOffer(const std::string &sdp);
+	void sendCandidates();
+	void sendRestart(const std::string &fragment);
+	std::string resolveUrl(const std::string &location) const;
 };
@@ -42,7 +42,33 @@ bool MillicastWebsocketClientImpl::connect(const std::string &publish_api_url,
 {
 	this->token = sanitizeString(token);
 
-	RestClient::init();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (stopping)
+		return false;
+	// Async
+	thread = std::thread([=]() {
+		if (!connectWebsocket(publish_api_url, stream_name, listener)) {
+			{
+				// Not reported once disconnected
+				std::lock_guard<std::mutex> lock(mutex);
+				if (stopping)
+					return;
+			}
+			listener->onLoggedError(0);
+			return;
+		}
+		// Start ASIO io_service run loop
+		// (single connection will be made to the server)
+		client.run(); // will exit when this connection is closed
+	});
+	// OK
+	return true;
+}
+
+bool MillicastWebsocketClientImpl::connectWebsocket(
+	const std::string &publish_api_url, const std::string &stream_name,
+	WebsocketClient::Listener *listener)
+{
 	RestClient::Connection *conn = new RestClient::Connection("");
 	RestClient::HeaderFields headers;
 	headers["Authorization"] = "Bearer " + this->token;
@@ -52,7 +78,6 @@ bool MillicastWebsocketClientImpl::connect(const std::string &publish_api_url,
 	json data = {{"streamName", sanitizeString(stream_name)}};
 	RestClient::Response r = conn->post(publish_api_url, data.dump());
 	delete conn;
-	RestClient::disable();
 
 	std::string url;
 	std::string jwt;
@@ -95,18 +120,16 @@ bool MillicastWebsocketClientImpl::connect(const std::string &publish_api_url,
 		std::string wss = url + "?token=" + jwt;
 		info("Connection URL:   %s", wss.c_str());
 
-		connection = client.get_connection(wss, ec);
-		if (!connection)
-			warn("No Connection");
-		connection->set_close_handshake_timeout(5000);
-		if (ec) {
+		Client::connection_ptr con = client.get_connection(wss, ec);
+		if (ec || !con) {
 			error("Error establishing websocket connection: %s",
 			      ec.message().c_str());
-			return 0;
+			return false;
 		}
+		con->set_close_handshake_timeout(5000);
 
 		// --- Message handler
-		connection->set_message_handler([=](websocketpp::
+		con->set_message_handler([=](websocketpp::
 							    connection_hdl /* con */,
 						    message_ptr frame) {
 			const char *x = frame->get_payload().c_str();
@@ -143,7 +166,7 @@ bool MillicastWebsocketClientImpl::connect(const std::string &publish_api_url,
 		});
 
 		// --- Open handler
-		connection->set_open_handler(
+		con->set_open_handler(
 			[=](websocketpp::connection_hdl /* con */) {
 				// Launch event
 				listener->onConnected();
@@ -152,35 +175,38 @@ bool MillicastWebsocketClientImpl::connect(const std::string &publish_api_url,
 			});
 
 		// --- Close handler
-		connection->set_close_handler([=](...) {
+		con->set_close_handler([=](...) {
 			info("> set_close_handler called");
-			// Don't wait for connection close
-			thread.detach();
-			// Remove connection
-			connection = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				// Don't wait for connection close
+				if (thread.joinable())
+					thread.detach();
+				// Remove connection
+				connection = nullptr;
+			}
 			// Call listener
 			listener->onDisconnected();
 		});
 
 		// -- Failure handler
-		connection->set_fail_handler([=](...) {
+		con->set_fail_handler([=](...) {
 			info("> set_fail_handler called");
 			listener->onDisconnected();
 		});
 
 		// -- HTTP handler
-		connection->set_http_handler(
+		con->set_http_handler(
 			[=](...) { info("> https called"); });
 
+		std::lock_guard<std::mutex> lock(mutex);
+		// Disconnected during the REST request
+		if (stopping)
+			return false;
+		connection = con;
 		// Note that connect here only requests a connection. No network messages
-		// exchanged until the event loop starts running in the next line.
-		client.connect(connection);
-		// Async
-		thread = std::thread([&]() {
-			// Start ASIO io_service run loop
-			// (single connection will be made to the server)
-			client.run(); // will exit when this connection is closed
-		});
+		// exchanged until the event loop starts running.
+		client.connect(con);
 	} catch (const websocketpp::exception &e) {
 		warn("connect exception: %s", e.what());
 		return false;
@@ -239,10 +265,31 @@ bool MillicastWebsocketClientImpl::trickle(const std::string & /* mid       */,
 	return true;
 }
 
+bool MillicastWebsocketClientImpl::restartIce(const std::string & /* sdp */)
+{
+	// Not supported by the publish websocket
+	return false;
+}
+
 bool MillicastWebsocketClientImpl::disconnect(bool /* wait */)
 {
-	if (!connection)
+	Client::connection_ptr connection;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		connection = this->connection;
+	}
+	if (!connection) {
+		// Still in the REST request, or failed: the thread exits
+		// without calling the listener
+		if (thread.joinable()) {
+			if (thread.get_id() == std::this_thread::get_id())
+				thread.detach();
+			else
+				thread.join();
+		}
 		return true;
+	}
 	websocketpp::lib::error_code ec;
 	try {
 		json close = {{"type", "cmd"}, {"name", "unpublish"}};
@@ -267,6 +314,7 @@ bool MillicastWebsocketClientImpl::disconnect(bool /* wait */)
 		client.set_close_handler([](...) {});
 		client.set_fail_handler([](...) {});
 		// Detach thread
+		std::lock_guard<std::mutex> lock(mutex);
 		if (thread.joinable())
 			thread.detach();
 	} catch (const websocketpp::exception &e) {
@@ -14,6 +14,9 @@
 #include "websocketpp/config/asio_client.hpp"
 #include "websocketpp/client.hpp"
 
+#include <mutex>
+#include <thread>
+
 typedef websocketpp::client<websocketpp::config::asio_tls_client> Client;
 
 class MillicastWebsocketClientImpl : public WebsocketClient {
@@ -32,6 +35,7 @@ public:
 	bool trickle(const std::string & /* mid */, int /* index */,
 		     const std::string & /* candidate */,
 		     bool /* last */) override;
+	bool restartIce(const std::string & /* sdp */) override;
 	bool disconnect(bool /* wait */) override;
 
 private:
@@ -40,6 +44,14 @@ private:
 	Client client;
 	Client::connection_ptr connection;
 	std::thread thread;
+	// The REST request of the websocket url runs on |thread|, ahead of
+	// the ASIO loop, so that the WebRTC signaling thread never waits for
+	// it. Protects connection, thread and stopping against disconnect.
+	std::mutex mutex;
+	bool stopping = false;
+	bool connectWebsocket(const std::string &publish_api_url,
+			      const std::string &stream_name,
+			      WebsocketClient::Listener *listener);
 
 	std::string sanitizeString(const std::string &s);
 };
@@ -4,15 +4,23 @@
 #include <openssl/opensslv.h>
 #include "MillicastWebsocketClientImpl.h"
 #include "CustomWebrtcImpl.h"
+#include "restclient-cpp/restclient.h"
 
 OBS_DECLARE_MODULE()
 
 bool obs_module_load(void)
 {
 	OPENSSL_init_ssl(0, NULL);
+	// Process wide (curl_global_init), shared by all the clients
+	RestClient::init();
 	return true;
 }
 
+void obs_module_unload(void)
+{
+	RestClient::disable();
+}
+
 WEBSOCKETCLIENT_API WebsocketClient *createWebsocketClient(int type)
 {
 	if (type == Type::Millicast)
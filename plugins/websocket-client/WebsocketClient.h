@@ -34,6 +34,10 @@ public:
 		virtual void onOpenedError(int code) = 0;
 		virtual void
 		onRemoteIceCandidate(const std::string &sdpData) = 0;
+		// Answer of an ICE restart: the previous answer with the
+		// new remote ICE credentials and candidates
+		virtual void onIceRestarted(const std::string &sdp) = 0;
+		virtual void onIceRestartError(int code) = 0;
 	};
 
 public:
@@ -48,6 +52,9 @@ public:
 			  const std::string &username) = 0;
 	virtual bool trickle(const std::string &mid, int index,
 			     const std::string &candidate, bool last) = 0;
+	// Send the new ICE credentials of an ice_restart offer, the media
+	// are not renegotiated. False if the signaling does not support it.
+	virtual bool restartIce(const std::string &sdp) = 0;
 	virtual bool disconnect(bool wait) = 0;
 };
 
@@ -495,6 +495,28 @@ RestClient::Connection::put(const std::string& url,
 
   return this->performCurlRequest(url);
 }
+/**
+ * @brief HTTP PATCH method
+ *
+ * @param url to query
+ * @param data HTTP PATCH body
+ *
+ * @return response struct
+ */
+RestClient::Response
+RestClient::Connection::patch(const std::string& url,
+                              const std::string& data) {
+  /** we want HTTP PATCH */
+  const char* http_patch = "PATCH";
+
+  /** set HTTP PATCH METHOD */
+  curl_easy_setopt(this->curlHandle, CURLOPT_CUSTOMREQUEST, http_patch);
+  /** set patch fields */
+  curl_easy_setopt(this->curlHandle, CURLOPT_POSTFIELDS, data.c_str());
+  curl_easy_setopt(this->curlHandle, CURLOPT_POSTFIELDSIZE, data.size());
+
+  return this->performCurlRequest(url);
+}
 /**
  * @brief HTTP DELETE method
  *
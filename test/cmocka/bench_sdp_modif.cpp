@@ -0,0 +1,54 @@
+/* Times the offer munging of WebRTCStream on the Chrome offer fixture.
+ * Built with the tests but not run by ctest:
+ *   bench_sdp_modif [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SDPModif.h"
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+	if (iterations <= 0)
+		iterations = 10000;
+
+	std::ifstream file(std::string(SDP_FIXTURES_DIR) + "/chrome-offer.sdp",
+			   std::ios::binary);
+	if (!file) {
+		fprintf(stderr, "missing fixture chrome-offer.sdp\n");
+		return 1;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	const std::string offer = contents.str();
+
+	size_t total_size = 0;
+	auto begin = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) {
+		SDPModif sdp(offer);
+		std::vector<int> audio_payloads;
+		std::vector<int> video_payloads;
+
+		sdp.forcePayload(audio_payloads, video_payloads, "opus", "h264",
+				 1, "42e01f", 0);
+		sdp.bitrateMaxMin(2500, video_payloads);
+		sdp.stereo(128);
+		sdp.opus(SDPModif::OpusParameters());
+		total_size += sdp.toString().size();
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double us = std::chrono::duration<double, std::micro>(end - begin)
+			    .count();
+	printf("%d offers munged in %.1f ms, %.2f us per offer (%zu bytes)\n",
+	       iterations, us / 1000.0, us / iterations,
+	       total_size / iterations);
+	return 0;
+}
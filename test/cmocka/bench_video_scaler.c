@@ -0,0 +1,174 @@
+/* Times the built-in scaler against swscale, as video-scaler-ffmpeg.c calls
+ * it, on the resizes raw outputs usually ask for.
+ * Built with the tests but not run by ctest:
+ *   bench_video_scaler [iterations] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libswscale/swscale.h>
+
+#include <media-io/video-frame.h>
+#include <media-io/video-scaler-simd.h>
+#include <util/platform.h>
+
+struct bench_case {
+	enum video_format format;
+	enum video_scale_type type;
+	uint32_t src_width;
+	uint32_t src_height;
+	uint32_t dst_width;
+	uint32_t dst_height;
+};
+
+/* fast bilinear first, video-io scales raw outputs with it */
+static const struct bench_case cases[] = {
+	{VIDEO_FORMAT_NV12, VIDEO_SCALE_FAST_BILINEAR, 1920, 1080, 1280, 720},
+	{VIDEO_FORMAT_NV12, VIDEO_SCALE_FAST_BILINEAR, 3840, 2160, 1920, 1080},
+	{VIDEO_FORMAT_I420, VIDEO_SCALE_FAST_BILINEAR, 1920, 1080, 1280, 720},
+	{VIDEO_FORMAT_NV12, VIDEO_SCALE_BILINEAR, 1920, 1080, 1280, 720},
+	{VIDEO_FORMAT_NV12, VIDEO_SCALE_BICUBIC, 1920, 1080, 1280, 720},
+	{VIDEO_FORMAT_NV12, VIDEO_SCALE_BILINEAR, 3840, 2160, 1920, 1080},
+	{VIDEO_FORMAT_I420, VIDEO_SCALE_BILINEAR, 1920, 1080, 1280, 720},
+	{VIDEO_FORMAT_I420, VIDEO_SCALE_BILINEAR, 3840, 2160, 1920, 1080},
+};
+
+static int get_sws_format(enum video_format format)
+{
+	return format == VIDEO_FORMAT_NV12 ? AV_PIX_FMT_NV12
+					   : AV_PIX_FMT_YUV420P;
+}
+
+/* Same flags as video-scaler-ffmpeg.c */
+static int get_sws_flags(enum video_scale_type type)
+{
+	switch (type) {
+	case VIDEO_SCALE_BICUBIC:
+		return SWS_BICUBIC;
+	case VIDEO_SCALE_BILINEAR:
+		return SWS_BILINEAR | SWS_AREA;
+	default:
+		return SWS_FAST_BILINEAR;
+	}
+}
+
+static const char *get_type_name(enum video_scale_type type)
+{
+	switch (type) {
+	case VIDEO_SCALE_BICUBIC:
+		return "bicubic";
+	case VIDEO_SCALE_BILINEAR:
+		return "bilinear";
+	default:
+		return "fast bilinear";
+	}
+}
+
+static struct video_scale_info make_info(enum video_format format,
+					 uint32_t width, uint32_t height)
+{
+	struct video_scale_info info = {
+		.format = format,
+		.width = width,
+		.height = height,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+	return info;
+}
+
+static double run_simd(const struct bench_case *bench,
+		       struct video_frame *input, struct video_frame *output,
+		       int iterations)
+{
+	struct video_scale_info src = make_info(
+		bench->format, bench->src_width, bench->src_height);
+	struct video_scale_info dst = make_info(
+		bench->format, bench->dst_width, bench->dst_height);
+
+	struct simd_scaler *scaler =
+		simd_scaler_create(&dst, &src, bench->type);
+	if (!scaler)
+		return -1.0;
+
+	uint64_t begin = os_gettime_ns();
+	for (int i = 0; i < iterations; i++)
+		simd_scaler_scale(scaler, output->data, output->linesize,
+				  (const uint8_t *const *)input->data,
+				  input->linesize);
+	uint64_t end = os_gettime_ns();
+
+	simd_scaler_destroy(scaler);
+	return (double)(end - begin) / 1000000.0 / iterations;
+}
+
+/* swscale writes to its own buffer, copied to the output by video-io */
+static double run_swscale(const struct bench_case *bench,
+			  struct video_frame *input, struct video_frame *output,
+			  int iterations)
+{
+	struct SwsContext *sws = sws_getContext(
+		bench->src_width, bench->src_height,
+		get_sws_format(bench->format), bench->dst_width,
+		bench->dst_height, get_sws_format(bench->format),
+		get_sws_flags(bench->type), NULL, NULL, NULL);
+	if (!sws)
+		return -1.0;
+
+	struct video_frame scaled;
+	video_frame_init(&scaled, bench->format, bench->dst_width,
+			 bench->dst_height);
+
+	uint64_t begin = os_gettime_ns();
+	for (int i = 0; i < iterations; i++) {
+		sws_scale(sws, (const uint8_t *const *)input->data,
+			  (const int *)input->linesize, 0, bench->src_height,
+			  scaled.data, (const int *)scaled.linesize);
+		video_frame_copy(output, &scaled, bench->format,
+				 bench->dst_height);
+	}
+	uint64_t end = os_gettime_ns();
+
+	video_frame_free(&scaled);
+	sws_freeContext(sws);
+	return (double)(end - begin) / 1000000.0 / iterations;
+}
+
+int main(int argc, char *argv[])
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 100;
+	if (iterations <= 0)
+		iterations = 100;
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		const struct bench_case *bench = &cases[i];
+		struct video_frame input, output;
+
+		video_frame_init(&input, bench->format, bench->src_width,
+				 bench->src_height);
+		video_frame_init(&output, bench->format, bench->dst_width,
+				 bench->dst_height);
+		for (size_t p = 0; p < MAX_AV_PLANES && input.data[p]; p++) {
+			uint32_t rows = p ? bench->src_height / 2
+					  : bench->src_height;
+			memset(input.data[p], (int)(p * 40 + 60),
+			       input.linesize[p] * rows);
+		}
+
+		double simd = run_simd(bench, &input, &output, iterations);
+		double sws = run_swscale(bench, &input, &output, iterations);
+
+		printf("%s %s %ux%u -> %ux%u: built-in %.2f ms, "
+		       "swscale %.2f ms per frame\n",
+		       get_video_format_name(bench->format),
+		       get_type_name(bench->type),
+		       bench->src_width, bench->src_height, bench->dst_width,
+		       bench->dst_height, simd, sws);
+
+		video_frame_free(&input);
+		video_frame_free(&output);
+	}
+
+	return 0;
+}
@@ -0,0 +1,124 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include "AudioChannelLayout.h"
+
+#define assert_near(a, b) assert_true(fabs((double)(a) - (double)(b)) < 1e-6)
+
+static const float half_power = 0.70710678f;
+
+/* Gain of |input| in |output| of a matrix for |speakers| */
+static float gain(const std::vector<float> &matrix,
+		  enum speaker_layout speakers, size_t output, size_t input)
+{
+	return matrix[output * get_audio_channels(speakers) + input];
+}
+
+static void layout_test(void **state)
+{
+	AudioChannelLayout mono = AudioChannelLayout::ForSpeakers(SPEAKERS_MONO);
+	assert_int_equal(mono.channels, 1);
+	assert_false(mono.surround());
+	assert_string_equal(mono.codec(), "opus");
+
+	AudioChannelLayout stereo =
+		AudioChannelLayout::ForSpeakers(SPEAKERS_STEREO);
+	assert_int_equal(stereo.channels, 2);
+	assert_string_equal(stereo.codec(), "opus");
+
+	/* Same stream layouts as libwebrtc */
+	AudioChannelLayout surround51 =
+		AudioChannelLayout::ForSpeakers(SPEAKERS_5POINT1);
+	assert_int_equal(surround51.channels, 6);
+	assert_int_equal(surround51.num_streams, 4);
+	assert_int_equal(surround51.coupled_streams, 2);
+	assert_string_equal(surround51.channel_mapping.c_str(), "0,4,1,2,3,5");
+	assert_string_equal(surround51.codec(), "multiopus");
+
+	AudioChannelLayout surround71 =
+		AudioChannelLayout::ForSpeakers(SPEAKERS_7POINT1);
+	assert_int_equal(surround71.channels, 8);
+	assert_int_equal(surround71.num_streams, 5);
+	assert_int_equal(surround71.coupled_streams, 3);
+	assert_string_equal(surround71.channel_mapping.c_str(),
+			    "0,6,1,4,5,2,3,7");
+
+	/* The other surround layouts go as 5.1 */
+	for (enum speaker_layout speakers :
+	     {SPEAKERS_2POINT1, SPEAKERS_4POINT0, SPEAKERS_4POINT1})
+		assert_int_equal(
+			AudioChannelLayout::ForSpeakers(speakers).channels, 6);
+}
+
+static void passthrough_test(void **state)
+{
+	/* Sent as they are, no mix */
+	assert_true(AudioMixMatrix(SPEAKERS_MONO, 1).empty());
+	assert_true(AudioMixMatrix(SPEAKERS_STEREO, 2).empty());
+	assert_true(AudioMixMatrix(SPEAKERS_5POINT1, 6).empty());
+	assert_true(AudioMixMatrix(SPEAKERS_7POINT1, 8).empty());
+}
+
+static void downmix_test(void **state)
+{
+	/* 5.1 into stereo: center and surrounds at -3 dB, LFE dropped */
+	std::vector<float> matrix = AudioMixMatrix(SPEAKERS_5POINT1, 2);
+	assert_int_equal(matrix.size(), 2 * 6);
+
+	const float left[] = {1.0f, 0.0f, half_power, 0.0f, half_power, 0.0f};
+	const float right[] = {0.0f, 1.0f, half_power, 0.0f, 0.0f, half_power};
+	for (size_t i = 0; i < 6; i++) {
+		assert_near(gain(matrix, SPEAKERS_5POINT1, 0, i), left[i]);
+		assert_near(gain(matrix, SPEAKERS_5POINT1, 1, i), right[i]);
+	}
+
+	/* Stereo into mono */
+	matrix = AudioMixMatrix(SPEAKERS_STEREO, 1);
+	assert_int_equal(matrix.size(), 2);
+	assert_near(matrix[0], half_power);
+	assert_near(matrix[1], half_power);
+
+	/* 7.1 into 5.1: side into back */
+	matrix = AudioMixMatrix(SPEAKERS_7POINT1, 6);
+	assert_int_equal(matrix.size(), 6 * 8);
+	assert_near(gain(matrix, SPEAKERS_7POINT1, 0, 6), half_power);
+	assert_near(gain(matrix, SPEAKERS_7POINT1, 1, 7), half_power);
+	assert_near(gain(matrix, SPEAKERS_7POINT1, 3, 3), 1.0f);
+	assert_near(gain(matrix, SPEAKERS_7POINT1, 4, 4), 1.0f);
+}
+
+static void upmix_test(void **state)
+{
+	/* 4.0 into 5.1: back center split over the back pair */
+	std::vector<float> matrix = AudioMixMatrix(SPEAKERS_4POINT0, 6);
+	assert_int_equal(matrix.size(), 6 * 4);
+	for (size_t i = 0; i < 3; i++)
+		assert_near(gain(matrix, SPEAKERS_4POINT0, i, i), 1.0f);
+	assert_near(gain(matrix, SPEAKERS_4POINT0, 3, 3), 0.0f);
+	assert_near(gain(matrix, SPEAKERS_4POINT0, 4, 3), half_power);
+	assert_near(gain(matrix, SPEAKERS_4POINT0, 5, 3), half_power);
+
+	/* 2.1 into 5.1: LFE kept */
+	matrix = AudioMixMatrix(SPEAKERS_2POINT1, 6);
+	assert_int_equal(matrix.size(), 6 * 3);
+	assert_near(gain(matrix, SPEAKERS_2POINT1, 0, 0), 1.0f);
+	assert_near(gain(matrix, SPEAKERS_2POINT1, 1, 1), 1.0f);
+	assert_near(gain(matrix, SPEAKERS_2POINT1, 3, 2), 1.0f);
+	assert_near(gain(matrix, SPEAKERS_2POINT1, 2, 0), 0.0f);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(layout_test),
+		cmocka_unit_test(passthrough_test),
+		cmocka_unit_test(downmix_test),
+		cmocka_unit_test(upmix_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,168 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdlib.h>
+
+#include "AudioChannelLayout.h"
+#include "AudioChunker.h"
+
+/* Chunks handed to the callback */
+struct chunks {
+	std::vector<const int16_t *> pointers;
+	std::vector<int16_t> samples;
+	size_t frames = 0;
+	size_t count = 0;
+};
+
+static void push(AudioChunker &chunker, uint8_t *const *data, uint32_t frames,
+		 chunks &out)
+{
+	chunker.Push(data, frames, [&](const int16_t *chunk, size_t count) {
+		assert_int_equal(count, chunker.frames_per_chunk());
+		out.pointers.push_back(chunk);
+		out.samples.insert(out.samples.end(), chunk,
+				   chunk + count * chunker.channels());
+		out.frames += count;
+		out.count++;
+	});
+}
+
+static void in_place_test(void **state)
+{
+	AudioChunker chunker;
+	chunker.Configure(AUDIO_FORMAT_16BIT, 48000, 2);
+	assert_int_equal(chunker.frames_per_chunk(), 480);
+
+	/* 16 bit interleaved on a chunk boundary: no copy */
+	std::vector<int16_t> input(960 * 2);
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = (int16_t)i;
+	uint8_t *data[] = {(uint8_t *)input.data()};
+
+	chunks out;
+	push(chunker, data, 960, out);
+	assert_int_equal(out.count, 2);
+	assert_ptr_equal(out.pointers[0], input.data());
+	assert_ptr_equal(out.pointers[1], input.data() + 480 * 2);
+}
+
+static void rechunk_test(void **state)
+{
+	AudioChunker chunker;
+	chunker.Configure(AUDIO_FORMAT_16BIT, 44100, 2);
+	assert_int_equal(chunker.frames_per_chunk(), 441);
+
+	/* OBS blocks of 1024 frames into 441 frame chunks, in order */
+	std::vector<int16_t> input(1024 * 2 * 3);
+	for (size_t i = 0; i < input.size(); i++)
+		input[i] = (int16_t)(i & 0x7fff);
+
+	chunks out;
+	for (size_t block = 0; block < 3; block++) {
+		uint8_t *data[] = {
+			(uint8_t *)(input.data() + block * 1024 * 2)};
+		push(chunker, data, 1024, out);
+	}
+	/* 3072 frames: 6 chunks, 426 frames left */
+	assert_int_equal(out.count, 6);
+	assert_int_equal(out.frames, 6 * 441);
+	assert_memory_equal(out.samples.data(), input.data(),
+			    out.samples.size() * sizeof(int16_t));
+
+	/* The remainder is dropped by Reset */
+	chunker.Reset();
+	uint8_t *data[] = {(uint8_t *)input.data()};
+	chunks next;
+	push(chunker, data, 441, next);
+	assert_int_equal(next.count, 1);
+	assert_memory_equal(next.samples.data(), input.data(),
+			    441 * 2 * sizeof(int16_t));
+}
+
+static void convert_test(void **state)
+{
+	AudioChunker chunker;
+	chunker.Configure(AUDIO_FORMAT_FLOAT_PLANAR, 48000, 2);
+
+	/* Float planar into 16 bit interleaved, clamped */
+	std::vector<float> left(480), right(480);
+	for (size_t i = 0; i < 480; i++) {
+		left[i] = i % 2 ? 0.5f : -0.5f;
+		right[i] = i % 2 ? 2.0f : -2.0f;
+	}
+	uint8_t *data[] = {(uint8_t *)left.data(), (uint8_t *)right.data()};
+
+	chunks out;
+	push(chunker, data, 480, out);
+	assert_int_equal(out.count, 1);
+	for (size_t i = 0; i < 480; i++) {
+		assert_int_equal(out.samples[i * 2], i % 2 ? 16383 : -16383);
+		assert_int_equal(out.samples[i * 2 + 1],
+				 i % 2 ? 32767 : -32768);
+	}
+
+	/* Unsigned 8 bit interleaved */
+	chunker.Configure(AUDIO_FORMAT_U8BIT, 48000, 1);
+	std::vector<uint8_t> u8(480, 192);
+	uint8_t *u8_data[] = {u8.data()};
+	chunks u8_out;
+	push(chunker, u8_data, 480, u8_out);
+	assert_int_equal(u8_out.count, 1);
+	assert_int_equal(u8_out.samples[0], 64 << 8);
+}
+
+static void mix_test(void **state)
+{
+	AudioChunker chunker;
+	chunker.Configure(AUDIO_FORMAT_FLOAT_PLANAR, 48000, 6);
+	chunker.SetMix(2, AudioMixMatrix(SPEAKERS_5POINT1, 2));
+	assert_int_equal(chunker.channels(), 2);
+
+	/* FL, FR, FC, LFE, BL, BR */
+	const float levels[] = {0.1f, -0.1f, 0.2f, 0.9f, 0.3f, -0.3f};
+	std::vector<std::vector<float>> planes;
+	for (float level : levels)
+		planes.push_back(std::vector<float>(480, level));
+	uint8_t *data[6];
+	for (size_t ch = 0; ch < 6; ch++)
+		data[ch] = (uint8_t *)planes[ch].data();
+
+	/* 3 + 477 frames: the vector loop and its scalar tail */
+	chunks out;
+	uint8_t *head[6], *tail[6];
+	for (size_t ch = 0; ch < 6; ch++) {
+		head[ch] = data[ch];
+		tail[ch] = (uint8_t *)(planes[ch].data() + 3);
+	}
+	push(chunker, head, 3, out);
+	assert_int_equal(out.count, 0);
+	push(chunker, tail, 477, out);
+	assert_int_equal(out.count, 1);
+
+	const float h = 0.70710678f;
+	const int left = (int)((0.1f + h * 0.2f + h * 0.3f) * 32767.0f);
+	const int right = (int)((-0.1f + h * 0.2f - h * 0.3f) * 32767.0f);
+	for (size_t i = 0; i < 480; i++) {
+		/* Rounded by the vector loop, truncated by the tail */
+		assert_true(abs(out.samples[i * 2] - left) <= 1);
+		assert_true(abs(out.samples[i * 2 + 1] - right) <= 1);
+	}
+
+	/* No matrix: back to the input channels */
+	chunker.SetMix(2, std::vector<float>());
+	assert_int_equal(chunker.channels(), 6);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(in_place_test),
+		cmocka_unit_test(rechunk_test),
+		cmocka_unit_test(convert_test),
+		cmocka_unit_test(mix_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
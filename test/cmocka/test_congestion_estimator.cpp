@@ -0,0 +1,165 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "CongestionEstimator.h"
+
+#define assert_near(a, b) assert_true(fabs((double)(a) - (double)(b)) < 1e-6)
+
+static const double target_bps = 2500000.0;
+
+/* Each test starts from a single layer with twice the bandwidth it needs */
+static int setup(void **state)
+{
+	webrtc_stats *stats = (webrtc_stats *)calloc(1, sizeof(webrtc_stats));
+	if (!stats)
+		return -1;
+	stats->num_layers = 1;
+	stats->available_outgoing_bitrate = 2 * target_bps;
+	*state = stats;
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	free(*state);
+	return 0;
+}
+
+static void idle_test(void **state)
+{
+	CongestionEstimator estimator(1.0);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	for (int i = 0; i < 10; i++) {
+		stats.layers[0].packets_sent += 100;
+		assert_near(estimator.Update(stats, target_bps), 0.0);
+	}
+}
+
+static void loss_test(void **state)
+{
+	CongestionEstimator estimator(1.0);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	/* 10 % lost is full congestion, the worst of audio and video counts */
+	stats.video_fraction_lost = 0.02;
+	stats.audio_fraction_lost = 0.05;
+	assert_near(estimator.Update(stats, target_bps), 0.5);
+
+	stats.video_fraction_lost = 0.5;
+	assert_near(estimator.Update(stats, target_bps), 1.0);
+}
+
+static void bandwidth_test(void **state)
+{
+	CongestionEstimator estimator(1.0);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	stats.available_outgoing_bitrate = target_bps / 4;
+	assert_near(estimator.Update(stats, target_bps), 0.75);
+
+	/* no estimate yet, or no target: not a signal */
+	stats.available_outgoing_bitrate = 0.0;
+	assert_near(estimator.Update(stats, target_bps), 0.0);
+	stats.available_outgoing_bitrate = target_bps / 4;
+	assert_near(estimator.Update(stats, 0.0), 0.0);
+}
+
+static void pacer_test(void **state)
+{
+	CongestionEstimator estimator(1.0);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	/* the first sample has nothing to compare to */
+	stats.layers[0].packets_sent = 1000;
+	stats.layers[0].total_packet_send_delay = 100.0;
+	assert_near(estimator.Update(stats, target_bps), 0.0);
+
+	/* 100 packets waited 10 s in total: 0.1 s each, 0.5 s is full */
+	stats.layers[0].packets_sent += 100;
+	stats.layers[0].total_packet_send_delay += 10.0;
+	assert_near(estimator.Update(stats, target_bps), 0.2);
+
+	/* summed over the simulcast layers */
+	stats.num_layers = 2;
+	stats.layers[0].packets_sent += 100;
+	stats.layers[0].total_packet_send_delay += 25.0;
+	stats.layers[1].packets_sent = 0;
+	stats.layers[1].total_packet_send_delay = 0.0;
+	assert_near(estimator.Update(stats, target_bps), 0.5);
+
+	/* nothing sent since the previous sample */
+	assert_near(estimator.Update(stats, target_bps), 0.0);
+}
+
+static void worst_signal_test(void **state)
+{
+	CongestionEstimator estimator(1.0);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	stats.video_fraction_lost = 0.03;
+	stats.available_outgoing_bitrate = target_bps / 2;
+	assert_near(estimator.Update(stats, target_bps), 0.5);
+}
+
+static void smoothing_test(void **state)
+{
+	CongestionEstimator estimator(0.3);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	stats.video_fraction_lost = 0.1;
+	assert_near(estimator.Update(stats, target_bps), 0.3);
+	assert_near(estimator.Update(stats, target_bps), 0.51);
+	for (int i = 0; i < 50; i++)
+		estimator.Update(stats, target_bps);
+	assert_true(estimator.congestion() > 0.99f);
+
+	/* recovers the same way once the loss is gone */
+	stats.video_fraction_lost = 0.0;
+	for (int i = 0; i < 50; i++)
+		estimator.Update(stats, target_bps);
+	assert_true(estimator.congestion() < 0.01f);
+}
+
+static void reset_test(void **state)
+{
+	CongestionEstimator estimator(1.0);
+	webrtc_stats &stats = *(webrtc_stats *)*state;
+
+	stats.layers[0].packets_sent = 100;
+	stats.video_fraction_lost = 0.1;
+	estimator.Update(stats, target_bps);
+	assert_near(estimator.congestion(), 1.0);
+
+	estimator.Reset();
+	assert_near(estimator.congestion(), 0.0);
+
+	/* the pacer delay is measured from the next sample again */
+	stats.video_fraction_lost = 0.0;
+	stats.layers[0].packets_sent = 200;
+	stats.layers[0].total_packet_send_delay = 1000.0;
+	assert_near(estimator.Update(stats, target_bps), 0.0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(idle_test, setup, teardown),
+		cmocka_unit_test_setup_teardown(loss_test, setup, teardown),
+		cmocka_unit_test_setup_teardown(bandwidth_test, setup,
+						teardown),
+		cmocka_unit_test_setup_teardown(pacer_test, setup, teardown),
+		cmocka_unit_test_setup_teardown(worst_signal_test, setup,
+						teardown),
+		cmocka_unit_test_setup_teardown(smoothing_test, setup,
+						teardown),
+		cmocka_unit_test_setup_teardown(reset_test, setup, teardown),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
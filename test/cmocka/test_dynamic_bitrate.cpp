@@ -0,0 +1,192 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "DynamicBitrate.h"
+
+static const long bitrate = 2500; /* kbps, configured on the encoder */
+
+/* rtc::TimeMillis() of a machine up for 3 days, when the output starts */
+static const int64_t start_ms = 3 * 24 * 3600 * 1000LL;
+
+/* Sample |ms| after the start, the transport allocating |target_kbps| to the
+ * single video layer */
+static long update(DynamicBitrate &dbr, long target_kbps, int64_t ms)
+{
+	webrtc_stats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.num_layers = 1;
+	stats.layers[0].target_bitrate = target_kbps * 1000.0;
+	return dbr.Update(stats, 0.0, start_ms + ms);
+}
+
+static void disabled_test(void **state)
+{
+	DynamicBitrate dbr;
+
+	/* Nothing configured, nothing to adapt */
+	assert_int_equal(update(dbr, 100, 60000), 0);
+
+	/* No target in the stats yet */
+	dbr.Reset(bitrate, start_ms);
+	webrtc_stats stats;
+	memset(&stats, 0, sizeof(stats));
+	assert_int_equal(dbr.Update(stats, 0.0, start_ms + 60000), 0);
+	assert_int_equal(dbr.bitrate(), bitrate);
+}
+
+static void hysteresis_test(void **state)
+{
+	DynamicBitrate dbr;
+	dbr.Reset(bitrate, start_ms);
+
+	/* Within 15 % of the current bitrate, kept */
+	assert_int_equal(update(dbr, 2200, 60000), 0);
+	assert_int_equal(dbr.target(), 2200);
+	assert_int_equal(dbr.bitrate(), bitrate);
+}
+
+static void ramp_up_test(void **state)
+{
+	DynamicBitrate dbr;
+	dbr.Reset(6000, start_ms);
+
+	/* GCC starts around 300 kbps and probes up: not a decrease */
+	assert_int_equal(update(dbr, 300, 1000), 0);
+	assert_int_equal(update(dbr, 900, 2000), 0);
+	assert_int_equal(update(dbr, 1800, 3000), 0);
+	assert_int_equal(update(dbr, 3400, 4000), 0);
+	assert_int_equal(update(dbr, 5500, 5000), 0);
+	assert_int_equal(dbr.bitrate(), 6000);
+
+	/* Ramped up, decreases apply again */
+	assert_int_equal(update(dbr, 3000, 6000), 3000);
+}
+
+static void ramp_up_end_test(void **state)
+{
+	DynamicBitrate dbr;
+
+	/* The estimate stopped growing below the bitrate: the link is slower */
+	dbr.Reset(6000, start_ms);
+	assert_int_equal(update(dbr, 300, 1000), 0);
+	assert_int_equal(update(dbr, 900, 2000), 0);
+	assert_int_equal(update(dbr, 1500, 3000), 0);
+	assert_int_equal(update(dbr, 1500, 4000), 1500);
+
+	/* or still growing slowly after 30 s */
+	dbr.Reset(6000, start_ms);
+	for (int i = 1; i < 30; i++)
+		assert_int_equal(update(dbr, 1000 + i * 10, i * 1000), 0);
+	assert_int_equal(update(dbr, 1300, 30000), 1300);
+}
+
+static void restart_test(void **state)
+{
+	DynamicBitrate dbr;
+	dbr.Reset(bitrate, start_ms);
+	assert_int_equal(update(dbr, 1500, 5000), 0);
+	assert_int_equal(update(dbr, 1500, 6000), 1500);
+
+	/* A reconnection keeps the bitrate, the new estimate ramps up */
+	dbr.Restart(start_ms + 60000);
+	assert_int_equal(update(dbr, 300, 61000), 0);
+	assert_int_equal(update(dbr, 900, 62000), 0);
+	assert_int_equal(dbr.bitrate(), 1500);
+	assert_int_equal(update(dbr, 900, 63000), 900);
+}
+
+static void decrease_test(void **state)
+{
+	DynamicBitrate dbr;
+	dbr.Reset(bitrate, start_ms);
+
+	/* Held for 2 s after the start, then rounded to 100 */
+	assert_int_equal(update(dbr, 1234, 1000), 0);
+	assert_int_equal(update(dbr, 1234, 2000), 1200);
+	assert_int_equal(dbr.bitrate(), 1200);
+
+	/* Applied at once, not by steps, 2 s after the previous change */
+	assert_int_equal(update(dbr, 700, 3000), 0);
+	assert_int_equal(update(dbr, 700, 4000), 700);
+	assert_int_equal(dbr.original(), bitrate);
+}
+
+static void minimum_test(void **state)
+{
+	DynamicBitrate dbr;
+
+	/* 20 % of the configured bitrate */
+	dbr.Reset(bitrate, start_ms);
+	assert_int_equal(update(dbr, 100, 5000), 0);
+	assert_int_equal(update(dbr, 100, 6000), 500);
+
+	/* but never below 50 kbps */
+	dbr.Reset(200, start_ms);
+	assert_int_equal(update(dbr, 10, 5000), 0);
+	assert_int_equal(update(dbr, 10, 6000), 50);
+}
+
+static void increase_test(void **state)
+{
+	DynamicBitrate dbr;
+	dbr.Reset(bitrate, start_ms);
+	assert_int_equal(update(dbr, 1000, 5000), 0);
+	assert_int_equal(update(dbr, 1000, 6000), 1000);
+
+	/* Held for 10 s, then up by 10 % of the configured bitrate */
+	assert_int_equal(update(dbr, 5000, 11000), 0);
+	assert_int_equal(update(dbr, 5000, 16000), 1250);
+	assert_int_equal(update(dbr, 5000, 26000), 1500);
+
+	/* Never above the target */
+	assert_int_equal(update(dbr, 1600, 36000), 0);
+	assert_int_equal(update(dbr, 1800, 36000), 1750);
+	assert_int_equal(update(dbr, 2100, 46000), 2000);
+	assert_int_equal(update(dbr, 2100, 56000), 0);
+
+	/* The configured bitrate is reached from within the dead band */
+	assert_int_equal(update(dbr, 5000, 66000), 2250);
+	assert_int_equal(update(dbr, 5000, 76000), 2500);
+	assert_int_equal(update(dbr, 5000, 86000), 0);
+	assert_int_equal(dbr.bitrate(), bitrate);
+}
+
+static void estimate_test(void **state)
+{
+	DynamicBitrate dbr;
+	dbr.Reset(bitrate, start_ms);
+
+	/* No layer allocation, the pair estimate less the audio is used */
+	webrtc_stats stats;
+	memset(&stats, 0, sizeof(stats));
+	stats.num_layers = 1;
+	stats.available_outgoing_bitrate = 1128000.0;
+	assert_int_equal(dbr.Update(stats, 128000.0, start_ms + 5000), 0);
+	assert_int_equal(dbr.Update(stats, 128000.0, start_ms + 6000), 1000);
+	assert_int_equal(dbr.target(), 1000);
+
+	/* The layer allocation wins when there is one */
+	stats.layers[0].target_bitrate = 800000.0;
+	assert_int_equal(dbr.Update(stats, 128000.0, start_ms + 10000), 800);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(disabled_test),
+		cmocka_unit_test(hysteresis_test),
+		cmocka_unit_test(ramp_up_test),
+		cmocka_unit_test(ramp_up_end_test),
+		cmocka_unit_test(restart_test),
+		cmocka_unit_test(decrease_test),
+		cmocka_unit_test(minimum_test),
+		cmocka_unit_test(increase_test),
+		cmocka_unit_test(estimate_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
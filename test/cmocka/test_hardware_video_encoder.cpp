@@ -0,0 +1,174 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "HardwareVideoEncoder.h"
+
+#include <media/base/media_constants.h>
+#include <modules/video_coding/codecs/h264/include/h264.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+static const char *software_name = "test software";
+
+/* Stands for the builtin encoders, reports a name of its own */
+class SoftwareEncoder : public webrtc::VideoEncoder {
+public:
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback * /* callback */) override
+	{
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+	int32_t Encode(const webrtc::VideoFrame & /* frame */,
+		       const std::vector<webrtc::VideoFrameType>
+			       * /* frame_types */) override
+	{
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	void SetRates(const RateControlParameters & /* parameters */) override
+	{
+	}
+	EncoderInfo GetEncoderInfo() const override
+	{
+		EncoderInfo info;
+		info.implementation_name = software_name;
+		info.is_hardware_accelerated = false;
+		return info;
+	}
+};
+
+class SoftwareFactory : public webrtc::VideoEncoderFactory {
+public:
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override
+	{
+		return {webrtc::SdpVideoFormat(cricket::kVp8CodecName),
+			webrtc::CreateH264Format(
+				webrtc::H264::kProfileConstrainedBaseline,
+				webrtc::H264::kLevel3_1, "1")};
+	}
+	CodecInfo QueryVideoEncoder(
+		const webrtc::SdpVideoFormat & /* format */) const override
+	{
+		CodecInfo info;
+		info.is_hardware_accelerated = false;
+		info.has_internal_source = false;
+		return info;
+	}
+	std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(
+		const webrtc::SdpVideoFormat & /* format */) override
+	{
+		return std::make_unique<SoftwareEncoder>();
+	}
+};
+
+static std::unique_ptr<HardwareVideoEncoderFactory>
+make_factory(const std::string &preference)
+{
+	return std::make_unique<HardwareVideoEncoderFactory>(
+		std::make_unique<SoftwareFactory>(), preference);
+}
+
+static const webrtc::SdpVideoFormat h264 = webrtc::CreateH264Format(
+	webrtc::H264::kProfileConstrainedBaseline, webrtc::H264::kLevel3_1,
+	"1");
+static const webrtc::SdpVideoFormat vp8(cricket::kVp8CodecName);
+
+static std::string encoder_name(HardwareVideoEncoderFactory &factory,
+				const webrtc::SdpVideoFormat &format)
+{
+	std::unique_ptr<webrtc::VideoEncoder> encoder =
+		factory.CreateVideoEncoder(format);
+	assert_non_null(encoder.get());
+	return encoder->GetEncoderInfo().implementation_name;
+}
+
+static void assert_software(HardwareVideoEncoderFactory &factory)
+{
+	assert_string_equal(factory.backend().c_str(), "none");
+	assert_false(factory.QueryVideoEncoder(h264).is_hardware_accelerated);
+	assert_string_equal(encoder_name(factory, h264).c_str(),
+			    software_name);
+	assert_string_equal(encoder_name(factory, vp8).c_str(),
+			    software_name);
+	assert_int_equal(factory.GetSupportedFormats().size(), 2);
+}
+
+static void none_test(void **state)
+{
+	/* Software only, whatever this machine has */
+	auto factory = make_factory("none");
+	assert_software(*factory);
+}
+
+static void unavailable_test(void **state)
+{
+	std::vector<std::string> available =
+		HardwareVideoEncoderFactory::AvailableBackends();
+
+	/* Unknown backend */
+	auto unknown = make_factory("quicksync");
+	assert_software(*unknown);
+
+	/* Known ones, when they cannot encode here */
+	for (const char *name : {"nvenc", "vaapi"}) {
+		if (std::find(available.begin(), available.end(), name) !=
+		    available.end())
+			continue;
+		auto factory = make_factory(name);
+		assert_software(*factory);
+	}
+}
+
+static void auto_test(void **state)
+{
+	std::vector<std::string> available =
+		HardwareVideoEncoderFactory::AvailableBackends();
+	auto factory = make_factory("auto");
+
+	if (available.empty()) {
+		assert_software(*factory);
+		return;
+	}
+
+	/* First backend available, H.264 only */
+	assert_string_equal(factory->backend().c_str(), available[0].c_str());
+	assert_true(factory->QueryVideoEncoder(h264).is_hardware_accelerated);
+	assert_false(factory->QueryVideoEncoder(vp8).is_hardware_accelerated);
+	assert_int_equal(encoder_name(*factory, h264).compare(0, 7, "FFmpeg "),
+			 0);
+	assert_string_equal(encoder_name(*factory, vp8).c_str(),
+			    software_name);
+}
+
+static void backend_test(void **state)
+{
+	/* Each available backend can be picked by name */
+	for (const std::string &name :
+	     HardwareVideoEncoderFactory::AvailableBackends()) {
+		auto factory = make_factory(name);
+		assert_string_equal(factory->backend().c_str(), name.c_str());
+		assert_true(factory->QueryVideoEncoder(h264)
+				    .is_hardware_accelerated);
+		assert_int_equal(encoder_name(*factory, h264)
+					 .compare(0, 7, "FFmpeg "),
+				 0);
+	}
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(none_test),
+		cmocka_unit_test(unavailable_test),
+		cmocka_unit_test(auto_test),
+		cmocka_unit_test(backend_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
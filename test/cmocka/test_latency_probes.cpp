@@ -0,0 +1,280 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <memory>
+#include <vector>
+
+#include "LatencyProbes.h"
+
+#include <api/task_queue/default_task_queue_factory.h>
+#include <api/video/i420_buffer.h>
+#include <logging/rtc_event_log/events/rtc_event_audio_send_stream_config.h>
+#include <logging/rtc_event_log/events/rtc_event_rtp_packet_outgoing.h>
+#include <logging/rtc_event_log/rtc_stream_config.h>
+#include <media/base/media_constants.h>
+#include <modules/rtp_rtcp/source/rtp_packet_to_send.h>
+#include <modules/video_coding/include/video_error_codes.h>
+
+#include <util/platform.h>
+
+static const uint32_t video_ssrc = 1111;
+static const uint32_t audio_ssrc = 2222;
+
+/* Random start timestamps of the RTP streams, one per simulcast layer */
+static const uint32_t rtp_offsets[] = {0x9e3779b9, 0x7f4a7c15};
+
+/* Emits one image per layer, with the RTP timestamp of the frame */
+class LayeredEncoder : public webrtc::VideoEncoder {
+public:
+	explicit LayeredEncoder(int layers)
+		: layers_(layers), callback_(nullptr)
+	{
+	}
+
+	int32_t RegisterEncodeCompleteCallback(
+		webrtc::EncodedImageCallback *callback) override
+	{
+		callback_ = callback;
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	int32_t Release() override { return WEBRTC_VIDEO_CODEC_OK; }
+	int32_t Encode(const webrtc::VideoFrame &frame,
+		       const std::vector<webrtc::VideoFrameType>
+			       * /* frame_types */) override
+	{
+		for (int layer = 0; layer < layers_; layer++) {
+			webrtc::EncodedImage image;
+			image.SetTimestamp(frame.timestamp());
+			image.SetSpatialIndex(layer);
+			image._frameType =
+				webrtc::VideoFrameType::kVideoFrameKey;
+			callback_->OnEncodedImage(image, nullptr);
+		}
+		return WEBRTC_VIDEO_CODEC_OK;
+	}
+	void SetRates(const RateControlParameters & /* parameters */) override
+	{
+	}
+
+private:
+	const int layers_;
+	webrtc::EncodedImageCallback *callback_;
+};
+
+class LayeredFactory : public webrtc::VideoEncoderFactory {
+public:
+	explicit LayeredFactory(int layers) : layers_(layers) {}
+
+	std::vector<webrtc::SdpVideoFormat> GetSupportedFormats() const override
+	{
+		return {webrtc::SdpVideoFormat(cricket::kVp8CodecName)};
+	}
+	CodecInfo QueryVideoEncoder(
+		const webrtc::SdpVideoFormat & /* format */) const override
+	{
+		return CodecInfo();
+	}
+	std::unique_ptr<webrtc::VideoEncoder> CreateVideoEncoder(
+		const webrtc::SdpVideoFormat & /* format */) override
+	{
+		return std::make_unique<LayeredEncoder>(layers_);
+	}
+
+private:
+	const int layers_;
+};
+
+static void send_marker(webrtc::RtcEventLog *event_log, uint32_t ssrc,
+			uint32_t rtp_timestamp)
+{
+	webrtc::RtpPacketToSend packet(nullptr);
+	packet.SetSsrc(ssrc);
+	packet.SetTimestamp(rtp_timestamp);
+	packet.SetMarker(true);
+	event_log->Log(std::make_unique<webrtc::RtcEventRtpPacketOutgoing>(
+		packet, webrtc::PacedPacketInfo::kNotAProbe));
+}
+
+/* Stands for RtpVideoSender: adds the start timestamp of the stream and
+ * returns the RTP timestamp as the frame id. With |pacer_first| the packets
+ * leave before the call returns. */
+class RtpSender : public webrtc::EncodedImageCallback {
+public:
+	explicit RtpSender(webrtc::RtcEventLog *log)
+		: event_log(log), pacer_first(false)
+	{
+	}
+
+	Result OnEncodedImage(
+		const webrtc::EncodedImage &image,
+		const webrtc::CodecSpecificInfo * /* info */) override
+	{
+		uint32_t rtp_timestamp =
+			image.Timestamp() +
+			rtp_offsets[image.SpatialIndex().value_or(0)];
+		if (pacer_first)
+			send_marker(event_log, video_ssrc, rtp_timestamp);
+		return Result(Result::OK, rtp_timestamp);
+	}
+
+	webrtc::RtcEventLog *const event_log;
+	bool pacer_first;
+};
+
+struct probes {
+	std::unique_ptr<webrtc::TaskQueueFactory> task_queue_factory;
+	std::shared_ptr<LatencyTracer> tracer;
+	std::unique_ptr<webrtc::RtcEventLog> event_log;
+	std::unique_ptr<webrtc::VideoEncoder> encoder;
+	std::unique_ptr<RtpSender> sender;
+};
+
+static probes *make_probes(int layers)
+{
+	probes *p = new probes;
+	auto tracers = std::make_shared<LatencyTracerSet>();
+	p->tracer = std::make_shared<LatencyTracer>();
+	tracers->Add(p->tracer);
+
+	p->task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+	PacketSentEventLogFactory log_factory(p->task_queue_factory.get(),
+					      tracers);
+	p->event_log = log_factory.CreateRtcEventLog(
+		webrtc::RtcEventLog::EncodingType::Legacy);
+
+	auto config = std::make_unique<webrtc::rtclog::StreamConfig>();
+	config->local_ssrc = audio_ssrc;
+	p->event_log->Log(
+		std::make_unique<webrtc::RtcEventAudioSendStreamConfig>(
+			std::move(config)));
+
+	TracingVideoEncoderFactory encoder_factory(
+		std::make_unique<LayeredFactory>(layers), tracers);
+	p->encoder = encoder_factory.CreateVideoEncoder(
+		webrtc::SdpVideoFormat(cricket::kVp8CodecName));
+	p->sender = std::make_unique<RtpSender>(p->event_log.get());
+	p->encoder->RegisterEncodeCompleteCallback(p->sender.get());
+	return p;
+}
+
+static int setup(void **state)
+{
+	*state = make_probes(1);
+	return 0;
+}
+
+static int setup_simulcast(void **state)
+{
+	*state = make_probes(2);
+	return 0;
+}
+
+static int teardown(void **state)
+{
+	delete (probes *)*state;
+	return 0;
+}
+
+static void encode(probes &p, uint16_t frame_id, uint32_t rtp_timestamp)
+{
+	p.tracer->Delivered(frame_id, os_gettime_ns());
+	rtc::scoped_refptr<webrtc::I420Buffer> buffer =
+		webrtc::I420Buffer::Create(16, 16);
+	webrtc::VideoFrame frame = webrtc::VideoFrame::Builder()
+					   .set_video_frame_buffer(buffer)
+					   .set_timestamp_rtp(rtp_timestamp)
+					   .set_id(frame_id)
+					   .build();
+	p.encoder->Encode(frame, nullptr);
+}
+
+static uint64_t count(probes &p, webrtc_latency_stage stage)
+{
+	webrtc_latency_stats stats[WEBRTC_LATENCY_STAGES];
+	p.tracer->GetStats(stats);
+	return stats[stage].count;
+}
+
+static void offset_test(void **state)
+{
+	probes &p = *(probes *)*state;
+
+	encode(p, 1, 90000);
+	assert_int_equal(count(p, WEBRTC_LATENCY_ENCODED), 1);
+
+	/* The encoder timestamp is not the one on the wire */
+	send_marker(p.event_log.get(), video_ssrc, 90000);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 0);
+	send_marker(p.event_log.get(), video_ssrc, 90000 + rtp_offsets[0]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 1);
+
+	/* Once per frame, RTX resends the marker packet */
+	send_marker(p.event_log.get(), video_ssrc, 90000 + rtp_offsets[0]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 1);
+
+	/* Wrapping around */
+	encode(p, 2, 0xfffffff0);
+	send_marker(p.event_log.get(), video_ssrc,
+		    0xfffffff0 + rtp_offsets[0]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 2);
+}
+
+static void pacer_first_test(void **state)
+{
+	probes &p = *(probes *)*state;
+
+	encode(p, 1, 90000);
+	send_marker(p.event_log.get(), video_ssrc, 90000 + rtp_offsets[0]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 1);
+
+	/* Sent before OnEncodedImage returns, mapped with the offset of the
+	 * previous frame */
+	p.sender->pacer_first = true;
+	encode(p, 2, 93000);
+	encode(p, 3, 96000);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 3);
+}
+
+static void audio_test(void **state)
+{
+	probes &p = *(probes *)*state;
+
+	/* An audio talk spurt with the RTP timestamp of the frame */
+	encode(p, 1, 90000);
+	send_marker(p.event_log.get(), audio_ssrc, 90000 + rtp_offsets[0]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 0);
+	send_marker(p.event_log.get(), video_ssrc, 90000 + rtp_offsets[0]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 1);
+}
+
+static void simulcast_test(void **state)
+{
+	probes &p = *(probes *)*state;
+
+	/* Each layer has a start timestamp of its own, the first one out
+	 * records the frame */
+	encode(p, 1, 90000);
+	send_marker(p.event_log.get(), video_ssrc, 90000 + rtp_offsets[1]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 1);
+
+	encode(p, 2, 93000);
+	send_marker(p.event_log.get(), video_ssrc, 93000 + rtp_offsets[0]);
+	send_marker(p.event_log.get(), video_ssrc, 93000 + rtp_offsets[1]);
+	assert_int_equal(count(p, WEBRTC_LATENCY_SENT), 2);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test_setup_teardown(offset_test, setup, teardown),
+		cmocka_unit_test_setup_teardown(pacer_first_test, setup,
+						teardown),
+		cmocka_unit_test_setup_teardown(audio_test, setup, teardown),
+		cmocka_unit_test_setup_teardown(simulcast_test, setup_simulcast,
+						teardown),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,201 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SDPModif.h"
+
+/* SDP_FIXTURES_DIR is set by CMake to test/cmocka/sdp */
+static std::string read_fixture(const std::string &name)
+{
+	std::ifstream file(std::string(SDP_FIXTURES_DIR) + "/" + name,
+			   std::ios::binary);
+	if (!file)
+		fail_msg("missing fixture %s", name.c_str());
+
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+/* toString() emits CRLF, fixtures are checked in with LF */
+static std::string strip_cr(const std::string &sdp)
+{
+	std::string out;
+	out.reserve(sdp.size());
+	for (char c : sdp)
+		if (c != '\r')
+			out += c;
+	return out;
+}
+
+static std::string media_section(const std::string &sdp,
+				 const std::string &type)
+{
+	size_t begin = sdp.find("m=" + type + " ");
+	if (begin == std::string::npos)
+		return std::string();
+	size_t end = sdp.find("\nm=", begin);
+	return sdp.substr(begin, end == std::string::npos ? std::string::npos
+							   : end - begin + 1);
+}
+
+/* Same munging as WebRTCStream::start on the local offer */
+static std::string munge_offer(const std::string &video_codec)
+{
+	SDPModif sdp(read_fixture("chrome-offer.sdp"));
+	std::vector<int> audio_payloads;
+	std::vector<int> video_payloads;
+
+	sdp.forcePayload(audio_payloads, video_payloads, "opus", video_codec,
+			 1, "42e01f", 0);
+	sdp.bitrateMaxMin(2500, video_payloads);
+	sdp.stereo(128);
+	sdp.opus(SDPModif::OpusParameters());
+	return strip_cr(sdp.toString());
+}
+
+static void offer_h264_test(void **state)
+{
+	std::string offer = munge_offer("h264");
+
+	assert_string_equal(offer.c_str(),
+			    read_fixture("chrome-offer-h264.expected.sdp").c_str());
+}
+
+static void offer_vp8_test(void **state)
+{
+	std::string offer = munge_offer("vp8");
+
+	assert_string_equal(offer.c_str(),
+			    read_fixture("chrome-offer-vp8.expected.sdp").c_str());
+
+	/* VP8 has no fmtp line in the offer, one is inserted */
+	assert_true(offer.find("\na=fmtp:96 x-google-min-bitrate=2500;"
+			       "x-google-max-bitrate=2500\n") !=
+		    std::string::npos);
+	assert_true(offer.find("a= fmtp") == std::string::npos);
+}
+
+static void keep_rtcp_test(void **state)
+{
+	std::string audio = media_section(munge_offer("h264"), "audio");
+
+	/* G722 (payload 9) is removed, the rtcp port 9 line is not */
+	assert_true(audio.find("a=rtpmap:9 ") == std::string::npos);
+	assert_true(audio.find("\na=rtcp:9 IN IP4 0.0.0.0\n") !=
+		    std::string::npos);
+}
+
+static void answer_test(void **state)
+{
+	/* Same munging as WebRTCStream::setAnswer */
+	SDPModif sdp(read_fixture("millicast-answer.sdp"));
+	sdp.bitrate(2500);
+	sdp.stereo(128);
+	sdp.opus(SDPModif::OpusParameters());
+
+	assert_string_equal(strip_cr(sdp.toString()).c_str(),
+			    read_fixture("millicast-answer.expected.sdp").c_str());
+}
+
+/* Audio section of a libwebrtc offer with the builtin multiopus codec */
+static const char *multiopus_offer =
+	"v=0\r\n"
+	"o=- 1 2 IN IP4 127.0.0.1\r\n"
+	"s=-\r\n"
+	"t=0 0\r\n"
+	"m=audio 9 UDP/TLS/RTP/SAVPF 111 114 115 9\r\n"
+	"c=IN IP4 0.0.0.0\r\n"
+	"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+	"a=mid:0\r\n"
+	"a=rtpmap:111 opus/48000/2\r\n"
+	"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+	"a=rtpmap:114 multiopus/48000/6\r\n"
+	"a=fmtp:114 channel_mapping=0,4,1,2,3,5;coupled_streams=2;"
+	"minptime=10;num_streams=4;useinbandfec=1\r\n"
+	"a=rtpmap:115 multiopus/48000/8\r\n"
+	"a=rtpmap:9 G722/8000\r\n";
+
+static void surround_test(void **state)
+{
+	/* Same munging as WebRTCStream::start for 5.1 */
+	SDPModif sdp(multiopus_offer);
+	std::vector<int> audio_payloads;
+	std::vector<int> video_payloads;
+	sdp.forcePayload(audio_payloads, video_payloads, "multiopus,opus",
+			 "h264", 1, "42e01f", 0);
+	sdp.stereo(128);
+	assert_true(sdp.surround(6, 4, 2, "0,4,1,2,3,5", 128));
+	sdp.opus(SDPModif::OpusParameters());
+	std::string offer = strip_cr(sdp.toString());
+
+	/* 5.1 first, stereo opus as fallback, the 7.1 payload removed */
+	assert_true(offer.find("\nm=audio 9 UDP/TLS/RTP/SAVPF 114 111\n") !=
+		    std::string::npos);
+	assert_true(offer.find("a=rtpmap:115") == std::string::npos);
+	assert_true(offer.find("a=rtpmap:9 ") == std::string::npos);
+	assert_true(offer.find("\na=fmtp:114 channel_mapping=0,4,1,2,3,5;"
+			       "coupled_streams=2;minptime=10;num_streams=4;"
+			       "useinbandfec=1;maxaveragebitrate=131072;"
+			       "usedtx=0;cbr=0\n") != std::string::npos);
+	assert_true(offer.find("\na=fmtp:111 minptime=10;useinbandfec=1;"
+			       "stereo=1;") != std::string::npos);
+}
+
+static void surround_fmtp_test(void **state)
+{
+	/* 7.1 has no fmtp line in the offer, one is inserted */
+	SDPModif sdp(multiopus_offer);
+	assert_true(sdp.surround(8, 5, 3, "0,6,1,4,5,2,3,7", 256));
+	std::string offer = strip_cr(sdp.toString());
+
+	assert_true(offer.find("\nm=audio 9 UDP/TLS/RTP/SAVPF 115 111 9\n") !=
+		    std::string::npos);
+	assert_true(offer.find("\na=rtpmap:115 multiopus/48000/8\n"
+			       "a=fmtp:115 minptime=10;useinbandfec=1;"
+			       "num_streams=5;coupled_streams=3;"
+			       "channel_mapping=0,6,1,4,5,2,3,7;"
+			       "maxaveragebitrate=262144\n") !=
+		    std::string::npos);
+	assert_true(offer.find("a=rtpmap:114") == std::string::npos);
+
+	/* No multiopus for that layout */
+	SDPModif stereo(read_fixture("chrome-offer.sdp"));
+	assert_false(stereo.surround(6, 4, 2, "0,4,1,2,3,5", 128));
+}
+
+static void ice_candidates_test(void **state)
+{
+	const std::string udp =
+		"candidate:842163049 1 udp 1677729535 1.2.3.4 50000 typ srflx";
+	const std::string tcp =
+		"candidate:1510613869 1 tcp 1518280447 10.0.0.2 9 typ host "
+		"tcptype active";
+
+	assert_true(SDPModif::filterIceCandidates(udp, "UDP"));
+	assert_false(SDPModif::filterIceCandidates(udp, "TCP"));
+	assert_true(SDPModif::filterIceCandidates("a=" + tcp, "tcp"));
+	assert_false(SDPModif::filterIceCandidates("candidate:1 1", "UDP"));
+	assert_false(SDPModif::filterIceCandidates("", "UDP"));
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(offer_h264_test),
+		cmocka_unit_test(offer_vp8_test),
+		cmocka_unit_test(keep_rtcp_test),
+		cmocka_unit_test(answer_test),
+		cmocka_unit_test(surround_test),
+		cmocka_unit_test(surround_fmtp_test),
+		cmocka_unit_test(ice_candidates_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,542 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AudioChannelLayout.h"
+#include "AudioChunker.h"
+#include "SDPModif.h"
+
+#include <api/audio_codecs/builtin_audio_decoder_factory.h>
+#include <api/audio_codecs/builtin_audio_encoder_factory.h>
+#include <api/create_peerconnection_factory.h>
+#include <api/jsep.h>
+#include <api/media_stream_interface.h>
+#include <api/notifier.h>
+#include <api/peer_connection_interface.h>
+#include <api/task_queue/default_task_queue_factory.h>
+#include <api/video_codecs/builtin_video_decoder_factory.h>
+#include <api/video_codecs/builtin_video_encoder_factory.h>
+#include <modules/audio_device/include/audio_device_default.h>
+#include <modules/audio_device/include/test_audio_device.h>
+#include <rtc_base/event.h>
+#include <rtc_base/ref_counted_object.h>
+#include <rtc_base/ssl_adapter.h>
+#include <rtc_base/synchronization/mutex.h>
+#include <rtc_base/thread.h>
+
+#define PI 3.14159265358979323846
+
+static const int sample_rate = 48000;
+static const int audio_bitrate = 256; /* kbps */
+
+/* One tone per channel, in the OBS order: FL FR FC LFE RL RR SL SR */
+static const double tones[8] = {440, 620, 830, 110, 1050, 1270, 1490, 1710};
+
+/* Received audio analysed, the last 0.5 s */
+static const size_t analysed_frames = sample_rate / 2;
+
+/* Plays OBS audio blocks of a tone per channel through the chunker of
+ * obsWebrtcAudioSource, in real time */
+class ToneSource : public webrtc::Notifier<webrtc::AudioSourceInterface> {
+public:
+	explicit ToneSource(size_t channels) : channels_(channels)
+	{
+		chunker_.Configure(AUDIO_FORMAT_FLOAT_PLANAR, sample_rate,
+				   channels);
+	}
+	~ToneSource() override { Stop(); }
+
+	SourceState state() const override { return kLive; }
+	bool remote() const override { return false; }
+
+	void AddSink(webrtc::AudioTrackSinkInterface *sink) override
+	{
+		webrtc::MutexLock lock(&sinks_lock_);
+		sinks_.push_back(sink);
+	}
+	void RemoveSink(webrtc::AudioTrackSinkInterface *sink) override
+	{
+		webrtc::MutexLock lock(&sinks_lock_);
+		sinks_.erase(std::remove(sinks_.begin(), sinks_.end(), sink),
+			     sinks_.end());
+	}
+
+	void Start()
+	{
+		running_ = true;
+		thread_ = std::thread(&ToneSource::Run, this);
+	}
+	void Stop()
+	{
+		running_ = false;
+		if (thread_.joinable())
+			thread_.join();
+	}
+
+private:
+	/* AUDIO_OUTPUT_FRAMES */
+	static const uint32_t kBlockFrames = 1024;
+
+	void Run()
+	{
+		std::vector<std::vector<float>> planes(
+			channels_, std::vector<float>(kBlockFrames));
+		std::vector<uint8_t *> data(channels_);
+		for (size_t c = 0; c < channels_; c++)
+			data[c] = (uint8_t *)planes[c].data();
+
+		auto next = std::chrono::steady_clock::now();
+		uint64_t position = 0;
+		while (running_) {
+			for (size_t c = 0; c < channels_; c++)
+				for (uint32_t i = 0; i < kBlockFrames; i++)
+					planes[c][i] = (float)(
+						0.3 *
+						sin(2.0 * PI * tones[c] *
+						    (double)(position + i) /
+						    sample_rate));
+			position += kBlockFrames;
+
+			webrtc::MutexLock lock(&sinks_lock_);
+			chunker_.Push(
+				data.data(), kBlockFrames,
+				[this](const int16_t *chunk, size_t frames) {
+					for (webrtc::AudioTrackSinkInterface
+						     *sink : sinks_)
+						sink->OnData(chunk, 16,
+							     sample_rate,
+							     channels_, frames);
+				});
+
+			next += std::chrono::microseconds(
+				kBlockFrames * 1000000 / sample_rate);
+			std::this_thread::sleep_until(next);
+		}
+	}
+
+	const size_t channels_;
+	AudioChunker chunker_;
+	std::atomic<bool> running_{false};
+	std::thread thread_;
+	webrtc::Mutex sinks_lock_;
+	std::vector<webrtc::AudioTrackSinkInterface *> sinks_;
+};
+
+/* Keeps the latest decoded audio of the remote track */
+class AudioCollector : public webrtc::AudioTrackSinkInterface {
+public:
+	void OnData(const void *audio_data, int bits_per_sample,
+		    int sample_rate_hz, size_t number_of_channels,
+		    size_t number_of_frames) override
+	{
+		if (bits_per_sample != 16)
+			return;
+		webrtc::MutexLock lock(&lock_);
+		if (channels_ != number_of_channels) {
+			samples_.clear();
+			channels_ = number_of_channels;
+		}
+		sample_rate_ = sample_rate_hz;
+		const int16_t *data = (const int16_t *)audio_data;
+		samples_.insert(samples_.end(), data,
+				data + number_of_frames * number_of_channels);
+		size_t max = analysed_frames * channels_;
+		if (samples_.size() > max)
+			samples_.erase(samples_.begin(),
+				       samples_.end() - max);
+		frames_ += number_of_frames;
+	}
+
+	size_t frames()
+	{
+		webrtc::MutexLock lock(&lock_);
+		return frames_;
+	}
+	size_t channels()
+	{
+		webrtc::MutexLock lock(&lock_);
+		return channels_;
+	}
+	int sample_rate()
+	{
+		webrtc::MutexLock lock(&lock_);
+		return sample_rate_;
+	}
+
+	/* Power of |frequency| in |channel| (Goertzel) */
+	double Power(size_t channel, double frequency)
+	{
+		webrtc::MutexLock lock(&lock_);
+		if (!channels_ || !sample_rate_)
+			return 0.0;
+		double coeff = 2.0 * cos(2.0 * PI * frequency / sample_rate_);
+		double s1 = 0.0, s2 = 0.0;
+		for (size_t i = channel; i < samples_.size(); i += channels_) {
+			double s = samples_[i] + coeff * s1 - s2;
+			s2 = s1;
+			s1 = s;
+		}
+		return s1 * s1 + s2 * s2 - coeff * s1 * s2;
+	}
+
+private:
+	webrtc::Mutex lock_;
+	std::vector<int16_t> samples_;
+	size_t channels_ = 0;
+	int sample_rate_ = 0;
+	size_t frames_ = 0;
+};
+
+class CreateObserver : public webrtc::CreateSessionDescriptionObserver {
+public:
+	void OnSuccess(webrtc::SessionDescriptionInterface *desc) override
+	{
+		desc->ToString(&sdp);
+		delete desc;
+		done.Set();
+	}
+	void OnFailure(webrtc::RTCError error) override
+	{
+		print_error("%s\n", error.message());
+		done.Set();
+	}
+
+	std::string sdp;
+	rtc::Event done;
+};
+
+class SetObserver : public webrtc::SetSessionDescriptionObserver {
+public:
+	void OnSuccess() override
+	{
+		ok = true;
+		done.Set();
+	}
+	void OnFailure(webrtc::RTCError error) override
+	{
+		print_error("%s\n", error.message());
+		done.Set();
+	}
+
+	std::atomic<bool> ok{false};
+	rtc::Event done;
+};
+
+/* Peer connection observer, keeps the ICE candidates until the other side
+ * has its remote description */
+class Peer : public webrtc::PeerConnectionObserver {
+public:
+	void OnSignalingChange(
+		webrtc::PeerConnectionInterface::SignalingState /* state */)
+		override
+	{
+	}
+	void OnDataChannel(
+		rtc::scoped_refptr<webrtc::DataChannelInterface> /* channel */)
+		override
+	{
+	}
+	void OnRenegotiationNeeded() override {}
+	void OnIceGatheringChange(
+		webrtc::PeerConnectionInterface::IceGatheringState /* state */)
+		override
+	{
+	}
+	void OnIceCandidate(const webrtc::IceCandidateInterface *candidate) override
+	{
+		Candidate pending;
+		pending.mid = candidate->sdp_mid();
+		pending.index = candidate->sdp_mline_index();
+		candidate->ToString(&pending.sdp);
+		webrtc::MutexLock lock(&lock_);
+		candidates_.push_back(pending);
+	}
+
+	/* Hands the candidates gathered so far to |other| */
+	void SendCandidates(webrtc::PeerConnectionInterface *other)
+	{
+		std::vector<Candidate> candidates;
+		{
+			webrtc::MutexLock lock(&lock_);
+			candidates.swap(candidates_);
+		}
+		for (const Candidate &pending : candidates) {
+			webrtc::SdpParseError error;
+			std::unique_ptr<webrtc::IceCandidateInterface> candidate(
+				webrtc::CreateIceCandidate(pending.mid,
+							   pending.index,
+							   pending.sdp,
+							   &error));
+			if (candidate)
+				other->AddIceCandidate(candidate.get());
+		}
+	}
+
+	rtc::scoped_refptr<webrtc::PeerConnectionInterface> pc;
+
+private:
+	struct Candidate {
+		std::string mid;
+		int index;
+		std::string sdp;
+	};
+
+	webrtc::Mutex lock_;
+	std::vector<Candidate> candidates_;
+};
+
+/* Threads and factories of the loopback */
+struct Loopback {
+	std::unique_ptr<webrtc::TaskQueueFactory> task_queue_factory;
+	std::unique_ptr<rtc::Thread> network;
+	std::unique_ptr<rtc::Thread> worker;
+	std::unique_ptr<rtc::Thread> signaling;
+	/* Sends from the track source as the WebRTC outputs do, its audio
+	 * device does nothing */
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> sender;
+	/* Plays out in real time, which pulls the remote audio */
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> receiver;
+};
+
+static rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface>
+create_factory(Loopback *loopback,
+	       rtc::scoped_refptr<webrtc::AudioDeviceModule> adm)
+{
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory =
+		webrtc::CreatePeerConnectionFactory(
+			loopback->network.get(), loopback->worker.get(),
+			loopback->signaling.get(), adm,
+			webrtc::CreateBuiltinAudioEncoderFactory(),
+			webrtc::CreateBuiltinAudioDecoderFactory(),
+			webrtc::CreateBuiltinVideoEncoderFactory(),
+			webrtc::CreateBuiltinVideoDecoderFactory(), nullptr,
+			nullptr);
+	if (factory) {
+		/* Both ends are on this machine, maybe on loopback only */
+		webrtc::PeerConnectionFactoryInterface::Options options;
+		options.network_ignore_mask = 0;
+		factory->SetOptions(options);
+	}
+	return factory;
+}
+
+static int setup(void **state)
+{
+	if (!rtc::InitializeSSL())
+		return -1;
+
+	Loopback *loopback = new Loopback();
+	loopback->task_queue_factory = webrtc::CreateDefaultTaskQueueFactory();
+	loopback->network = rtc::Thread::CreateWithSocketServer();
+	loopback->network->Start();
+	loopback->worker = rtc::Thread::Create();
+	loopback->worker->Start();
+	loopback->signaling = rtc::Thread::Create();
+	loopback->signaling->Start();
+
+	loopback->sender = create_factory(
+		loopback,
+		new rtc::RefCountedObject<
+			webrtc::webrtc_impl::AudioDeviceModuleDefault<
+				webrtc::AudioDeviceModule>>());
+	loopback->receiver = create_factory(
+		loopback,
+		webrtc::TestAudioDeviceModule::Create(
+			loopback->task_queue_factory.get(),
+			webrtc::TestAudioDeviceModule::
+				CreatePulsedNoiseCapturer(0, sample_rate),
+			webrtc::TestAudioDeviceModule::CreateDiscardRenderer(
+				sample_rate, 2)));
+	*state = loopback;
+	return loopback->sender && loopback->receiver ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	Loopback *loopback = (Loopback *)*state;
+	if (loopback) {
+		loopback->sender = nullptr;
+		loopback->receiver = nullptr;
+		loopback->signaling->Stop();
+		loopback->worker->Stop();
+		loopback->network->Stop();
+		delete loopback;
+	}
+	rtc::CleanupSSL();
+	return 0;
+}
+
+static std::string create_description(webrtc::PeerConnectionInterface *pc,
+				      bool offer)
+{
+	rtc::scoped_refptr<CreateObserver> observer(
+		new rtc::RefCountedObject<CreateObserver>());
+	webrtc::PeerConnectionInterface::RTCOfferAnswerOptions options;
+	if (offer)
+		pc->CreateOffer(observer.get(), options);
+	else
+		pc->CreateAnswer(observer.get(), options);
+	assert_true(observer->done.Wait(5000));
+	assert_false(observer->sdp.empty());
+	return observer->sdp;
+}
+
+static void set_description(webrtc::PeerConnectionInterface *pc, bool local,
+			    webrtc::SdpType type, const std::string &sdp)
+{
+	webrtc::SdpParseError error;
+	std::unique_ptr<webrtc::SessionDescriptionInterface> desc =
+		webrtc::CreateSessionDescription(type, sdp, &error);
+	if (!desc)
+		fail_msg("%s\n%s", error.description.c_str(), sdp.c_str());
+
+	rtc::scoped_refptr<SetObserver> observer(
+		new rtc::RefCountedObject<SetObserver>());
+	if (local)
+		pc->SetLocalDescription(observer.get(), desc.release());
+	else
+		pc->SetRemoteDescription(observer.get(), desc.release());
+	assert_true(observer->done.Wait(5000));
+	if (!observer->ok)
+		fail_msg("Description refused:\n%s", sdp.c_str());
+}
+
+/* Publishes the tones of |speakers| as the WebRTC outputs do, and checks
+ * each one comes back on its channel. False if libwebrtc does not offer
+ * multiopus for the layout */
+static bool round_trip(Loopback *loopback, enum speaker_layout speakers)
+{
+	AudioChannelLayout layout = AudioChannelLayout::ForSpeakers(speakers);
+	assert_true(layout.surround());
+
+	webrtc::PeerConnectionInterface::RTCConfiguration config;
+	config.sdp_semantics = webrtc::SdpSemantics::kUnifiedPlan;
+	Peer sender, receiver;
+	sender.pc = loopback->sender->CreatePeerConnection(config, nullptr,
+							   nullptr, &sender);
+	receiver.pc = loopback->receiver->CreatePeerConnection(
+		config, nullptr, nullptr, &receiver);
+	assert_non_null(sender.pc.get());
+	assert_non_null(receiver.pc.get());
+
+	rtc::scoped_refptr<ToneSource> source(
+		new rtc::RefCountedObject<ToneSource>(layout.channels));
+	rtc::scoped_refptr<webrtc::AudioTrackInterface> track =
+		loopback->sender->CreateAudioTrack("audio", source.get());
+	webrtc::RtpTransceiverInit init;
+	init.direction = webrtc::RtpTransceiverDirection::kSendOnly;
+	init.stream_ids = {"obs"};
+	assert_true(sender.pc->AddTransceiver(track, init).ok());
+
+	/* Offer munged as WebRTCStream::OnSuccess does */
+	SDPModif offer(create_description(sender.pc.get(), true));
+	std::vector<int> audio_payloads, video_payloads;
+	offer.forcePayload(audio_payloads, video_payloads, "multiopus,opus",
+			   "", 1, "42e01f", 0);
+	offer.stereo(audio_bitrate);
+	if (!offer.surround(layout.channels, layout.num_streams,
+			    layout.coupled_streams, layout.channel_mapping,
+			    audio_bitrate)) {
+		/* libwebrtc advertises multiopus only when built to */
+		print_message("No multiopus/48000/%zu in the offer\n",
+			      layout.channels);
+		sender.pc->Close();
+		receiver.pc->Close();
+		return false;
+	}
+	set_description(sender.pc.get(), true, webrtc::SdpType::kOffer,
+			offer.toString());
+	set_description(receiver.pc.get(), false, webrtc::SdpType::kOffer,
+			offer.toString());
+
+	/* Answer munged as WebRTCStream::setAnswer does */
+	std::string answer_sdp = create_description(receiver.pc.get(), false);
+	set_description(receiver.pc.get(), true, webrtc::SdpType::kAnswer,
+			answer_sdp);
+	SDPModif answer(answer_sdp);
+	answer.stereo(audio_bitrate);
+	assert_string_equal(answer.audioCodec().c_str(), "multiopus");
+	assert_true(answer.surround(layout.channels, layout.num_streams,
+				    layout.coupled_streams,
+				    layout.channel_mapping, audio_bitrate));
+	set_description(sender.pc.get(), false, webrtc::SdpType::kAnswer,
+			answer.toString());
+
+	std::vector<rtc::scoped_refptr<webrtc::RtpTransceiverInterface>>
+		transceivers = receiver.pc->GetTransceivers();
+	assert_int_equal(transceivers.size(), 1);
+	rtc::scoped_refptr<webrtc::MediaStreamTrackInterface> remote =
+		transceivers[0]->receiver()->track();
+	assert_string_equal(remote->kind().c_str(),
+			    webrtc::MediaStreamTrackInterface::kAudioKind);
+	webrtc::AudioTrackInterface *remote_audio =
+		static_cast<webrtc::AudioTrackInterface *>(remote.get());
+	AudioCollector collector;
+	remote_audio->AddSink(&collector);
+	source->Start();
+
+	/* Connected and 2 s decoded, the codec is settled */
+	for (int i = 0; i < 1000 && collector.frames() < 2 * sample_rate;
+	     i++) {
+		sender.SendCandidates(receiver.pc.get());
+		receiver.SendCandidates(sender.pc.get());
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	source->Stop();
+	remote_audio->RemoveSink(&collector);
+
+	assert_true(collector.frames() >= 2 * sample_rate);
+	assert_int_equal(collector.channels(), layout.channels);
+	assert_int_equal(collector.sample_rate(), sample_rate);
+
+	/* Each tone on the channel it was sent on, 20 dB above the others */
+	for (size_t c = 0; c < layout.channels; c++) {
+		double power = collector.Power(c, tones[c]);
+		for (size_t other = 0; other < layout.channels; other++) {
+			if (other == c)
+				continue;
+			double leak = collector.Power(c, tones[other]);
+			if (power < 100.0 * leak)
+				fail_msg("%zu channels: channel %zu has %.0f Hz at %.1f dB of its %.0f Hz tone",
+					 layout.channels, c, tones[other],
+					 10.0 * log10(leak / power), tones[c]);
+		}
+	}
+
+	sender.pc->Close();
+	receiver.pc->Close();
+	return true;
+}
+
+static void surround51_test(void **state)
+{
+	if (!round_trip((Loopback *)*state, SPEAKERS_5POINT1))
+		skip();
+}
+
+static void surround71_test(void **state)
+{
+	if (!round_trip((Loopback *)*state, SPEAKERS_7POINT1))
+		skip();
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(surround51_test),
+		cmocka_unit_test(surround71_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
@@ -0,0 +1,395 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs.h>
+#include <media-io/video-io.h>
+#include <media-io/video-frame.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define FRAME_TIME 1000
+
+/* Connected callback, optionally blocked in its first call until released */
+struct input {
+	volatile long calls;
+	uint64_t timestamps[16];
+	uint8_t *planes[16];
+	uint8_t values[16];
+	bool block;
+	os_event_t *entered;
+	os_event_t *release;
+	video_t *video;
+	volatile bool returned;
+};
+
+static void input_init(struct input *input, bool block)
+{
+	memset(input, 0, sizeof(*input));
+	input->block = block;
+	os_event_init(&input->entered, OS_EVENT_TYPE_MANUAL);
+	os_event_init(&input->release, OS_EVENT_TYPE_MANUAL);
+}
+
+static void input_free(struct input *input)
+{
+	os_event_destroy(input->entered);
+	os_event_destroy(input->release);
+}
+
+static void receive_video(void *param, struct video_data *frame)
+{
+	struct input *input = param;
+	long call = os_atomic_load_long(&input->calls);
+
+	if (call < 16) {
+		input->timestamps[call] = frame->timestamp;
+		input->planes[call] = frame->data[0];
+		input->values[call] = frame->data[0][0];
+	}
+	os_atomic_inc_long(&input->calls);
+
+	if (input->block && call == 0) {
+		os_event_signal(input->entered);
+		os_event_wait(input->release);
+	}
+}
+
+/* Disconnects itself, then is still running while the output closes */
+static void receive_video_disconnect(void *param, struct video_data *frame)
+{
+	struct input *input = param;
+
+	if (os_atomic_inc_long(&input->calls) != 1)
+		return;
+
+	video_output_disconnect(input->video, receive_video_disconnect, input);
+	os_event_signal(input->entered);
+	os_sleep_ms(100);
+	os_atomic_set_bool(&input->returned, true);
+}
+
+static video_t *open_video_cache(size_t cache_size, size_t input_queue_size)
+{
+	struct video_output_info vi = {
+		.name = "test",
+		.format = VIDEO_FORMAT_RGBA,
+		.fps_num = 1000000,
+		.fps_den = 1,
+		.width = 16,
+		.height = 16,
+		.cache_size = cache_size,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+		.input_queue_size = input_queue_size,
+	};
+	video_t *video = NULL;
+
+	assert_int_equal(video_output_open(&video, &vi), VIDEO_OUTPUT_SUCCESS);
+	return video;
+}
+
+static video_t *open_video(void)
+{
+	return open_video_cache(8, 0);
+}
+
+static void output_frame(video_t *video, int count, uint64_t timestamp)
+{
+	struct video_frame frame;
+
+	assert_true(video_output_lock_frame(video, &frame, count, timestamp));
+	video_output_unlock_frame(video);
+}
+
+static void wait_calls(struct input *input, long calls)
+{
+	for (int i = 0; i < 1000; i++) {
+		if (os_atomic_load_long(&input->calls) >= calls)
+			break;
+		os_sleep_ms(1);
+	}
+	assert_int_equal(os_atomic_load_long(&input->calls), calls);
+}
+
+static void wait_total(video_t *video, uint32_t total)
+{
+	for (int i = 0; i < 1000; i++) {
+		if (video_output_get_total_frames(video) >= total)
+			break;
+		os_sleep_ms(1);
+	}
+	assert_int_equal(video_output_get_total_frames(video), total);
+}
+
+static void wait_skipped(video_t *video, uint32_t skipped)
+{
+	for (int i = 0; i < 1000; i++) {
+		if (video_output_get_skipped_frames(video) >= skipped)
+			break;
+		os_sleep_ms(1);
+	}
+	assert_int_equal(video_output_get_skipped_frames(video), skipped);
+}
+
+static void connect_test(void **state)
+{
+	video_t *video = open_video();
+	struct input a, b;
+	input_init(&a, false);
+	input_init(&b, false);
+
+	assert_true(video_output_connect(video, NULL, receive_video, &a));
+	assert_true(video_output_connect(video, NULL, receive_video, &b));
+	assert_false(video_output_connect(video, NULL, receive_video, &a));
+	assert_true(video_output_active(video));
+
+	/* A frame output twice is called twice, one frame time apart */
+	output_frame(video, 2, 5000);
+	output_frame(video, 1, 7000);
+	wait_calls(&a, 3);
+	wait_calls(&b, 3);
+	assert_int_equal(a.timestamps[0], 5000);
+	assert_int_equal(a.timestamps[1], 5000 + FRAME_TIME);
+	assert_int_equal(a.timestamps[2], 7000);
+	wait_total(video, 3);
+	assert_int_equal(video_output_get_skipped_frames(video), 0);
+
+	/* Not called anymore once disconnected */
+	video_output_disconnect(video, receive_video, &a);
+	output_frame(video, 1, 8000);
+	wait_calls(&b, 4);
+	assert_int_equal(os_atomic_load_long(&a.calls), 3);
+
+	video_output_disconnect(video, receive_video, &b);
+	assert_false(video_output_active(video));
+
+	video_output_close(video);
+	input_free(&a);
+	input_free(&b);
+}
+
+static void lag_test(void **state)
+{
+	video_t *video = open_video();
+	struct input fast, slow1, slow2;
+	input_init(&fast, false);
+	input_init(&slow1, true);
+	input_init(&slow2, true);
+
+	assert_true(video_output_connect(video, NULL, receive_video, &fast));
+	assert_true(video_output_connect(video, NULL, receive_video, &slow1));
+	assert_true(video_output_connect(video, NULL, receive_video, &slow2));
+
+	/* Both slow inputs are busy with the first frame, then their queue
+	 * of 2 fills up */
+	output_frame(video, 1, 1000);
+	assert_int_equal(os_event_wait(slow1.entered), 0);
+	assert_int_equal(os_event_wait(slow2.entered), 0);
+	output_frame(video, 1, 2000);
+	output_frame(video, 1, 3000);
+	wait_total(video, 3);
+
+	/* Lagging: the last queued frame is repeated in place of one output
+	 * 3 times, the fast input is not held back */
+	output_frame(video, 3, 4000);
+	wait_calls(&fast, 6);
+	assert_int_equal(fast.timestamps[3], 4000);
+	assert_int_equal(fast.timestamps[5], 4000 + 2 * FRAME_TIME);
+	wait_total(video, 6);
+
+	os_event_signal(slow1.release);
+	os_event_signal(slow2.release);
+	wait_calls(&slow1, 6);
+	wait_calls(&slow2, 6);
+	assert_int_equal(slow1.timestamps[2], 3000);
+	assert_int_equal(slow1.timestamps[5], 3000 + 3 * FRAME_TIME);
+
+	/* Counted per input, and once for the output however many lagged */
+	assert_int_equal(video_output_get_input_skipped_frames(
+				 video, receive_video, &slow1),
+			 3);
+	assert_int_equal(video_output_get_input_skipped_frames(
+				 video, receive_video, &slow2),
+			 3);
+	assert_int_equal(video_output_get_input_skipped_frames(
+				 video, receive_video, &fast),
+			 0);
+	assert_int_equal(video_output_get_skipped_frames(video), 3);
+	assert_int_equal(video_output_get_total_frames(video), 6);
+
+	video_output_close(video);
+	input_free(&fast);
+	input_free(&slow1);
+	input_free(&slow2);
+}
+
+/* Planes handed to video_output_push_frame */
+struct shared_frame {
+	uint8_t data[16 * 16 * 4];
+	volatile long released;
+};
+
+static void release_shared_frame(void *param)
+{
+	struct shared_frame *frame = param;
+	os_atomic_inc_long(&frame->released);
+}
+
+static void push_frame(video_t *video, struct shared_frame *frame,
+		       uint8_t value, uint64_t timestamp)
+{
+	struct video_data data = {.timestamp = timestamp};
+	memset(frame->data, value, sizeof(frame->data));
+	frame->released = 0;
+	data.data[0] = frame->data;
+	data.linesize[0] = 16 * 4;
+
+	assert_true(video_output_push_frame(video, &data, 1,
+					    release_shared_frame, frame));
+}
+
+static void wait_released(struct shared_frame *frame)
+{
+	for (int i = 0; i < 1000; i++) {
+		if (os_atomic_load_long(&frame->released))
+			break;
+		os_sleep_ms(1);
+	}
+	assert_int_equal(os_atomic_load_long(&frame->released), 1);
+}
+
+static void zero_copy_test(void **state)
+{
+	video_t *video = open_video();
+	struct shared_frame frames[3];
+	struct input fast, slow;
+	input_init(&fast, false);
+	input_init(&slow, true);
+
+	assert_true(video_output_connect(video, NULL, receive_video, &fast));
+	assert_true(video_output_connect(video, NULL, receive_video, &slow));
+
+	/* Both read the planes as-is, released once the slow input is done
+	 * with its callback */
+	push_frame(video, &frames[0], 1, 1000);
+	assert_int_equal(os_event_wait(slow.entered), 0);
+	wait_calls(&fast, 1);
+	assert_ptr_equal(fast.planes[0], frames[0].data);
+	assert_ptr_equal(slow.planes[0], frames[0].data);
+	assert_int_equal(os_atomic_load_long(&frames[0].released), 0);
+
+	/* The slow input still busy gets copies, the planes are not held
+	 * for it */
+	push_frame(video, &frames[1], 2, 2000);
+	push_frame(video, &frames[2], 3, 3000);
+	wait_calls(&fast, 3);
+	wait_released(&frames[1]);
+	wait_released(&frames[2]);
+	assert_ptr_equal(fast.planes[2], frames[2].data);
+	assert_int_equal(os_atomic_load_long(&frames[0].released), 0);
+
+	os_event_signal(slow.release);
+	wait_released(&frames[0]);
+	wait_calls(&slow, 3);
+	assert_int_equal(slow.values[1], 2);
+	assert_int_equal(slow.values[2], 3);
+	assert_ptr_not_equal(slow.planes[1], frames[1].data);
+	assert_ptr_not_equal(slow.planes[2], frames[2].data);
+
+	video_output_close(video);
+	input_free(&fast);
+	input_free(&slow);
+}
+
+static void cache_test(void **state)
+{
+	video_t *video = open_video_cache(6, 8);
+	assert_int_equal(video_output_get_info(video)->input_queue_size, 4);
+	video_output_close(video);
+
+	video = open_video_cache(3, 0);
+	assert_int_equal(video_output_get_info(video)->input_queue_size, 1);
+
+	struct input slow1, slow2;
+	input_init(&slow1, true);
+	input_init(&slow2, true);
+
+	/* The first input holds the frame in its callback and its queue of
+	 * one, the second one connected later holds the last entry */
+	assert_true(video_output_connect(video, NULL, receive_video, &slow1));
+	output_frame(video, 1, 1000);
+	assert_int_equal(os_event_wait(slow1.entered), 0);
+	output_frame(video, 1, 2000);
+	wait_total(video, 2);
+	assert_true(video_output_connect(video, NULL, receive_video, &slow2));
+	output_frame(video, 1, 3000);
+	assert_int_equal(os_event_wait(slow2.entered), 0);
+	wait_total(video, 3);
+	wait_skipped(video, 1);
+
+	/* No entry left to output to, nor queued to repeat */
+	struct video_frame frame;
+	assert_false(video_output_lock_frame(video, &frame, 2, 4000));
+	assert_int_equal(video_output_get_total_frames(video), 5);
+	assert_int_equal(video_output_get_skipped_frames(video), 3);
+
+	os_event_signal(slow1.release);
+	os_event_signal(slow2.release);
+	video_output_close(video);
+	input_free(&slow1);
+	input_free(&slow2);
+}
+
+static void close_test(void **state)
+{
+	video_t *video = open_video();
+	struct input self, blocked;
+	input_init(&self, false);
+	input_init(&blocked, true);
+	self.video = video;
+
+	assert_true(video_output_connect(video, NULL, receive_video_disconnect,
+					 &self));
+	assert_true(video_output_connect(video, NULL, receive_video, &blocked));
+
+	output_frame(video, 1, 1000);
+	output_frame(video, 1, 2000);
+	assert_int_equal(os_event_wait(self.entered), 0);
+	assert_int_equal(os_event_wait(blocked.entered), 0);
+	os_event_signal(blocked.release);
+
+	/* Waits for the input still in the callback it disconnected from */
+	video_output_close(video);
+	assert_true(os_atomic_load_bool(&self.returned));
+	assert_int_equal(os_atomic_load_long(&self.calls), 1);
+
+	input_free(&self);
+	input_free(&blocked);
+}
+
+static int setup(void **state)
+{
+	/* video-io names its threads in the profiler of the core */
+	return obs_startup("en-US", NULL, NULL) ? 0 : -1;
+}
+
+static int teardown(void **state)
+{
+	obs_shutdown();
+	return 0;
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(connect_test),
+		cmocka_unit_test(lag_test),
+		cmocka_unit_test(zero_copy_test),
+		cmocka_unit_test(cache_test),
+		cmocka_unit_test(close_test),
+	};
+
+	return cmocka_run_group_tests(tests, setup, teardown);
+}
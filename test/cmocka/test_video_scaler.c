@@ -0,0 +1,314 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <libavutil/cpu.h>
+#include <libswscale/swscale.h>
+
+#include <media-io/video-frame.h>
+#include <media-io/video-scaler.h>
+#include <media-io/video-scaler-simd.h>
+
+#define PI 3.14159265358979323846
+
+/* interior compared, swscale and the built-in scaler fold the filter
+ * differently on the edges */
+#define BORDER 4
+#define TOLERANCE 2
+/* swscale scales fast bilinear horizontally from the left edge of the
+ * first sample, not the center: up to half a source pixel off at 2:1, on a
+ * pattern changing by up to 5 per pixel */
+#define FAST_BILINEAR_TOLERANCE 4
+
+struct plane_desc {
+	uint32_t width;
+	uint32_t height;
+	uint32_t components;
+};
+
+static size_t get_planes(enum video_format format, uint32_t width,
+			 uint32_t height, struct plane_desc planes[3])
+{
+	planes[0] = (struct plane_desc){width, height, 1};
+
+	switch (format) {
+	case VIDEO_FORMAT_NV12:
+		planes[1] = (struct plane_desc){width / 2, height / 2, 2};
+		return 2;
+	case VIDEO_FORMAT_I420:
+		planes[1] = (struct plane_desc){width / 2, height / 2, 1};
+		planes[2] = planes[1];
+		return 3;
+	case VIDEO_FORMAT_I444:
+		planes[1] = planes[2] = planes[0];
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+static int get_sws_format(enum video_format format)
+{
+	switch (format) {
+	case VIDEO_FORMAT_NV12:
+		return AV_PIX_FMT_NV12;
+	case VIDEO_FORMAT_I420:
+		return AV_PIX_FMT_YUV420P;
+	default:
+		return AV_PIX_FMT_YUV444P;
+	}
+}
+
+/* Same flags as video-scaler-ffmpeg.c */
+static int get_sws_flags(enum video_scale_type type)
+{
+	switch (type) {
+	case VIDEO_SCALE_BICUBIC:
+		return SWS_BICUBIC;
+	case VIDEO_SCALE_BILINEAR:
+		return SWS_BILINEAR | SWS_AREA;
+	default:
+		return SWS_FAST_BILINEAR;
+	}
+}
+
+static const char *get_type_name(enum video_scale_type type)
+{
+	switch (type) {
+	case VIDEO_SCALE_BICUBIC:
+		return "bicubic";
+	case VIDEO_SCALE_BILINEAR:
+		return "bilinear";
+	default:
+		return "fast bilinear";
+	}
+}
+
+static struct video_scale_info make_info(enum video_format format,
+					 uint32_t width, uint32_t height)
+{
+	struct video_scale_info info = {
+		.format = format,
+		.width = width,
+		.height = height,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+	return info;
+}
+
+/* Smooth pattern with detail: a 64x48 period wave over a gradient,
+ * different for each component */
+static void fill_frame(struct video_frame *frame, enum video_format format,
+		       uint32_t width, uint32_t height)
+{
+	struct plane_desc planes[3];
+	size_t num_planes = get_planes(format, width, height, planes);
+
+	for (size_t p = 0; p < num_planes; p++) {
+		for (uint32_t y = 0; y < planes[p].height; y++) {
+			uint8_t *row = frame->data[p] + y * frame->linesize[p];
+
+			for (uint32_t x = 0; x < planes[p].width; x++) {
+				for (uint32_t c = 0; c < planes[p].components;
+				     c++) {
+					double phase = (double)(p * 2 + c);
+					double value =
+						128.0 +
+						50.0 * sin(2.0 * PI * x / 64.0 +
+							   phase) *
+							cos(2.0 * PI * y / 48.0 +
+							    phase) +
+						40.0 * ((double)x /
+								planes[p].width -
+							0.5);
+					row[x * planes[p].components + c] =
+						(uint8_t)lround(value);
+				}
+			}
+		}
+	}
+}
+
+static int max_difference(const struct video_frame *a,
+			  const struct video_frame *b, enum video_format format,
+			  uint32_t width, uint32_t height)
+{
+	struct plane_desc planes[3];
+	size_t num_planes = get_planes(format, width, height, planes);
+	int max_diff = 0;
+
+	for (size_t p = 0; p < num_planes; p++) {
+		uint32_t bytes = planes[p].width * planes[p].components;
+		uint32_t border = BORDER * planes[p].components;
+
+		for (uint32_t y = BORDER; y < planes[p].height - BORDER; y++) {
+			const uint8_t *row_a = a->data[p] + y * a->linesize[p];
+			const uint8_t *row_b = b->data[p] + y * b->linesize[p];
+
+			for (uint32_t x = border; x < bytes - border; x++) {
+				int diff = abs((int)row_a[x] - (int)row_b[x]);
+				if (diff > max_diff)
+					max_diff = diff;
+			}
+		}
+	}
+
+	return max_diff;
+}
+
+static void compare_with_swscale(enum video_format format,
+				 enum video_scale_type type, uint32_t src_width,
+				 uint32_t src_height, uint32_t dst_width,
+				 uint32_t dst_height)
+{
+	struct video_scale_info src = make_info(format, src_width, src_height);
+	struct video_scale_info dst = make_info(format, dst_width, dst_height);
+	struct video_frame input, output, reference;
+
+	video_frame_init(&input, format, src_width, src_height);
+	video_frame_init(&output, format, dst_width, dst_height);
+	video_frame_init(&reference, format, dst_width, dst_height);
+	fill_frame(&input, format, src_width, src_height);
+
+	struct simd_scaler *scaler = simd_scaler_create(&dst, &src, type);
+	assert_non_null(scaler);
+	simd_scaler_scale(scaler, output.data, output.linesize,
+			  (const uint8_t *const *)input.data, input.linesize);
+	simd_scaler_destroy(scaler);
+
+	struct SwsContext *sws = sws_getContext(
+		src_width, src_height, get_sws_format(format), dst_width,
+		dst_height, get_sws_format(format), get_sws_flags(type), NULL,
+		NULL, NULL);
+	assert_non_null(sws);
+	sws_scale(sws, (const uint8_t *const *)input.data,
+		  (const int *)input.linesize, 0, src_height, reference.data,
+		  (const int *)reference.linesize);
+	sws_freeContext(sws);
+
+	int diff = max_difference(&output, &reference, format, dst_width,
+				  dst_height);
+	int tolerance = type == VIDEO_SCALE_FAST_BILINEAR
+				? FAST_BILINEAR_TOLERANCE
+				: TOLERANCE;
+	if (diff > tolerance)
+		fail_msg("%s %s %ux%u -> %ux%u: off by %d from swscale",
+			 get_video_format_name(format), get_type_name(type),
+			 src_width, src_height, dst_width, dst_height, diff);
+
+	video_frame_free(&input);
+	video_frame_free(&output);
+	video_frame_free(&reference);
+}
+
+static const enum video_format formats[] = {
+	VIDEO_FORMAT_NV12,
+	VIDEO_FORMAT_I420,
+	VIDEO_FORMAT_I444,
+};
+
+static void downscale_test(void **state)
+{
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		compare_with_swscale(formats[i], VIDEO_SCALE_BILINEAR, 1920,
+				     1080, 1280, 720);
+		compare_with_swscale(formats[i], VIDEO_SCALE_BICUBIC, 1920,
+				     1080, 1280, 720);
+		compare_with_swscale(formats[i], VIDEO_SCALE_BILINEAR, 3840,
+				     2160, 1920, 1080);
+	}
+}
+
+static void upscale_test(void **state)
+{
+	/* 1080 output lines, split in slices */
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		compare_with_swscale(formats[i], VIDEO_SCALE_BILINEAR, 1280,
+				     720, 1920, 1080);
+		compare_with_swscale(formats[i], VIDEO_SCALE_BICUBIC, 1280,
+				     720, 1920, 1080);
+	}
+}
+
+/* video-io scales the raw outputs that ask for another size with it */
+static void fast_bilinear_test(void **state)
+{
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		compare_with_swscale(formats[i], VIDEO_SCALE_FAST_BILINEAR,
+				     1920, 1080, 1280, 720);
+		compare_with_swscale(formats[i], VIDEO_SCALE_FAST_BILINEAR,
+				     3840, 2160, 1920, 1080);
+		compare_with_swscale(formats[i], VIDEO_SCALE_FAST_BILINEAR,
+				     1280, 720, 1920, 1080);
+	}
+}
+
+static void fallback_test(void **state)
+{
+	struct video_scale_info src = make_info(VIDEO_FORMAT_NV12, 1920, 1080);
+	struct video_scale_info dst = make_info(VIDEO_FORMAT_NV12, 1280, 720);
+	struct simd_scaler *scaler;
+
+	/* Default colorspace and range are 709 and partial, as in swscale */
+	dst.colorspace = VIDEO_CS_DEFAULT;
+	dst.range = VIDEO_RANGE_DEFAULT;
+	scaler = simd_scaler_create(&dst, &src, VIDEO_SCALE_BILINEAR);
+	assert_non_null(scaler);
+	simd_scaler_destroy(scaler);
+
+	/* Conversions are left to swscale */
+	dst = make_info(VIDEO_FORMAT_NV12, 1280, 720);
+	dst.colorspace = VIDEO_CS_601;
+	assert_null(simd_scaler_create(&dst, &src, VIDEO_SCALE_BILINEAR));
+
+	dst = make_info(VIDEO_FORMAT_NV12, 1280, 720);
+	dst.range = VIDEO_RANGE_FULL;
+	assert_null(simd_scaler_create(&dst, &src, VIDEO_SCALE_BILINEAR));
+
+	dst = make_info(VIDEO_FORMAT_I420, 1280, 720);
+	assert_null(simd_scaler_create(&dst, &src, VIDEO_SCALE_BILINEAR));
+
+	dst = make_info(VIDEO_FORMAT_NV12, 1280, 720);
+	assert_null(simd_scaler_create(&dst, &src, VIDEO_SCALE_POINT));
+
+	/* which video_scaler_create still handles */
+	dst.colorspace = VIDEO_CS_601;
+	video_scaler_t *video_scaler = NULL;
+	assert_int_equal(video_scaler_create(&video_scaler, &dst, &src,
+					     VIDEO_SCALE_BILINEAR),
+			 VIDEO_SCALER_SUCCESS);
+
+	struct video_frame input, output;
+	video_frame_init(&input, VIDEO_FORMAT_NV12, 1920, 1080);
+	video_frame_init(&output, VIDEO_FORMAT_NV12, 1280, 720);
+	fill_frame(&input, VIDEO_FORMAT_NV12, 1920, 1080);
+	assert_true(video_scaler_scale(video_scaler, output.data,
+				       output.linesize,
+				       (const uint8_t *const *)input.data,
+				       input.linesize));
+
+	video_scaler_destroy(video_scaler);
+	video_frame_free(&input);
+	video_frame_free(&output);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(downscale_test),
+		cmocka_unit_test(upscale_test),
+		cmocka_unit_test(fast_bilinear_test),
+		cmocka_unit_test(fallback_test),
+	};
+
+	/* the SIMD paths of swscale place fast bilinear samples differently
+	 * from one CPU to the other, its C one is compared to */
+	av_force_cpu_flags(0);
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}